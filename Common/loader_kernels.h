@@ -0,0 +1,479 @@
+/**
+  ******************************************************************************
+  * @file    loader_kernels.h
+  * @author  MCD Application Team
+  * @brief   Data kernels shared by the external loaders: byte sums of the
+  *          CheckSum and Verify entry points, LZ4 block decoding, CRC-32 on
+  *          the CRC unit and SHA-256 on the HASH unit or in software.
+  *          Included by Loader_Src.c after its device and driver headers,
+  *          the kernels being built with the device definitions of each
+  *          board.
+  *
+  ******************************************************************************
+  * @attention
+  *
+  * <h2><center>&copy; Copyright (c) 2021 STMicroelectronics.
+  * All rights reserved.</center></h2>
+  *
+  * This software component is licensed by ST under BSD 3-Clause license,
+  * the "License"; You may not use this file except in compliance with the
+  * License. You may obtain a copy of the License at:
+  *                        opensource.org/licenses/BSD-3-Clause
+  *
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __LOADER_KERNELS_H
+#define __LOADER_KERNELS_H
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdint.h>
+#include <string.h>
+
+/* Without the bit reversal bits, as on the CRC unit of the STM32F4 or with
+   the STM32F7 standard peripheral headers, the unit is used at its reset
+   configuration and the input words and the result are bit-reversed by the
+   core */
+#if defined(CRC_CR_REV_IN)
+#define CRC32_WORD(Word) (Word)
+#else
+#define CRC32_WORD(Word) __RBIT(Word)
+#endif
+
+/**
+  * Description :
+  * Adds up the bytes of a word-aligned zone, four words per iteration
+  * Inputs    :
+  *      Data          : Word-aligned start of the zone
+  *      Words         : Size (in 32-bit words)
+  * outputs   :
+  *     R0             : Sum of the bytes
+  */
+__STATIC_INLINE uint32_t CheckSum_Words(const uint32_t* Data, uint32_t Words)
+{
+  uint32_t Sum = 0;
+  uint32_t Lanes;
+  uint32_t Count;
+
+  while(Words >= 4)
+  {
+    /* Each word adds at most 2*0xFF to both 16-bit lanes, so the lanes are
+       folded every 32 iterations before they can overflow */
+    Count = Words/4;
+    if(Count > 32)
+    {
+      Count = 32;
+    }
+    Words -= Count*4;
+
+    Lanes = 0;
+    while(Count--)
+    {
+      Lanes += (Data[0] & 0x00FF00FF) + ((Data[0] >> 8) & 0x00FF00FF);
+      Lanes += (Data[1] & 0x00FF00FF) + ((Data[1] >> 8) & 0x00FF00FF);
+      Lanes += (Data[2] & 0x00FF00FF) + ((Data[2] >> 8) & 0x00FF00FF);
+      Lanes += (Data[3] & 0x00FF00FF) + ((Data[3] >> 8) & 0x00FF00FF);
+      Data += 4;
+    }
+    Sum += (Lanes & 0xFFFF) + (Lanes >> 16);
+  }
+
+  while(Words--)
+  {
+    Lanes = (*Data & 0x00FF00FF) + ((*Data >> 8) & 0x00FF00FF);
+    Sum += (Lanes & 0xFFFF) + (Lanes >> 16);
+    Data++;
+  }
+
+  return Sum;
+}
+
+/**
+  * Description :
+  * Compares a word-aligned zone with a RAM buffer and adds up the bytes of
+  * the zone in the same pass
+  * Inputs    :
+  *      Data          : Word-aligned start of the zone
+  *      Buffer        : Word-aligned RAM buffer
+  *      Words         : Size (in 32-bit words)
+  *      Sum           : Sum of the bytes, incremented
+  * outputs   :
+  *     R0             : Offset (in bytes) of the first differing word, or
+  *                      the zone size
+  */
+__STATIC_INLINE uint32_t Verify_Words(const uint32_t* Data, const uint32_t* Buffer, uint32_t Words, uint32_t* Sum)
+{
+  uint32_t Offset = 0;
+  uint32_t Lanes;
+  uint32_t Count;
+  uint32_t Val;
+
+  while(Words != 0)
+  {
+    /* Lanes folded every 128 words, as in CheckSum_Words */
+    Count = (Words > 128) ? 128 : Words;
+    Words -= Count;
+
+    Lanes = 0;
+    while(Count--)
+    {
+      Val = *Data++;
+      if(Val != *Buffer++)
+      {
+        return Offset;
+      }
+      Lanes += (Val & 0x00FF00FF) + ((Val >> 8) & 0x00FF00FF);
+      Offset += 4;
+    }
+    *Sum += (Lanes & 0xFFFF) + (Lanes >> 16);
+  }
+
+  return Offset;
+}
+
+/**
+  * Description :
+  * Derives the CheckSum value of a verified zone from the sum of all its
+  * bytes, taking back the bytes CheckSum leaves out of the first and last words
+  * Inputs    :
+  *      Buffer        : Word-aligned RAM copy of the zone
+  *      Size          : Size (in bytes, multiple of 4)
+  *      missalignement: Leading bytes in bits 0-3, trailing bytes in bits
+  *                      16-19, both below 4
+  *      Sum           : Sum of the bytes of the zone
+  * outputs   :
+  *     R0             : Checksum value
+  */
+__STATIC_INLINE uint32_t Verify_CheckSum(const uint32_t* Buffer, uint32_t Size, uint32_t missalignement, uint32_t Sum)
+{
+  uint32_t Head = missalignement & 0xF;
+  uint32_t Tail = (missalignement >> 16) & 0xF;
+  uint32_t Val;
+
+  Val = Buffer[0] & ~(0xFFFFFFFF << (8*Head));
+  Sum -= CheckSum_Words(&Val, 1);
+
+  /* The leading bytes take precedence in a single word zone */
+  if((Head == 0) || (Size > 4))
+  {
+    Val = Buffer[Size/4 - 1];
+    /* A partial last word only counts in zones below 256 bytes, see CheckSum */
+    if((Tail == 0) || ((Size - Tail) < 0x100))
+    {
+      Val &= ~(0xFFFFFFFF >> (8*Tail));
+    }
+    Sum -= CheckSum_Words(&Val, 1);
+  }
+
+  return Sum;
+}
+
+/**
+  * @brief   Decode one LZ4 block.
+  * @param   Src     : pointer to the compressed block
+  * @param   SrcSize : size of the compressed block
+  * @param   Dst     : pointer to the decode buffer
+  * @param   DstSize : size of the decode buffer
+  * @retval  Number of bytes decoded, 0 if the block is malformed
+  */
+__STATIC_INLINE uint32_t LZ4_DecodeBlock(const uint8_t* Src, uint32_t SrcSize, uint8_t* Dst, uint32_t DstSize)
+{
+  const uint8_t* SrcEnd = Src + SrcSize;
+  uint32_t Out = 0;
+  uint32_t Length;
+  uint32_t Offset;
+  uint8_t Token;
+  uint8_t Byte;
+
+  while(Src < SrcEnd)
+  {
+    Token = *Src++;
+
+    /* Literals, the length being extended by bytes while they read 255 */
+    Length = Token >> 4;
+    if(Length == 15)
+    {
+      do
+      {
+        if(Src == SrcEnd)
+          return 0;
+        Byte = *Src++;
+        Length += Byte;
+      } while(Byte == 255);
+    }
+    if((Length > (uint32_t)(SrcEnd - Src)) || (Length > (DstSize - Out)))
+      return 0;
+    memcpy(&Dst[Out], Src, Length);
+    Src += Length;
+    Out += Length;
+
+    /* The last sequence of the block has no match */
+    if(Src == SrcEnd)
+      break;
+
+    /* Match, copied from the bytes already decoded */
+    if((SrcEnd - Src) < 2)
+      return 0;
+    Offset = Src[0] | ((uint32_t)Src[1] << 8);
+    Src += 2;
+    if((Offset == 0) || (Offset > Out))
+      return 0;
+    Length = Token & 0x0F;
+    if(Length == 15)
+    {
+      do
+      {
+        if(Src == SrcEnd)
+          return 0;
+        Byte = *Src++;
+        Length += Byte;
+      } while(Byte == 255);
+    }
+    Length += 4;
+    if(Length > (DstSize - Out))
+      return 0;
+    /* Byte by byte, the match may overlap the bytes it produces */
+    while(Length != 0)
+    {
+      Dst[Out] = Dst[Out - Offset];
+      Out++;
+      Length--;
+    }
+  }
+
+  return Out;
+}
+
+/**
+  * @brief   Starts a CRC-32 calculation on the CRC unit.
+  * @retval  None
+  */
+__STATIC_INLINE void CRC32_Start(void)
+{
+#if defined(__HAL_RCC_CRC_CLK_ENABLE)
+  __HAL_RCC_CRC_CLK_ENABLE();
+#else
+  RCC_AHB1PeriphClockCmd(RCC_AHB1Periph_CRC, ENABLE);
+#endif
+#if defined(CRC_CR_REV_IN)
+  /* Bit-reversed words in and out, the bytes being processed in memory
+     order least significant bit first */
+  CRC->INIT = 0xFFFFFFFF;
+  CRC->CR = CRC_CR_REV_IN | CRC_CR_REV_OUT | CRC_CR_RESET;
+#else
+  /* Reset configuration, CRC32_Words bit-reversing the input words */
+  CRC->CR = CRC_CR_RESET;
+#endif
+}
+
+/**
+  * @brief   Feeds the whole words of a zone to the CRC unit.
+  * @param   Data  : start of the zone, aligned or not
+  * @param   Words : Size (in 32-bit words)
+  * @retval  None
+  */
+__STATIC_INLINE void CRC32_Words(const uint8_t* Data, uint32_t Words)
+{
+  if(((uint32_t)Data & 0x3) == 0)
+  {
+    while(Words > 0)
+    {
+      CRC->DR = CRC32_WORD(*(const uint32_t*)Data);
+      Data += 4;
+      Words--;
+    }
+  }
+  else
+  {
+    /* Words rebuilt from bytes, in little-endian order */
+    while(Words > 0)
+    {
+      CRC->DR = CRC32_WORD(Data[0] | ((uint32_t)Data[1] << 8) | ((uint32_t)Data[2] << 16) | ((uint32_t)Data[3] << 24));
+      Data += 4;
+      Words--;
+    }
+  }
+}
+
+/**
+  * @brief   Completes the CRC-32 calculation with the last bytes of the zone.
+  * @param   Data : bytes following the whole words
+  * @param   Size : number of bytes, below 4
+  * @retval  CRC-32 of the zone
+  */
+__STATIC_INLINE uint32_t CRC32_End(const uint8_t* Data, uint32_t Size)
+{
+  uint32_t Crc = CRC32_WORD(CRC->DR);
+  uint32_t Bit;
+
+  /* Bitwise, with the reflected polynomial */
+  while(Size > 0)
+  {
+    Crc ^= *Data++;
+    for(Bit = 0; Bit < 8; Bit++)
+      Crc = (Crc >> 1) ^ (0xEDB88320 & (0 - (Crc & 1)));
+    Size--;
+  }
+
+  return ~Crc;
+}
+
+#if defined(HASH)
+/**
+  * @brief   Calculates the SHA-256 digest of a memory zone on the HASH unit.
+  *          The unit swaps the bytes of the input words, so that they are
+  *          hashed in memory order.
+  * @param   Data   : start of the zone
+  * @param   Size   : size of the zone (in bytes)
+  * @param   Digest : 32-byte digest
+  * @retval  None
+  */
+__STATIC_INLINE void SHA256_Calculate(const uint8_t* Data, uint32_t Size, uint8_t* Digest)
+{
+  uint32_t Words = Size / 4;
+  uint32_t Tail = Size % 4;
+  uint32_t Last = 0;
+  uint32_t i;
+
+#if defined(__HAL_RCC_HASH_CLK_ENABLE)
+  __HAL_RCC_HASH_CLK_ENABLE();
+#else
+  RCC_AHB2PeriphClockCmd(RCC_AHB2Periph_HASH, ENABLE);
+#endif
+  HASH->CR = HASH_CR_ALGO_1 | HASH_CR_ALGO_0 | HASH_CR_DATATYPE_1 | HASH_CR_INIT;
+  /* Number of valid bits in the last word */
+  HASH->STR = 8 * Tail;
+
+  /* The writes to DIN are stalled while the unit processes a block */
+  if(((uint32_t)Data & 0x3) == 0)
+  {
+    while(Words > 0)
+    {
+      HASH->DIN = *(const uint32_t*)Data;
+      Data += 4;
+      Words--;
+    }
+  }
+  else
+  {
+    while(Words > 0)
+    {
+      HASH->DIN = Data[0] | ((uint32_t)Data[1] << 8) | ((uint32_t)Data[2] << 16) | ((uint32_t)Data[3] << 24);
+      Data += 4;
+      Words--;
+    }
+  }
+  if(Tail != 0)
+  {
+    for(i = 0; i < Tail; i++)
+      Last |= (uint32_t)Data[i] << (8 * i);
+    HASH->DIN = Last;
+  }
+
+  /* Pad the message and wait for the digest */
+  HASH->STR |= HASH_STR_DCAL;
+  while((HASH->SR & HASH_SR_DCIS) == 0);
+
+  for(i = 0; i < 32; i++)
+    Digest[i] = (uint8_t)(HASH_DIGEST->HR[i / 4] >> (24 - 8 * (i % 4)));
+}
+#else
+/**
+  * @brief   Runs the SHA-256 compression function over 64-byte blocks.
+  *          The message schedule is kept in a 16-word ring.
+  * @param   State  : hash state, 8 words
+  * @param   Data   : start of the blocks, aligned or not
+  * @param   Blocks : number of 64-byte blocks
+  * @retval  None
+  */
+__STATIC_INLINE void SHA256_Blocks(uint32_t* State, const uint8_t* Data, uint32_t Blocks)
+{
+  /* SHA-256 round constants */
+  static const uint32_t SHA256_K[64] =
+  {
+    0x428A2F98, 0x71374491, 0xB5C0FBCF, 0xE9B5DBA5, 0x3956C25B, 0x59F111F1, 0x923F82A4, 0xAB1C5ED5,
+    0xD807AA98, 0x12835B01, 0x243185BE, 0x550C7DC3, 0x72BE5D74, 0x80DEB1FE, 0x9BDC06A7, 0xC19BF174,
+    0xE49B69C1, 0xEFBE4786, 0x0FC19DC6, 0x240CA1CC, 0x2DE92C6F, 0x4A7484AA, 0x5CB0A9DC, 0x76F988DA,
+    0x983E5152, 0xA831C66D, 0xB00327C8, 0xBF597FC7, 0xC6E00BF3, 0xD5A79147, 0x06CA6351, 0x14292967,
+    0x27B70A85, 0x2E1B2138, 0x4D2C6DFC, 0x53380D13, 0x650A7354, 0x766A0ABB, 0x81C2C92E, 0x92722C85,
+    0xA2BFE8A1, 0xA81A664B, 0xC24B8B70, 0xC76C51A3, 0xD192E819, 0xD6990624, 0xF40E3585, 0x106AA070,
+    0x19A4C116, 0x1E376C08, 0x2748774C, 0x34B0BCB5, 0x391C0CB3, 0x4ED8AA4A, 0x5B9CCA4F, 0x682E6FF3,
+    0x748F82EE, 0x78A5636F, 0x84C87814, 0x8CC70208, 0x90BEFFFA, 0xA4506CEB, 0xBEF9A3F7, 0xC67178F2
+  };
+  uint32_t W[16];
+  uint32_t a, b, c, d, e, f, g, h;
+  uint32_t T1, T2;
+  uint32_t i;
+
+  while(Blocks > 0)
+  {
+    for(i = 0; i < 16; i++)
+    {
+      if(((uint32_t)Data & 0x3) == 0)
+        W[i] = __REV(((const uint32_t*)Data)[i]);
+      else
+        W[i] = ((uint32_t)Data[4*i] << 24) | ((uint32_t)Data[4*i+1] << 16) | ((uint32_t)Data[4*i+2] << 8) | Data[4*i+3];
+    }
+
+    a = State[0]; b = State[1]; c = State[2]; d = State[3];
+    e = State[4]; f = State[5]; g = State[6]; h = State[7];
+    for(i = 0; i < 64; i++)
+    {
+      if(i >= 16)
+      {
+        T1 = W[(i + 14) & 15];
+        T2 = W[(i + 1) & 15];
+        W[i & 15] += (__ROR(T1, 17) ^ __ROR(T1, 19) ^ (T1 >> 10)) + W[(i + 9) & 15]
+                   + (__ROR(T2, 7) ^ __ROR(T2, 18) ^ (T2 >> 3));
+      }
+      T1 = h + (__ROR(e, 6) ^ __ROR(e, 11) ^ __ROR(e, 25)) + (g ^ (e & (f ^ g))) + SHA256_K[i] + W[i & 15];
+      T2 = (__ROR(a, 2) ^ __ROR(a, 13) ^ __ROR(a, 22)) + ((a & b) | (c & (a | b)));
+      h = g; g = f; f = e; e = d + T1;
+      d = c; c = b; b = a; a = T1 + T2;
+    }
+    State[0] += a; State[1] += b; State[2] += c; State[3] += d;
+    State[4] += e; State[5] += f; State[6] += g; State[7] += h;
+
+    Data += 64;
+    Blocks--;
+  }
+}
+
+/**
+  * @brief   Calculates the SHA-256 digest of a memory zone in software.
+  * @param   Data   : start of the zone
+  * @param   Size   : size of the zone (in bytes)
+  * @param   Digest : 32-byte digest
+  * @retval  None
+  */
+__STATIC_INLINE void SHA256_Calculate(const uint8_t* Data, uint32_t Size, uint8_t* Digest)
+{
+  uint32_t State[8] = {0x6A09E667, 0xBB67AE85, 0x3C6EF372, 0xA54FF53A,
+                       0x510E527F, 0x9B05688C, 0x1F83D9AB, 0x5BE0CD19};
+  uint8_t Block[128];
+  uint32_t Tail = Size % 64;
+  uint32_t Pad = (Tail < 56) ? 64 : 128;
+  uint32_t i;
+
+  /* Whole blocks straight from the memory, the padded tail from RAM */
+  SHA256_Blocks(State, Data, Size / 64);
+  Data += Size - Tail;
+  for(i = 0; i < Pad; i++)
+    Block[i] = (i < Tail) ? Data[i] : 0;
+  Block[Tail] = 0x80;
+  Block[Pad - 5] = (uint8_t)(Size >> 29);
+  Block[Pad - 4] = (uint8_t)(Size >> 21);
+  Block[Pad - 3] = (uint8_t)(Size >> 13);
+  Block[Pad - 2] = (uint8_t)(Size >> 5);
+  Block[Pad - 1] = (uint8_t)(Size << 3);
+  SHA256_Blocks(State, Block, Pad / 64);
+
+  for(i = 0; i < 32; i++)
+    Digest[i] = (uint8_t)(State[i / 4] >> (24 - 8 * (i % 4)));
+}
+#endif /* HASH */
+
+#endif /* __LOADER_KERNELS_H */
+
+/************************ (C) COPYRIGHT STMicroelectronics *****END OF FILE****/
@@ -0,0 +1,236 @@
+/**
+  ******************************************************************************
+  * @file    loader_trace.h
+  * @author  MCD Application Team
+  * @brief   Command trace of the QSPI and OSPI external loaders: layout of the
+  *          CommandTrace ring the host reads over SWD, and, in the loaders
+  *          built with USE_COMMAND_TRACE, the wrappers logging each command
+  *          sent to the memory.
+  *          The file is included after the HAL headers by Loader_Src.h and by
+  *          the drivers calling HAL_QSPI_Command or HAL_OSPI_Command. The HAL
+  *          command calls of these files then go through the Trace_QSPI_ and
+  *          Trace_OSPI_ wrappers below, which log a TRACE_COMMAND record and
+  *          call the HAL function. The HAL driver itself is not changed.
+  *
+  ******************************************************************************
+  * @attention
+  *
+  * <h2><center>&copy; Copyright (c) 2021 STMicroelectronics.
+  * All rights reserved.</center></h2>
+  *
+  * This software component is licensed by ST under BSD 3-Clause license,
+  * the "License"; You may not use this file except in compliance with the
+  * License. You may obtain a copy of the License at:
+  *                        opensource.org/licenses/BSD-3-Clause
+  *
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __LOADER_TRACE_H
+#define __LOADER_TRACE_H
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdint.h>
+
+/* Exported constants --------------------------------------------------------*/
+/* Records kept by CommandTrace, a power of two */
+#define TRACE_DEPTH 128
+
+/* Value of CommandTrace.Magic once the trace is initialized, the host
+   clearing Magic to restart the trace */
+#define TRACE_MAGIC 0x54524345
+
+/* TRACE_RECORD.Kind values */
+#define TRACE_OPERATION  0x0U  /*!< Loader entry point called          */
+#define TRACE_CALL       0x1U  /*!< BSP function called, wait started  */
+#define TRACE_RETURN     0x2U  /*!< BSP function returned, wait over   */
+#define TRACE_COMMAND    0x3U  /*!< Command sent to the memory         */
+
+/* TRACE_RECORD.Call of a TRACE_COMMAND record, the HAL function sending it */
+#define TRACE_HAL_COMMAND        0x0U  /*!< Indirect or status command     */
+#define TRACE_HAL_AUTO_POLLING   0x1U  /*!< Status polled by the interface */
+#define TRACE_HAL_MEMORY_MAPPED  0x2U  /*!< Read or write command of the
+                                            memory-mapped mode             */
+
+/* Fields of TRACE_RECORD.Modes in a TRACE_COMMAND record: lines of the
+   instruction, address and data phases (0 when the phase is absent, 1, 2, 4
+   or 8), bytes of the address, dummy cycles, and a double transfer rate
+   phase */
+#define TRACE_MODES_INSTRUCTION(Modes)    ((Modes) & 0xFU)
+#define TRACE_MODES_ADDRESS(Modes)        (((Modes) >> 4) & 0xFU)
+#define TRACE_MODES_DATA(Modes)           (((Modes) >> 8) & 0xFU)
+#define TRACE_MODES_ADDRESS_BYTES(Modes)  (((Modes) >> 12) & 0xFU)
+#define TRACE_MODES_DUMMY(Modes)          (((Modes) >> 16) & 0xFFU)
+#define TRACE_MODES_DTR                   (1U << 24)
+
+/* Lines of a phase from its mode divided by the 1-line mode of the HAL:
+   0 for no phase, then 1, 2, 3 and 4 for 1, 2, 4 and 8 lines */
+#define TRACE_LINES(Index)  (((Index) == 0U) ? 0U : (1U << ((Index) - 1U)))
+
+/* TRACE_RECORD.Modes of a command */
+#define TRACE_MODES(Instruction, Address, Data, AddressBytes, Dummy, Dtr)      \
+        (TRACE_LINES(Instruction) | (TRACE_LINES(Address) << 4) |              \
+         (TRACE_LINES(Data) << 8) | ((AddressBytes) << 12) |                   \
+         (((Dummy) & 0xFFU) << 16) | ((Dtr) ? TRACE_MODES_DTR : 0U))
+
+#ifdef USE_COMMAND_TRACE
+/* Logs a record in CommandTrace */
+#define trace_command(Kind, Call, Address, Size, Status) \
+        Trace_Command((Kind), (Call), (Address), (Size), (Status))
+/* Runs the BSP call Expr between a TRACE_CALL record and a TRACE_RETURN
+   record holding the status it returns */
+#define trace_bsp(Call, Address, Size, Expr) \
+        (Trace_Command(TRACE_CALL, (Call), (Address), (Size), 0U), Trace_Return((Call), (Expr)))
+#else
+#define trace_command(Kind, Call, Address, Size, Status) ((void)0U)
+#define trace_bsp(Call, Address, Size, Expr) (Expr)
+#endif /* USE_COMMAND_TRACE */
+
+/* Exported types ------------------------------------------------------------*/
+/**
+  * @brief BSP calls logged in CommandTrace, the TRACE_RECORD.Call of the
+  *        TRACE_CALL and TRACE_RETURN records
+  */
+typedef enum
+{
+  TRACE_BSP_INIT = 0,       /*!< Interface and memory initialized         */
+  TRACE_BSP_DEINIT,         /*!< Interface de-initialized                 */
+  TRACE_BSP_READ,           /*!< Read in indirect mode                    */
+  TRACE_BSP_WRITE,          /*!< Pages programmed                         */
+  TRACE_BSP_ERASE_BLOCK,    /*!< Block erase started                      */
+  TRACE_BSP_ERASE_CHIP,     /*!< Chip erase started                       */
+  TRACE_BSP_WAIT,           /*!< Status polled until the memory is ready  */
+  TRACE_BSP_READ_ID,        /*!< Memory ID read                           */
+  TRACE_BSP_READ_SFDP,      /*!< SFDP tables read                         */
+  TRACE_BSP_MEMORY_MAPPED,  /*!< Memory-mapped mode enabled               */
+  TRACE_BSP_INDIRECT        /*!< Memory-mapped mode disabled              */
+} TRACE_BSP;
+
+/**
+  * @brief Record logged in CommandTrace
+  */
+typedef struct
+{
+  uint32_t Cycles;       /*!< DWT cycle count when the record was logged   */
+  uint32_t Kind;         /*!< TRACE_OPERATION, TRACE_CALL, TRACE_RETURN or
+                              TRACE_COMMAND                                */
+  uint32_t Call;         /*!< TRACE_BSP of a call, PERF_ENTRY of an
+                              operation, TRACE_HAL_ of a command           */
+  uint32_t Address;      /*!< Memory address of a read, write, block erase
+                              or command                                   */
+  uint32_t Size;         /*!< Bytes of a read or write, of an operation, of
+                              the data phase of a command, or status bytes
+                              of a polling                                 */
+  uint32_t Status;       /*!< Status the BSP or the HAL returned, in a
+                              TRACE_RETURN or TRACE_COMMAND                */
+  uint32_t Instruction;  /*!< Instruction of a command                     */
+  uint32_t Modes;        /*!< TRACE_MODES of a command                     */
+} TRACE_RECORD;
+
+/**
+  * @brief Command trace, kept across loader calls. The records are logged in
+  *        a ring: the last one is Records[(Head - 1) % TRACE_DEPTH] and the
+  *        oldest kept the TRACE_DEPTH before it. A BSP call lasts from its
+  *        TRACE_CALL record to its TRACE_RETURN record, the commands it sends
+  *        being logged in between.
+  */
+typedef struct
+{
+  uint32_t Magic;                       /*!< TRACE_MAGIC once initialized    */
+  uint32_t Depth;                       /*!< TRACE_DEPTH                     */
+  uint32_t Head;                        /*!< Records logged, free running    */
+  TRACE_RECORD Records[TRACE_DEPTH];    /*!< Ring of the last records        */
+} TRACE_BUFFER;
+
+/* Exported functions --------------------------------------------------------*/
+#ifdef USE_COMMAND_TRACE
+/* Defined in Loader_Src.c: logs a TRACE_COMMAND record, then the status the
+   HAL returned for it */
+void Trace_Hal(uint32_t Call, uint32_t Instruction, uint32_t Modes, uint32_t Address, uint32_t Size);
+uint32_t Trace_HalReturn(uint32_t Status);
+
+#if defined(HAL_QSPI_MODULE_ENABLED) && defined(QUADSPI)
+/**
+  * @brief  TRACE_MODES of a QUADSPI command.
+  * @param  cmd : command of the HAL
+  * @retval Modes
+  */
+__STATIC_INLINE uint32_t Trace_QSPI_Modes(const QSPI_CommandTypeDef *cmd)
+{
+  return TRACE_MODES(cmd->InstructionMode / QSPI_INSTRUCTION_1_LINE,
+                     cmd->AddressMode / QSPI_ADDRESS_1_LINE,
+                     cmd->DataMode / QSPI_DATA_1_LINE,
+                     (cmd->AddressMode == QSPI_ADDRESS_NONE) ? 0U : (cmd->AddressSize / QSPI_ADDRESS_16_BITS + 1U),
+                     cmd->DummyCycles, cmd->DdrMode != QSPI_DDR_MODE_DISABLE);
+}
+
+/**
+  * @brief  Logs and sends a QUADSPI command, in place of HAL_QSPI_Command.
+  * @param  hqspi, cmd, Timeout : parameters of HAL_QSPI_Command
+  * @retval Status of HAL_QSPI_Command
+  */
+__STATIC_INLINE HAL_StatusTypeDef Trace_QSPI_Command(QSPI_HandleTypeDef *hqspi, QSPI_CommandTypeDef *cmd, uint32_t Timeout)
+{
+  Trace_Hal(TRACE_HAL_COMMAND, cmd->Instruction, Trace_QSPI_Modes(cmd),
+            (cmd->AddressMode == QSPI_ADDRESS_NONE) ? 0U : cmd->Address,
+            (cmd->DataMode == QSPI_DATA_NONE) ? 0U : cmd->NbData);
+  return (HAL_StatusTypeDef)Trace_HalReturn((uint32_t)(HAL_QSPI_Command)(hqspi, cmd, Timeout));
+}
+
+/**
+  * @brief  Logs and sends a QUADSPI status polling, in place of
+  *         HAL_QSPI_AutoPolling.
+  * @param  hqspi, cmd, cfg, Timeout : parameters of HAL_QSPI_AutoPolling
+  * @retval Status of HAL_QSPI_AutoPolling
+  */
+__STATIC_INLINE HAL_StatusTypeDef Trace_QSPI_AutoPolling(QSPI_HandleTypeDef *hqspi, QSPI_CommandTypeDef *cmd, QSPI_AutoPollingTypeDef *cfg, uint32_t Timeout)
+{
+  Trace_Hal(TRACE_HAL_AUTO_POLLING, cmd->Instruction, Trace_QSPI_Modes(cmd),
+            (cmd->AddressMode == QSPI_ADDRESS_NONE) ? 0U : cmd->Address, cfg->StatusBytesSize);
+  return (HAL_StatusTypeDef)Trace_HalReturn((uint32_t)(HAL_QSPI_AutoPolling)(hqspi, cmd, cfg, Timeout));
+}
+
+/**
+  * @brief  Logs and configures the QUADSPI memory-mapped read command, in
+  *         place of HAL_QSPI_MemoryMapped.
+  * @param  hqspi, cmd, cfg : parameters of HAL_QSPI_MemoryMapped
+  * @retval Status of HAL_QSPI_MemoryMapped
+  */
+__STATIC_INLINE HAL_StatusTypeDef Trace_QSPI_MemoryMapped(QSPI_HandleTypeDef *hqspi, QSPI_CommandTypeDef *cmd, QSPI_MemoryMappedTypeDef *cfg)
+{
+  Trace_Hal(TRACE_HAL_MEMORY_MAPPED, cmd->Instruction, Trace_QSPI_Modes(cmd), 0U, 0U);
+  return (HAL_StatusTypeDef)Trace_HalReturn((uint32_t)(HAL_QSPI_MemoryMapped)(hqspi, cmd, cfg));
+}
+
+#define HAL_QSPI_Command(hqspi, cmd, Timeout)           Trace_QSPI_Command((hqspi), (cmd), (Timeout))
+#define HAL_QSPI_AutoPolling(hqspi, cmd, cfg, Timeout)  Trace_QSPI_AutoPolling((hqspi), (cmd), (cfg), (Timeout))
+#define HAL_QSPI_MemoryMapped(hqspi, cmd, cfg)          Trace_QSPI_MemoryMapped((hqspi), (cmd), (cfg))
+#endif /* HAL_QSPI_MODULE_ENABLED */
+
+#if defined(HAL_OSPI_MODULE_ENABLED) && (defined(OCTOSPI) || defined(OCTOSPI1))
+/* The command is read by its fields only: the OCTOSPI types are named
+   HAL_OSPI_HandleTypeDef and HAL_OSPI_RegularCmdTypeDef in the first HAL
+   releases of the STM32L4+ devices. */
+#define TRACE_OSPI_MODES(cmd)  TRACE_MODES((cmd)->InstructionMode / HAL_OSPI_INSTRUCTION_1_LINE,                 \
+                                           (cmd)->AddressMode / HAL_OSPI_ADDRESS_1_LINE,                         \
+                                           (cmd)->DataMode / HAL_OSPI_DATA_1_LINE,                               \
+                                           ((cmd)->AddressMode == HAL_OSPI_ADDRESS_NONE) ? 0U :                  \
+                                           ((cmd)->AddressSize / HAL_OSPI_ADDRESS_16_BITS + 1U),                 \
+                                           (cmd)->DummyCycles,                                                   \
+                                           ((cmd)->InstructionDtrMode | (cmd)->AddressDtrMode | (cmd)->DataDtrMode) != 0U)
+
+/* Logs and sends an OCTOSPI command. The read and write commands of the
+   memory-mapped mode are logged as TRACE_HAL_MEMORY_MAPPED. */
+#define HAL_OSPI_Command(hospi, cmd, Timeout)                                                                    \
+  (Trace_Hal(((cmd)->OperationType == HAL_OSPI_OPTYPE_COMMON_CFG) ? TRACE_HAL_COMMAND : TRACE_HAL_MEMORY_MAPPED, \
+             (cmd)->Instruction, TRACE_OSPI_MODES(cmd),                                                         \
+             ((cmd)->AddressMode == HAL_OSPI_ADDRESS_NONE) ? 0U : (cmd)->Address,                              \
+             ((cmd)->DataMode == HAL_OSPI_DATA_NONE) ? 0U : (cmd)->NbData),                                    \
+   (HAL_StatusTypeDef)Trace_HalReturn((uint32_t)(HAL_OSPI_Command)((hospi), (cmd), (Timeout))))
+#endif /* HAL_OSPI_MODULE_ENABLED */
+#endif /* USE_COMMAND_TRACE */
+
+#endif /* __LOADER_TRACE_H */
+
+/************************ (C) COPYRIGHT STMicroelectronics *****END OF FILE****/
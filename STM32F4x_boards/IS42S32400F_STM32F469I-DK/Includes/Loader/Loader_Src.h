@@ -30,11 +30,75 @@
 #define TIMEOUT 5000U
 #define KeepInCompilation __root
 
+/* Set to 1 to count the calls, bytes and DWT cycles of the loader operations
+   in PerfCounters, placed by Target.icf at the fixed address it exports as
+   __ICFEDIT_region_PERF_start__, for the host to read over SWD */
+#define PERF_COUNTERS 1
+
+/* Value of PerfCounters.Magic once the counters are initialized, the host
+   clearing Magic to restart the counts */
+#define PERF_MAGIC 0x50455246
+
+/**
+  * @brief Loader entry points counted in PerfCounters
+  */
+typedef enum
+{
+  PERF_INIT = 0,      /*!< Init                                         */
+  PERF_WRITE,         /*!< Write, also run by the other write functions */
+  PERF_SECTOR_ERASE,  /*!< SectorErase                                  */
+  PERF_MASS_ERASE,    /*!< MassErase, also run by a full SectorErase    */
+  PERF_VERIFY,        /*!< Verify                                       */
+  PERF_CHECKSUM,      /*!< CheckSum, also run by Verify on a mismatch   */
+  PERF_CHECKCRC,      /*!< CheckCRC                                     */
+  PERF_CHECKSHA256,   /*!< CheckSHA256                                  */
+  PERF_ENTRY_COUNT
+} PERF_ENTRY;
+
+/**
+  * @brief Phases the loader cycles are spent in
+  */
+typedef enum
+{
+  PERF_PHASE_INIT = 0,  /*!< Init, controller re-init and mode switches   */
+  PERF_PHASE_DATA,      /*!< Page program runs sent to the memory         */
+  PERF_PHASE_BUSY,      /*!< Erase commands and waits for the memory      */
+  PERF_PHASE_VERIFY,    /*!< Memory reads of Verify and of the checks     */
+  PERF_PHASE_COUNT
+} PERF_PHASE;
+
+/**
+  * @brief Timing of a memory operation (in DWT cycles)
+  */
+typedef struct
+{
+  uint32_t Count;       /*!< Operations timed, Total/Count the average    */
+  uint32_t Min;         /*!< Shortest operation                           */
+  uint32_t Max;         /*!< Longest operation                            */
+  uint64_t Total;       /*!< Sum of the operations                        */
+} PERF_TIMING;
+
+/**
+  * @brief Performance counters, kept across loader calls
+  */
+typedef struct
+{
+  uint32_t Magic;                     /*!< PERF_MAGIC once initialized        */
+  uint32_t CoreClock;                 /*!< Clock the cycles count at (Hz)     */
+  uint32_t Calls[PERF_ENTRY_COUNT];   /*!< Calls of each entry point          */
+  uint32_t Bytes[PERF_ENTRY_COUNT];   /*!< Bytes written, verified or checked */
+  uint64_t Cycles[PERF_PHASE_COUNT];  /*!< Cycles spent in each phase         */
+  PERF_TIMING PageProgram;            /*!< tPP, Count the pages programmed    */
+  PERF_TIMING BlockErase;             /*!< tBE, Count the blocks erased       */
+} PERF_BLOCK;
+
 /* Private function prototypes -----------------------------------------------*/
 int Init ();
 KeepInCompilation int Write (uint32_t Address, uint32_t Size, uint8_t* buffer);
 KeepInCompilation int SectorErase (uint32_t EraseStartAddress ,uint32_t EraseEndAddress);
 KeepInCompilation uint64_t Verify (uint32_t MemoryAddr, uint32_t RAMBufferAddr, uint32_t Size, uint32_t missalignement);
+KeepInCompilation uint32_t CheckCRC (uint32_t StartAddress, uint32_t Size);
+KeepInCompilation int CheckSHA256 (uint32_t StartAddress, uint32_t Size, uint8_t* Digest);
 KeepInCompilation HAL_StatusTypeDef HAL_InitTick(uint32_t TickPriority);
 KeepInCompilation int MassErase (uint32_t Parallelism );
 int SystemClock_Config(void);
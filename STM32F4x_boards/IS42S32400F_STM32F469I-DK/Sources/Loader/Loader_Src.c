@@ -21,11 +21,87 @@
 
 #include "Loader_Src.h"
 #include <string.h>
+#include "loader_kernels.h"
+
+#pragma section=".bss"
 
 /* Private variables ---------------------------------------------------------*/
+#if (PERF_COUNTERS == 1)
+__no_init PERF_BLOCK PerfCounters @ ".perf";
+#endif
 
 
 /* Private functions ---------------------------------------------------------*/
+/**
+  * @brief  Starts the DWT cycle counter. PerfCounters is cleared unless it
+  *         already holds the counts of the previous calls.
+  * @retval None
+  */
+static void Perf_Init(void)
+{
+#if (PERF_COUNTERS == 1)
+  CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+#if (__CORTEX_M == 7U)
+  /* The Cortex-M7 DWT is write-locked */
+  DWT->LAR = 0xC5ACCE55;
+#endif
+  DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
+  if(PerfCounters.Magic != PERF_MAGIC)
+  {
+    memset(&PerfCounters, 0, sizeof(PerfCounters));
+    PerfCounters.Magic = PERF_MAGIC;
+  }
+#endif
+}
+
+/**
+  * @brief  Reads the DWT cycle counter.
+  * @retval Cycle count, 0 without PERF_COUNTERS
+  */
+static uint32_t Perf_Cycles(void)
+{
+#if (PERF_COUNTERS == 1)
+  return DWT->CYCCNT;
+#else
+  return 0;
+#endif
+}
+
+/**
+  * @brief  Counts a call to a loader entry point.
+  * @param  Entry : entry point called
+  * @param  Size  : bytes handled by the call
+  * @retval None
+  */
+static void Perf_Count(PERF_ENTRY Entry, uint32_t Size)
+{
+#if (PERF_COUNTERS == 1)
+  PerfCounters.Calls[Entry]++;
+  PerfCounters.Bytes[Entry] += Size;
+#endif
+}
+
+/**
+  * @brief  Adds the cycles elapsed since Start to a phase, Start being moved
+  *         to the current count. The 64-bit totals do not wrap with the
+  *         counter as long as this is called once per 2^32 cycles.
+  * @param  Phase : phase the cycles were spent in
+  * @param  Start : cycle count the phase started at
+  * @retval None
+  */
+static void Perf_Add(PERF_PHASE Phase, uint32_t* Start)
+{
+#if (PERF_COUNTERS == 1)
+  uint32_t Now = DWT->CYCCNT;
+
+  PerfCounters.Cycles[Phase] += Now - *Start;
+  *Start = Now;
+  /* Init changes the clock the cycles count at */
+  PerfCounters.CoreClock = SystemCoreClock;
+#endif
+}
+
 KeepInCompilation HAL_StatusTypeDef HAL_InitTick(uint32_t TickPriority)
 { 
   return HAL_OK;
@@ -49,12 +125,18 @@ uint32_t HAL_GetTick(void)
 
 int Init()
 {
+  uint32_t Start;
   
 /*  Init structs to Zero*/
-   memset((void*)0x20001628, 0, 0xC0);
+   char *   startadd =  __section_begin(".bss");
+   uint32_t size =  __section_size(".bss");
+   memset(startadd,0,size);
     /*  init system*/
    SystemInit(); 
    HAL_Init();  
+   Perf_Init();
+   Perf_Count(PERF_INIT, 0);
+   Start = Perf_Cycles();
  
   /* Configure the system clock  */
    SystemClock_Config();
@@ -63,6 +145,7 @@ int Init()
    if(BSP_SDRAM_Init() !=0)
     return 0;
    
+   Perf_Add(PERF_PHASE_INIT, &Start);
    return 1;
 }
 
@@ -76,13 +159,16 @@ int Init()
   */
 KeepInCompilation int Write (uint32_t Address, uint32_t Size, uint8_t* buffer)
 {
+  uint32_t Start = Perf_Cycles();
  
+  Perf_Count(PERF_WRITE, Size);
       for(; Size != 0U; Size--)
   {
     *(__IO uint8_t *)Address =  *(__IO uint32_t *)buffer;
     buffer++;
     Address++;          
   }
+  Perf_Add(PERF_PHASE_DATA, &Start);
  
  return 1;
 
@@ -96,6 +182,7 @@ KeepInCompilation int Write (uint32_t Address, uint32_t Size, uint8_t* buffer)
   */
 KeepInCompilation int MassErase (uint32_t Parallelism ){
   
+  Perf_Count(PERF_MASS_ERASE, 0);
   return 1;
 }
 
@@ -107,6 +194,7 @@ KeepInCompilation int MassErase (uint32_t Parallelism ){
   */
 KeepInCompilation int SectorErase (uint32_t EraseStartAddress ,uint32_t EraseEndAddress)
 {
+  Perf_Count(PERF_SECTOR_ERASE, 0);
   return 1;	
 }
 
@@ -124,69 +212,42 @@ KeepInCompilation int SectorErase (uint32_t EraseStartAddress ,uint32_t EraseEnd
   */
 uint32_t CheckSum(uint32_t StartAddress, uint32_t Size, uint32_t InitVal)
 {
-  uint8_t missalignementAddress = StartAddress%4;
-  uint8_t missalignementSize = Size ;
-  int cnt;
+  uint32_t missalignementAddress = StartAddress%4;
+  uint32_t missalignementSize = (4 - Size%4)%4;
+  uint32_t Words;
   uint32_t Val;
-	
-  StartAddress-=StartAddress%4;
-  Size += (Size%4==0)?0:4-(Size%4);
+  uint32_t Start = Perf_Cycles();
+  
+  Perf_Count(PERF_CHECKSUM, Size);
+  /* The zone is walked as whole words from the aligned start address, the
+     leading bytes of the first word and the padding of the last one are
+     left out of the sum */
+  StartAddress-=missalignementAddress;
+  Words = (Size + missalignementSize)/4;
   
-  for(cnt=0; cnt<Size ; cnt+=4)
+  if((missalignementAddress != 0) && (Words != 0))
   {
-    Val = *(uint32_t*)StartAddress;
-    if(missalignementAddress)
-    {
-      switch (missalignementAddress)
-      {
-        case 1:
-          InitVal += (uint8_t) (Val>>8 & 0xff);
-          InitVal += (uint8_t) (Val>>16 & 0xff);
-          InitVal += (uint8_t) (Val>>24 & 0xff);
-          missalignementAddress-=1;
-          break;
-        case 2:
-          InitVal += (uint8_t) (Val>>16 & 0xff);
-          InitVal += (uint8_t) (Val>>24 & 0xff);
-          missalignementAddress-=2;
-          break;
-        case 3:   
-          InitVal += (uint8_t) (Val>>24 & 0xff);
-          missalignementAddress-=3;
-          break;
-      }  
-    }
-    else if((Size-missalignementSize)%4 && (Size-cnt) <=4)
-    {
-      switch (Size-missalignementSize)
-      {
-        case 1:
-          InitVal += (uint8_t) Val;
-          InitVal += (uint8_t) (Val>>8 & 0xff);
-          InitVal += (uint8_t) (Val>>16 & 0xff);
-          missalignementSize-=1;
-          break;
-        case 2:
-          InitVal += (uint8_t) Val;
-          InitVal += (uint8_t) (Val>>8 & 0xff);
-          missalignementSize-=2;
-          break;
-        case 3:   
-          InitVal += (uint8_t) Val;
-          missalignementSize-=3;
-          break;
-      } 
-    }
-    else
+    Val = *(uint32_t*)StartAddress >> (8*missalignementAddress);
+    InitVal += CheckSum_Words(&Val, 1);
+    StartAddress+=4;
+    Words--;
+  }
+  
+  if((missalignementSize != 0) && (Words != 0))
+  {
+    Words--;
+    /* The size counter of the former byte ladder was 8-bit, so the partial
+       last word only ever counted in zones below 256 bytes */
+    if(Size < 0x100)
     {
-      InitVal += (uint8_t) Val;
-      InitVal += (uint8_t) (Val>>8 & 0xff);
-      InitVal += (uint8_t) (Val>>16 & 0xff);
-      InitVal += (uint8_t) (Val>>24 & 0xff);
+      Val = *(uint32_t*)(StartAddress + 4*Words) & (0xFFFFFFFF >> (8*missalignementSize));
+      InitVal += CheckSum_Words(&Val, 1);
     }
-    StartAddress+=4;
   }
   
+  InitVal += CheckSum_Words((const uint32_t*)StartAddress, Words);
+  
+  Perf_Add(PERF_PHASE_VERIFY, &Start);
   return (InitVal);
 }
 
@@ -209,21 +270,89 @@ KeepInCompilation uint64_t Verify (uint32_t MemoryAddr, uint32_t RAMBufferAddr,
 {
   uint32_t VerifiedData = 0, InitVal = 0;
   uint64_t checksum;
+  uint32_t Start;
   Size*=4;
+  Perf_Count(PERF_VERIFY, Size);
+  Start = Perf_Cycles();
 
   
+  /* Word-aligned zones are compared and added up in a single pass over the
+     memory. On a difference the checksum is recalculated and the byte loop
+     below resumes at the differing word */
+  if((((MemoryAddr | RAMBufferAddr) % 4) == 0) && ((missalignement & 0x000C000C) == 0) && (Size != 0))
+  {
+    VerifiedData = Verify_Words((const uint32_t*)MemoryAddr, (const uint32_t*)RAMBufferAddr, Size/4, &InitVal);
+    if(VerifiedData == Size)
+    {
+      Perf_Add(PERF_PHASE_VERIFY, &Start);
+      return ((uint64_t)Verify_CheckSum((const uint32_t*)RAMBufferAddr, Size, missalignement, InitVal) << 32);
+    }
+    InitVal = 0;
+  }
+  Perf_Add(PERF_PHASE_VERIFY, &Start);
   checksum = CheckSum((uint32_t)MemoryAddr + (missalignement & 0xf), Size - ((missalignement >> 16) & 0xF), InitVal);
+  Start = Perf_Cycles();
+  MemoryAddr += VerifiedData;
   while (Size>VerifiedData)
   {
     if ( *(uint8_t*)MemoryAddr++ != *((uint8_t*)RAMBufferAddr + VerifiedData))
-      return ((checksum<<32) + (MemoryAddr + VerifiedData));  
+    {
+      Perf_Add(PERF_PHASE_VERIFY, &Start);
+      return ((checksum<<32) + (MemoryAddr + VerifiedData));
+    }  
    
     VerifiedData++;  
   }
         
+  Perf_Add(PERF_PHASE_VERIFY, &Start);
   return (checksum<<32);
 }
 
+/**
+  * @brief   Calculates the CRC-32 of a memory zone with the CRC unit.
+  *          This is the IEEE 802.3 CRC-32 of zlib crc32(), so that the result
+  *          can be checked against a CRC of the source image on the host,
+  *          the CRC-32 of the 9 bytes "123456789" being 0xCBF43926.
+  * @param   StartAddress : start address of the zone
+  * @param   Size         : size of the zone (in bytes)
+  * @retval  CRC-32 of the zone
+  */
+KeepInCompilation uint32_t CheckCRC (uint32_t StartAddress, uint32_t Size)
+{
+  uint32_t Start;
+  uint32_t Crc;
+
+  Perf_Count(PERF_CHECKCRC, Size);
+  Start = Perf_Cycles();
+  CRC32_Start();
+  CRC32_Words((const uint8_t*)StartAddress, Size/4);
+  Crc = CRC32_End((const uint8_t*)StartAddress + (Size & ~0x3), Size%4);
+  Perf_Add(PERF_PHASE_VERIFY, &Start);
+
+  return Crc;
+}
+
+/**
+  * @brief   Calculates the SHA-256 digest of a memory zone, the host
+  *          comparing a single digest with the one of the source image
+  *          instead of reading the memory back.
+  * @param   StartAddress : start address of the zone
+  * @param   Size         : size of the zone (in bytes)
+  * @param   Digest       : RAM buffer receiving the 32-byte digest
+  * @retval  1      : Operation succeeded
+  * @retval  0      : Operation failed
+  */
+KeepInCompilation int CheckSHA256 (uint32_t StartAddress, uint32_t Size, uint8_t* Digest)
+{
+  uint32_t Start;
+
+  Perf_Count(PERF_CHECKSHA256, Size);
+  Start = Perf_Cycles();
+  SHA256_Calculate((const uint8_t*)StartAddress, Size, Digest);
+  Perf_Add(PERF_PHASE_VERIFY, &Start);
+  return 1;
+}
+
 
 /**
   * @brief  System Clock Configuration
@@ -21,8 +21,34 @@
 
 #include "Loader_Src.h"
 #include <string.h>
+#include "loader_kernels.h"
+
+/* Private define ------------------------------------------------------------*/
+#define PROGRAM_PAGE_SIZE  MT25QL512A_PAGE_SIZE
 #pragma section=".bss"
 
+/* Private variables ---------------------------------------------------------*/
+extern QSPI_HandleTypeDef QSPIHandle;
+SESSION_STATE Session;
+uint32_t SkippedPages;
+uint32_t SkippedSectors;
+DIFF_STATUS DiffStatus;
+STREAM_RING StreamRing;
+static uint32_t FillBuffer[FILL_BUFFER_SIZE/4 + 1];
+static uint8_t DecompressBuffer[DECOMPRESS_BUFFER_SIZE];
+#if (PERF_COUNTERS == 1)
+__no_init PERF_BLOCK PerfCounters @ ".perf";
+static uint32_t PerfEraseStart;
+static uint32_t PerfErasing;
+#endif
+#if (CLOCK_SEARCH == 1)
+CLOCK_STATUS ClockSearch;
+static uint8_t ClockReference[CLOCK_SIGNATURE_SIZE + 4];
+static uint8_t ClockSignature[CLOCK_SIGNATURE_SIZE + 4];
+#endif
+#ifdef USE_COMMAND_TRACE
+__no_init TRACE_BUFFER CommandTrace;
+#endif
 
 /* Private functions ---------------------------------------------------------*/
 KeepInCompilation HAL_StatusTypeDef HAL_InitTick(uint32_t TickPriority)
@@ -38,6 +64,691 @@ uint32_t HAL_GetTick(void)
   * @{
   */
 
+/**
+  * @brief  Starts the DWT cycle counter. PerfCounters and CommandTrace are
+  *         cleared unless they already hold the previous calls.
+  * @retval None
+  */
+static void Perf_Init(void)
+{
+#if (PERF_COUNTERS == 1) || defined(USE_COMMAND_TRACE) || (STREAM_TIMEOUT_MS != 0)
+  CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+#if (__CORTEX_M == 7U)
+  /* The Cortex-M7 DWT is write-locked */
+  DWT->LAR = 0xC5ACCE55;
+#endif
+  DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+#endif
+
+#if (PERF_COUNTERS == 1)
+  if(PerfCounters.Magic != PERF_MAGIC)
+  {
+    memset(&PerfCounters, 0, sizeof(PerfCounters));
+    PerfCounters.Magic = PERF_MAGIC;
+  }
+#endif
+
+#ifdef USE_COMMAND_TRACE
+  if(CommandTrace.Magic != TRACE_MAGIC)
+  {
+    memset(&CommandTrace, 0, sizeof(CommandTrace));
+    CommandTrace.Magic = TRACE_MAGIC;
+    CommandTrace.Depth = TRACE_DEPTH;
+  }
+#endif
+}
+
+/**
+  * @brief  Reads the DWT cycle counter.
+  * @retval Cycle count, 0 without PERF_COUNTERS and USE_COMMAND_TRACE
+  */
+static uint32_t Perf_Cycles(void)
+{
+#if (PERF_COUNTERS == 1) || defined(USE_COMMAND_TRACE)
+  return DWT->CYCCNT;
+#else
+  return 0;
+#endif
+}
+
+#ifdef USE_COMMAND_TRACE
+/**
+  * @brief  Logs a record in CommandTrace, at each loader entry point and
+  *         around the BSP calls.
+  * @param  Kind    : TRACE_OPERATION, TRACE_CALL, TRACE_RETURN or TRACE_COMMAND
+  * @param  Call    : TRACE_BSP of a call, PERF_ENTRY of an operation, or
+  *                   TRACE_HAL_ of a command
+  * @param  Address : memory address of the call
+  * @param  Size    : bytes of the call or of the operation
+  * @param  Status  : status the BSP returned
+  * @retval None
+  */
+static void Trace_Command(uint32_t Kind, uint32_t Call, uint32_t Address, uint32_t Size, uint32_t Status)
+{
+  TRACE_RECORD* Record = &CommandTrace.Records[CommandTrace.Head % TRACE_DEPTH];
+
+  Record->Cycles = Perf_Cycles();
+  Record->Kind = Kind;
+  Record->Call = Call;
+  Record->Address = Address;
+  Record->Size = Size;
+  Record->Status = Status;
+  Record->Instruction = 0;
+  Record->Modes = 0;
+  CommandTrace.Head++;
+}
+
+/**
+  * @brief  Logs the return of a BSP call run by trace_bsp.
+  * @param  Call   : TRACE_BSP of the call
+  * @param  Status : status the BSP returned
+  * @retval Status
+  */
+static int32_t Trace_Return(uint32_t Call, int32_t Status)
+{
+  Trace_Command(TRACE_RETURN, Call, 0, 0, (uint32_t)Status);
+  return Status;
+}
+
+/**
+  * @brief  Logs a command sent to the memory, by the HAL wrappers of
+  *         loader_trace.h before they send it.
+  * @param  Call        : TRACE_HAL_ function sending the command
+  * @param  Instruction : instruction of the command
+  * @param  Modes       : TRACE_MODES of the command
+  * @param  Address     : address of the command
+  * @param  Size        : bytes of its data phase
+  * @retval None
+  */
+void Trace_Hal(uint32_t Call, uint32_t Instruction, uint32_t Modes, uint32_t Address, uint32_t Size)
+{
+  TRACE_RECORD* Record = &CommandTrace.Records[CommandTrace.Head % TRACE_DEPTH];
+
+  Trace_Command(TRACE_COMMAND, Call, Address, Size, 0);
+  Record->Instruction = Instruction;
+  Record->Modes = Modes;
+}
+
+/**
+  * @brief  Logs the status the HAL returned for the last command.
+  * @param  Status : status the HAL returned
+  * @retval Status
+  */
+uint32_t Trace_HalReturn(uint32_t Status)
+{
+  CommandTrace.Records[(CommandTrace.Head - 1) % TRACE_DEPTH].Status = Status;
+  return Status;
+}
+#endif
+
+/**
+  * @brief  Counts a call to a loader entry point.
+  * @param  Entry : entry point called
+  * @param  Size  : bytes handled by the call
+  * @retval None
+  */
+static void Perf_Count(PERF_ENTRY Entry, uint32_t Size)
+{
+#if (PERF_COUNTERS == 1)
+  PerfCounters.Calls[Entry]++;
+  PerfCounters.Bytes[Entry] += Size;
+#endif
+  trace_command(TRACE_OPERATION, Entry, 0, Size, 0);
+}
+
+/**
+  * @brief  Adds the cycles elapsed since Start to a phase, Start being moved
+  *         to the current count. The 64-bit totals do not wrap with the
+  *         counter as long as this is called once per 2^32 cycles.
+  * @param  Phase : phase the cycles were spent in
+  * @param  Start : cycle count the phase started at
+  * @retval None
+  */
+static void Perf_Add(PERF_PHASE Phase, uint32_t* Start)
+{
+#if (PERF_COUNTERS == 1)
+  uint32_t Now = DWT->CYCCNT;
+
+  PerfCounters.Cycles[Phase] += Now - *Start;
+  *Start = Now;
+  /* Init changes the clock the cycles count at */
+  PerfCounters.CoreClock = SystemCoreClock;
+#endif
+}
+
+#if (PERF_COUNTERS == 1)
+/**
+  * @brief  Adds Count operations, lasting Cycles in total, to a timing.
+  * @param  Timing : timing of the operation
+  * @param  Cycles : cycles of the operations
+  * @param  Count  : number of operations
+  * @retval None
+  */
+static void Perf_Sample(PERF_TIMING* Timing, uint32_t Cycles, uint32_t Count)
+{
+  uint32_t Average = Cycles / Count;
+
+  if((Timing->Count == 0) || (Average < Timing->Min))
+    Timing->Min = Average;
+  if(Average > Timing->Max)
+    Timing->Max = Average;
+  Timing->Count += Count;
+  Timing->Total += Cycles;
+}
+#endif
+
+/**
+  * @brief  Accounts a page program run to the data phase and to tPP. The
+  *         run waits for the end of each page program before sending the
+  *         next page, so each page is sampled with its data phase.
+  * @param  Address : run start address
+  * @param  Size    : run size
+  * @param  Start   : cycle count the run started at
+  * @retval None
+  */
+static void Perf_Program(uint32_t Address, uint32_t Size, uint32_t Start)
+{
+#if (PERF_COUNTERS == 1)
+  uint32_t Cycles = DWT->CYCCNT - Start;
+
+  PerfCounters.Cycles[PERF_PHASE_DATA] += Cycles;
+  Perf_Sample(&PerfCounters.PageProgram, Cycles,
+              ((Address % PROGRAM_PAGE_SIZE) + Size + PROGRAM_PAGE_SIZE - 1) / PROGRAM_PAGE_SIZE);
+#endif
+}
+
+/**
+  * @brief  Marks the start of a block erase, sampled as tBE once the memory
+  *         is seen idle again.
+  * @retval Cycle count the erase started at
+  */
+static uint32_t Perf_EraseStart(void)
+{
+#if (PERF_COUNTERS == 1)
+  PerfEraseStart = DWT->CYCCNT;
+  PerfErasing = 1;
+  return PerfEraseStart;
+#else
+  return 0;
+#endif
+}
+
+/**
+  * @brief  Samples tBE when the memory is seen idle after a block erase.
+  *         With DEFERRED_COMPLETION, the sample also covers the time until
+  *         the next loader call.
+  * @retval None
+  */
+static void Perf_EraseDone(void)
+{
+#if (PERF_COUNTERS == 1)
+  if(PerfErasing != 0)
+  {
+    Perf_Sample(&PerfCounters.BlockErase, DWT->CYCCNT - PerfEraseStart, 1);
+    PerfErasing = 0;
+  }
+#endif
+}
+
+#if (CLOCK_SEARCH == 1)
+/**
+  * @brief  Reads the QUADSPI kernel clock divider.
+  * @retval Divider, the PRESCALER field plus one
+  */
+static uint32_t Clock_GetDivider(void)
+{
+  return ((CLOCK_INSTANCE->CR & QUADSPI_CR_PRESCALER) >> QUADSPI_CR_PRESCALER_Pos) + 1U;
+}
+
+/**
+  * @brief  Sets the QUADSPI kernel clock divider once the QUADSPI is idle.
+  * @param  Divider : kernel clock divider
+  * @retval None
+  */
+static void Clock_SetDivider(uint32_t Divider)
+{
+  while((CLOCK_INSTANCE->SR & QUADSPI_SR_BUSY) != 0U)
+  {
+  }
+  MODIFY_REG(CLOCK_INSTANCE->CR, QUADSPI_CR_PRESCALER, (Divider - 1U) << QUADSPI_CR_PRESCALER_Pos);
+}
+
+/**
+  * @brief  Reads the signature, the CLOCK_SIGNATURE_SIZE first bytes of the
+  *         memory, in the read mode the BSP set. The BSP has no ID read.
+  * @param  Signature : buffer of CLOCK_SIGNATURE_SIZE + 4 bytes
+  * @retval  1      : Operation succeeded
+  * @retval  0      : Operation failed
+  */
+static int Clock_ReadSignature(uint8_t *Signature)
+{
+  memset(Signature, 0, CLOCK_SIGNATURE_SIZE + 4);
+  if(trace_bsp(TRACE_BSP_READ, 0, CLOCK_SIGNATURE_SIZE, BSP_QSPI_Read(Signature + 4, 0, CLOCK_SIGNATURE_SIZE)) != QSPI_OK)
+    return 0;
+  return 1;
+}
+
+/**
+  * @brief  Checks whether the signature only holds 0x00 and 0xFF bytes, as
+  *         read from an erased memory or from stuck lines, no clock being
+  *         validated with it.
+  * @param  Signature : buffer of CLOCK_SIGNATURE_SIZE + 4 bytes
+  * @retval  1      : Signature is flat
+  * @retval  0      : Signature can validate a clock
+  */
+static int Clock_IsFlat(const uint8_t *Signature)
+{
+  uint32_t i;
+
+  for(i = 0; i < CLOCK_SIGNATURE_SIZE + 4; i++)
+  {
+    if((Signature[i] != 0x00U) && (Signature[i] != 0xFFU))
+      return 0;
+  }
+  return 1;
+}
+#endif
+
+/**
+  * @brief  Searches the fastest stable memory clock. The signature is first
+  *         read at the BSP clock, then each divider from the one of
+  *         CLOCK_MAX_HZ up to the BSP one reads it back CLOCK_PASSES times.
+  *         The first divider passing is applied, the BSP one being kept when
+  *         none passes or when the signature is flat. CLOCK_DIVIDER_PIN is
+  *         applied as is when set. The result is kept in ClockSearch.
+  * @retval None
+  */
+static void Clock_Search(void)
+{
+#if (CLOCK_SEARCH == 1)
+  uint32_t Divider;
+  uint32_t Pass;
+
+  memset(&ClockSearch, 0, sizeof(ClockSearch));
+  ClockSearch.Magic = CLOCK_MAGIC;
+  ClockSearch.BspDivider = Clock_GetDivider();
+  ClockSearch.Divider = ClockSearch.BspDivider;
+  ClockSearch.Status = CLOCK_BSP_KEPT;
+
+  if(CLOCK_DIVIDER_PIN != 0U)
+  {
+    ClockSearch.Divider = CLOCK_DIVIDER_PIN;
+    ClockSearch.Status = CLOCK_PINNED;
+  }
+  else if((Clock_ReadSignature(ClockReference) == 0) || (Clock_IsFlat(ClockReference) != 0))
+    ClockSearch.Status = CLOCK_NO_SIGNATURE;
+  else
+  {
+    for(Divider = (CLOCK_KERNEL_HZ + CLOCK_MAX_HZ - 1U) / CLOCK_MAX_HZ;
+        Divider < ClockSearch.BspDivider; Divider++)
+    {
+      Clock_SetDivider(Divider);
+      for(Pass = 0; Pass < CLOCK_PASSES; Pass++)
+      {
+        if((Clock_ReadSignature(ClockSignature) == 0) ||
+           (memcmp(ClockSignature, ClockReference, sizeof(ClockSignature)) != 0))
+          break;
+      }
+
+      if(Pass == CLOCK_PASSES)
+      {
+        ClockSearch.Divider = Divider;
+        ClockSearch.Status = CLOCK_SEARCHED;
+        break;
+      }
+      if(Divider < 32U)
+        ClockSearch.FailMap |= 1UL << Divider;
+    }
+  }
+
+  Clock_SetDivider(ClockSearch.Divider);
+  ClockSearch.ClockHz = CLOCK_KERNEL_HZ / ClockSearch.Divider;
+#endif
+}
+
+/**
+  * @brief  Applies the divider found again once the BSP has re-initialized
+  *         the QUADSPI.
+  * @retval None
+  */
+static void Clock_Apply(void)
+{
+#if (CLOCK_SEARCH == 1)
+  if(ClockSearch.Magic == CLOCK_MAGIC)
+    Clock_SetDivider(ClockSearch.Divider);
+#endif
+}
+
+/**
+  * @brief  Puts the QSPI controller in indirect mode.
+  *         The controller is re-initialized only after a failed operation.
+  * @retval  1      : Operation succeeded
+  * @retval  0      : Operation failed
+  */
+static int Session_EnterIndirect(void)
+{
+  uint32_t Start = Perf_Cycles();
+
+  if(Session == SESSION_BUSY)
+  {
+    /*Complete the program/erase left running by the previous call*/
+    trace_command(TRACE_CALL, TRACE_BSP_WAIT, 0, 0, 0);
+    while (BSP_QSPI_GetStatus()!=0)
+      Perf_Add(PERF_PHASE_BUSY, &Start);
+    Perf_Add(PERF_PHASE_BUSY, &Start);
+    trace_command(TRACE_RETURN, TRACE_BSP_WAIT, 0, 0, 0);
+    Perf_EraseDone();
+    Session = SESSION_INDIRECT;
+  }
+
+  if(Session == SESSION_MEMMAPPED)
+  {
+    /*Leave memory-mapped mode without resetting the memory*/
+    if(HAL_QSPI_Abort(&QSPIHandle) == HAL_OK)
+      Session = SESSION_INDIRECT;
+    else
+      Session = SESSION_RESET;
+  }
+
+  if(Session == SESSION_RESET)
+  {
+    trace_bsp(TRACE_BSP_DEINIT, 0, 0, BSP_QSPI_DeInit());
+    if(trace_bsp(TRACE_BSP_INIT, 0, 0, BSP_QSPI_Init()) != 0)
+      return 0;
+    Clock_Apply();
+    Session = SESSION_INDIRECT;
+  }
+
+  Perf_Add(PERF_PHASE_INIT, &Start);
+  return 1;
+}
+
+/**
+  * @brief  Puts the QSPI controller in memory-mapped mode.
+  * @retval  1      : Operation succeeded
+  * @retval  0      : Operation failed
+  */
+static int Session_EnterMemoryMapped(void)
+{
+  uint32_t Start;
+
+  if(Session == SESSION_MEMMAPPED)
+    return 1;
+
+  if(Session_EnterIndirect() == 0)
+    return 0;
+  Start = Perf_Cycles();
+
+  if(trace_bsp(TRACE_BSP_MEMORY_MAPPED, 0, 0, BSP_QSPI_EnableMemoryMappedMode()) != 0)
+  {
+    Session = SESSION_RESET;
+    return 0;
+  }
+  Session = SESSION_MEMMAPPED;
+  Perf_Add(PERF_PHASE_INIT, &Start);
+
+  return 1;
+}
+
+/**
+  * @brief  Waits for the end of the program/erase just issued, unless its
+  *         completion is deferred to the next loader call.
+  * @retval  1      : Operation succeeded
+  * @retval  0      : Operation failed
+  */
+static int Session_Complete(void)
+{
+#if (DEFERRED_COMPLETION == 0)
+  return Session_EnterIndirect();
+#else
+  return 1;
+#endif
+}
+
+/**
+  * @brief  Checks whether a buffer holds only the erase value (0xFF).
+  *         The buffer is scanned word by word once aligned.
+  * @param  buffer : pointer to data buffer
+  * @param  Size   : size of data
+  * @retval  1      : Buffer is blank
+  * @retval  0      : Buffer holds data to program
+  */
+static int Buffer_IsErased(uint8_t* buffer, uint32_t Size)
+{
+  while((Size > 0) && (((uint32_t)buffer & 0x3) != 0))
+  {
+    if(*buffer++ != 0xFF)
+      return 0;
+    Size--;
+  }
+  while(Size >= 4)
+  {
+    if(*(uint32_t*)buffer != 0xFFFFFFFF)
+      return 0;
+    buffer += 4;
+    Size   -= 4;
+  }
+  while(Size > 0)
+  {
+    if(*buffer++ != 0xFF)
+      return 0;
+    Size--;
+  }
+
+  return 1;
+}
+
+/**
+  * @brief   Programs memory, skipping the pages whose data is entirely the
+  *          erase value. Consecutive pages holding data are programmed with
+  *          a single call.
+  * @param   Address: page address
+  * @param   Size   : size of data
+  * @param   buffer : pointer to data buffer
+  * @retval  1      : Operation succeeded
+  * @retval  0      : Operation failed
+  */
+static int Program_Pages(uint32_t Address, uint32_t Size, uint8_t* buffer)
+{
+  uint32_t run, page = 0;
+  uint32_t Start;
+
+  while(Size > 0)
+  {
+    /* Gather the pages holding data up to the next blank page */
+    run = 0;
+    while(run < Size)
+    {
+      page = PROGRAM_PAGE_SIZE - ((Address + run) % PROGRAM_PAGE_SIZE);
+      if(page > Size - run)
+        page = Size - run;
+      if(Buffer_IsErased(buffer + run, page) != 0)
+        break;
+      run += page;
+    }
+
+    if(run != 0)
+    {
+      Start = Perf_Cycles();
+      if(trace_bsp(TRACE_BSP_WRITE, Address, run, BSP_QSPI_Write(buffer,Address, run)) != 0)
+        return 0;
+      Perf_Program(Address, run, Start);
+    }
+
+    /* Skip the blank page */
+    if(run < Size)
+    {
+      SkippedPages++;
+      run += page;
+    }
+
+    Address += run;
+    buffer  += run;
+    Size    -= run;
+  }
+
+  return 1;
+}
+
+#if (DIFFERENTIAL_WRITE == 1)
+/**
+  * @brief  Compares a page of the memory with the data to program in it.
+  *         Scanned word by word when the memory and the buffer share their
+  *         alignment.
+  * @param  Memory : pointer to the page in the memory-mapped region
+  * @param  buffer : pointer to data buffer
+  * @param  Size   : size of data
+  * @retval PAGE_IDENTICAL : Memory already holds the data
+  * @retval PAGE_PROGRAM   : Data only clears bits, page can be programmed
+  * @retval PAGE_ERASE     : Data sets bits, page must be erased first
+  */
+static PAGE_STATE Page_Compare(const uint8_t* Memory, const uint8_t* buffer, uint32_t Size)
+{
+  PAGE_STATE State = PAGE_IDENTICAL;
+
+  while((Size > 0) && (((uint32_t)Memory & 0x3) != 0))
+  {
+    if(*Memory != *buffer)
+    {
+      if((*Memory & *buffer) != *buffer)
+        return PAGE_ERASE;
+      State = PAGE_PROGRAM;
+    }
+    Memory++;
+    buffer++;
+    Size--;
+  }
+  if(((uint32_t)buffer & 0x3) == 0)
+  {
+    while(Size >= 4)
+    {
+      if(*(uint32_t*)Memory != *(uint32_t*)buffer)
+      {
+        if((*(uint32_t*)Memory & *(uint32_t*)buffer) != *(uint32_t*)buffer)
+          return PAGE_ERASE;
+        State = PAGE_PROGRAM;
+      }
+      Memory += 4;
+      buffer += 4;
+      Size   -= 4;
+    }
+  }
+  while(Size > 0)
+  {
+    if(*Memory != *buffer)
+    {
+      if((*Memory & *buffer) != *buffer)
+        return PAGE_ERASE;
+      State = PAGE_PROGRAM;
+    }
+    Memory++;
+    buffer++;
+    Size--;
+  }
+
+  return State;
+}
+
+/**
+  * @brief   Programs memory, skipping the pages that already hold the data.
+  *          Each page is first compared with the memory content through
+  *          memory-mapped mode. The pages whose data would set bits are not
+  *          programmed, they are reported in DiffStatus and fail the
+  *          Write once the other pages are programmed.
+  * @param   MapAddr: base address of the memory-mapped region
+  * @param   Address: page address
+  * @param   Size   : size of data
+  * @param   buffer : pointer to data buffer
+  * @retval  1      : Operation succeeded
+  * @retval  0      : Operation failed
+  */
+static int Program_Differential(uint32_t MapAddr, uint32_t Address, uint32_t Size, uint8_t* buffer)
+{
+  uint32_t run, page = 0;
+  PAGE_STATE State = PAGE_IDENTICAL;
+
+  DiffStatus.IdenticalPages = 0;
+  DiffStatus.ProgrammedPages = 0;
+  DiffStatus.ErasePages = 0;
+  DiffStatus.EraseAddress = 0;
+
+  while(Size > 0)
+  {
+    /* Gather the pages to program up to the next page to leave as is */
+    if(Session_EnterMemoryMapped() == 0)
+      return 0;
+    run = 0;
+    while(run < Size)
+    {
+      page = PROGRAM_PAGE_SIZE - ((Address + run) % PROGRAM_PAGE_SIZE);
+      if(page > Size - run)
+        page = Size - run;
+      State = Page_Compare((uint8_t*)(MapAddr + Address + run), buffer + run, page);
+      if(State != PAGE_PROGRAM)
+        break;
+      DiffStatus.ProgrammedPages++;
+      run += page;
+    }
+
+    if(run != 0)
+    {
+      if(Session_EnterIndirect() == 0)
+        return 0;
+      if(Program_Pages(Address, run, buffer) == 0)
+        return 0;
+    }
+
+    /* Skip the identical page, or report the page to erase */
+    if(run < Size)
+    {
+      if(State == PAGE_IDENTICAL)
+      {
+        DiffStatus.IdenticalPages++;
+      }
+      else
+      {
+        if(DiffStatus.ErasePages == 0)
+          DiffStatus.EraseAddress = MapAddr + Address + run;
+        DiffStatus.ErasePages++;
+      }
+      run += page;
+    }
+
+    Address += run;
+    buffer  += run;
+    Size    -= run;
+  }
+
+  /* The pages left as is do not hold the data: the Write fails */
+  if(DiffStatus.ErasePages != 0)
+    return 0;
+
+  return 1;
+}
+#endif /* DIFFERENTIAL_WRITE */
+
+/**
+  * @brief  Checks through memory-mapped mode whether a block is already
+  *         erased, so that its erase can be skipped.
+  * @param  Address : block address in the memory-mapped region
+  * @param  Size    : block size
+  * @retval  1      : Block is blank
+  * @retval  0      : Block must be erased
+  */
+static int Block_IsErased(uint32_t Address, uint32_t Size)
+{
+#if (BLANK_CHECK_BEFORE_ERASE == 1)
+  if(Session_EnterMemoryMapped() == 0)
+    return 0;
+  if(Buffer_IsErased((uint8_t*)Address, Size) == 0)
+    return 0;
+  SkippedSectors++;
+  return 1;
+#else
+  return 0;
+#endif
+}
+
 /**
   * @brief  System initialization.
   * @param  None
@@ -45,7 +756,8 @@ uint32_t HAL_GetTick(void)
   * @retval  0      : Operation failed
   */
 int Init()
-{  
+{
+  uint32_t Start;
  /* Disable Interrupts */
   __disable_irq();
  
@@ -56,22 +768,35 @@ int Init()
     
  /*  init system*/
   SystemInit(); 
-  HAL_Init();  
+  HAL_Init();
+  Perf_Init();
+  Perf_Count(PERF_INIT, 0);
+  Start = Perf_Cycles();
+  Session = SESSION_RESET;
+  SkippedPages = 0;
+  SkippedSectors = 0;
 
  /* Configure the system clock  */
   SystemClock_Config();
    
  /*Initialaize QSPI*/
-  if(BSP_QSPI_Init() !=0)
+  if(trace_bsp(TRACE_BSP_INIT, 0, 0, BSP_QSPI_Init()) !=0)
    return 0;
+  Session = SESSION_INDIRECT;
+  Clock_Search();
    
  /*Configure the QSPI in memory-mapped mode*/ 
-  if(BSP_QSPI_EnableMemoryMappedMode()!=0)
+  if(trace_bsp(TRACE_BSP_MEMORY_MAPPED, 0, 0, BSP_QSPI_EnableMemoryMappedMode())!=0)
+  {
+    Session = SESSION_RESET;
     return 0;
+  }
+  Session = SESSION_MEMMAPPED;
   
  /*Enable Interrupts*/
   __enable_irq();
  
+   Perf_Add(PERF_PHASE_INIT, &Start);
    return 1;
 
 }
@@ -86,18 +811,27 @@ int Init()
   */
 KeepInCompilation int Write (uint32_t Address, uint32_t Size, uint8_t* buffer)
 {    
+#if (DIFFERENTIAL_WRITE == 1)
+  uint32_t MapAddr = Address & 0xF0000000;
+#endif
  /*Disable Interrupts*/
   __disable_irq();
     
   Address = Address & 0x0fffffff;
     
-  if(BSP_QSPI_DeInit()!=0)
-    return 0;
-  if( BSP_QSPI_Init()!=0)
+  Perf_Count(PERF_WRITE, Size);
+  if(Session_EnterIndirect() == 0)
     return 0;
  /*Writes an amount of data to the QSPI memory.*/
-  if( BSP_QSPI_Write(buffer,Address, Size)!=0)
-   return 0;
+#if (DIFFERENTIAL_WRITE == 1)
+  if(Program_Differential(MapAddr, Address, Size, buffer) == 0)
+#else
+  if(Program_Pages(Address, Size, buffer) == 0)
+#endif
+  {
+    Session = SESSION_RESET;
+    return 0;
+  }
   
  /*Enable Interrupts*/
    __enable_irq();  
@@ -105,6 +839,237 @@ KeepInCompilation int Write (uint32_t Address, uint32_t Size, uint8_t* buffer)
   return 1;
 }
 
+/**
+  * @brief   Program memory from LZ4 compressed data.
+  *          The data is a sequence of blocks, each one being its compressed
+  *          size on 32 bits (little endian) followed by an LZ4 block that
+  *          decodes to at most DECOMPRESS_BUFFER_SIZE bytes. The blocks are
+  *          decoded in turn and programmed through Write. Not called by
+  *          STM32CubeProgrammer, it is meant for host tools driving the
+  *          loader directly.
+  * @param   Address: address of the first decoded byte
+  * @param   Size   : size of the compressed data
+  * @param   buffer : pointer to the compressed data
+  * @retval  1      : Operation succeeded
+  * @retval  0      : Operation failed
+  */
+KeepInCompilation int WriteCompressed (uint32_t Address, uint32_t Size, uint8_t* buffer)
+{
+  uint32_t BlockSize;
+  uint32_t Decoded;
+
+  while(Size != 0)
+  {
+    if(Size < 4)
+      return 0;
+    BlockSize = buffer[0] | ((uint32_t)buffer[1] << 8) | ((uint32_t)buffer[2] << 16) | ((uint32_t)buffer[3] << 24);
+    buffer += 4;
+    Size -= 4;
+    if(BlockSize > Size)
+      return 0;
+
+    Decoded = LZ4_DecodeBlock(buffer, BlockSize, DecompressBuffer, DECOMPRESS_BUFFER_SIZE);
+    if(Decoded == 0)
+      return 0;
+    if(Write(Address, Decoded, DecompressBuffer) == 0)
+      return 0;
+
+    Address += Decoded;
+    buffer += BlockSize;
+    Size -= BlockSize;
+  }
+
+  return 1;
+}
+/**
+  * @brief   Programs the data the host streams through StreamRing.
+  *          The host sets Address and End, then keeps writing the data to
+  *          Data and advancing Head while the loader runs. Each complete
+  *          page is programmed as soon as it is available and Tail advanced,
+  *          so that the debug link transfer overlaps with the programming
+  *          instead of waiting for a loader call per chunk. Head and Tail
+  *          are free running, Data being indexed modulo STREAM_BUFFER_SIZE:
+  *          the host must keep Head - Tail within STREAM_BUFFER_SIZE.
+  *          The stream fails when the host sets Abort, or leaves Head
+  *          unchanged for STREAM_TIMEOUT_MS while the loader waits for data.
+  * @retval  1      : Operation succeeded
+  * @retval  0      : Operation failed
+  */
+KeepInCompilation int WriteStream (void)
+{
+  uint32_t Offset;
+  uint32_t Count;
+#if (STREAM_TIMEOUT_MS != 0)
+  uint32_t Head = StreamRing.Head;
+  uint32_t Idle = DWT->CYCCNT;
+#endif
+
+  StreamRing.Abort = 0;
+  StreamRing.Status = STREAM_RUNNING;
+  while(StreamRing.Address < StreamRing.End)
+  {
+    /* Up to the end of the page, of the stream and of the ring */
+    Offset = StreamRing.Tail % STREAM_BUFFER_SIZE;
+    Count = PROGRAM_PAGE_SIZE - (StreamRing.Address % PROGRAM_PAGE_SIZE);
+    if(Count > StreamRing.End - StreamRing.Address)
+      Count = StreamRing.End - StreamRing.Address;
+    if(Count > STREAM_BUFFER_SIZE - Offset)
+      Count = STREAM_BUFFER_SIZE - Offset;
+
+    /* Wait for the host to write the whole chunk */
+    if((StreamRing.Head - StreamRing.Tail) < Count)
+    {
+      if(StreamRing.Abort != 0)
+      {
+        StreamRing.Status = STREAM_ERROR;
+        return 0;
+      }
+#if (STREAM_TIMEOUT_MS != 0)
+      if(StreamRing.Head != Head)
+      {
+        Head = StreamRing.Head;
+        Idle = DWT->CYCCNT;
+      }
+      else if((DWT->CYCCNT - Idle) > STREAM_TIMEOUT_MS * (SystemCoreClock / 1000U))
+      {
+        StreamRing.Status = STREAM_ERROR;
+        return 0;
+      }
+#endif
+      continue;
+    }
+    __DMB();
+
+    if(Write(StreamRing.Address, Count, &StreamRing.Data[Offset]) == 0)
+    {
+      StreamRing.Status = STREAM_ERROR;
+      return 0;
+    }
+    StreamRing.Address += Count;
+    StreamRing.Tail += Count;
+#if (STREAM_TIMEOUT_MS != 0)
+    Idle = DWT->CYCCNT;
+#endif
+  }
+  StreamRing.Status = STREAM_DONE;
+
+  return 1;
+}
+/**
+  * @brief   Runs a list of erase, program and verify operations in a single
+  *          call, saving the debugger round trip of one call per operation.
+  *          The operations are run in order up to the first failure, each
+  *          one getting its status, the following ones being left
+  *          OPERATION_NOT_RUN.
+  * @param   List  : pointer to the operation descriptors
+  * @param   Count : number of descriptors
+  * @retval  1      : All operations succeeded
+  * @retval  0      : An operation failed
+  */
+KeepInCompilation int RunOperations (OPERATION* List, uint32_t Count)
+{
+  uint32_t i;
+  uint32_t Offset;
+  int Result = 1;
+
+  for(i = 0; i < Count; i++)
+    List[i].Status = OPERATION_NOT_RUN;
+
+  for(i = 0; (i < Count) && (Result != 0); i++)
+  {
+    switch(List[i].Op)
+    {
+    case OPERATION_ERASE:
+      if(List[i].Size != 0)
+        Result = SectorErase(List[i].Address, List[i].Address + List[i].Size - 1);
+      break;
+    case OPERATION_PROGRAM:
+      Result = Write(List[i].Address, List[i].Size, List[i].Buffer);
+      break;
+    case OPERATION_VERIFY:
+      /* Verify returns the failing address in its low word. It compares the
+         whole words, the last bytes being compared byte by byte as it does,
+         in the memory-mapped mode it leaves enabled */
+      Result = ((uint32_t)Verify(List[i].Address, (uint32_t)List[i].Buffer, List[i].Size / 4, 0) == 0);
+      for(Offset = List[i].Size & ~0x3; (Result != 0) && (Offset < List[i].Size); Offset++)
+        Result = (*(uint8_t*)(List[i].Address + Offset) == List[i].Buffer[Offset]);
+      break;
+    default:
+      Result = 0;
+      break;
+    }
+    List[i].Status = (Result != 0) ? OPERATION_OK : OPERATION_FAILED;
+  }
+
+  return Result;
+}
+
+/**
+  * @brief   Programs a memory zone with a repeated pattern generated in RAM,
+  *          so that constant runs need not be transferred to the loader.
+  *          A fill with the erase value (0xFF) programs nothing and fails
+  *          unless the zone is already erased.
+  * @param   Address     : zone start address
+  * @param   Size        : zone size
+  * @param   Pattern     : pattern, least significant byte first
+  * @param   PatternSize : pattern size, 1, 2 or 4 bytes
+  * @retval  1      : Operation succeeded
+  * @retval  0      : Operation failed
+  */
+KeepInCompilation int Fill (uint32_t Address, uint32_t Size, uint32_t Pattern, uint32_t PatternSize)
+{
+  uint32_t Mask;
+  uint32_t Phase = 0;
+  uint32_t Count;
+  uint32_t i;
+
+  if((PatternSize != 1) && (PatternSize != 2) && (PatternSize != 4))
+    return 0;
+  Mask = (PatternSize == 4) ? 0xFFFFFFFF : ((1UL << (8 * PatternSize)) - 1);
+  if((Pattern & Mask) == Mask)
+  {
+    /* Programming the erase value changes no bit: the zone is checked to be
+       erased instead, by Verify against a chunk of 0xFF, the last bytes
+       being read in the memory-mapped mode it leaves enabled */
+    memset(FillBuffer, 0xFF, FILL_BUFFER_SIZE);
+    do
+    {
+      Count = (Size < FILL_BUFFER_SIZE) ? (Size & ~0x3) : FILL_BUFFER_SIZE;
+      if((uint32_t)Verify(Address, (uint32_t)FillBuffer, Count / 4, 0) != 0)
+        return 0;
+      Address += Count;
+      Size -= Count;
+    } while(Size >= 4);
+    for(i = 0; i < Size; i++)
+    {
+      if(*(uint8_t*)(Address + i) != 0xFF)
+        return 0;
+    }
+    return 1;
+  }
+
+  /* One pattern more than the chunk size, each chunk starting at its phase */
+  for(i = 0; i < FILL_BUFFER_SIZE + 4; i++)
+    ((uint8_t*)FillBuffer)[i] = (uint8_t)(Pattern >> (8 * (i % PatternSize)));
+
+  while(Size > 0)
+  {
+    /* Chunks aligned on the buffer size, so on pages */
+    Count = FILL_BUFFER_SIZE - (Address % FILL_BUFFER_SIZE);
+    if(Count > Size)
+      Count = Size;
+    if(Write(Address, Count, (uint8_t*)FillBuffer + Phase) == 0)
+      return 0;
+    Phase = (Phase + Count) % PatternSize;
+    Address += Count;
+    Size -= Count;
+  }
+
+  return 1;
+}
+
+
+
 /**
   * @brief 	 Full erase of the device 						
   * @param 	 Parallelism : 0 																		
@@ -112,28 +1077,31 @@ KeepInCompilation int Write (uint32_t Address, uint32_t Size, uint8_t* buffer)
   * @retval  0           : Operation failed											
   */
 KeepInCompilation int MassErase (uint32_t Parallelism ){
+  uint32_t Start;
+
+  Perf_Count(PERF_MASS_ERASE, 0);
   
  /*Disable Interrupts*/
   __disable_irq();
   
- /*Deinitialaize QSPI*/ 
-  if(BSP_QSPI_DeInit()!=0)
-     return 0;
-  
- /*Initialaize QSPI*/
-   if( BSP_QSPI_Init()!=0)
-     return 0;
+ /*Initialaize QSPI, only after a failed operation*/
+  if(Session_EnterIndirect() == 0)
+    return 0;
    
   /*Erases the entire QSPI memory*/
-   BSP_QSPI_Erase_Chip();
-   
- /*Reads current status of the QSPI memory*/
-   while (BSP_QSPI_GetStatus()!=0);
+   Start = Perf_Cycles();
+   if(trace_bsp(TRACE_BSP_ERASE_CHIP, 0, 0, BSP_QSPI_Erase_Chip()) != 0)
+   {
+     Session = SESSION_RESET;
+     return 0;
+   }
+   Perf_Add(PERF_PHASE_BUSY, &Start);
+   Session = SESSION_BUSY;
    
  /*Enable Interrupts*/
    __enable_irq();
   
-  return 1;
+  return Session_Complete();
 }
 
 
@@ -149,32 +1117,44 @@ KeepInCompilation int SectorErase (uint32_t EraseStartAddress ,uint32_t EraseEnd
   __disable_irq();
   
   uint32_t BlockAddr;
+  uint32_t MapAddr = EraseStartAddress & 0xF0000000;
+  uint32_t Start;
+
+  Perf_Count(PERF_SECTOR_ERASE, 0);
   EraseStartAddress &= 0x0FFFFFFF;  
   EraseEndAddress &= 0x0FFFFFFF;
   EraseStartAddress = EraseStartAddress -  EraseStartAddress % 0x10000;
   
- /*Deinitialaize QSPI*/
-  if(BSP_QSPI_DeInit()!=0)
-    return 0;
- 
- /*Initialaize QSPI*/
-  if( BSP_QSPI_Init()!=0)
-    return 0;
-  
+ /*Initialaize QSPI, only after a failed operation*/
  while (EraseEndAddress>=EraseStartAddress)
  {
+    /*Skip the blocks already erased*/
+    if(Block_IsErased(MapAddr + EraseStartAddress, 0x10000) != 0)
+    {
+      EraseStartAddress+=0x10000;
+      continue;
+    }
+    /*Indirect mode, previous block erase completed*/
+    if(Session_EnterIndirect() == 0)
+      return 0;
    BlockAddr = EraseStartAddress;
  /*Erase the specified block of the QSPI memory*/
-   BSP_QSPI_Erase_Block(BlockAddr);
+   Start = Perf_EraseStart();
+   if(trace_bsp(TRACE_BSP_ERASE_BLOCK, BlockAddr, 0, BSP_QSPI_Erase_Block(BlockAddr)) != 0)
+   {
+     Session = SESSION_RESET;
+     return 0;
+   }
  /*Read current status of the QSPI memory*/
-   while (BSP_QSPI_GetStatus()!=0);
+    Perf_Add(PERF_PHASE_BUSY, &Start);
+    Session = SESSION_BUSY;
      EraseStartAddress+=0x10000;
   }
   
  /*Enable Interrupts*/
  __enable_irq();
   
-  return 1;	
+  return Session_Complete();	
 }
 
 /**
@@ -190,69 +1170,44 @@ KeepInCompilation int SectorErase (uint32_t EraseStartAddress ,uint32_t EraseEnd
   */
 uint32_t CheckSum(uint32_t StartAddress, uint32_t Size, uint32_t InitVal)
 {
-  uint8_t missalignementAddress = StartAddress%4;
-  uint8_t missalignementSize = Size ;
-  int cnt;
+  uint32_t missalignementAddress = StartAddress%4;
+  uint32_t missalignementSize = (4 - Size%4)%4;
+  uint32_t Words;
   uint32_t Val;
-	
-  StartAddress-=StartAddress%4;
-  Size += (Size%4==0)?0:4-(Size%4);
+  uint32_t Start;
   
-  for(cnt=0; cnt<Size ; cnt+=4)
+  Perf_Count(PERF_CHECKSUM, Size);
+  Start = Perf_Cycles();
+
+  /* The zone is walked as whole words from the aligned start address, the
+     leading bytes of the first word and the padding of the last one are
+     left out of the sum */
+  StartAddress-=missalignementAddress;
+  Words = (Size + missalignementSize)/4;
+  
+  if((missalignementAddress != 0) && (Words != 0))
   {
-    Val = *(uint32_t*)StartAddress;
-    if(missalignementAddress)
-    {
-      switch (missalignementAddress)
-      {
-        case 1:
-          InitVal += (uint8_t) (Val>>8 & 0xff);
-          InitVal += (uint8_t) (Val>>16 & 0xff);
-          InitVal += (uint8_t) (Val>>24 & 0xff);
-          missalignementAddress-=1;
-          break;
-        case 2:
-          InitVal += (uint8_t) (Val>>16 & 0xff);
-          InitVal += (uint8_t) (Val>>24 & 0xff);
-          missalignementAddress-=2;
-          break;
-        case 3:   
-          InitVal += (uint8_t) (Val>>24 & 0xff);
-          missalignementAddress-=3;
-          break;
-      }  
-    }
-    else if((Size-missalignementSize)%4 && (Size-cnt) <=4)
-    {
-      switch (Size-missalignementSize)
-      {
-        case 1:
-          InitVal += (uint8_t) Val;
-          InitVal += (uint8_t) (Val>>8 & 0xff);
-          InitVal += (uint8_t) (Val>>16 & 0xff);
-          missalignementSize-=1;
-          break;
-        case 2:
-          InitVal += (uint8_t) Val;
-          InitVal += (uint8_t) (Val>>8 & 0xff);
-          missalignementSize-=2;
-          break;
-        case 3:   
-          InitVal += (uint8_t) Val;
-          missalignementSize-=3;
-          break;
-      } 
-    }
-    else
+    Val = *(uint32_t*)StartAddress >> (8*missalignementAddress);
+    InitVal += CheckSum_Words(&Val, 1);
+    StartAddress+=4;
+    Words--;
+  }
+  
+  if((missalignementSize != 0) && (Words != 0))
+  {
+    Words--;
+    /* The size counter of the former byte ladder was 8-bit, so the partial
+       last word only ever counted in zones below 256 bytes */
+    if(Size < 0x100)
     {
-      InitVal += (uint8_t) Val;
-      InitVal += (uint8_t) (Val>>8 & 0xff);
-      InitVal += (uint8_t) (Val>>16 & 0xff);
-      InitVal += (uint8_t) (Val>>24 & 0xff);
+      Val = *(uint32_t*)(StartAddress + 4*Words) & (0xFFFFFFFF >> (8*missalignementSize));
+      InitVal += CheckSum_Words(&Val, 1);
     }
-    StartAddress+=4;
   }
   
+  InitVal += CheckSum_Words((const uint32_t*)StartAddress, Words);
+  
+  Perf_Add(PERF_PHASE_VERIFY, &Start);
   return (InitVal);
 }
 
@@ -275,21 +1230,97 @@ KeepInCompilation uint64_t Verify (uint32_t MemoryAddr, uint32_t RAMBufferAddr,
 {
   uint32_t VerifiedData = 0, InitVal = 0;
   uint64_t checksum;
+  uint32_t Start;
   Size*=4;
+  Perf_Count(PERF_VERIFY, Size);
 
   
+  if(Session_EnterMemoryMapped() == 0)
+    return MemoryAddr;
+  Start = Perf_Cycles();
+  /* Word-aligned zones are compared and added up in a single pass over the
+     memory. On a difference the checksum is recalculated and the byte loop
+     below resumes at the differing word */
+  if((((MemoryAddr | RAMBufferAddr) % 4) == 0) && ((missalignement & 0x000C000C) == 0) && (Size != 0))
+  {
+    VerifiedData = Verify_Words((const uint32_t*)MemoryAddr, (const uint32_t*)RAMBufferAddr, Size/4, &InitVal);
+    if(VerifiedData == Size)
+    {
+      Perf_Add(PERF_PHASE_VERIFY, &Start);
+      return ((uint64_t)Verify_CheckSum((const uint32_t*)RAMBufferAddr, Size, missalignement, InitVal) << 32);
+    }
+    InitVal = 0;
+  }
+  Perf_Add(PERF_PHASE_VERIFY, &Start);
   checksum = CheckSum((uint32_t)MemoryAddr + (missalignement & 0xf), Size - ((missalignement >> 16) & 0xF), InitVal);
+  Start = Perf_Cycles();
+  MemoryAddr += VerifiedData;
   while (Size>VerifiedData)
   {
     if ( *(uint8_t*)MemoryAddr++ != *((uint8_t*)RAMBufferAddr + VerifiedData))
+    {
+      Perf_Add(PERF_PHASE_VERIFY, &Start);
       return ((checksum<<32) + (MemoryAddr + VerifiedData));  
+    }
    
     VerifiedData++;  
   }
         
+  Perf_Add(PERF_PHASE_VERIFY, &Start);
   return (checksum<<32);
 }
 
+/**
+  * @brief   Calculates the CRC-32 of a memory zone with the CRC unit.
+  *          This is the IEEE 802.3 CRC-32 of zlib crc32(), so that the result
+  *          can be checked against a CRC of the source image on the host,
+  *          the CRC-32 of the 9 bytes "123456789" being 0xCBF43926.
+  * @param   StartAddress : start address of the zone
+  * @param   Size         : size of the zone (in bytes)
+  * @retval  CRC-32 of the zone, 0 if the memory could not be read
+  */
+KeepInCompilation uint32_t CheckCRC (uint32_t StartAddress, uint32_t Size)
+{
+  uint32_t Start;
+  uint32_t Crc;
+
+  Perf_Count(PERF_CHECKCRC, Size);
+  if(Session_EnterMemoryMapped() == 0)
+    return 0;
+
+  Start = Perf_Cycles();
+  CRC32_Start();
+  CRC32_Words((const uint8_t*)StartAddress, Size/4);
+  Crc = CRC32_End((const uint8_t*)StartAddress + (Size & ~0x3), Size%4);
+  Perf_Add(PERF_PHASE_VERIFY, &Start);
+
+  return Crc;
+}
+
+/**
+  * @brief   Calculates the SHA-256 digest of a memory zone, the host
+  *          comparing a single digest with the one of the source image
+  *          instead of reading the memory back.
+  * @param   StartAddress : start address of the zone
+  * @param   Size         : size of the zone (in bytes)
+  * @param   Digest       : RAM buffer receiving the 32-byte digest
+  * @retval  1      : Operation succeeded
+  * @retval  0      : Operation failed
+  */
+KeepInCompilation int CheckSHA256 (uint32_t StartAddress, uint32_t Size, uint8_t* Digest)
+{
+  uint32_t Start;
+
+  Perf_Count(PERF_CHECKSHA256, Size);
+  if(Session_EnterMemoryMapped() == 0)
+    return 0;
+
+  Start = Perf_Cycles();
+  SHA256_Calculate((const uint8_t*)StartAddress, Size, Digest);
+  Perf_Add(PERF_PHASE_VERIFY, &Start);
+  return 1;
+}
+
 
 /**
   * @brief  System Clock Configuration
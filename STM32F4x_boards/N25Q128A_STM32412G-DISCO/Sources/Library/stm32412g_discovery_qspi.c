@@ -64,6 +64,7 @@
 
 /* Includes ------------------------------------------------------------------*/
 #include "stm32412g_discovery_qspi.h"
+#include "loader_trace.h"
 
 /** @addtogroup BSP
   * @{
@@ -302,7 +303,7 @@ uint8_t BSP_QSPI_Erase_Block(uint32_t BlockAddress)
 
   /* Initialize the erase command */
   s_command.InstructionMode   = QSPI_INSTRUCTION_1_LINE;
-  s_command.Instruction       = SUBSECTOR_ERASE_CMD;
+  s_command.Instruction       = SECTOR_ERASE_CMD;
   s_command.AddressMode       = QSPI_ADDRESS_1_LINE;
   s_command.AddressSize       = QSPI_ADDRESS_24_BITS;
   s_command.Address           = BlockAddress;
@@ -326,7 +327,7 @@ uint8_t BSP_QSPI_Erase_Block(uint32_t BlockAddress)
   }
   
   /* Configure automatic polling mode to wait for end of erase */  
-  if (QSPI_AutoPollingMemReady(&QSPIHandle, N25Q128A_SUBSECTOR_ERASE_MAX_TIME) != QSPI_OK)
+  if (QSPI_AutoPollingMemReady(&QSPIHandle, N25Q128A_SECTOR_ERASE_MAX_TIME) != QSPI_OK)
   {
     return QSPI_ERROR;
   }
@@ -23,18 +23,263 @@
 #define __LOADER_SRC_H
 
 /* Includes ------------------------------------------------------------------*/
-#include "stm32F4xx_hal.h"
-#include "stm32F4xx_hal_qspi.h"
+#include "stm32f4xx_hal.h"
+#include "stm32f4xx_hal_qspi.h"
 #include "stm32f413h_discovery_qspi.h"
+#include "loader_trace.h"
 
 #define TIMEOUT 5000U
 #define KeepInCompilation __root
+/* Set to 1 to return from SectorErase and MassErase as soon as the last
+   erase command is accepted, the busy wait being completed on the next
+   loader call. Write is not deferred, the BSP waiting for the end of each
+   page program. Keep 0 if the host may call Init while the memory is still
+   busy, Init resetting the memory. */
+#define DEFERRED_COMPLETION 0
+
+/* Set to 1 to read each block through memory-mapped mode before erasing it,
+   the blocks already at the erase value being skipped */
+#define BLANK_CHECK_BEFORE_ERASE 0
+
+/* Set to 1 to compare each page with the memory content before programming
+   it: the pages already holding the data are skipped, and the pages whose
+   data would set bits are left as is, reported in DiffStatus, and fail the
+   Write */
+#define DIFFERENTIAL_WRITE 0
+
+/* Size of the RAM buffer each WriteCompressed block is decoded to */
+#define DECOMPRESS_BUFFER_SIZE 0x1000
+
+/* Size of the ring buffer drained by WriteStream, a multiple of the page size */
+#define STREAM_BUFFER_SIZE 0x2000
+
+/* Time WriteStream waits for the host to advance Head before failing, in ms,
+   measured with the DWT cycle counter: keep it below 2^32 core clock cycles.
+   Set to 0 to wait until the host sets Abort */
+#define STREAM_TIMEOUT_MS 1000
+
+/* Chunk size of the Fill pattern buffer, a multiple of the page size */
+#define FILL_BUFFER_SIZE 0x400
+
+/* Set to 1 to search the fastest stable memory clock at Init: the QUADSPI
+   clock divider is raised from the one of CLOCK_MAX_HZ up to the BSP one,
+   each divider reading the signature back CLOCK_PASSES times, and the first
+   divider reading it as the BSP clock does is kept. The result is kept in
+   ClockSearch for the host to read over SWD */
+#define CLOCK_SEARCH 0
+
+/* Clock divider applied without searching, 0 to search. Pin a divider
+   validated on the board when the search is not wanted */
+#define CLOCK_DIVIDER_PIN 0U
+
+/* QUADSPI instance and kernel clock, and memory clock rating of the read
+   command set by the BSP, to lower when the MCU I/O rating is below it */
+#define CLOCK_INSTANCE QUADSPI
+#define CLOCK_KERNEL_HZ HAL_RCC_GetHCLKFreq()
+#define CLOCK_MAX_HZ 108000000U  /* N25Q128A, quad output read */
+
+/* Reads of the signature each divider must pass, and bytes of the memory
+   read in the signature */
+#define CLOCK_PASSES 8U
+#define CLOCK_SIGNATURE_SIZE 64U
+
+/* Value of ClockSearch.Magic once the search has run */
+#define CLOCK_MAGIC 0x434C4B53
+
+/* Set to 1 to count the calls, bytes and DWT cycles of the loader operations
+   in PerfCounters, placed by Target.icf at the fixed address it exports as
+   __ICFEDIT_region_PERF_start__, for the host to read over SWD */
+#define PERF_COUNTERS 1
+
+/* Value of PerfCounters.Magic once the counters are initialized, the host
+   clearing Magic to restart the counts */
+#define PERF_MAGIC 0x50455246
+
+/* Define USE_COMMAND_TRACE in the preprocessor symbols of the project to log
+   the entry points, the BSP calls and the memory commands of the loader in
+   CommandTrace (loader_trace.h), kept across loader calls for the host to
+   read over SWD. The BSP driver is built with it to log the commands it
+   sends */
+
+/* Exported types ------------------------------------------------------------*/
+/**
+  * @brief QSPI session state kept across loader calls
+  */
+typedef enum
+{
+  SESSION_RESET = 0,  /*!< Controller must be (re)initialized     */
+  SESSION_INDIRECT,   /*!< Controller ready for indirect commands */
+  SESSION_MEMMAPPED,  /*!< Controller in memory-mapped mode       */
+  SESSION_BUSY        /*!< Indirect mode, program/erase running   */
+} SESSION_STATE;
+
+/**
+  * @brief Result of the comparison of a page with the memory content
+  */
+typedef enum
+{
+  PAGE_IDENTICAL = 0, /*!< Memory already holds the data          */
+  PAGE_PROGRAM,       /*!< Data only clears bits, programmed      */
+  PAGE_ERASE          /*!< Data sets bits, page must be erased    */
+} PAGE_STATE;
+
+/**
+  * @brief Statistics of the last Write call in differential mode
+  */
+typedef struct
+{
+  uint32_t IdenticalPages;  /*!< Pages skipped, already holding the data  */
+  uint32_t ProgrammedPages; /*!< Pages programmed in place                */
+  uint32_t ErasePages;      /*!< Pages left as is, needing an erase       */
+  uint32_t EraseAddress;    /*!< Address of the first page needing erase  */
+} DIFF_STATUS;
+
+/**
+  * @brief State of the WriteStream ring buffer
+  */
+typedef enum
+{
+  STREAM_IDLE = 0,  /*!< No stream started                      */
+  STREAM_RUNNING,   /*!< Data programmed as the host writes it  */
+  STREAM_DONE,      /*!< Whole stream programmed                */
+  STREAM_ERROR      /*!< Program failed, timeout or abort       */
+} STREAM_STATE;
+
+/**
+  * @brief Ring buffer the host streams the data to program into
+  */
+typedef struct
+{
+  volatile uint32_t Head;       /*!< Bytes written by the host, free running */
+  volatile uint32_t Tail;       /*!< Bytes programmed, free running          */
+  volatile uint32_t Address;    /*!< Memory address of the next byte         */
+  volatile uint32_t End;        /*!< Memory address ending the stream        */
+  volatile STREAM_STATE Status; /*!< Stream state, polled by the host        */
+  volatile uint32_t Abort;      /*!< Set by the host to stop the stream      */
+  uint8_t Data[STREAM_BUFFER_SIZE];
+} STREAM_RING;
+
+/**
+  * @brief Operations run by RunOperations
+  */
+typedef enum
+{
+  OPERATION_ERASE = 0,  /*!< SectorErase of the blocks of the zone        */
+  OPERATION_PROGRAM,    /*!< Write of the zone from Buffer                */
+  OPERATION_VERIFY      /*!< Verify of the zone against Buffer            */
+} OPERATION_TYPE;
+
+/**
+  * @brief Status of an operation run by RunOperations
+  */
+typedef enum
+{
+  OPERATION_FAILED = 0, /*!< Operation failed, the list stopped           */
+  OPERATION_OK,         /*!< Operation succeeded                          */
+  OPERATION_NOT_RUN     /*!< Operation after a failure, not run           */
+} OPERATION_STATUS;
+
+/**
+  * @brief Operation descriptor, in RAM
+  */
+typedef struct
+{
+  uint32_t Op;          /*!< OPERATION_TYPE                               */
+  uint32_t Address;     /*!< Memory address of the zone                   */
+  uint32_t Size;        /*!< Size of the zone (in bytes)                  */
+  uint8_t* Buffer;      /*!< Data to program or to verify                 */
+  uint32_t Status;      /*!< OPERATION_STATUS, written by the loader      */
+} OPERATION;
+
+/**
+  * @brief Result of the clock divider search
+  */
+typedef enum
+{
+  CLOCK_NOT_RUN = 0,  /*!< Search not run                               */
+  CLOCK_SEARCHED,     /*!< Fastest divider passing applied              */
+  CLOCK_PINNED,       /*!< CLOCK_DIVIDER_PIN applied                    */
+  CLOCK_BSP_KEPT,     /*!< No faster divider passed, BSP one kept       */
+  CLOCK_NO_SIGNATURE  /*!< Signature not read or flat, BSP one kept     */
+} CLOCK_STATE;
+
+/**
+  * @brief Clock divider search status, read by the host over SWD
+  */
+typedef struct
+{
+  uint32_t Magic;         /*!< CLOCK_MAGIC once the search has run          */
+  uint32_t Status;        /*!< CLOCK_STATE                                  */
+  uint32_t BspDivider;    /*!< Kernel clock divider set by the BSP          */
+  uint32_t Divider;       /*!< Kernel clock divider in use                  */
+  uint32_t ClockHz;       /*!< Memory clock in use                          */
+  uint32_t FailMap;       /*!< Bit n set when divider n failed, n < 32      */
+} CLOCK_STATUS;
+
+/**
+  * @brief Loader entry points counted in PerfCounters
+  */
+typedef enum
+{
+  PERF_INIT = 0,      /*!< Init                                         */
+  PERF_WRITE,         /*!< Write, also run by the other write functions */
+  PERF_SECTOR_ERASE,  /*!< SectorErase                                  */
+  PERF_MASS_ERASE,    /*!< MassErase, also run by a full SectorErase    */
+  PERF_VERIFY,        /*!< Verify                                       */
+  PERF_CHECKSUM,      /*!< CheckSum, also run by Verify on a mismatch   */
+  PERF_CHECKCRC,      /*!< CheckCRC                                     */
+  PERF_CHECKSHA256,   /*!< CheckSHA256                                  */
+  PERF_ENTRY_COUNT
+} PERF_ENTRY;
+
+/**
+  * @brief Phases the loader cycles are spent in
+  */
+typedef enum
+{
+  PERF_PHASE_INIT = 0,  /*!< Init, controller re-init and mode switches   */
+  PERF_PHASE_DATA,      /*!< Page program runs sent to the memory         */
+  PERF_PHASE_BUSY,      /*!< Erase commands and waits for the memory      */
+  PERF_PHASE_VERIFY,    /*!< Memory reads of Verify and of the checks     */
+  PERF_PHASE_COUNT
+} PERF_PHASE;
+
+/**
+  * @brief Timing of a memory operation (in DWT cycles)
+  */
+typedef struct
+{
+  uint32_t Count;       /*!< Operations timed, Total/Count the average    */
+  uint32_t Min;         /*!< Shortest operation                           */
+  uint32_t Max;         /*!< Longest operation                            */
+  uint64_t Total;       /*!< Sum of the operations                        */
+} PERF_TIMING;
+
+/**
+  * @brief Performance counters, kept across loader calls
+  */
+typedef struct
+{
+  uint32_t Magic;                     /*!< PERF_MAGIC once initialized        */
+  uint32_t CoreClock;                 /*!< Clock the cycles count at (Hz)     */
+  uint32_t Calls[PERF_ENTRY_COUNT];   /*!< Calls of each entry point          */
+  uint32_t Bytes[PERF_ENTRY_COUNT];   /*!< Bytes written, verified or checked */
+  uint64_t Cycles[PERF_PHASE_COUNT];  /*!< Cycles spent in each phase         */
+  PERF_TIMING PageProgram;            /*!< tPP, Count the pages programmed    */
+  PERF_TIMING BlockErase;             /*!< tBE, Count the blocks erased       */
+} PERF_BLOCK;
 
 /* Private function prototypes -----------------------------------------------*/
 int Init ();
 KeepInCompilation int Write (uint32_t Address, uint32_t Size, uint8_t* buffer);
+KeepInCompilation int WriteCompressed (uint32_t Address, uint32_t Size, uint8_t* buffer);
+KeepInCompilation int WriteStream (void);
+KeepInCompilation int RunOperations (OPERATION* List, uint32_t Count);
+KeepInCompilation int Fill (uint32_t Address, uint32_t Size, uint32_t Pattern, uint32_t PatternSize);
 KeepInCompilation int SectorErase (uint32_t EraseStartAddress ,uint32_t EraseEndAddress);
 KeepInCompilation uint64_t Verify (uint32_t MemoryAddr, uint32_t RAMBufferAddr, uint32_t Size, uint32_t missalignement);
+KeepInCompilation uint32_t CheckCRC (uint32_t StartAddress, uint32_t Size);
+KeepInCompilation int CheckSHA256 (uint32_t StartAddress, uint32_t Size, uint8_t* Digest);
 KeepInCompilation HAL_StatusTypeDef HAL_InitTick(uint32_t TickPriority);
 KeepInCompilation int MassErase (uint32_t Parallelism );
 int SystemClock_Config(void);
@@ -64,6 +64,7 @@
 
 /* Includes ------------------------------------------------------------------*/
 #include "stm32f413h_discovery_qspi.h"
+#include "loader_trace.h"
 
 /** @addtogroup BSP
   * @{
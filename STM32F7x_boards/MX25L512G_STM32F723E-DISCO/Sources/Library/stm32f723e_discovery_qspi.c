@@ -72,6 +72,7 @@ EndDependencies */
 
 /* Includes ------------------------------------------------------------------*/
 #include "stm32f723e_discovery_qspi.h"
+#include "loader_trace.h"
 
 /** @addtogroup BSP
   * @{
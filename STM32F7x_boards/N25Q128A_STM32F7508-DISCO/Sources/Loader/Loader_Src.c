@@ -24,14 +24,353 @@
 #include "Flash_QSPI_Micron.h"
 #include "stm32f7xx_rcc.h"
 #include <string.h>
+#include "loader_kernels.h"
 
 /* Private variables ---------------------------------------------------------*/
 QUADSPI_InitTypeDef QUADSPI_InitStructure;
 QUADSPI_ComConfig_InitTypeDef QUADSPI_ComConfig_InitStructure;
+uint32_t SkippedPages;
+uint32_t SkippedSectors;
+/* Core clock of system_stm32f7xx.c, which has no header */
+extern uint32_t SystemCoreClock;
+
+/* Set to 1 to read each sector through memory-mapped mode before erasing it,
+   the sectors already at the erase value being skipped */
+#define BLANK_CHECK_BEFORE_ERASE 0
+
+/* Chunk size of the Fill pattern buffer, a multiple of the page size */
+#define FILL_BUFFER_SIZE 0x400
+static uint32_t FillBuffer[FILL_BUFFER_SIZE/4 + 1];
+
+/* Set to 1 to count the calls, bytes and DWT cycles of the loader operations
+   in PerfCounters, placed by Target.lin in the PerfData region at 0x2004EF00
+   (Image$$PerfData$$Base), for the host to read over SWD */
+#define PERF_COUNTERS 1
+
+/* Value of PerfCounters.Magic once the counters are initialized, the host
+   clearing Magic to restart the counts */
+#define PERF_MAGIC 0x50455246
+
+/* Loader entry points counted in PerfCounters */
+typedef enum
+{
+  PERF_INIT = 0,      /* Init                                         */
+  PERF_WRITE,         /* Write, also run by Fill                      */
+  PERF_SECTOR_ERASE,  /* SectorErase                                  */
+  PERF_MASS_ERASE,    /* MassErase                                    */
+  PERF_VERIFY,        /* Verify                                       */
+  PERF_CHECKSUM,      /* CheckSum, also run by Verify on a mismatch   */
+  PERF_CHECKCRC,      /* CheckCRC                                     */
+  PERF_CHECKSHA256,   /* CheckSHA256                                  */
+  PERF_ENTRY_COUNT
+} PERF_ENTRY;
+
+/* Phases the loader cycles are spent in */
+typedef enum
+{
+  PERF_PHASE_INIT = 0,  /* Init                                         */
+  PERF_PHASE_DATA,      /* Page program runs, with their busy waits     */
+  PERF_PHASE_BUSY,      /* Erase commands, with their busy waits        */
+  PERF_PHASE_VERIFY,    /* Memory reads of Verify and of the checks     */
+  PERF_PHASE_COUNT
+} PERF_PHASE;
+
+/* Timing of a memory operation (in DWT cycles) */
+typedef struct
+{
+  uint32_t Count;       /* Operations timed, Total/Count the average    */
+  uint32_t Min;         /* Shortest operation                           */
+  uint32_t Max;         /* Longest operation                            */
+  uint64_t Total;       /* Sum of the operations                        */
+} PERF_TIMING;
+
+/* Performance counters, kept across loader calls */
+typedef struct
+{
+  uint32_t Magic;                     /* PERF_MAGIC once initialized        */
+  uint32_t CoreClock;                 /* Clock the cycles count at (Hz)     */
+  uint32_t Calls[PERF_ENTRY_COUNT];   /* Calls of each entry point          */
+  uint32_t Bytes[PERF_ENTRY_COUNT];   /* Bytes written, verified or checked */
+  uint64_t Cycles[PERF_PHASE_COUNT];  /* Cycles spent in each phase         */
+  PERF_TIMING PageProgram;            /* tPP, Count the pages programmed    */
+  PERF_TIMING BlockErase;             /* tBE, Count the sectors erased      */
+} PERF_BLOCK;
+
+#if (PERF_COUNTERS == 1)
+PERF_BLOCK PerfCounters __attribute__((section(".perf"), zero_init));
+#endif
+
+/* Set to 1 to search the fastest stable memory clock at Init: the QUADSPI
+   clock divider is raised from the one of CLOCK_MAX_HZ up to the one set
+   below in Init, each divider reading the signature back CLOCK_PASSES times
+   through the memory-mapped window, and the first divider reading it as the
+   Init clock does is kept. The result is kept in ClockSearch for the host to
+   read over SWD */
+#define CLOCK_SEARCH 0
+
+/* Clock divider applied without searching, 0 to search. Pin a divider
+   validated on the board when the search is not wanted */
+#define CLOCK_DIVIDER_PIN 0
+
+/* Memory clock rating of the memory-mapped read, quad output fast read with
+   8 dummy cycles */
+#define CLOCK_MAX_HZ 108000000  /* N25Q128A */
+
+/* Reads of the signature each divider must pass, and bytes of the memory
+   read in the signature */
+#define CLOCK_PASSES 8
+#define CLOCK_SIGNATURE_SIZE 64
+
+/* Value of ClockSearch.Magic once the search has run */
+#define CLOCK_MAGIC 0x434C4B53
+
+/* Result of the clock divider search */
+typedef enum
+{
+  CLOCK_NOT_RUN = 0,  /* Search not run                               */
+  CLOCK_SEARCHED,     /* Fastest divider passing applied              */
+  CLOCK_PINNED,       /* CLOCK_DIVIDER_PIN applied                    */
+  CLOCK_INIT_KEPT,    /* No faster divider passed, Init one kept      */
+  CLOCK_NO_SIGNATURE  /* Signature flat, Init divider kept            */
+} CLOCK_STATE;
+
+/* Clock divider search status, read by the host over SWD */
+typedef struct
+{
+  uint32_t Magic;       /* CLOCK_MAGIC once the search has run          */
+  uint32_t Status;      /* CLOCK_STATE                                  */
+  uint32_t BspDivider;  /* Kernel clock divider set by Init             */
+  uint32_t Divider;     /* Kernel clock divider in use                  */
+  uint32_t ClockHz;     /* Memory clock in use                          */
+  uint32_t FailMap;     /* Bit n set when divider n failed, n < 32      */
+} CLOCK_STATUS;
+
+#if (CLOCK_SEARCH == 1)
+CLOCK_STATUS ClockSearch;
+static uint8_t ClockReference[CLOCK_SIGNATURE_SIZE];
+static uint8_t ClockSignature[CLOCK_SIGNATURE_SIZE];
+#endif
 
 extern void SystemInit(void);
 
 uint64_t Verify (uint32_t MemoryAddr, uint32_t RAMBufferAddr, uint32_t Size, uint32_t missalignement);
+uint32_t CheckCRC (uint32_t StartAddress, uint32_t Size);
+int CheckSHA256 (uint32_t StartAddress, uint32_t Size, uint8_t* Digest);
+int Fill (uint32_t Address, uint32_t Size, uint32_t Pattern, uint32_t PatternSize);
+
+/**
+  * @brief  Starts the DWT cycle counter. PerfCounters is cleared unless it
+  *         already holds the counts of the previous calls.
+  * @param  None
+  * @retval None
+  */
+static void Perf_Init(void)
+{
+#if (PERF_COUNTERS == 1)
+  CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+  /* The Cortex-M7 DWT is write-locked */
+  DWT->LAR = 0xC5ACCE55;
+  DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
+  if(PerfCounters.Magic != PERF_MAGIC)
+  {
+    memset(&PerfCounters, 0, sizeof(PerfCounters));
+    PerfCounters.Magic = PERF_MAGIC;
+  }
+#endif
+}
+
+/**
+  * @brief  Reads the DWT cycle counter.
+  * @param  None
+  * @retval Cycle count, 0 without PERF_COUNTERS
+  */
+static uint32_t Perf_Cycles(void)
+{
+#if (PERF_COUNTERS == 1)
+  return DWT->CYCCNT;
+#else
+  return 0;
+#endif
+}
+
+/**
+  * @brief  Counts a call to a loader entry point.
+  * @param  Entry : entry point called
+  * @param  Size  : bytes handled by the call
+  * @retval None
+  */
+static void Perf_Count(PERF_ENTRY Entry, uint32_t Size)
+{
+#if (PERF_COUNTERS == 1)
+  PerfCounters.Calls[Entry]++;
+  PerfCounters.Bytes[Entry] += Size;
+#endif
+}
+
+/**
+  * @brief  Adds the cycles elapsed since Start to a phase and, when Timing is
+  *         not NULL, Count operations lasting these cycles in total to it.
+  * @param  Phase  : phase the cycles were spent in
+  * @param  Start  : cycle count the phase started at
+  * @param  Timing : timing of the operations, or NULL
+  * @param  Count  : number of operations
+  * @retval None
+  */
+static void Perf_Add(PERF_PHASE Phase, uint32_t Start, PERF_TIMING* Timing, uint32_t Count)
+{
+#if (PERF_COUNTERS == 1)
+  uint32_t Cycles = DWT->CYCCNT - Start;
+  uint32_t Average;
+
+  PerfCounters.Cycles[Phase] += Cycles;
+  PerfCounters.CoreClock = SystemCoreClock;
+  if((Timing == NULL) || (Count == 0))
+    return;
+
+  Average = Cycles / Count;
+  if((Timing->Count == 0) || (Average < Timing->Min))
+    Timing->Min = Average;
+  if(Average > Timing->Max)
+    Timing->Max = Average;
+  Timing->Count += Count;
+  Timing->Total += Cycles;
+#endif
+}
+
+/**
+  * @brief  Configures the QUADSPI in memory-mapped mode (quad output fast read).
+  * @param  None
+  * @retval None
+  */
+static void QSPI_MemoryMappedMode(void)
+{
+  QUADSPI_ComConfig_InitStructure.QUADSPI_ComConfig_DummyCycles  = 8;
+  QUADSPI_ComConfig_InitStructure.QUADSPI_ComConfig_FMode = QUADSPI_ComConfig_FMode_Memory_Mapped;
+  QUADSPI_ComConfig_InitStructure.QUADSPI_ComConfig_ADMode = QUADSPI_ComConfig_ADMode_1Line;
+  QUADSPI_ComConfig_InitStructure.QUADSPI_ComConfig_ADSize = QUADSPI_ComConfig_ADSize_24bit;
+  QUADSPI_ComConfig_InitStructure.QUADSPI_ComConfig_DMode = QUADSPI_ComConfig_DMode_4Line;
+  QUADSPI_ComConfig_InitStructure.QUADSPI_ComConfig_IMode = QUADSPI_ComConfig_IMode_1Line;
+  QUADSPI_ComConfig_InitStructure.QUADSPI_ComConfig_Ins = READ_QUAD_CMD;
+  QUADSPI_ComConfig_Init(&QUADSPI_ComConfig_InitStructure);
+}
+
+#if (CLOCK_SEARCH == 1)
+/**
+  * @brief  Sets the QUADSPI kernel clock divider, the memory-mapped mode
+  *         being left while it changes.
+  * @param  Divider : kernel clock divider
+  * @retval None
+  */
+static void Clock_SetDivider(uint32_t Divider)
+{
+  QUADSPI_AbortRequest();
+  while(QUADSPI_GetFlagStatus(QUADSPI_FLAG_BUSY)==SET);
+  QUADSPI->CR = (QUADSPI->CR & ~QUADSPI_CR_PRESCALER) | ((Divider - 1) << 24);
+  QSPI_MemoryMappedMode();
+}
+
+/**
+  * @brief  Reads the signature, the CLOCK_SIGNATURE_SIZE first bytes of the
+  *         memory, through the memory-mapped window. The memory-mapped mode
+  *         is entered again first, so that the bytes prefetched by the
+  *         QUADSPI are not read back.
+  * @param  Signature : buffer of CLOCK_SIGNATURE_SIZE bytes
+  * @retval None
+  */
+static void Clock_ReadSignature(uint8_t* Signature)
+{
+  QUADSPI_AbortRequest();
+  while(QUADSPI_GetFlagStatus(QUADSPI_FLAG_BUSY)==SET);
+  QSPI_MemoryMappedMode();
+  memcpy(Signature, (uint8_t*)0x90000000, CLOCK_SIGNATURE_SIZE);
+}
+
+/**
+  * @brief  Checks whether the signature only holds 0x00 and 0xFF bytes, as
+  *         read from an erased memory or from stuck lines, no clock being
+  *         validated with it.
+  * @param  Signature : buffer of CLOCK_SIGNATURE_SIZE bytes
+  * @retval  1      : Signature is flat
+  * @retval  0      : Signature can validate a clock
+  */
+static int Clock_IsFlat(const uint8_t* Signature)
+{
+  uint32_t i;
+
+  for(i = 0; i < CLOCK_SIGNATURE_SIZE; i++)
+  {
+    if((Signature[i] != 0x00) && (Signature[i] != 0xFF))
+      return 0;
+  }
+  return 1;
+}
+#endif
+
+/**
+  * @brief  Searches the fastest stable memory clock. The signature is first
+  *         read at the Init clock, then each divider from the one of
+  *         CLOCK_MAX_HZ up to the Init one reads it back CLOCK_PASSES times.
+  *         The first divider passing is applied, the Init one being kept when
+  *         none passes or when the signature is flat. CLOCK_DIVIDER_PIN is
+  *         applied as is when set. The result is kept in ClockSearch.
+  * @param  None
+  * @retval None
+  */
+static void Clock_Search(void)
+{
+#if (CLOCK_SEARCH == 1)
+  RCC_ClocksTypeDef Clocks;
+  uint32_t Divider;
+  uint32_t Pass;
+
+  RCC_GetClocksFreq(&Clocks);
+  memset(&ClockSearch, 0, sizeof(ClockSearch));
+  ClockSearch.Magic = CLOCK_MAGIC;
+  ClockSearch.BspDivider = ((QUADSPI->CR & QUADSPI_CR_PRESCALER) >> 24) + 1;
+  ClockSearch.Divider = ClockSearch.BspDivider;
+  ClockSearch.Status = CLOCK_INIT_KEPT;
+
+  if(CLOCK_DIVIDER_PIN != 0)
+  {
+    ClockSearch.Divider = CLOCK_DIVIDER_PIN;
+    ClockSearch.Status = CLOCK_PINNED;
+  }
+  else
+  {
+    Clock_ReadSignature(ClockReference);
+    if(Clock_IsFlat(ClockReference) != 0)
+      ClockSearch.Status = CLOCK_NO_SIGNATURE;
+    else
+    {
+      for(Divider = (Clocks.HCLK_Frequency + CLOCK_MAX_HZ - 1) / CLOCK_MAX_HZ;
+          Divider < ClockSearch.BspDivider; Divider++)
+      {
+        Clock_SetDivider(Divider);
+        for(Pass = 0; Pass < CLOCK_PASSES; Pass++)
+        {
+          Clock_ReadSignature(ClockSignature);
+          if(memcmp(ClockSignature, ClockReference, sizeof(ClockSignature)) != 0)
+            break;
+        }
+
+        if(Pass == CLOCK_PASSES)
+        {
+          ClockSearch.Divider = Divider;
+          ClockSearch.Status = CLOCK_SEARCHED;
+          break;
+        }
+        if(Divider < 32)
+          ClockSearch.FailMap |= 1UL << Divider;
+      }
+    }
+  }
+
+  Clock_SetDivider(ClockSearch.Divider);
+  ClockSearch.ClockHz = Clocks.HCLK_Frequency / ClockSearch.Divider;
+#endif
+}
+
 /**
   * @brief  System initialization.
   * @param  None
@@ -41,13 +380,19 @@ uint64_t Verify (uint32_t MemoryAddr, uint32_t RAMBufferAddr, uint32_t Size, uin
 int Init (void)
 { 
   GPIO_InitTypeDef GPIO_InitStructure;
+  uint32_t Start;
 
   SystemInit();	
   RCC_HCLKConfig(RCC_SYSCLK_Div1);
+  Perf_Init();
+  Perf_Count(PERF_INIT, 0);
+  Start = Perf_Cycles();
 
 	/*  Init structs to Zero*/
 	memset( &QUADSPI_InitStructure,0,sizeof(QUADSPI_InitStructure));
 	memset( &QUADSPI_ComConfig_InitStructure,0,sizeof(QUADSPI_ComConfig_InitStructure));
+	SkippedPages = 0;
+	SkippedSectors = 0;
 	
   /* Enable QUADSPI Clock*/
 	RCC->AHB3ENR |= RCC_AHB3Periph_QSPI;
@@ -142,21 +487,53 @@ int Init (void)
 	__DSB();
 	
 	/* Configure QUADSPI To Memory Mapped Mode */
-  QUADSPI_ComConfig_InitStructure.QUADSPI_ComConfig_DummyCycles  = 8;
-  QUADSPI_ComConfig_InitStructure.QUADSPI_ComConfig_FMode = QUADSPI_ComConfig_FMode_Memory_Mapped;
-  QUADSPI_ComConfig_InitStructure.QUADSPI_ComConfig_ADMode = QUADSPI_ComConfig_ADMode_1Line;
-  QUADSPI_ComConfig_InitStructure.QUADSPI_ComConfig_ADSize = QUADSPI_ComConfig_ADSize_24bit;
-  QUADSPI_ComConfig_InitStructure.QUADSPI_ComConfig_DMode = QUADSPI_ComConfig_DMode_4Line; 
-  QUADSPI_ComConfig_InitStructure.QUADSPI_ComConfig_IMode = QUADSPI_ComConfig_IMode_1Line;
-  QUADSPI_ComConfig_InitStructure.QUADSPI_ComConfig_Ins = READ_QUAD_CMD;
-  QUADSPI_ComConfig_Init(&QUADSPI_ComConfig_InitStructure);
+	QSPI_MemoryMappedMode();
+
+	/* Search the fastest stable QUADSPI clock */
+	Clock_Search();
+	Perf_Add(PERF_PHASE_INIT, Start, NULL, 0);
 	
   return (1);
 }
 
 
+/**
+  * @brief  Checks whether a buffer holds only the erase value (0xFF).
+  *         The buffer is scanned word by word once aligned.
+  * @param  buffer : pointer to data buffer
+  * @param  Size   : size of data
+  * @retval  1      : Buffer is blank
+  * @retval  0      : Buffer holds data to program
+  */
+static int Buffer_IsErased(uint8_t* buffer, uint32_t Size)
+{
+  while((Size > 0) && (((uint32_t)buffer & 0x3) != 0))
+  {
+    if(*buffer++ != 0xFF)
+      return 0;
+    Size--;
+  }
+  while(Size >= 4)
+  {
+    if(*(uint32_t*)buffer != 0xFFFFFFFF)
+      return 0;
+    buffer += 4;
+    Size   -= 4;
+  }
+  while(Size > 0)
+  {
+    if(*buffer++ != 0xFF)
+      return 0;
+    Size--;
+  }
+
+  return 1;
+}
+
 /**
   * @brief   Program memory.
+  *          The pages whose data is entirely the erase value are skipped,
+  *          consecutive pages holding data are written with a single call.
   * @param   Address: page address
   * @param   Size   : size of data
   * @param   buffer : pointer to data buffer
@@ -165,13 +542,140 @@ int Init (void)
   */
 int Write (uint32_t Address, uint32_t Size, uint16_t* Buffer)
 { 
-	uint32_t Counter = Size;
-	
-  QUADSPI_Valid_WriteBuffer((uint8_t*)Buffer,(Address & 0x0FFFFFFF), &Counter);
+  uint8_t* pData = (uint8_t*)Buffer;
+  uint32_t Counter, run, page = 0;
+  uint32_t Start;
+
+  Perf_Count(PERF_WRITE, Size);
+  Address &= 0x0FFFFFFF;
+  while(Size > 0)
+  {
+    /* Gather the pages holding data up to the next blank page */
+    run = 0;
+    while(run < Size)
+    {
+      page = QSPI_PAGESIZE - ((Address + run) % QSPI_PAGESIZE);
+      if(page > Size - run)
+        page = Size - run;
+      if(Buffer_IsErased(pData + run, page) != 0)
+        break;
+      run += page;
+    }
+
+    if(run != 0)
+    {
+      Counter = run;
+      Start = Perf_Cycles();
+      QUADSPI_Valid_WriteBuffer(pData, Address, &Counter);
+      Perf_Add(PERF_PHASE_DATA, Start, &PerfCounters.PageProgram,
+               ((Address % QSPI_PAGESIZE) + run + QSPI_PAGESIZE - 1) / QSPI_PAGESIZE);
+    }
+
+    /* Skip the blank page */
+    if(run < Size)
+    {
+      SkippedPages++;
+      run += page;
+    }
 
-	return 1;
+    Address += run;
+    pData   += run;
+    Size    -= run;
+  }
+
+  return 1;
 } 
 
+/**
+  * @brief   Programs a memory zone with a repeated pattern generated in RAM,
+  *          so that constant runs need not be transferred to the loader.
+  *          A fill with the erase value (0xFF) programs nothing and fails
+  *          unless the zone is already erased.
+  * @param   Address     : zone start address
+  * @param   Size        : zone size
+  * @param   Pattern     : pattern, least significant byte first
+  * @param   PatternSize : pattern size, 1, 2 or 4 bytes
+  * @retval  1      : Operation succeeded
+  * @retval  0      : Operation failed
+  */
+int Fill (uint32_t Address, uint32_t Size, uint32_t Pattern, uint32_t PatternSize)
+{
+  uint32_t Mask;
+  uint32_t Phase = 0;
+  uint32_t Count;
+  uint32_t i;
+
+  if((PatternSize != 1) && (PatternSize != 2) && (PatternSize != 4))
+    return 0;
+  Mask = (PatternSize == 4) ? 0xFFFFFFFF : ((1UL << (8 * PatternSize)) - 1);
+  if((Pattern & Mask) == Mask)
+  {
+    /* Programming the erase value changes no bit: the zone is checked to be
+       erased instead, by Verify against a chunk of 0xFF, the last bytes
+       being read in the memory-mapped mode it leaves enabled */
+    memset(FillBuffer, 0xFF, FILL_BUFFER_SIZE);
+    do
+    {
+      Count = (Size < FILL_BUFFER_SIZE) ? (Size & ~0x3) : FILL_BUFFER_SIZE;
+      if((uint32_t)Verify(Address, (uint32_t)FillBuffer, Count / 4, 0) != 0)
+        return 0;
+      Address += Count;
+      Size -= Count;
+    } while(Size >= 4);
+    for(i = 0; i < Size; i++)
+    {
+      if(*(uint8_t*)(Address + i) != 0xFF)
+        return 0;
+    }
+    return 1;
+  }
+
+  /* One pattern more than the chunk size, each chunk starting at its phase */
+  for(i = 0; i < FILL_BUFFER_SIZE + 4; i++)
+    ((uint8_t*)FillBuffer)[i] = (uint8_t)(Pattern >> (8 * (i % PatternSize)));
+
+  while(Size > 0)
+  {
+    /* Chunks aligned on the buffer size, so on pages */
+    Count = FILL_BUFFER_SIZE - (Address % FILL_BUFFER_SIZE);
+    if(Count > Size)
+      Count = Size;
+    if(Write(Address, Count, (uint16_t*)((uint8_t*)FillBuffer + Phase)) == 0)
+      return 0;
+    Phase = (Phase + Count) % PatternSize;
+    Address += Count;
+    Size -= Count;
+  }
+
+  return 1;
+}
+
+
+/**
+  * @brief  Checks through memory-mapped mode whether a sector is already
+  *         erased, memory-mapped mode being aborted before returning.
+  * @param  Address : sector address in the memory-mapped region
+  * @param  Size    : sector size
+  * @retval  1      : Sector is blank
+  * @retval  0      : Sector must be erased
+  */
+static int Sector_IsErased(uint32_t Address, uint32_t Size)
+{
+#if (BLANK_CHECK_BEFORE_ERASE == 1)
+  int blank;
+
+  QSPI_MemoryMappedMode();
+  blank = Buffer_IsErased((uint8_t*)Address, Size);
+  QUADSPI_AbortRequest();
+  while(QUADSPI_GetFlagStatus(QUADSPI_FLAG_BUSY)==SET);
+  if(blank != 0)
+    SkippedSectors++;
+
+  return blank;
+#else
+  return 0;
+#endif
+}
 
 /**
   * @brief   Sector erase.
@@ -182,12 +686,23 @@ int Write (uint32_t Address, uint32_t Size, uint16_t* Buffer)
 int SectorErase (uint32_t EraseStartAddress ,uint32_t EraseEndAddress)
 {      
 	uint32_t BlockAddr;
+	uint32_t Start;
+
+	Perf_Count(PERF_SECTOR_ERASE, 0);
 	EraseStartAddress = EraseStartAddress -  EraseStartAddress % 0x10000;
 		
 	while (EraseEndAddress>=EraseStartAddress)
 	{
+		/* Skip the sector already erased */
+		if(Sector_IsErased(EraseStartAddress, 0x10000) != 0)
+		{
+			EraseStartAddress += 0x10000;
+			continue;
+		}
 		BlockAddr = EraseStartAddress & 0x0FFFFFFF;
+		Start = Perf_Cycles();
 		QUADSPI_Valid_EraseSector( BlockAddr);
+		Perf_Add(PERF_PHASE_BUSY, Start, &PerfCounters.BlockErase, 1);
     EraseStartAddress += 0x10000;
 	}
  	return 1;	
@@ -200,76 +715,53 @@ int SectorErase (uint32_t EraseStartAddress ,uint32_t EraseEndAddress)
   * @retval  0           : Operation failed											
   */
 int MassErase (uint32_t Parallelism ){
- 
+  uint32_t Start;
+
+  Perf_Count(PERF_MASS_ERASE, 0);
+  Start = Perf_Cycles();
   QUADSPI_Valid_BulkErase();
+  Perf_Add(PERF_PHASE_BUSY, Start, NULL, 0);
   return 1;
 }
 
 uint32_t CheckSum(uint32_t StartAddress, uint32_t Size, uint32_t InitVal)
 {
-  uint8_t missalignementAddress = StartAddress%4;
-  uint8_t missalignementSize = Size ;
-  int cnt;
+  uint32_t missalignementAddress = StartAddress%4;
+  uint32_t missalignementSize = (4 - Size%4)%4;
+  uint32_t Words;
   uint32_t Val;
-	
-  StartAddress-=StartAddress%4;
-  Size += (Size%4==0)?0:4-(Size%4);
+  uint32_t Start = Perf_Cycles();
+  
+  Perf_Count(PERF_CHECKSUM, Size);
+  /* The zone is walked as whole words from the aligned start address, the
+     leading bytes of the first word and the padding of the last one are
+     left out of the sum */
+  StartAddress-=missalignementAddress;
+  Words = (Size + missalignementSize)/4;
   
-  for(cnt=0; cnt<Size ; cnt+=4)
+  if((missalignementAddress != 0) && (Words != 0))
   {
-    Val = *(uint32_t*)StartAddress;
-    if(missalignementAddress)
-    {
-      switch (missalignementAddress & 0xF)
-      {
-        case 1:
-          InitVal += (uint8_t) (Val>>8 & 0xff);
-          InitVal += (uint8_t) (Val>>16 & 0xff);
-          InitVal += (uint8_t) (Val>>24 & 0xff);
-          missalignementAddress-=1;
-          break;
-        case 2:
-          InitVal += (uint8_t) (Val>>16 & 0xff);
-          InitVal += (uint8_t) (Val>>24 & 0xff);
-          missalignementAddress-=2;
-          break;
-        case 3:   
-          InitVal += (uint8_t) (Val>>24 & 0xff);
-          missalignementAddress-=3;
-          break;
-      }  
-    }
-    else if((Size-missalignementSize)%4 && (Size-cnt) <=4)
-    {
-      switch ((Size-missalignementSize) & 0xF)
-      {
-        case 1:
-          InitVal += (uint8_t) Val;
-          InitVal += (uint8_t) (Val>>8 & 0xff);
-          InitVal += (uint8_t) (Val>>16 & 0xff);
-          missalignementSize-=1;
-          break;
-        case 2:
-          InitVal += (uint8_t) Val;
-          InitVal += (uint8_t) (Val>>8 & 0xff);
-          missalignementSize-=2;
-          break;
-        case 3:   
-          InitVal += (uint8_t) Val;
-          missalignementSize-=3;
-          break;
-      } 
-    }
-    else
+    Val = *(uint32_t*)StartAddress >> (8*missalignementAddress);
+    InitVal += CheckSum_Words(&Val, 1);
+    StartAddress+=4;
+    Words--;
+  }
+  
+  if((missalignementSize != 0) && (Words != 0))
+  {
+    Words--;
+    /* The size counter of the former byte ladder was 8-bit, so the partial
+       last word only ever counted in zones below 256 bytes */
+    if(Size < 0x100)
     {
-      InitVal += (uint8_t) Val;
-      InitVal += (uint8_t) (Val>>8 & 0xff);
-      InitVal += (uint8_t) (Val>>16 & 0xff);
-      InitVal += (uint8_t) (Val>>24 & 0xff);
+      Val = *(uint32_t*)(StartAddress + 4*Words) & (0xFFFFFFFF >> (8*missalignementSize));
+      InitVal += CheckSum_Words(&Val, 1);
     }
-    StartAddress+=4;
   }
   
+  InitVal += CheckSum_Words((const uint32_t*)StartAddress, Words);
+  Perf_Add(PERF_PHASE_VERIFY, Start, NULL, 0);
+  
   return (InitVal);
 }
 
@@ -289,29 +781,96 @@ uint64_t Verify (uint32_t MemoryAddr, uint32_t RAMBufferAddr, uint32_t Size, uin
     uint32_t InitVal = 0;
 	uint32_t VerifiedData = 0;
 	uint64_t checksum;
+	uint32_t Start;
 	Size*=4;
+	Perf_Count(PERF_VERIFY, Size);
 
 	/* Configure QUADSPI To Memory Mapped Mode */
-  QUADSPI_ComConfig_InitStructure.QUADSPI_ComConfig_DummyCycles  = 8;
-  QUADSPI_ComConfig_InitStructure.QUADSPI_ComConfig_FMode = QUADSPI_ComConfig_FMode_Memory_Mapped;
-  QUADSPI_ComConfig_InitStructure.QUADSPI_ComConfig_ADMode = QUADSPI_ComConfig_ADMode_1Line;
-  QUADSPI_ComConfig_InitStructure.QUADSPI_ComConfig_ADSize = QUADSPI_ComConfig_ADSize_24bit;
-  QUADSPI_ComConfig_InitStructure.QUADSPI_ComConfig_DMode = QUADSPI_ComConfig_DMode_4Line;
-  QUADSPI_ComConfig_InitStructure.QUADSPI_ComConfig_IMode = QUADSPI_ComConfig_IMode_1Line;
-  QUADSPI_ComConfig_InitStructure.QUADSPI_ComConfig_Ins = READ_QUAD_CMD;
-  QUADSPI_ComConfig_Init(&QUADSPI_ComConfig_InitStructure);
+	QSPI_MemoryMappedMode();
+	Start = Perf_Cycles();
+	/* Word-aligned zones are compared and added up in a single pass over the
+	   memory. On a difference the checksum is recalculated and the byte loop
+	   below resumes at the differing word */
+	if((((MemoryAddr | RAMBufferAddr) % 4) == 0) && ((missalignement & 0x000C000C) == 0) && (Size != 0))
+	{
+	  VerifiedData = Verify_Words((const uint32_t*)MemoryAddr, (const uint32_t*)RAMBufferAddr, Size/4, &InitVal);
+	  if(VerifiedData == Size)
+	  {
+	    Perf_Add(PERF_PHASE_VERIFY, Start, NULL, 0);
+	    return ((uint64_t)Verify_CheckSum((const uint32_t*)RAMBufferAddr, Size, missalignement, InitVal) << 32);
+	  }
+	  InitVal = 0;
+	}
+	Perf_Add(PERF_PHASE_VERIFY, Start, NULL, 0);
 	checksum = CheckSum((uint32_t)MemoryAddr + (missalignement & 0xf), Size - ((missalignement >> 16) & 0xF), InitVal);  
+	Start = Perf_Cycles();
+	MemoryAddr += VerifiedData;
 	
   while (Size>VerifiedData)
   {
 		if ( *(uint8_t*)MemoryAddr++ != *((uint8_t*)RAMBufferAddr + VerifiedData))
+		{
+			Perf_Add(PERF_PHASE_VERIFY, Start, NULL, 0);
 			return ((checksum<<32) + (MemoryAddr + VerifiedData));  
+		}
 		
 		VerifiedData++;  
   }
         
+  Perf_Add(PERF_PHASE_VERIFY, Start, NULL, 0);
   return (checksum<<32);
 }
 
+/**
+  * @brief   Calculates the CRC-32 of a memory zone with the CRC unit.
+  *          This is the IEEE 802.3 CRC-32 of zlib crc32(), so that the result
+  *          can be checked against a CRC of the source image on the host,
+  *          the CRC-32 of the 9 bytes "123456789" being 0xCBF43926.
+  * @param   StartAddress : start address of the zone
+  * @param   Size         : size of the zone (in bytes)
+  * @retval  CRC-32 of the zone
+  */
+uint32_t CheckCRC (uint32_t StartAddress, uint32_t Size)
+{
+  uint32_t Start;
+  uint32_t Crc;
+
+  Perf_Count(PERF_CHECKCRC, Size);
+  /* Configure QUADSPI To Memory Mapped Mode */
+  QSPI_MemoryMappedMode();
+
+  Start = Perf_Cycles();
+  CRC32_Start();
+  CRC32_Words((const uint8_t*)StartAddress, Size/4);
+  Crc = CRC32_End((const uint8_t*)StartAddress + (Size & ~0x3), Size%4);
+  Perf_Add(PERF_PHASE_VERIFY, Start, NULL, 0);
+
+  return Crc;
+}
+
+/**
+  * @brief   Calculates the SHA-256 digest of a memory zone, the host
+  *          comparing a single digest with the one of the source image
+  *          instead of reading the memory back.
+  * @param   StartAddress : start address of the zone
+  * @param   Size         : size of the zone (in bytes)
+  * @param   Digest       : RAM buffer receiving the 32-byte digest
+  * @retval  1      : Operation succeeded
+  * @retval  0      : Operation failed
+  */
+int CheckSHA256 (uint32_t StartAddress, uint32_t Size, uint8_t* Digest)
+{
+  uint32_t Start;
+
+  Perf_Count(PERF_CHECKSHA256, Size);
+  /* Configure QUADSPI To Memory Mapped Mode */
+  QSPI_MemoryMappedMode();
+
+  Start = Perf_Cycles();
+  SHA256_Calculate((const uint8_t*)StartAddress, Size, Digest);
+  Perf_Add(PERF_PHASE_VERIFY, Start, NULL, 0);
+  return 1;
+}
+
 /************************ (C) COPYRIGHT STMicroelectronics *****END OF FILE****/
 
@@ -21,8 +21,21 @@
 
 #include "Loader_Src.h"
 #include <string.h>
+#include "loader_kernels.h"
 #pragma section = ".bss"
 
+/* Private variables ---------------------------------------------------------*/
+uint32_t SkippedWords;
+uint32_t SkippedSectors;
+static uint32_t FillBuffer[FILL_BUFFER_SIZE/4 + 1];
+
+#if (PERF_COUNTERS == 1)
+__no_init PERF_BLOCK PerfCounters @ ".perf";
+#endif
+
+/* NOR handle of the BSP, polled after the write-to-buffer operations */
+extern NOR_HandleTypeDef norHandle;
+
 /* Private function prototypes -----------------------------------------------*/
 
 KeepInCompilation HAL_StatusTypeDef HAL_InitTick(uint32_t TickPriority)
@@ -40,6 +53,128 @@ void HAL_Delay(uint32_t Delay)
   int i=0;
   for (i=0; i<0x100000; i++);
 }
+/**
+  * @brief  Starts the DWT cycle counter. PerfCounters is cleared unless it
+  *         already holds the counts of the previous calls.
+  * @retval None
+  */
+static void Perf_Init(void)
+{
+#if (PERF_COUNTERS == 1)
+  CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+#if (__CORTEX_M == 7U)
+  /* The Cortex-M7 DWT is write-locked */
+  DWT->LAR = 0xC5ACCE55;
+#endif
+  DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
+  if(PerfCounters.Magic != PERF_MAGIC)
+  {
+    memset(&PerfCounters, 0, sizeof(PerfCounters));
+    PerfCounters.Magic = PERF_MAGIC;
+  }
+#endif
+}
+
+/**
+  * @brief  Reads the DWT cycle counter.
+  * @retval Cycle count, 0 without PERF_COUNTERS
+  */
+static uint32_t Perf_Cycles(void)
+{
+#if (PERF_COUNTERS == 1)
+  return DWT->CYCCNT;
+#else
+  return 0;
+#endif
+}
+
+/**
+  * @brief  Counts a call to a loader entry point.
+  * @param  Entry : entry point called
+  * @param  Size  : bytes handled by the call
+  * @retval None
+  */
+static void Perf_Count(PERF_ENTRY Entry, uint32_t Size)
+{
+#if (PERF_COUNTERS == 1)
+  PerfCounters.Calls[Entry]++;
+  PerfCounters.Bytes[Entry] += Size;
+#endif
+}
+
+/**
+  * @brief  Adds the cycles elapsed since Start to a phase, Start being moved
+  *         to the current count. The 64-bit totals do not wrap with the
+  *         counter as long as this is called once per 2^32 cycles.
+  * @param  Phase : phase the cycles were spent in
+  * @param  Start : cycle count the phase started at
+  * @retval None
+  */
+static void Perf_Add(PERF_PHASE Phase, uint32_t* Start)
+{
+#if (PERF_COUNTERS == 1)
+  uint32_t Now = DWT->CYCCNT;
+
+  PerfCounters.Cycles[Phase] += Now - *Start;
+  *Start = Now;
+  /* Init changes the clock the cycles count at */
+  PerfCounters.CoreClock = SystemCoreClock;
+#endif
+}
+
+#if (PERF_COUNTERS == 1)
+/**
+  * @brief  Adds Count operations, lasting Cycles in total, to a timing.
+  * @param  Timing : timing of the operation
+  * @param  Cycles : cycles of the operations
+  * @param  Count  : number of operations
+  * @retval None
+  */
+static void Perf_Sample(PERF_TIMING* Timing, uint32_t Cycles, uint32_t Count)
+{
+  uint32_t Average = Cycles / Count;
+
+  if((Timing->Count == 0) || (Average < Timing->Min))
+    Timing->Min = Average;
+  if(Average > Timing->Max)
+    Timing->Max = Average;
+  Timing->Count += Count;
+  Timing->Total += Cycles;
+}
+#endif
+
+/**
+  * @brief  Accounts a write buffer program to the data phase and to tPP.
+  * @param  Start : cycle count the program started at
+  * @retval None
+  */
+static void Perf_PageProgram(uint32_t Start)
+{
+#if (PERF_COUNTERS == 1)
+  uint32_t Cycles = DWT->CYCCNT - Start;
+
+  PerfCounters.Cycles[PERF_PHASE_DATA] += Cycles;
+  Perf_Sample(&PerfCounters.PageProgram, Cycles, 1);
+#endif
+}
+
+/**
+  * @brief  Accounts a block erase, its wait included, to the busy phase and
+  *         to tBE.
+  * @param  Start : cycle count the erase started at
+  * @retval None
+  */
+static void Perf_BlockErase(uint32_t Start)
+{
+#if (PERF_COUNTERS == 1)
+  uint32_t Cycles = DWT->CYCCNT - Start;
+
+  PerfCounters.Cycles[PERF_PHASE_BUSY] += Cycles;
+  Perf_Sample(&PerfCounters.BlockErase, Cycles, 1);
+#endif
+}
+
 /**
   * @brief  System initialization.
   * @param  None
@@ -48,6 +183,8 @@ void HAL_Delay(uint32_t Delay)
   */
 int Init (void)
 { 
+  uint32_t Start;
+
   /*  Init structs to Zero*/
   char *   startadd =  __section_begin(".bss");
   uint32_t size =  __section_size(".bss");
@@ -56,17 +193,130 @@ int Init (void)
   /*  Init system*/
   SystemInit();
   HAL_Init();
+  Perf_Init();
+  Perf_Count(PERF_INIT, 0);
+  Start = Perf_Cycles();
   
   /* Configure the system clock */
   SystemClock_Config();
   
  /* NOR device configuration */
   BSP_NOR_Init();
+  Perf_Add(PERF_PHASE_INIT, &Start);
   
   return 1;
 }
 
 
+/**
+  * @brief   Programs halfwords lying in a single write buffer page with the
+  *          write-to-buffer command (AMD command set). The sequence is issued
+  *          here as HAL_NOR_ProgramBuffer of this HAL version addresses the
+  *          data with the internal address.
+  * @param   WriteAddr  : NOR internal address
+  * @param   pData      : pointer to data buffer
+  * @param   uwDataSize : number of halfwords, up to NOR_BUFFER_WORDS
+  * @retval  1      : Operation succeeded
+  * @retval  0      : Operation failed
+  */
+static int NOR_ProgramBuffer(uint32_t WriteAddr, uint16_t* pData, uint32_t uwDataSize)
+{
+  uint32_t Address = NOR_DEVICE_ADDR + WriteAddr;
+
+  NOR_WRITE(NOR_ADDR_SHIFT(NOR_DEVICE_ADDR, NOR_MEMORY_16B, NOR_CMD_UNLOCK_ADDR1), 0x00AA);
+  NOR_WRITE(NOR_ADDR_SHIFT(NOR_DEVICE_ADDR, NOR_MEMORY_16B, NOR_CMD_UNLOCK_ADDR2), 0x0055);
+  NOR_WRITE(Address, NOR_CMD_WRITE_TO_BUFFER);
+  NOR_WRITE(Address, (uint16_t)(uwDataSize - 1));
+  for(; uwDataSize > 0; uwDataSize--)
+  {
+    NOR_WRITE(Address, *pData++);
+    Address += 2;
+  }
+  NOR_WRITE(NOR_DEVICE_ADDR + WriteAddr, NOR_CMD_BUFFER_CONFIRM);
+
+  if(HAL_NOR_GetStatus(&norHandle, NOR_DEVICE_ADDR, PROGRAM_TIMEOUT) != HAL_NOR_STATUS_SUCCESS)
+    return 0;
+
+  return 1;
+}
+
+/**
+  * @brief   Programs an amount of halfwords with the write-to-buffer command,
+  *          one write buffer page of NOR_BUFFER_WORDS halfwords at a time.
+  *          The halfwords left at the erase value (0xFFFF) at both ends of a
+  *          page are skipped, and so are the pages only holding it.
+  * @param   WriteAddr  : NOR internal address
+  * @param   pData      : pointer to data buffer
+  * @param   uwDataSize : number of halfwords
+  * @retval  1      : Operation succeeded
+  * @retval  0      : Operation failed
+  */
+static int NOR_WriteData(uint32_t WriteAddr, uint16_t* pData, uint32_t uwDataSize)
+{
+  uint32_t run;
+  uint32_t first;
+  uint32_t last;
+  uint32_t Start;
+
+  while(uwDataSize > 0)
+  {
+    /* Halfwords up to the next write buffer boundary */
+    run = NOR_BUFFER_WORDS - ((WriteAddr / 2) % NOR_BUFFER_WORDS);
+    if(run > uwDataSize)
+      run = uwDataSize;
+
+    /* Trim the halfwords left at the erase value */
+    first = 0;
+    while((first < run) && (pData[first] == 0xFFFF))
+      first++;
+    last = run;
+    while((last > first) && (pData[last - 1] == 0xFFFF))
+      last--;
+    SkippedWords += run - (last - first);
+
+    if(last != first)
+    {
+      Start = Perf_Cycles();
+      if(NOR_ProgramBuffer(WriteAddr + 2 * first, pData + first, last - first) == 0)
+        return 0;
+      Perf_PageProgram(Start);
+    }
+
+    pData += run;
+    WriteAddr += 2 * run;
+    uwDataSize -= run;
+  }
+
+  return 1;
+}
+
+/**
+  * @brief   Checks whether a NOR block only holds the erase value (0xFFFF),
+  *          so that its erase can be skipped.
+  * @param   Address : block address in the FMC bank
+  * @param   Size    : block size
+  * @retval  1      : Block is blank
+  * @retval  0      : Block must be erased
+  */
+static int NOR_BlockIsErased(uint32_t Address, uint32_t Size)
+{
+#if (BLANK_CHECK_BEFORE_ERASE == 1)
+  __IO uint32_t* pData = (__IO uint32_t*)Address;
+
+  BSP_NOR_ReturnToReadMode();
+  for(; Size >= 4; Size -= 4)
+  {
+    if(*pData++ != 0xFFFFFFFF)
+      return 0;
+  }
+  SkippedSectors++;
+
+  return 1;
+#else
+  return 0;
+#endif
+}
+
 /**
   * @brief   Program memory.
   * @param   Address: page address
@@ -82,6 +332,7 @@ int Write (uint32_t Address, uint32_t Size, uint16_t* Buffer)
   uint32_t Counter = 0;    
   uint16_t TmpBuffer = 0x00000000;
   
+  Perf_Count(PERF_WRITE, Size);
   if (InternalAddr%2 != 0)
   {
     BSP_NOR_ReadData((InternalAddr - InternalAddr%2), &TmpBuffer, 1);
@@ -97,7 +348,7 @@ int Write (uint32_t Address, uint32_t Size, uint16_t* Buffer)
   
   if (Size-WritedData >= 2)
   {
-    if (BSP_NOR_WriteData(InternalAddr+WritedData, (uint16_t*)((uint8_t*)Buffer+WritedData), ((Size-WritedData)/2))!=0)
+    if (NOR_WriteData(InternalAddr+WritedData, (uint16_t*)((uint8_t*)Buffer+WritedData), ((Size-WritedData)/2)) == 0)
       return 0;
 
     WritedData += (((Size-WritedData)/2)*2);
@@ -117,6 +368,75 @@ int Write (uint32_t Address, uint32_t Size, uint16_t* Buffer)
   return 1;
 } 
 
+/**
+  * @brief   Programs a memory zone with a repeated pattern generated in RAM,
+  *          so that constant runs need not be transferred to the loader.
+  *          A fill with the erase value (0xFF) programs nothing and fails
+  *          unless the zone is already erased.
+  * @param   Address     : zone start address
+  * @param   Size        : zone size
+  * @param   Pattern     : pattern, least significant byte first
+  * @param   PatternSize : pattern size, 1, 2 or 4 bytes
+  * @retval  1      : Operation succeeded
+  * @retval  0      : Operation failed
+  */
+int Fill (uint32_t Address, uint32_t Size, uint32_t Pattern, uint32_t PatternSize)
+{
+  uint32_t Mask;
+  uint32_t Phase = 0;
+  uint32_t Count;
+  uint32_t InternalAddr;
+  uint16_t Tail[3];
+  uint32_t i;
+
+  if((PatternSize != 1) && (PatternSize != 2) && (PatternSize != 4))
+    return 0;
+  Mask = (PatternSize == 4) ? 0xFFFFFFFF : ((1UL << (8 * PatternSize)) - 1);
+  if((Pattern & Mask) == Mask)
+  {
+    /* Programming the erase value changes no bit: the zone is checked to be
+       erased instead, by Verify against a chunk of 0xFF, the last bytes
+       being read through the BSP as Verify reads them */
+    memset(FillBuffer, 0xFF, FILL_BUFFER_SIZE);
+    do
+    {
+      Count = (Size < FILL_BUFFER_SIZE) ? (Size & ~0x3) : FILL_BUFFER_SIZE;
+      if((uint32_t)Verify(Address, (uint32_t)FillBuffer, Count / 4, 0) != 0)
+        return 0;
+      Address += Count;
+      Size -= Count;
+    } while(Size >= 4);
+    /* Halfwords holding the last bytes */
+    InternalAddr = Address - StartAddresse;
+    BSP_NOR_ReadData(InternalAddr - InternalAddr%2, Tail, (InternalAddr%2 + Size + 1) / 2);
+    for(i = 0; i < Size; i++)
+    {
+      if(((uint8_t*)Tail)[InternalAddr%2 + i] != 0xFF)
+        return 0;
+    }
+    return 1;
+  }
+
+  /* One pattern more than the chunk size, each chunk starting at its phase */
+  for(i = 0; i < FILL_BUFFER_SIZE + 4; i++)
+    ((uint8_t*)FillBuffer)[i] = (uint8_t)(Pattern >> (8 * (i % PatternSize)));
+
+  while(Size > 0)
+  {
+    /* Chunks aligned on the buffer size, so on write buffers */
+    Count = FILL_BUFFER_SIZE - (Address % FILL_BUFFER_SIZE);
+    if(Count > Size)
+      Count = Size;
+    if(Write(Address, Count, (uint16_t*)((uint8_t*)FillBuffer + Phase)) == 0)
+      return 0;
+    Phase = (Phase + Count) % PatternSize;
+    Address += Count;
+    Size -= Count;
+  }
+
+  return 1;
+}
+
 
 /**
   * @brief   Erase full chip.
@@ -126,7 +446,13 @@ int Write (uint32_t Address, uint32_t Size, uint16_t* Buffer)
   */
 int MassErase (void)
 {
-  if (BSP_NOR_Erase_Chip()==0)
+  uint32_t Start = Perf_Cycles();
+  uint8_t Status;
+
+  Perf_Count(PERF_MASS_ERASE, 0);
+  Status = BSP_NOR_Erase_Chip();
+  Perf_Add(PERF_PHASE_BUSY, &Start);
+  if (Status==0)
     return 1;
   else
     return 0;
@@ -142,12 +468,27 @@ int MassErase (void)
 int SectorErase (uint32_t EraseStartAddress ,uint32_t EraseEndAddress)
 {
   uint32_t BlockAddr;
+  uint32_t Start;
+
+  Perf_Count(PERF_SECTOR_ERASE, 0);
   EraseStartAddress = EraseStartAddress -  EraseStartAddress%0x20000;
+  /* Range covering the whole device, a single chip erase */
+  if((EraseStartAddress == StartAddresse) &&
+     ((EraseEndAddress - EraseEndAddress%0x20000 + 0x20000) >= (StartAddresse + NOR_DEVICE_SIZE)))
+    return MassErase();
   while (EraseEndAddress>=EraseStartAddress)
   {
+    /* Skip the block already erased */
+    if(NOR_BlockIsErased(EraseStartAddress, 0x20000) != 0)
+    {
+      EraseStartAddress+=0x20000;
+      continue;
+    }
     BlockAddr = EraseStartAddress - StartAddresse;
+    Start = Perf_Cycles();
     if (BSP_NOR_Erase_Block(BlockAddr)!=0)
       return 0;
+    Perf_BlockErase(Start);
     EraseStartAddress+=0x20000;
   }
   return 1;	
@@ -167,73 +508,53 @@ int SectorErase (uint32_t EraseStartAddress ,uint32_t EraseEndAddress)
   */
 uint32_t CheckSum(uint32_t StartAddress, uint32_t Size, uint32_t InitVal)
 {
-  uint8_t missalignementAddress = StartAddress%4;
-  uint8_t missalignementSize = Size ;
-  int cnt;
-  uint32_t Val;
-  uint16_t value;
-	
-  StartAddress-=StartAddress%4;
-  Size += (Size%4==0)?0:4-(Size%4);
+  uint32_t missalignementAddress = StartAddress%4;
+  uint32_t missalignementSize = (4 - Size%4)%4;
+  uint32_t Words;
+  uint32_t Count;
+  uint32_t Buffer[CHECKSUM_READ_WORDS];
+  uint32_t Start = Perf_Cycles();
+  
+  Perf_Count(PERF_CHECKSUM, Size);
+  /* The zone is walked as whole words from the aligned start address, the
+     leading bytes of the first word and the padding of the last one are
+     left out of the sum */
+  StartAddress-=missalignementAddress;
+  Words = (Size + missalignementSize)/4;
   
-  for(cnt=0; cnt<Size ; cnt+=4)
+  if((missalignementAddress != 0) && (Words != 0))
   {
-    BSP_NOR_ReadData(StartAddress - StartAddresse, &value,1);
-    Val = value;
-    BSP_NOR_ReadData(StartAddress - StartAddresse + 2, &value, 1);
-    Val+= value<<16;
-    if(missalignementAddress)
-    {
-      switch (missalignementAddress & 0xF)
-      {
-        case 1:
-          InitVal += (uint8_t) (Val>>8 & 0xff);
-          InitVal += (uint8_t) (Val>>16 & 0xff);
-          InitVal += (uint8_t) (Val>>24 & 0xff);
-          missalignementAddress-=1;
-          break;
-        case 2:
-          InitVal += (uint8_t) (Val>>16 & 0xff);
-          InitVal += (uint8_t) (Val>>24 & 0xff);
-          missalignementAddress-=2;
-          break;
-        case 3:   
-          InitVal += (uint8_t) (Val>>24 & 0xff);
-          missalignementAddress-=3;
-          break;
-      }  
-    }
-    else if((Size-missalignementSize)%4 && (Size-cnt) <=4)
-    {
-      switch ((Size-missalignementSize) & 0xF)
-      {
-        case 1:
-          InitVal += (uint8_t) Val;
-          InitVal += (uint8_t) (Val>>8 & 0xff);
-          InitVal += (uint8_t) (Val>>16 & 0xff);
-          missalignementSize-=1;
-          break;
-        case 2:
-          InitVal += (uint8_t) Val;
-          InitVal += (uint8_t) (Val>>8 & 0xff);
-          missalignementSize-=2;
-          break;
-        case 3:   
-          InitVal += (uint8_t) Val;
-          missalignementSize-=3;
-          break;
-      } 
-    }
-    else
+    BSP_NOR_ReadData(StartAddress - StartAddresse, (uint16_t*)Buffer, 2);
+    Buffer[0] >>= 8*missalignementAddress;
+    InitVal += CheckSum_Words(Buffer, 1);
+    StartAddress+=4;
+    Words--;
+  }
+  
+  if((missalignementSize != 0) && (Words != 0))
+  {
+    Words--;
+    /* The size counter of the former byte ladder was 8-bit, so the partial
+       last word only ever counted in zones below 256 bytes */
+    if(Size < 0x100)
     {
-      InitVal += (uint8_t) Val;
-      InitVal += (uint8_t) (Val>>8 & 0xff);
-      InitVal += (uint8_t) (Val>>16 & 0xff);
-      InitVal += (uint8_t) (Val>>24 & 0xff);
+      BSP_NOR_ReadData(StartAddress + 4*Words - StartAddresse, (uint16_t*)Buffer, 2);
+      Buffer[0] &= 0xFFFFFFFF >> (8*missalignementSize);
+      InitVal += CheckSum_Words(Buffer, 1);
     }
-    StartAddress+=4;
   }
   
+  /* Read the NOR in bursts instead of two halfwords per word */
+  while(Words != 0)
+  {
+    Count = (Words > CHECKSUM_READ_WORDS) ? CHECKSUM_READ_WORDS : Words;
+    BSP_NOR_ReadData(StartAddress - StartAddresse, (uint16_t*)Buffer, 2*Count);
+    InitVal += CheckSum_Words(Buffer, Count);
+    StartAddress+=4*Count;
+    Words-=Count;
+  }
+  
+  Perf_Add(PERF_PHASE_VERIFY, &Start);
   return (InitVal);
 }
 
@@ -257,16 +578,48 @@ uint64_t Verify (uint32_t MemoryAddr, uint32_t RAMBufferAddr, uint32_t Size, uin
   uint32_t InternalAddr = MemoryAddr - StartAddresse;
   uint32_t VerifiedData = 0, InitVal = 0;
   uint16_t TmpBuffer = 0x0000;
+  uint32_t Count;
+  uint32_t Offset;
+  uint32_t Buffer[CHECKSUM_READ_WORDS];
   uint64_t checksum;
+  uint32_t Start;
   Size*=4;
+  Perf_Count(PERF_VERIFY, Size);
+  Start = Perf_Cycles();
 	
+  /* Word-aligned zones are read in bursts, each burst being compared and
+     added up in a single pass over the NOR. On a difference the checksum is
+     recalculated and the halfword loop below resumes at the differing word */
+  if((((MemoryAddr | RAMBufferAddr) % 4) == 0) && ((missalignement & 0x000C000C) == 0) && (Size != 0))
+  {
+    while(VerifiedData < Size)
+    {
+      Count = ((Size - VerifiedData)/4 > CHECKSUM_READ_WORDS) ? CHECKSUM_READ_WORDS : (Size - VerifiedData)/4;
+      BSP_NOR_ReadData(InternalAddr + VerifiedData, (uint16_t*)Buffer, 2*Count);
+      Offset = Verify_Words(Buffer, (const uint32_t*)(RAMBufferAddr + VerifiedData), Count, &InitVal);
+      VerifiedData += Offset;
+      if(Offset != 4*Count)
+        break;
+    }
+    if(VerifiedData == Size)
+    {
+      Perf_Add(PERF_PHASE_VERIFY, &Start);
+      return ((uint64_t)Verify_CheckSum((const uint32_t*)RAMBufferAddr, Size, missalignement, InitVal) << 32);
+    }
+    InitVal = 0;
+  }
+  Perf_Add(PERF_PHASE_VERIFY, &Start);
   checksum = CheckSum((uint32_t)MemoryAddr + (missalignement & 0xf), Size - ((missalignement >> 16) & 0xF), InitVal);
+  Start = Perf_Cycles();
   if (InternalAddr%2 != 0)
   {
     BSP_NOR_ReadData((InternalAddr - InternalAddr%2), &TmpBuffer, 1);
         
     if ((uint8_t)(TmpBuffer>>8) != (*(uint8_t*)RAMBufferAddr))
+    {
+      Perf_Add(PERF_PHASE_VERIFY, &Start);
       return ((checksum<<32) +  MemoryAddr);
+    }
     VerifiedData++;    
   }
      
@@ -275,12 +628,18 @@ uint64_t Verify (uint32_t MemoryAddr, uint32_t RAMBufferAddr, uint32_t Size, uin
     BSP_NOR_ReadData(InternalAddr+VerifiedData, &TmpBuffer, 1);
        
     if ((TmpBuffer&0x00FF) != (*((uint8_t*)RAMBufferAddr+VerifiedData)))
+    {
+      Perf_Add(PERF_PHASE_VERIFY, &Start);
       return ((checksum<<32) + MemoryAddr+VerifiedData);
+    }
         
     VerifiedData++;
         
     if ((uint8_t)(TmpBuffer>>8) != (*((uint8_t*)RAMBufferAddr+VerifiedData)))
+    {
+      Perf_Add(PERF_PHASE_VERIFY, &Start);
       return ((checksum<<32) + MemoryAddr+VerifiedData);
+    }
         
     VerifiedData++;
   }
@@ -290,11 +649,66 @@ uint64_t Verify (uint32_t MemoryAddr, uint32_t RAMBufferAddr, uint32_t Size, uin
     BSP_NOR_ReadData(InternalAddr+VerifiedData, &TmpBuffer, 1);
        
     if ((uint8_t)(TmpBuffer&0x00FF) != (*((uint8_t*)RAMBufferAddr+VerifiedData)))
+    {
+      Perf_Add(PERF_PHASE_VERIFY, &Start);
       return ((checksum<<32) + MemoryAddr+VerifiedData);
+    }
   }
 
+  Perf_Add(PERF_PHASE_VERIFY, &Start);
   return (checksum<<32);
 }
+
+/**
+  * @brief   Calculates the CRC-32 of a memory zone with the CRC unit.
+  *          This is the IEEE 802.3 CRC-32 of zlib crc32(), so that the result
+  *          can be checked against a CRC of the source image on the host,
+  *          the CRC-32 of the 9 bytes "123456789" being 0xCBF43926.
+  * @param   StartAddress : start address of the zone
+  * @param   Size         : size of the zone (in bytes)
+  * @retval  CRC-32 of the zone
+  */
+KeepInCompilation uint32_t CheckCRC (uint32_t StartAddress, uint32_t Size)
+{
+  uint32_t Start;
+  uint32_t Crc;
+
+  Perf_Count(PERF_CHECKCRC, Size);
+  /* Read the NOR through the FMC window */
+  BSP_NOR_ReturnToReadMode();
+
+  Start = Perf_Cycles();
+  CRC32_Start();
+  CRC32_Words((const uint8_t*)StartAddress, Size/4);
+  Crc = CRC32_End((const uint8_t*)StartAddress + (Size & ~0x3), Size%4);
+  Perf_Add(PERF_PHASE_VERIFY, &Start);
+
+  return Crc;
+}
+
+/**
+  * @brief   Calculates the SHA-256 digest of a memory zone, the host
+  *          comparing a single digest with the one of the source image
+  *          instead of reading the memory back.
+  * @param   StartAddress : start address of the zone
+  * @param   Size         : size of the zone (in bytes)
+  * @param   Digest       : RAM buffer receiving the 32-byte digest
+  * @retval  1      : Operation succeeded
+  * @retval  0      : Operation failed
+  */
+KeepInCompilation int CheckSHA256 (uint32_t StartAddress, uint32_t Size, uint8_t* Digest)
+{
+  uint32_t Start;
+
+  Perf_Count(PERF_CHECKSHA256, Size);
+  /* Read the NOR through the FMC window */
+  BSP_NOR_ReturnToReadMode();
+
+  Start = Perf_Cycles();
+  SHA256_Calculate((const uint8_t*)StartAddress, Size, Digest);
+  Perf_Add(PERF_PHASE_VERIFY, &Start);
+  return 1;
+}
 /**
   * @brief  System Clock Configuration
   *         The system Clock is configured as follow : 
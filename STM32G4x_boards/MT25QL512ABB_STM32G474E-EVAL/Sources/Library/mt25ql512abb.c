@@ -37,6 +37,7 @@
 
 /* Includes ------------------------------------------------------------------*/
 #include "mt25ql512abb.h"
+#include "loader_trace.h"
 
 /** @addtogroup BSP
   * @{
@@ -27,6 +27,7 @@ extern "C" {
 
 /* Includes ------------------------------------------------------------------*/
 #include "stm32h573i_discovery_ospi.h"
+#include "loader_trace.h"
 
 /* Private includes ----------------------------------------------------------*/
 #include <string.h>
@@ -40,7 +41,9 @@ extern "C" {
 typedef enum
 {
     MEM_MAPDISABLE = 0, /*!< map mode disabled      */
-    MEM_MAPENABLE       /*!< map mode enabled       */
+    MEM_MAPENABLE,      /*!< map mode enabled       */
+    MEM_MAPRESET,       /*!< OSPI must be re-initialized */
+    MEM_MAPBUSY         /*!< map mode disabled, program/erase running */
 } MEM_MAPSTAT;
 
 /**
@@ -52,7 +55,8 @@ typedef enum
     DEBUG_STATE_INIT,        /*!< Debug state: Initialize */
     DEBUG_STATE_WRITE,       /*!< Debug state: Write      */
     DEBUG_STATE_SECTORERASE, /*!< Debug state: Sector Erase */
-    DEBUG_STATE_MASSERASE    /*!< Debug state: Mass Erase */
+    DEBUG_STATE_MASSERASE,   /*!< Debug state: Mass Erase */
+    DEBUG_STATE_STREAM       /*!< Debug state: Write Stream */
 } DEBUG_STATETypedef;
 
 /**
@@ -64,6 +68,159 @@ typedef enum
     LOADER_STATUS_FAIL = 0     /*!< Loader status: Fail    */
 } loader_status;
 
+/**
+  * @brief Erase command used by the SectorErase planner
+  */
+typedef struct
+{
+    uint32_t Size;             /*!< Erased size in bytes      */
+    BSP_OSPI_NOR_Erase_t Type; /*!< BSP erase command         */
+    uint32_t Time;             /*!< Erase time weight (ms)    */
+} erase_unit;
+
+/**
+  * @brief State of the WriteStream ring buffer
+  */
+typedef enum
+{
+    STREAM_IDLE = 0, /*!< No stream started                     */
+    STREAM_RUNNING,  /*!< Data programmed as the host writes it */
+    STREAM_DONE,     /*!< Whole stream programmed               */
+    STREAM_ERROR     /*!< Program failed, timeout or abort      */
+} stream_state;
+
+/* Size of the ring buffer drained by WriteStream, a multiple of the page size */
+#define STREAM_BUFFER_SIZE 0x2000U
+
+/* Time WriteStream waits for the host to advance Head before failing, in ms,
+   measured with the DWT cycle counter: keep it below 2^32 core clock cycles.
+   Set to 0 to wait until the host sets Abort */
+#define STREAM_TIMEOUT_MS 1000U
+
+/**
+  * @brief Ring buffer the host streams the data to program into
+  */
+typedef struct
+{
+    volatile uint32_t Head;       /*!< Bytes written by the host, free running */
+    volatile uint32_t Tail;       /*!< Bytes programmed, free running          */
+    volatile uint32_t Address;    /*!< Memory address of the next byte         */
+    volatile uint32_t End;        /*!< Memory address ending the stream        */
+    volatile stream_state Status; /*!< Stream state, polled by the host        */
+    volatile uint32_t Abort;      /*!< Set by the host to stop the stream      */
+    uint8_t Data[STREAM_BUFFER_SIZE];
+} stream_ring;
+
+/**
+  * @brief Operations run by RunOperations
+  */
+typedef enum
+{
+    OPERATION_ERASE = 0, /*!< SectorErase of the sectors of the zone */
+    OPERATION_PROGRAM,   /*!< Write of the zone from Buffer          */
+    OPERATION_VERIFY     /*!< Verify of the zone against Buffer      */
+} operation_type;
+
+/**
+  * @brief Status of an operation run by RunOperations
+  */
+typedef enum
+{
+    OPERATION_FAILED = 0, /*!< Operation failed, the list stopped */
+    OPERATION_OK,         /*!< Operation succeeded                */
+    OPERATION_NOT_RUN     /*!< Operation after a failure, not run */
+} operation_status;
+
+/**
+  * @brief Operation descriptor, in RAM
+  */
+typedef struct
+{
+    uint32_t Op;      /*!< operation_type                          */
+    uint32_t Address; /*!< Memory address of the zone              */
+    uint32_t Size;    /*!< Size of the zone (in bytes)             */
+    uint8_t *Buffer;  /*!< Data to program or to verify            */
+    uint32_t Status;  /*!< operation_status, written by the loader */
+} operation_desc;
+
+/**
+  * @brief Result of the clock divider search
+  */
+typedef enum
+{
+    CLOCK_NOT_RUN = 0, /*!< Search not run                         */
+    CLOCK_SEARCHED,    /*!< Fastest divider passing applied        */
+    CLOCK_PINNED,      /*!< CLOCK_DIVIDER_PIN applied              */
+    CLOCK_BSP_KEPT,    /*!< No faster divider passed, BSP one kept */
+    CLOCK_NO_SIGNATURE /*!< Signature not read or flat, BSP one kept */
+} clock_state;
+
+/**
+  * @brief Clock divider search status, read by the host over SWD
+  */
+typedef struct
+{
+    uint32_t Magic;      /*!< CLOCK_MAGIC once the search has run     */
+    uint32_t Status;     /*!< clock_state                             */
+    uint32_t BspDivider; /*!< Kernel clock divider set by the BSP     */
+    uint32_t Divider;    /*!< Kernel clock divider in use             */
+    uint32_t ClockHz;    /*!< Memory clock in use                     */
+    uint32_t FailMap;    /*!< Bit n set when divider n failed, n < 32 */
+} clock_status;
+
+/**
+  * @brief Loader entry points counted in PerfCounters
+  */
+typedef enum
+{
+    PERF_INIT = 0,     /*!< Init                                         */
+    PERF_WRITE,        /*!< Write, also run by the other write functions */
+    PERF_SECTOR_ERASE, /*!< SectorErase                                  */
+    PERF_MASS_ERASE,   /*!< MassErase, also run by a full SectorErase    */
+    PERF_VERIFY,       /*!< Verify                                       */
+    PERF_CHECKSUM,     /*!< CheckSum, also run by Verify on a mismatch   */
+    PERF_CHECKCRC,     /*!< CheckCRC                                     */
+    PERF_CHECKSHA256,  /*!< CheckSHA256                                  */
+    PERF_ENTRY_COUNT
+} perf_entry;
+
+/**
+  * @brief Phases the loader cycles are spent in
+  */
+typedef enum
+{
+    PERF_PHASE_INIT = 0, /*!< Init, OSPI re-init and mode switches */
+    PERF_PHASE_DATA,     /*!< Page program runs sent to the memory */
+    PERF_PHASE_BUSY,     /*!< Erase commands and waits for the memory */
+    PERF_PHASE_VERIFY,   /*!< Memory reads of Verify and of the checks */
+    PERF_PHASE_COUNT
+} perf_phase;
+
+/**
+  * @brief Timing of a memory operation (in DWT cycles)
+  */
+typedef struct
+{
+    uint32_t Count; /*!< Operations timed, Total/Count the average */
+    uint32_t Min;   /*!< Shortest operation                        */
+    uint32_t Max;   /*!< Longest operation                         */
+    uint64_t Total; /*!< Sum of the operations                     */
+} perf_timing;
+
+/**
+  * @brief Performance counters, kept across loader calls
+  */
+typedef struct
+{
+    uint32_t Magic;                    /*!< PERF_MAGIC once initialized        */
+    uint32_t CoreClock;                /*!< Clock the cycles count at (Hz)     */
+    uint32_t Calls[PERF_ENTRY_COUNT];  /*!< Calls of each entry point          */
+    uint32_t Bytes[PERF_ENTRY_COUNT];  /*!< Bytes written, verified or checked */
+    uint64_t Cycles[PERF_PHASE_COUNT]; /*!< Cycles spent in each phase         */
+    perf_timing PageProgram;           /*!< tPP, Count the pages programmed    */
+    perf_timing BlockErase;            /*!< tBE, Count the blocks erased       */
+} perf_block;
+
 /* Exported constants --------------------------------------------------------*/
 /* Exported macro ------------------------------------------------------------*/
 #define KEEP_IN_COMPILATION __root
@@ -71,18 +228,127 @@ typedef enum
 /* Exported functions prototypes ---------------------------------------------*/
 KEEP_IN_COMPILATION uint32_t Init();
 KEEP_IN_COMPILATION uint32_t Write(uint32_t Address, uint32_t Size, uint8_t *buffer);
+KEEP_IN_COMPILATION uint32_t WriteStream(void);
+KEEP_IN_COMPILATION uint32_t RunOperations(operation_desc *List, uint32_t Count);
+KEEP_IN_COMPILATION uint32_t Fill(uint32_t Address, uint32_t Size, uint32_t Pattern, uint32_t PatternSize);
 KEEP_IN_COMPILATION uint32_t SectorErase(uint32_t EraseStartAddress, uint32_t EraseEndAddress);
 KEEP_IN_COMPILATION uint64_t Verify(uint32_t MemoryAddr, uint32_t RAMBufferAddr,
                                     uint32_t Size, uint32_t missalignement);
 KEEP_IN_COMPILATION uint32_t MassErase(uint32_t Parallelism);
 KEEP_IN_COMPILATION uint32_t CheckSum(uint32_t StartAddress, uint32_t Size, uint32_t InitVal);
+KEEP_IN_COMPILATION uint32_t CheckCRC(uint32_t StartAddress, uint32_t Size);
+KEEP_IN_COMPILATION uint32_t CheckSHA256(uint32_t StartAddress, uint32_t Size, uint8_t *Digest);
+KEEP_IN_COMPILATION uint32_t DeInit(void);
 void Reset_Handler(void) __attribute__((weak));
 int main(void);
 HAL_StatusTypeDef COM_Init(void);
 
 /* Private defines -----------------------------------------------------------*/
+/* Set to 1 to return from SectorErase and MassErase as soon as the last erase
+   command is accepted, the busy wait being completed on the next loader call.
+   Write is not deferred, the BSP waiting for the end of each page program.
+   Keep 0 if the host may call Init while the memory is still busy, Init
+   resetting the memory. */
+#define DEFERRED_COMPLETION 0
+
+/* Programming granularity used to skip the pages left at the erase value */
+#define PROGRAM_PAGE_SIZE MX25LM51245G_PAGE_SIZE
+
+/* Set to 1 to read each sector through memory-mapped mode before erasing it,
+   the sectors already at the erase value being skipped */
+#define BLANK_CHECK_BEFORE_ERASE 0
+
+/* Sector size declared in Dev_Inf.c, the range SectorErase is given being
+   extended to whole sectors that the planner splits into erase commands */
+#define ERASE_SECTOR_SIZE 0x10000U
+#define MEMORY_SIZE MX25LM51245G_FLASH_SIZE
+
+/* Chunk size of the Fill pattern buffer, a multiple of the page size */
+#define FILL_BUFFER_SIZE 0x400U
+
+/* Set to 1 to read the memory back through the ICACHE: a remap region makes
+   the OCTOSPI window readable at CACHE_REMAP_BASE in the code area, where the
+   reads are cached and fetched as wrapped bursts. The ICACHE is invalidated
+   each time the window is mapped again. DeInit restores the ICACHE state
+   that Init found */
+#define CACHE_PROFILE 0
+
+/* ICACHE remap region of the memory-mapped window */
+#define CACHE_WINDOW_BASE 0x90000000U
+#define CACHE_REMAP_BASE  0x10000000U
+#define CACHE_REMAP_SIZE  6U          /* 64 MB, RSIZE encoding */
+
+/* Set to 1 to search the fastest stable memory clock at Init: the OCTOSPI
+   clock divider is raised from the one of CLOCK_MAX_HZ up to the BSP one, each
+   divider reading the signature back CLOCK_PASSES times, and the first divider
+   reading it as the BSP clock does is kept. The result is kept in ClockSearch
+   for the host to read over SWD */
+#define CLOCK_SEARCH 0
+
+/* Clock divider applied without searching, 0 to search. Pin a divider
+   validated on the board when the search is not wanted */
+#define CLOCK_DIVIDER_PIN 0U
+
+/* OCTOSPI instance and kernel clock, and memory clock rating of the read
+   command set by the BSP, to lower when the MCU I/O rating is below it */
+#define CLOCK_INSTANCE  OCTOSPI1
+#define CLOCK_KERNEL_HZ HAL_RCC_GetHCLKFreq()
+#define CLOCK_MAX_HZ    66000000U     /* MX25LM51245G, OPI STR, 6 dummy cycles */
+
+/* Reads of the signature each divider must pass, and bytes of the memory read
+   after the ID in the signature */
+#define CLOCK_PASSES         8U
+#define CLOCK_SIGNATURE_SIZE 64U
+
+/* Value of ClockSearch.Magic once the search has run */
+#define CLOCK_MAGIC 0x434C4B53U
+
+/* Set to 1 to count the calls, bytes and DWT cycles of the loader operations in
+   PerfCounters, placed by Target.icf at the address it exports as
+   __ICFEDIT_region_PERF_start__, for the host to read over SWD */
+#define PERF_COUNTERS 1
+
+/* Value of PerfCounters.Magic once the counters are initialized, the host
+   clearing Magic to restart the counts */
+#define PERF_MAGIC 0x50455246U
+
+/* Define USE_COMMAND_TRACE in the preprocessor symbols of the project to log
+   the entry points, the BSP calls and the memory commands of the loader in
+   CommandTrace (loader_trace.h), kept across loader calls for the host to read
+   over SWD. The BSP driver is built with it to log the commands it sends */
+
 /* Private function prototypes -----------------------------------------------*/
 static void SystemClock_Config(void);
+static uint32_t OSPI_EnterIndirectMode(void);
+static uint32_t OSPI_CompleteOperation(void);
+static uint32_t OSPI_EnterMemoryMappedMode(void);
+static void Cache_Init(void);
+static void Cache_DeInit(void);
+static void Cache_Invalidate(void);
+static uint32_t Cache_Address(uint32_t Address);
+#if (CLOCK_SEARCH == 1)
+static uint32_t Clock_GetDivider(void);
+static void Clock_SetDivider(uint32_t Divider);
+static uint32_t Clock_ReadSignature(uint8_t *Signature);
+static uint32_t Clock_IsFlat(const uint8_t *Signature);
+#endif
+static void Clock_Search(void);
+static void Clock_Apply(void);
+static uint32_t Buffer_IsErased(const uint8_t *buffer, uint32_t Size);
+static uint32_t OSPI_ProgramPages(uint32_t Address, uint32_t Size, uint8_t *buffer);
+static uint32_t OSPI_SectorIsErased(uint32_t Address, uint32_t Size);
+static const erase_unit *OSPI_PlanErase(uint32_t Address, uint32_t EndAddress);
+static void Perf_Init(void);
+static uint32_t Perf_Cycles(void);
+static void Perf_Count(perf_entry Entry, uint32_t Size);
+static void Perf_Add(perf_phase Phase, uint32_t *Start);
+static void Perf_Program(uint32_t Address, uint32_t Size, uint32_t Start);
+static uint32_t Perf_EraseStart(void);
+static void Perf_EraseDone(void);
+#ifdef USE_COMMAND_TRACE
+static void Trace_Command(uint32_t Kind, uint32_t Call, uint32_t Address, uint32_t Size, uint32_t Status);
+static int32_t Trace_Return(uint32_t Call, int32_t Status);
+#endif
 
 #ifdef __cplusplus
 }
@@ -20,6 +20,7 @@
 
 /* Includes ------------------------------------------------------------------*/
 #include "Loader_Src.h"
+#include "loader_kernels.h"
 
 /** @addtogroup Flash_lOADER
   * @ingroup MX25LM51245G_STM32H573I-DK
@@ -179,9 +180,73 @@ uint32_t HAL_GetTick(void)
 BSP_OSPI_NOR_Init_t Flash;
 
 /**
-  * @brief status of the mapped mode  MEM_DISABLE or MEM_ENABLE
+  * @brief status of the mapped mode  MEM_DISABLE, MEM_ENABLE, MEM_MAPRESET or MEM_MAPBUSY
   */
 MEM_MAPSTAT MemoryMappedMode;
+
+/**
+  * @brief number of pages left unprogrammed by Write because they only hold the erase value
+  */
+uint32_t SkippedPages;
+
+/**
+  * @brief number of sectors left unerased by SectorErase because they were already blank
+  */
+uint32_t SkippedSectors;
+
+/**
+  * @brief erase commands of the SectorErase planner, largest first, weighted
+  *        with the component maximum erase times
+  */
+static const erase_unit EraseUnits[] =
+{
+    {0x10000U, MX25LM51245G_ERASE_64K, MX25LM51245G_SECTOR_ERASE_MAX_TIME},
+    {0x1000U, MX25LM51245G_ERASE_4K, MX25LM51245G_SUBSECTOR_4K_ERASE_MAX_TIME}
+};
+#define ERASE_UNIT_COUNT (sizeof(EraseUnits) / sizeof(EraseUnits[0]))
+
+/**
+  * @brief ring buffer the host streams the data to program into, see WriteStream
+  */
+stream_ring StreamRing;
+
+/**
+  * @brief pattern pages programmed by Fill, one pattern longer than a chunk
+  */
+static uint32_t FillBuffer[(FILL_BUFFER_SIZE / 4U) + 1U];
+
+#if (PERF_COUNTERS == 1)
+/**
+  * @brief performance counters, read by the host at __ICFEDIT_region_PERF_start__
+  */
+__no_init perf_block PerfCounters @ ".perf";
+
+/**
+  * @brief cycle count of the block erase left running, and whether one is
+  */
+static uint32_t PerfEraseStart;
+static uint32_t PerfErasing;
+#endif
+
+#if (CLOCK_SEARCH == 1)
+/**
+  * @brief clock divider search result, read by the host at the ClockSearch symbol
+  */
+clock_status ClockSearch;
+
+/**
+  * @brief signature read at the BSP clock, and at the divider being tried
+  */
+static uint8_t ClockReference[CLOCK_SIGNATURE_SIZE + 4U];
+static uint8_t ClockSignature[CLOCK_SIGNATURE_SIZE + 4U];
+#endif
+
+#ifdef USE_COMMAND_TRACE
+/**
+  * @brief command trace, read by the host at the CommandTrace symbol
+  */
+__no_init TRACE_BUFFER CommandTrace;
+#endif
 /**
   * @}
   */
@@ -250,6 +315,13 @@ int main(void)
             exec = DEBUG_STATE_INIT;
             break;
         }
+        case DEBUG_STATE_STREAM:
+        {
+            WriteStream();
+            /* No re-initialization, which would clear the stream status */
+            exec = DEBUG_STATE_WAIT;
+            break;
+        }
         }
     } while (condition);
 
@@ -272,6 +344,7 @@ KEEP_IN_COMPILATION uint32_t Init(void)
 {
     /* Declare and initialize the ret variable */
     uint32_t ret = LOADER_STATUS_SUCCESS;
+    uint32_t start;
 
     /* Disable Interrupts */
     __disable_irq();
@@ -299,6 +372,14 @@ KEEP_IN_COMPILATION uint32_t Init(void)
         SystemClock_Config();
     }
 
+    /* Remap the memory window to the ICACHE */
+    Cache_Init();
+
+    /* Start the cycle counter */
+    Perf_Init();
+    Perf_Count(PERF_INIT, 0U);
+    start = Perf_Cycles();
+
     DEBUG_INIT(COM_Init);
     DEBUG_PRINTF("\r\n\n===================  Start Init ============================\r\n");
 
@@ -310,7 +391,7 @@ KEEP_IN_COMPILATION uint32_t Init(void)
     DEBUG_PRINTF("\r\n TransferRate= BSP_OSPI_NOR_STR_TRANSFER ");
 
     /* Deinitialize the OSPI interface */
-    if (BSP_OSPI_NOR_DeInit(0) != BSP_ERROR_NONE)
+    if (trace_bsp(TRACE_BSP_DEINIT, 0U, 0U, BSP_OSPI_NOR_DeInit(0)) != BSP_ERROR_NONE)
     {
         ret = LOADER_STATUS_FAIL;
     }
@@ -318,15 +399,17 @@ KEEP_IN_COMPILATION uint32_t Init(void)
     {
         DEBUG_PRINTF("\r\n OSPI interface is Deinitialized");
         /* Initialize OSPI */
-        if (BSP_OSPI_NOR_Init(0, &Flash) != BSP_ERROR_NONE)
+        if (trace_bsp(TRACE_BSP_INIT, 0U, 0U, BSP_OSPI_NOR_Init(0, &Flash)) != BSP_ERROR_NONE)
         {
             ret = LOADER_STATUS_FAIL;
         }
         else
         {
             DEBUG_PRINTF("\r\n OSPI interface is initialized");
+            /* Search the fastest stable OSPI clock */
+            Clock_Search();
             /* Enable the OSPI in memory-mapped mode */
-            if (BSP_OSPI_NOR_EnableMemoryMappedMode(0) != BSP_ERROR_NONE)
+            if (trace_bsp(TRACE_BSP_MEMORY_MAPPED, 0U, 0U, BSP_OSPI_NOR_EnableMemoryMappedMode(0)) != BSP_ERROR_NONE)
             {
                 ret = LOADER_STATUS_FAIL;
             }
@@ -338,8 +421,10 @@ KEEP_IN_COMPILATION uint32_t Init(void)
             }
         }
     }
-    /* Set the MemoryMappedMode variable to indicate that memory-mapped mode is enabled */
-    MemoryMappedMode = MEM_MAPENABLE;
+    /* Keep the OSPI session for the next operations, re-initialize it on failure */
+    Cache_Invalidate();
+    MemoryMappedMode = (ret != LOADER_STATUS_FAIL) ? MEM_MAPENABLE : MEM_MAPRESET;
+    Perf_Add(PERF_PHASE_INIT, &start);
 
     if (ret != LOADER_STATUS_FAIL)
         DEBUG_PRINTF("\r\n\n=================== Init Pass ============================\r\n");
@@ -350,6 +435,24 @@ KEEP_IN_COMPILATION uint32_t Init(void)
     return ret;
 }
 
+/**
+  * @brief  Completes the last program or erase and restores the ICACHE state
+  *         found by Init. The memory is left memory-mapped; Init is called
+  *         again before any other operation.
+  * @retval Loader status.
+  * @retval 1       Operation succeeded.
+  * @retval 0       Operation failed.
+  */
+KEEP_IN_COMPILATION uint32_t DeInit(void)
+{
+    uint32_t ret;
+
+    ret = OSPI_EnterMemoryMappedMode();
+    Cache_DeInit();
+
+    return ret;
+}
+
 /**
   * @brief   Erases the entire memory.
   * @param   Parallelism The parallelism mode.
@@ -361,38 +464,39 @@ KEEP_IN_COMPILATION uint32_t MassErase(uint32_t Parallelism)
 {
     /* Declare and initialize the ret variable */
     uint32_t ret = LOADER_STATUS_SUCCESS;
+    uint32_t start;
 
     DEBUG_PRINTF("\r\n\n=================== Start MassErase ============================\r\n");
+    Perf_Count(PERF_MASS_ERASE, 0U);
 
     /* Disable Interrupts */
     __disable_irq();
 
-    /* Exit form memory-mapped mode if enabled */
-    if (MemoryMappedMode == MEM_MAPENABLE)
+    /* Switch the OSPI interface to indirect mode */
+    if (OSPI_EnterIndirectMode() != LOADER_STATUS_SUCCESS)
     {
-        DEBUG_PRINTF("\r\n Disable memory-mapped mode ");
+        /* Set the return status to failure */
+        ret = LOADER_STATUS_FAIL;
+    }
 
-        if (BSP_OSPI_NOR_DisableMemoryMappedMode(0) != BSP_ERROR_NONE)
+    if (ret != LOADER_STATUS_FAIL)
+    {
+        /* Erase the entire OSPI memory */
+        start = Perf_Cycles();
+        if (trace_bsp(TRACE_BSP_ERASE_CHIP, 0U, 0U, BSP_OSPI_NOR_Erase_Chip(0)) != BSP_ERROR_NONE)
         {
-            /* Set the return status to failure */
             ret = LOADER_STATUS_FAIL;
+            MemoryMappedMode = MEM_MAPRESET;
+        }
+        else
+        {
+            /* Wait for the end of the erase, unless it is deferred */
+            Perf_Add(PERF_PHASE_BUSY, &start);
+            MemoryMappedMode = MEM_MAPBUSY;
+            ret = OSPI_CompleteOperation();
         }
-
-        DEBUG_PRINTF("\r\n Memory-mapped mode Disabled");
-
-        /* Set the MemoryMappedMode variable to indicate that memory-mapped mode is disabled */
-        MemoryMappedMode = MEM_MAPDISABLE;
-    }
-
-    /* Erase the entire OSPI memory */
-    if (BSP_OSPI_NOR_Erase_Chip(0) != BSP_ERROR_NONE)
-    {
-        ret = LOADER_STATUS_FAIL;
     }
 
-    /* Read current status of the OSPI memory */
-    while (BSP_OSPI_NOR_GetStatus(0) != BSP_ERROR_NONE);
-
     if (ret != LOADER_STATUS_FAIL)
         DEBUG_PRINTF("\r\n\n=================== MassErase Pass ============================\r\n");
     else
@@ -420,33 +524,25 @@ KEEP_IN_COMPILATION uint32_t Write(uint32_t Address, uint32_t Size, uint8_t *buf
     DEBUG_PRINTF("\r\n Address = %x ", Address);
     DEBUG_PRINTF("\r\n Size = %x ", Size);
     DEBUG_PRINTF("\r\n buffer = %x ", buffer);
+    Perf_Count(PERF_WRITE, Size);
 
     /* Disable Interrupts */
     __disable_irq();
 
     Address = Address & 0x0FFFFFFF;
 
-    /* Exit form memory-mapped mode if enabled */
-    if (MemoryMappedMode == MEM_MAPENABLE)
+    /* Switch the OSPI interface to indirect mode */
+    if (OSPI_EnterIndirectMode() != LOADER_STATUS_SUCCESS)
     {
-        DEBUG_PRINTF("\r\n Disable memory-mapped mode ");
-
-        if (BSP_OSPI_NOR_DisableMemoryMappedMode(0) != BSP_ERROR_NONE)
-        {
-            /* Set the return status to failure */
-            ret = LOADER_STATUS_FAIL;
-        }
-
-        DEBUG_PRINTF("\r\n Memory-mapped mode Disabled ");
-
-        /* Set the MemoryMappedMode variable to indicate that memory-mapped mode is disabled */
-        MemoryMappedMode = MEM_MAPDISABLE;
+        /* Set the return status to failure */
+        ret = LOADER_STATUS_FAIL;
     }
 
     /* Write an amount of data to the OSPI memory */
-    if (BSP_OSPI_NOR_Write(0, buffer, Address, Size) != BSP_ERROR_NONE)
+    if ((ret != LOADER_STATUS_FAIL) && (OSPI_ProgramPages(Address, Size, buffer) != LOADER_STATUS_SUCCESS))
     {
         ret = LOADER_STATUS_FAIL;
+        MemoryMappedMode = MEM_MAPRESET;
     }
 
     if (ret != LOADER_STATUS_FAIL)
@@ -458,6 +554,231 @@ KEEP_IN_COMPILATION uint32_t Write(uint32_t Address, uint32_t Size, uint8_t *buf
     return ret;
 }
 
+/**
+  * @brief  Programs the data the host streams through StreamRing.
+  * @retval Loader status.
+  * @retval 1       Operation succeeded.
+  * @retval 0       Operation failed.
+  * @note   The host sets Address and End, then keeps writing the data to Data and
+  *         advancing Head while the loader runs, either called or through the
+  *         DEBUG_STATE_STREAM state of main. Each complete page is programmed as
+  *         soon as it is available and Tail advanced, the debug link transfer
+  *         overlapping with the programming. Head and Tail are free running, Data
+  *         being indexed modulo STREAM_BUFFER_SIZE: the host must keep Head - Tail
+  *         within STREAM_BUFFER_SIZE. The stream fails when the host sets Abort, or
+  *         leaves Head unchanged for STREAM_TIMEOUT_MS while the loader waits for
+  *         data.
+  */
+KEEP_IN_COMPILATION uint32_t WriteStream(void)
+{
+    uint32_t offset;
+    uint32_t count;
+#if (STREAM_TIMEOUT_MS != 0U)
+    uint32_t head = StreamRing.Head;
+    uint32_t idle = DWT->CYCCNT;
+#endif
+
+    StreamRing.Abort = 0U;
+    StreamRing.Status = STREAM_RUNNING;
+    while (StreamRing.Address < StreamRing.End)
+    {
+        /* Program up to the end of the page, of the stream and of the ring */
+        offset = StreamRing.Tail % STREAM_BUFFER_SIZE;
+        count = PROGRAM_PAGE_SIZE - (StreamRing.Address % PROGRAM_PAGE_SIZE);
+        if (count > (StreamRing.End - StreamRing.Address))
+        {
+            count = StreamRing.End - StreamRing.Address;
+        }
+        if (count > (STREAM_BUFFER_SIZE - offset))
+        {
+            count = STREAM_BUFFER_SIZE - offset;
+        }
+
+        /* Wait for the host to write the whole chunk */
+        if ((StreamRing.Head - StreamRing.Tail) < count)
+        {
+            if (StreamRing.Abort != 0U)
+            {
+                StreamRing.Status = STREAM_ERROR;
+                return LOADER_STATUS_FAIL;
+            }
+#if (STREAM_TIMEOUT_MS != 0U)
+            if (StreamRing.Head != head)
+            {
+                head = StreamRing.Head;
+                idle = DWT->CYCCNT;
+            }
+            else if ((DWT->CYCCNT - idle) > (STREAM_TIMEOUT_MS * (SystemCoreClock / 1000U)))
+            {
+                StreamRing.Status = STREAM_ERROR;
+                return LOADER_STATUS_FAIL;
+            }
+#endif
+            continue;
+        }
+        __DMB();
+
+        if (Write(StreamRing.Address, count, &StreamRing.Data[offset]) != LOADER_STATUS_SUCCESS)
+        {
+            StreamRing.Status = STREAM_ERROR;
+            return LOADER_STATUS_FAIL;
+        }
+        StreamRing.Address += count;
+        StreamRing.Tail += count;
+#if (STREAM_TIMEOUT_MS != 0U)
+        idle = DWT->CYCCNT;
+#endif
+    }
+    StreamRing.Status = STREAM_DONE;
+
+    return LOADER_STATUS_SUCCESS;
+}
+
+/**
+  * @brief  Runs a list of erase, program and verify operations in a single call.
+  * @param  List  Pointer to the operation descriptors.
+  * @param  Count Number of descriptors.
+  * @retval Loader status.
+  * @retval 1       All operations succeeded.
+  * @retval 0       An operation failed.
+  * @note   Saves the debugger round trip of one call per operation. The operations
+  *         are run in order up to the first failure, each one getting its status,
+  *         the following ones being left OPERATION_NOT_RUN.
+  */
+KEEP_IN_COMPILATION uint32_t RunOperations(operation_desc *List, uint32_t Count)
+{
+    uint32_t ret = LOADER_STATUS_SUCCESS;
+    uint32_t i;
+    uint32_t offset;
+
+    for (i = 0U; i < Count; i++)
+    {
+        List[i].Status = OPERATION_NOT_RUN;
+    }
+
+    for (i = 0U; (i < Count) && (ret == LOADER_STATUS_SUCCESS); i++)
+    {
+        switch (List[i].Op)
+        {
+        case OPERATION_ERASE:
+        {
+            if (List[i].Size != 0U)
+            {
+                ret = SectorErase(List[i].Address, List[i].Address + List[i].Size - 1U);
+            }
+            break;
+        }
+        case OPERATION_PROGRAM:
+        {
+            ret = Write(List[i].Address, List[i].Size, List[i].Buffer);
+            break;
+        }
+        case OPERATION_VERIFY:
+        {
+            /* Verify returns the failing address in its low word. It compares the
+               whole words, the last bytes being compared byte by byte as it does,
+               in the memory-mapped mode it leaves enabled */
+            if ((uint32_t)Verify(List[i].Address, (uint32_t)List[i].Buffer, List[i].Size / 4U, 0U) != 0U)
+            {
+                ret = LOADER_STATUS_FAIL;
+            }
+            for (offset = List[i].Size & ~0x3U; (ret == LOADER_STATUS_SUCCESS) && (offset < List[i].Size); offset++)
+            {
+                if (*(uint8_t *)Cache_Address(List[i].Address + offset) != List[i].Buffer[offset])
+                {
+                    ret = LOADER_STATUS_FAIL;
+                }
+            }
+            break;
+        }
+        default:
+        {
+            ret = LOADER_STATUS_FAIL;
+            break;
+        }
+        }
+        List[i].Status = (ret == LOADER_STATUS_SUCCESS) ? OPERATION_OK : OPERATION_FAILED;
+    }
+
+    return ret;
+}
+/**
+  * @brief  Programs a memory zone with a repeated pattern generated in RAM.
+  * @param  Address     The zone start address.
+  * @param  Size        The zone size.
+  * @param  Pattern     The pattern, least significant byte first.
+  * @param  PatternSize The pattern size, 1, 2 or 4 bytes.
+  * @retval Loader status.
+  * @retval 1       Operation succeeded.
+  * @retval 0       Operation failed.
+  * @note   Constant runs need not be transferred to the loader. The zone is written
+  *         in chunks aligned on FILL_BUFFER_SIZE, so on pages, each chunk starting
+  *         in FillBuffer at its pattern phase. A fill with the erase value (0xFF)
+  *         programs nothing and fails unless the zone is already erased.
+  */
+KEEP_IN_COMPILATION uint32_t Fill(uint32_t Address, uint32_t Size, uint32_t Pattern, uint32_t PatternSize)
+{
+    uint32_t mask;
+    uint32_t phase = 0U;
+    uint32_t count;
+    uint32_t i;
+
+    if ((PatternSize != 1U) && (PatternSize != 2U) && (PatternSize != 4U))
+    {
+        return LOADER_STATUS_FAIL;
+    }
+    mask = (PatternSize == 4U) ? 0xFFFFFFFFU : ((1UL << (8U * PatternSize)) - 1U);
+    if ((Pattern & mask) == mask)
+    {
+        /* Programming the erase value changes no bit: check the zone is erased
+           instead, by Verify against a chunk of 0xFF, and read the last bytes
+           in the memory-mapped mode it leaves enabled */
+        (void)memset(FillBuffer, 0xFF, FILL_BUFFER_SIZE);
+        do
+        {
+            count = (Size < FILL_BUFFER_SIZE) ? (Size & ~0x3U) : FILL_BUFFER_SIZE;
+            if ((uint32_t)Verify(Address, (uint32_t)FillBuffer, count / 4U, 0U) != 0U)
+            {
+                return LOADER_STATUS_FAIL;
+            }
+            Address += count;
+            Size -= count;
+        } while (Size >= 4U);
+        for (i = 0U; i < Size; i++)
+        {
+            if (*(uint8_t *)Cache_Address(Address + i) != 0xFFU)
+            {
+                return LOADER_STATUS_FAIL;
+            }
+        }
+        return LOADER_STATUS_SUCCESS;
+    }
+
+    for (i = 0U; i < (FILL_BUFFER_SIZE + 4U); i++)
+    {
+        ((uint8_t *)FillBuffer)[i] = (uint8_t)(Pattern >> (8U * (i % PatternSize)));
+    }
+
+    while (Size > 0U)
+    {
+        count = FILL_BUFFER_SIZE - (Address % FILL_BUFFER_SIZE);
+        if (count > Size)
+        {
+            count = Size;
+        }
+        if (Write(Address, count, (uint8_t *)FillBuffer + phase) != LOADER_STATUS_SUCCESS)
+        {
+            return LOADER_STATUS_FAIL;
+        }
+        phase = (phase + count) % PatternSize;
+        Address += count;
+        Size -= count;
+    }
+
+    return LOADER_STATUS_SUCCESS;
+}
+
+
 /**
   * @brief   Erases sectors.
   * @param   EraseStartAddress The erase start address.
@@ -472,9 +793,9 @@ KEEP_IN_COMPILATION uint32_t SectorErase(uint32_t EraseStartAddress, uint32_t Er
     uint32_t ret = LOADER_STATUS_SUCCESS;
     uint32_t current_end_addr;
     uint32_t current_start_addr;
-
-    /* define the Sector Size */
-    uint32_t sector_size = 0x10000;
+    uint32_t mapped_base = EraseStartAddress & 0xF0000000;
+    const erase_unit *unit;
+    uint32_t start;
 
     /* Disable Interrupts */
     __disable_irq();
@@ -482,43 +803,73 @@ KEEP_IN_COMPILATION uint32_t SectorErase(uint32_t EraseStartAddress, uint32_t Er
     DEBUG_PRINTF("\r\n\n=================== Start SectorErase ============================\r\n");
     DEBUG_PRINTF("\r\n EraseStartAddress = %x ", EraseStartAddress);
     DEBUG_PRINTF("\r\n EraseEndAddress = %x ", EraseEndAddress);
-    DEBUG_PRINTF("\r\n sector_size = %x ", sector_size);
+    Perf_Count(PERF_SECTOR_ERASE, 0U);
 
-    /* Exit form memory-mapped mode if enabled */
-    if (MemoryMappedMode == MEM_MAPENABLE)
+    /* Switch the OSPI interface to indirect mode */
+    if (OSPI_EnterIndirectMode() != LOADER_STATUS_SUCCESS)
     {
-        DEBUG_PRINTF("\r\n Disable memory-mapped mode ");
-
-        if (BSP_OSPI_NOR_DisableMemoryMappedMode(0) != BSP_ERROR_NONE)
-        {
-            /* Set the return status to failure */
-            ret = LOADER_STATUS_FAIL;
-        }
-
-        DEBUG_PRINTF("\r\n Memory-mapped mode Disabled ");
-
-        /* Set the MemoryMappedMode variable to indicate that memory-mapped mode is disabled */
-        MemoryMappedMode = MEM_MAPDISABLE;
+        /* Set the return status to failure */
+        ret = LOADER_STATUS_FAIL;
     }
 
     /* Mask the addresses to 28 bits */
     current_end_addr = EraseEndAddress & 0x0FFFFFFF;
     current_start_addr = EraseStartAddress & 0x0FFFFFFF;
 
-    /* Align the start address to the nearest 64K boundary */
-    current_start_addr = current_start_addr - (current_start_addr % sector_size);
+    /* Align the range on the sectors, the end address being excluded */
+    current_start_addr = current_start_addr - (current_start_addr % ERASE_SECTOR_SIZE);
+    current_end_addr = current_end_addr - (current_end_addr % ERASE_SECTOR_SIZE) + ERASE_SECTOR_SIZE;
+    if (current_end_addr > MEMORY_SIZE)
+    {
+        current_end_addr = MEMORY_SIZE;
+    }
+
+    /* A range covering the whole memory is erased with a single chip erase */
+    if ((ret != LOADER_STATUS_FAIL) && (current_start_addr == 0U) && (current_end_addr == MEMORY_SIZE))
+    {
+        ret = MassErase(0);
+        current_start_addr = current_end_addr;
+    }
 
-    while ((current_end_addr >= current_start_addr) && (ret != LOADER_STATUS_FAIL))
+    while ((current_end_addr > current_start_addr) && (ret != LOADER_STATUS_FAIL))
     {
-        /* Erase the specified block of the OSPI memory */
-        if (BSP_OSPI_NOR_Erase_Block(0, current_start_addr, MX25LM51245G_ERASE_64K) != BSP_ERROR_NONE)
+        /* Select the fastest erase command fitting at this address */
+        unit = OSPI_PlanErase(current_start_addr, current_end_addr);
+        DEBUG_PRINTF("\r\n erase %x at %x ", unit->Size, current_start_addr);
+
+        /* Skip the sector already erased */
+        if (OSPI_SectorIsErased(mapped_base + current_start_addr, unit->Size) != 0U)
+        {
+            SkippedSectors++;
+        }
+        /* Wait for the previous block erase */
+        else if (OSPI_EnterIndirectMode() != LOADER_STATUS_SUCCESS)
         {
             ret = LOADER_STATUS_FAIL;
         }
-        /* Read current status of the OSPI memory */
-        while (BSP_OSPI_NOR_GetStatus(0) != BSP_ERROR_NONE);
+        /* Erase the specified block of the OSPI memory */
+        else
+        {
+            start = Perf_EraseStart();
+            if (trace_bsp(TRACE_BSP_ERASE_BLOCK, current_start_addr, 0U, BSP_OSPI_NOR_Erase_Block(0, current_start_addr, unit->Type)) != BSP_ERROR_NONE)
+            {
+                ret = LOADER_STATUS_FAIL;
+                MemoryMappedMode = MEM_MAPRESET;
+            }
+            else
+            {
+                Perf_Add(PERF_PHASE_BUSY, &start);
+                MemoryMappedMode = MEM_MAPBUSY;
+            }
+        }
+
+        current_start_addr += unit->Size;
+    }
 
-        current_start_addr += sector_size;
+    /* Wait for the end of the last block erase, unless it is deferred */
+    if (ret != LOADER_STATUS_FAIL)
+    {
+        ret = OSPI_CompleteOperation();
     }
 
     if (ret != LOADER_STATUS_FAIL)
@@ -541,79 +892,47 @@ KEEP_IN_COMPILATION uint32_t SectorErase(uint32_t EraseStartAddress, uint32_t Er
 KEEP_IN_COMPILATION uint32_t CheckSum(uint32_t StartAddress, uint32_t Size, uint32_t InitVal)
 {
     /* Calculate misalignment of the start address */
-    uint8_t misalignment_address = StartAddress % 4;
-    /* Store the original size for later use */
-    uint8_t misalignment_size = Size;
-    uint32_t cnt;
+    uint32_t misalignment_address = StartAddress % 4U;
+    /* Calculate the padding completing the last word */
+    uint32_t misalignment_size = (4U - (Size % 4U)) % 4U;
+    uint32_t words;
     uint32_t Val;
+    uint32_t start = Perf_Cycles();
+
+    Perf_Count(PERF_CHECKSUM, Size);
+    StartAddress = Cache_Address(StartAddress);
 
     /* Align the start address to the nearest 4-byte boundary */
-    StartAddress -= StartAddress % 4;
-    /* Adjust the size to be a multiple of 4 bytes */
-    Size += (Size % 4 == 0) ? 0 : 4 - (Size % 4);
+    StartAddress -= misalignment_address;
+    /* Count the 4-byte chunks of the memory region */
+    words = (Size + misalignment_size) / 4U;
 
-    /* Iterate over the memory region in 4-byte chunks */
-    for (cnt = 0; cnt < Size; cnt += 4)
+    /* Handle initial misalignment of the start address */
+    if ((misalignment_address != 0U) && (words != 0U))
     {
-        /* Read a 4-byte value from the current address */
-        Val = *(uint32_t *)StartAddress;
+        Val = *(uint32_t *)StartAddress >> (8U * misalignment_address);
+        InitVal += CheckSum_Words(&Val, 1U);
+        StartAddress += 4U;
+        words--;
+    }
 
-        /* Handle initial misalignment of the start address */
-        if (misalignment_address)
-        {
-            switch (misalignment_address)
-            {
-            case 1:
-                InitVal += (uint8_t)(Val >> 8 & 0xff);
-                InitVal += (uint8_t)(Val >> 16 & 0xff);
-                InitVal += (uint8_t)(Val >> 24 & 0xff);
-                misalignment_address -= 1;
-                break;
-            case 2:
-                InitVal += (uint8_t)(Val >> 16 & 0xff);
-                InitVal += (uint8_t)(Val >> 24 & 0xff);
-                misalignment_address -= 2;
-                break;
-            case 3:
-                InitVal += (uint8_t)(Val >> 24 & 0xff);
-                misalignment_address -= 3;
-                break;
-            }
-        }
-        /* Handle final misalignment of the size */
-        else if ((Size - misalignment_size) % 4 && (Size - cnt) <= 4)
-        {
-            switch (Size - misalignment_size)
-            {
-            case 1:
-                InitVal += (uint8_t)Val;
-                InitVal += (uint8_t)(Val >> 8 & 0xff);
-                InitVal += (uint8_t)(Val >> 16 & 0xff);
-                misalignment_size -= 1;
-                break;
-            case 2:
-                InitVal += (uint8_t)Val;
-                InitVal += (uint8_t)(Val >> 8 & 0xff);
-                misalignment_size -= 2;
-                break;
-            case 3:
-                InitVal += (uint8_t)Val;
-                misalignment_size -= 3;
-                break;
-            }
-        }
-        /* Process aligned 4-byte chunks */
-        else
+    /* Handle final misalignment of the size */
+    if ((misalignment_size != 0U) && (words != 0U))
+    {
+        words--;
+        /* The size counter of the former byte ladder was 8-bit, so the partial
+           last word only ever counted in zones below 256 bytes */
+        if (Size < 0x100U)
         {
-            InitVal += (uint8_t)Val;
-            InitVal += (uint8_t)(Val >> 8 & 0xff);
-            InitVal += (uint8_t)(Val >> 16 & 0xff);
-            InitVal += (uint8_t)(Val >> 24 & 0xff);
+            Val = *(uint32_t *)(StartAddress + (4U * words)) & (0xFFFFFFFFU >> (8U * misalignment_size));
+            InitVal += CheckSum_Words(&Val, 1U);
         }
-        /* Move to the next 4-byte chunk */
-        StartAddress += 4;
     }
 
+    /* Process aligned 4-byte chunks */
+    InitVal += CheckSum_Words((const uint32_t *)StartAddress, words);
+    Perf_Add(PERF_PHASE_VERIFY, &start);
+
     /* Return the calculated checksum value */
     return InitVal;
 }
@@ -634,41 +953,871 @@ KEEP_IN_COMPILATION uint64_t Verify(uint32_t MemoryAddr, uint32_t RAMBufferAddr,
     uint32_t VerifiedData = 0;
     uint32_t InitVal = 0;
     uint64_t checksum;
+    uint32_t start;
     Size *= 4;
+    Perf_Count(PERF_VERIFY, Size);
 
     /* Enter memory-mapped mode if disabled */
-    if (MemoryMappedMode == MEM_MAPDISABLE)
+    if (OSPI_EnterMemoryMappedMode() != LOADER_STATUS_SUCCESS)
     {
-        /* Configure the OSPI in memory-mapped mode */
-        if (BSP_OSPI_NOR_EnableMemoryMappedMode(0) != BSP_ERROR_NONE)
+        /* Report the start address as the failure address */
+        return MemoryAddr;
+    }
+    start = Perf_Cycles();
+
+    /* Compare and add up word-aligned regions in a single pass over the memory */
+    if ((((MemoryAddr | RAMBufferAddr) % 4U) == 0U) && ((misalignment & 0x000C000CU) == 0U) && (Size != 0U))
+    {
+        VerifiedData = Verify_Words((const uint32_t *)Cache_Address(MemoryAddr), (const uint32_t *)RAMBufferAddr, Size / 4U, &InitVal);
+        if (VerifiedData == Size)
         {
-            /* Set the return status to failure */
-            return LOADER_STATUS_FAIL;
+            Perf_Add(PERF_PHASE_VERIFY, &start);
+            /* Return the checksum value */
+            return ((uint64_t)Verify_CheckSum((const uint32_t *)RAMBufferAddr, Size, misalignment, InitVal) << 32);
         }
-
-        /* Set the MemoryMappedMode variable to indicate that memory-mapped mode is enabled */
-        MemoryMappedMode = MEM_MAPENABLE;
+        /* Fall back to the byte loop from the differing word */
+        InitVal = 0;
     }
 
-    /* Calculate checksum of the memory region */
+    /* Calculate checksum of the memory region, timed by CheckSum */
+    Perf_Add(PERF_PHASE_VERIFY, &start);
     checksum = CheckSum((uint32_t)MemoryAddr + (misalignment & 0xf), Size - ((misalignment >> 16) & 0xF), InitVal);
+    start = Perf_Cycles();
+    MemoryAddr += VerifiedData;
 
     /* Verify the memory region against the RAM buffer */
     while (Size > VerifiedData)
     {
-        if (*(uint8_t *)MemoryAddr++ != *((uint8_t *)RAMBufferAddr + VerifiedData))
+        if (*(uint8_t *)Cache_Address(MemoryAddr++) != *((uint8_t *)RAMBufferAddr + VerifiedData))
         {
+            Perf_Add(PERF_PHASE_VERIFY, &start);
             /* Return the address of failure and checksum */
             return ((checksum << 32) + (MemoryAddr + VerifiedData));
         }
 
         VerifiedData++;
     }
+    Perf_Add(PERF_PHASE_VERIFY, &start);
 
     /* Return the checksum value */
     return (checksum << 32);
 }
 
+/**
+  * @brief  Calculates the CRC-32 of a memory zone with the CRC unit.
+  * @param  StartAddress Start address of the zone.
+  * @param  Size         Size (in bytes).
+  * @retval CRC-32 of the zone, 0 if the memory could not be read.
+  * @note   IEEE 802.3 CRC-32 of zlib crc32(), to be checked on the host against
+  *         a CRC of the source image. The CRC-32 of "123456789" is 0xCBF43926.
+  */
+KEEP_IN_COMPILATION uint32_t CheckCRC(uint32_t StartAddress, uint32_t Size)
+{
+    uint32_t start;
+    uint32_t crc;
+
+    Perf_Count(PERF_CHECKCRC, Size);
+
+    /* Enter memory-mapped mode if disabled */
+    if (OSPI_EnterMemoryMappedMode() != LOADER_STATUS_SUCCESS)
+    {
+        return 0U;
+    }
+
+    StartAddress = Cache_Address(StartAddress);
+    start = Perf_Cycles();
+    CRC32_Start();
+    CRC32_Words((const uint8_t *)StartAddress, Size / 4U);
+    crc = CRC32_End((const uint8_t *)StartAddress + (Size & ~0x3U), Size % 4U);
+    Perf_Add(PERF_PHASE_VERIFY, &start);
+
+    return crc;
+}
+
+/**
+  * @brief  Calculates the SHA-256 digest of a memory zone with the HASH unit.
+  * @param  StartAddress Start address of the zone.
+  * @param  Size         Size (in bytes).
+  * @param  Digest       RAM buffer receiving the 32-byte digest.
+  * @retval Loader status.
+  * @retval 1       Operation succeeded.
+  * @retval 0       Operation failed.
+  * @note   The host compares a single digest with the one of the source image
+  *         instead of reading the memory back.
+  */
+KEEP_IN_COMPILATION uint32_t CheckSHA256(uint32_t StartAddress, uint32_t Size, uint8_t *Digest)
+{
+    uint32_t start;
+
+    Perf_Count(PERF_CHECKSHA256, Size);
+
+    /* Enter memory-mapped mode if disabled */
+    if (OSPI_EnterMemoryMappedMode() != LOADER_STATUS_SUCCESS)
+    {
+        return LOADER_STATUS_FAIL;
+    }
+
+    start = Perf_Cycles();
+    SHA256_Calculate((const uint8_t *)Cache_Address(StartAddress), Size, Digest);
+    Perf_Add(PERF_PHASE_VERIFY, &start);
+    return LOADER_STATUS_SUCCESS;
+}
+
+/**
+  * @brief  Puts the OSPI interface in indirect mode.
+  * @note   The OSPI interface is kept initialized between loader calls and is
+  *         re-initialized only when a previous operation failed.
+  * @retval Loader status.
+  * @retval 1       Operation succeeded.
+  * @retval 0       Operation failed.
+  */
+static uint32_t OSPI_EnterIndirectMode(void)
+{
+    uint32_t start = Perf_Cycles();
+
+    /* Complete the program/erase left running by the previous call */
+    if (MemoryMappedMode == MEM_MAPBUSY)
+    {
+        trace_command(TRACE_CALL, TRACE_BSP_WAIT, 0U, 0U, 0U);
+        while (BSP_OSPI_NOR_GetStatus(0) != BSP_ERROR_NONE)
+        {
+            Perf_Add(PERF_PHASE_BUSY, &start);
+        }
+        Perf_Add(PERF_PHASE_BUSY, &start);
+        trace_command(TRACE_RETURN, TRACE_BSP_WAIT, 0U, 0U, 0U);
+        Perf_EraseDone();
+        MemoryMappedMode = MEM_MAPDISABLE;
+    }
+
+    /* Exit from memory-mapped mode if enabled */
+    if (MemoryMappedMode == MEM_MAPENABLE)
+    {
+        DEBUG_PRINTF("\r\n Disable memory-mapped mode ");
+
+        if (trace_bsp(TRACE_BSP_INDIRECT, 0U, 0U, BSP_OSPI_NOR_DisableMemoryMappedMode(0)) != BSP_ERROR_NONE)
+        {
+            /* Fall back to a full re-initialization */
+            MemoryMappedMode = MEM_MAPRESET;
+        }
+        else
+        {
+            DEBUG_PRINTF("\r\n Memory-mapped mode Disabled ");
+
+            /* Set the MemoryMappedMode variable to indicate that memory-mapped mode is disabled */
+            MemoryMappedMode = MEM_MAPDISABLE;
+        }
+    }
+
+    /* Re-initialize the OSPI interface after a failed operation */
+    if (MemoryMappedMode == MEM_MAPRESET)
+    {
+        DEBUG_PRINTF("\r\n Re-initialize the OSPI interface ");
+
+        (void)trace_bsp(TRACE_BSP_DEINIT, 0U, 0U, BSP_OSPI_NOR_DeInit(0));
+        if (trace_bsp(TRACE_BSP_INIT, 0U, 0U, BSP_OSPI_NOR_Init(0, &Flash)) != BSP_ERROR_NONE)
+        {
+            return LOADER_STATUS_FAIL;
+        }
+        Clock_Apply();
+
+        MemoryMappedMode = MEM_MAPDISABLE;
+    }
+
+    Perf_Add(PERF_PHASE_INIT, &start);
+    return LOADER_STATUS_SUCCESS;
+}
+
+/**
+  * @brief  Waits for the end of the program/erase just issued.
+  * @note   With DEFERRED_COMPLETION set, the wait is left to the next loader
+  *         call through OSPI_EnterIndirectMode().
+  * @retval Loader status.
+  * @retval 1       Operation succeeded.
+  * @retval 0       Operation failed.
+  */
+static uint32_t OSPI_CompleteOperation(void)
+{
+#if (DEFERRED_COMPLETION == 0)
+    return OSPI_EnterIndirectMode();
+#else
+    return LOADER_STATUS_SUCCESS;
+#endif
+}
+
+/**
+  * @brief  Puts the OSPI interface in memory-mapped mode.
+  * @retval Loader status.
+  * @retval 1       Operation succeeded.
+  * @retval 0       Operation failed.
+  */
+static uint32_t OSPI_EnterMemoryMappedMode(void)
+{
+    uint32_t start;
+
+    if (MemoryMappedMode == MEM_MAPENABLE)
+    {
+        return LOADER_STATUS_SUCCESS;
+    }
+
+    /* Configure the OSPI in memory-mapped mode */
+    if (OSPI_EnterIndirectMode() != LOADER_STATUS_SUCCESS)
+    {
+        MemoryMappedMode = MEM_MAPRESET;
+        return LOADER_STATUS_FAIL;
+    }
+    start = Perf_Cycles();
+    if (trace_bsp(TRACE_BSP_MEMORY_MAPPED, 0U, 0U, BSP_OSPI_NOR_EnableMemoryMappedMode(0)) != BSP_ERROR_NONE)
+    {
+        MemoryMappedMode = MEM_MAPRESET;
+        return LOADER_STATUS_FAIL;
+    }
+
+    /* Drop the lines read before the last programs and erases */
+    Cache_Invalidate();
+
+    /* Set the MemoryMappedMode variable to indicate that memory-mapped mode is enabled */
+    MemoryMappedMode = MEM_MAPENABLE;
+    Perf_Add(PERF_PHASE_INIT, &start);
+
+    return LOADER_STATUS_SUCCESS;
+}
+
+#if (CACHE_PROFILE == 1)
+/* ICACHE state found by Init, restored by DeInit. Initialized data rather
+   than .bss, which Init clears, so that an Init run again without DeInit does
+   not save the configuration of the loader */
+static struct
+{
+    uint32_t Empty;     /* 1 until Init saves the state */
+    uint32_t Cr;
+    uint32_t Crr0;
+} CacheState = {1U};
+#endif
+
+/**
+  * @brief  Remaps the OCTOSPI window to CACHE_REMAP_BASE with the ICACHE
+  *         region 0, on the master 2 port in wrapped bursts, and enables the
+  *         ICACHE.
+  * @retval None
+  */
+static void Cache_Init(void)
+{
+#if (CACHE_PROFILE == 1)
+    if (CacheState.Empty != 0U)
+    {
+        CacheState.Cr = ICACHE->CR;
+        CacheState.Crr0 = ICACHE->CRR0;
+        CacheState.Empty = 0U;
+    }
+
+    /* The regions are configured with the ICACHE disabled */
+    ICACHE->CR &= ~ICACHE_CR_EN;
+    while ((ICACHE->SR & ICACHE_SR_BUSYF) != 0U)
+    {
+    }
+
+    ICACHE->CRR0 = ((CACHE_REMAP_BASE >> 21U) & ICACHE_CRRx_BASEADDR) |
+                   (CACHE_REMAP_SIZE << ICACHE_CRRx_RSIZE_Pos) |
+                   ((CACHE_WINDOW_BASE >> 5U) & ICACHE_CRRx_REMAPADDR) |
+                   ICACHE_CRRx_MSTSEL | ICACHE_CRRx_REN;
+
+    ICACHE->CR |= ICACHE_CR_CACHEINV;
+    while ((ICACHE->SR & ICACHE_SR_BUSYF) != 0U)
+    {
+    }
+    ICACHE->CR |= ICACHE_CR_EN;
+#endif
+}
+
+/**
+  * @brief  Drops the ICACHE lines of the previous mapping, which the programs
+  *         and erases run since then may have made stale.
+  * @retval None
+  */
+static void Cache_Invalidate(void)
+{
+#if (CACHE_PROFILE == 1)
+    ICACHE->CR |= ICACHE_CR_CACHEINV;
+    while ((ICACHE->SR & ICACHE_SR_BUSYF) != 0U)
+    {
+    }
+#endif
+}
+
+/**
+  * @brief  Disables the ICACHE remap region and restores the ICACHE state
+  *         saved by Cache_Init, the lines of the window being invalidated.
+  * @retval None
+  */
+static void Cache_DeInit(void)
+{
+#if (CACHE_PROFILE == 1)
+    if (CacheState.Empty != 0U)
+    {
+        return;
+    }
+
+    /* The regions are configured with the ICACHE disabled */
+    ICACHE->CR &= ~ICACHE_CR_EN;
+    while ((ICACHE->SR & ICACHE_SR_BUSYF) != 0U)
+    {
+    }
+    ICACHE->CRR0 = CacheState.Crr0;
+
+    ICACHE->CR |= ICACHE_CR_CACHEINV;
+    while ((ICACHE->SR & ICACHE_SR_BUSYF) != 0U)
+    {
+    }
+    ICACHE->CR = CacheState.Cr & ~ICACHE_CR_CACHEINV;
+    CacheState.Empty = 1U;
+#endif
+}
+
+/**
+  * @brief  Gives the address to read a memory-mapped location from.
+  * @param  Address Address in the OCTOSPI window.
+  * @retval Its alias in the ICACHE remap region, or Address itself when it is
+  *         out of the memory.
+  */
+static uint32_t Cache_Address(uint32_t Address)
+{
+#if (CACHE_PROFILE == 1)
+    if ((Address >= CACHE_WINDOW_BASE) && ((Address - CACHE_WINDOW_BASE) < MEMORY_SIZE))
+    {
+        return Address - CACHE_WINDOW_BASE + CACHE_REMAP_BASE;
+    }
+#endif
+    return Address;
+}
+
+#if (CLOCK_SEARCH == 1)
+/**
+  * @brief  Reads the OCTOSPI kernel clock divider.
+  * @retval Divider, the PRESCALER field plus one.
+  */
+static uint32_t Clock_GetDivider(void)
+{
+    return ((CLOCK_INSTANCE->DCR2 & OCTOSPI_DCR2_PRESCALER) >> OCTOSPI_DCR2_PRESCALER_Pos) + 1U;
+}
+
+/**
+  * @brief  Sets the OCTOSPI kernel clock divider once the OCTOSPI is idle.
+  * @param  Divider Kernel clock divider.
+  * @retval None
+  */
+static void Clock_SetDivider(uint32_t Divider)
+{
+    while ((CLOCK_INSTANCE->SR & OCTOSPI_SR_BUSY) != 0U)
+    {
+    }
+    MODIFY_REG(CLOCK_INSTANCE->DCR2, OCTOSPI_DCR2_PRESCALER, (Divider - 1U) << OCTOSPI_DCR2_PRESCALER_Pos);
+}
+
+/**
+  * @brief  Reads the signature: the memory ID followed by the
+  *         CLOCK_SIGNATURE_SIZE first bytes of the memory, in the read mode
+  *         the BSP set.
+  * @param  Signature Buffer of CLOCK_SIGNATURE_SIZE + 4 bytes.
+  * @retval Loader status.
+  * @retval 1       Operation succeeded.
+  * @retval 0       Operation failed.
+  */
+static uint32_t Clock_ReadSignature(uint8_t *Signature)
+{
+    (void)memset(Signature, 0, CLOCK_SIGNATURE_SIZE + 4U);
+    if (trace_bsp(TRACE_BSP_READ_ID, 0U, 0U, BSP_OSPI_NOR_ReadID(0, Signature)) != BSP_ERROR_NONE)
+    {
+        return LOADER_STATUS_FAIL;
+    }
+    if (trace_bsp(TRACE_BSP_READ, 0U, CLOCK_SIGNATURE_SIZE, BSP_OSPI_NOR_Read(0, Signature + 4U, 0, CLOCK_SIGNATURE_SIZE)) != BSP_ERROR_NONE)
+    {
+        return LOADER_STATUS_FAIL;
+    }
+    return LOADER_STATUS_SUCCESS;
+}
+
+/**
+  * @brief  Checks whether the signature only holds 0x00 and 0xFF bytes, as
+  *         read from an erased memory or from stuck lines, no clock being
+  *         validated with it.
+  * @param  Signature Buffer of CLOCK_SIGNATURE_SIZE + 4 bytes.
+  * @retval 1 when the signature is flat, 0 otherwise.
+  */
+static uint32_t Clock_IsFlat(const uint8_t *Signature)
+{
+    uint32_t i;
+
+    for (i = 0U; i < (CLOCK_SIGNATURE_SIZE + 4U); i++)
+    {
+        if ((Signature[i] != 0x00U) && (Signature[i] != 0xFFU))
+        {
+            return 0U;
+        }
+    }
+    return 1U;
+}
+#endif
+
+/**
+  * @brief  Searches the fastest stable memory clock.
+  * @note   The signature is first read at the BSP clock, then each divider
+  *         from the one of CLOCK_MAX_HZ up to the BSP one reads it back
+  *         CLOCK_PASSES times. The first divider passing is applied, the BSP
+  *         one being kept when none passes or when the signature is flat.
+  *         CLOCK_DIVIDER_PIN is applied as is when set. The result is kept in
+  *         ClockSearch.
+  * @retval None
+  */
+static void Clock_Search(void)
+{
+#if (CLOCK_SEARCH == 1)
+    uint32_t divider;
+    uint32_t pass;
+
+    (void)memset(&ClockSearch, 0, sizeof(ClockSearch));
+    ClockSearch.Magic = CLOCK_MAGIC;
+    ClockSearch.BspDivider = Clock_GetDivider();
+    ClockSearch.Divider = ClockSearch.BspDivider;
+    ClockSearch.Status = CLOCK_BSP_KEPT;
+
+    if (CLOCK_DIVIDER_PIN != 0U)
+    {
+        ClockSearch.Divider = CLOCK_DIVIDER_PIN;
+        ClockSearch.Status = CLOCK_PINNED;
+    }
+    else if ((Clock_ReadSignature(ClockReference) != LOADER_STATUS_SUCCESS) ||
+             (Clock_IsFlat(ClockReference) != 0U))
+    {
+        ClockSearch.Status = CLOCK_NO_SIGNATURE;
+    }
+    else
+    {
+        for (divider = (CLOCK_KERNEL_HZ + CLOCK_MAX_HZ - 1U) / CLOCK_MAX_HZ;
+             divider < ClockSearch.BspDivider; divider++)
+        {
+            Clock_SetDivider(divider);
+            for (pass = 0U; pass < CLOCK_PASSES; pass++)
+            {
+                if ((Clock_ReadSignature(ClockSignature) != LOADER_STATUS_SUCCESS) ||
+                    (memcmp(ClockSignature, ClockReference, sizeof(ClockSignature)) != 0))
+                {
+                    break;
+                }
+            }
+
+            if (pass == CLOCK_PASSES)
+            {
+                ClockSearch.Divider = divider;
+                ClockSearch.Status = CLOCK_SEARCHED;
+                break;
+            }
+            if (divider < 32U)
+            {
+                ClockSearch.FailMap |= 1UL << divider;
+            }
+        }
+    }
+
+    Clock_SetDivider(ClockSearch.Divider);
+    ClockSearch.ClockHz = CLOCK_KERNEL_HZ / ClockSearch.Divider;
+#endif
+}
+
+/**
+  * @brief  Applies the divider found again once the BSP has re-initialized
+  *         the OCTOSPI.
+  * @retval None
+  */
+static void Clock_Apply(void)
+{
+#if (CLOCK_SEARCH == 1)
+    if (ClockSearch.Magic == CLOCK_MAGIC)
+    {
+        Clock_SetDivider(ClockSearch.Divider);
+    }
+#endif
+}
+
+/**
+  * @brief  Checks whether a buffer holds only the erase value (0xFF).
+  * @note   The buffer is scanned word by word once aligned.
+  * @param  buffer Pointer to the data buffer.
+  * @param  Size   The size of data.
+  * @retval 1       Buffer is blank.
+  * @retval 0       Buffer holds data to program.
+  */
+static uint32_t Buffer_IsErased(const uint8_t *buffer, uint32_t Size)
+{
+    while ((Size > 0U) && (((uint32_t)buffer & 0x3U) != 0U))
+    {
+        if (*buffer++ != 0xFFU)
+        {
+            return 0U;
+        }
+        Size--;
+    }
+
+    while (Size >= 4U)
+    {
+        if (*(const uint32_t *)buffer != 0xFFFFFFFFU)
+        {
+            return 0U;
+        }
+        buffer += 4U;
+        Size -= 4U;
+    }
+
+    while (Size > 0U)
+    {
+        if (*buffer++ != 0xFFU)
+        {
+            return 0U;
+        }
+        Size--;
+    }
+
+    return 1U;
+}
+
+/**
+  * @brief  Programs memory, skipping the pages whose data is entirely the erase value.
+  * @note   Consecutive pages holding data are programmed with a single BSP call.
+  * @param  Address The page address.
+  * @param  Size    The size of data to write.
+  * @param  buffer  Pointer to the data buffer.
+  * @retval Loader status.
+  * @retval 1       Operation succeeded.
+  * @retval 0       Operation failed.
+  */
+static uint32_t OSPI_ProgramPages(uint32_t Address, uint32_t Size, uint8_t *buffer)
+{
+    uint32_t run;
+    uint32_t page = 0U;
+    uint32_t start;
+
+    while (Size > 0U)
+    {
+        /* Gather the pages holding data up to the next blank page */
+        run = 0U;
+        while (run < Size)
+        {
+            page = PROGRAM_PAGE_SIZE - ((Address + run) % PROGRAM_PAGE_SIZE);
+            if (page > (Size - run))
+            {
+                page = Size - run;
+            }
+            if (Buffer_IsErased(buffer + run, page) != 0U)
+            {
+                break;
+            }
+            run += page;
+        }
+
+        if (run != 0U)
+        {
+            start = Perf_Cycles();
+            if (trace_bsp(TRACE_BSP_WRITE, Address, run, BSP_OSPI_NOR_Write(0, buffer, Address, run)) != BSP_ERROR_NONE)
+            {
+                return LOADER_STATUS_FAIL;
+            }
+            Perf_Program(Address, run, start);
+        }
+
+        /* Skip the blank page */
+        if (run < Size)
+        {
+            SkippedPages++;
+            run += page;
+        }
+
+        Address += run;
+        buffer += run;
+        Size -= run;
+    }
+
+    return LOADER_STATUS_SUCCESS;
+}
+
+/**
+  * @brief  Checks through memory-mapped mode whether a sector is already erased.
+  * @note   Always reports the sector as not blank when BLANK_CHECK_BEFORE_ERASE is 0,
+  *         or when memory-mapped mode cannot be entered, the erase then
+  *         re-initializing the OSPI interface.
+  * @param  Address The sector address in the memory-mapped region.
+  * @param  Size    The sector size.
+  * @retval 1       Sector is blank.
+  * @retval 0       Sector must be erased.
+  */
+static uint32_t OSPI_SectorIsErased(uint32_t Address, uint32_t Size)
+{
+#if (BLANK_CHECK_BEFORE_ERASE == 1)
+    if (OSPI_EnterMemoryMappedMode() != LOADER_STATUS_SUCCESS)
+    {
+        return 0U;
+    }
+
+    /* The ICACHE has no range invalidation */
+    Cache_Invalidate();
+    return Buffer_IsErased((const uint8_t *)Cache_Address(Address), Size);
+#else
+    return 0U;
+#endif
+}
+
+/**
+  * @brief  Selects the erase command for the block at Address: the fastest per
+  *         byte among the commands aligned on Address that fit in the range.
+  * @param  Address    The block address.
+  * @param  EndAddress The end of the range to erase (excluded).
+  * @retval Erase command.
+  */
+static const erase_unit *OSPI_PlanErase(uint32_t Address, uint32_t EndAddress)
+{
+    const erase_unit *unit = &EraseUnits[ERASE_UNIT_COUNT - 1U];
+    uint32_t i;
+
+    for (i = 0U; i < (ERASE_UNIT_COUNT - 1U); i++)
+    {
+        if (((Address % EraseUnits[i].Size) == 0U) &&
+            ((EndAddress - Address) >= EraseUnits[i].Size) &&
+            ((EraseUnits[i].Time * unit->Size) < (unit->Time * EraseUnits[i].Size)))
+        {
+            unit = &EraseUnits[i];
+        }
+    }
+
+    return unit;
+}
+
+/**
+  * @brief  Starts the DWT cycle counter.
+  * @note   PerfCounters and CommandTrace are cleared unless they already hold
+  *         the previous calls.
+  * @retval None
+  */
+static void Perf_Init(void)
+{
+#if (PERF_COUNTERS == 1) || defined(USE_COMMAND_TRACE) || (STREAM_TIMEOUT_MS != 0U)
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+#endif
+
+#if (PERF_COUNTERS == 1)
+    if (PerfCounters.Magic != PERF_MAGIC)
+    {
+        memset(&PerfCounters, 0, sizeof(PerfCounters));
+        PerfCounters.Magic = PERF_MAGIC;
+    }
+#endif
+
+#ifdef USE_COMMAND_TRACE
+    if (CommandTrace.Magic != TRACE_MAGIC)
+    {
+        memset(&CommandTrace, 0, sizeof(CommandTrace));
+        CommandTrace.Magic = TRACE_MAGIC;
+        CommandTrace.Depth = TRACE_DEPTH;
+    }
+#endif
+}
+
+/**
+  * @brief  Reads the DWT cycle counter.
+  * @retval Cycle count, 0 without PERF_COUNTERS and USE_COMMAND_TRACE.
+  */
+static uint32_t Perf_Cycles(void)
+{
+#if (PERF_COUNTERS == 1) || defined(USE_COMMAND_TRACE)
+    return DWT->CYCCNT;
+#else
+    return 0U;
+#endif
+}
+
+/**
+  * @brief  Counts a call to a loader entry point.
+  * @param  Entry The entry point called.
+  * @param  Size  The bytes handled by the call.
+  * @retval None
+  */
+static void Perf_Count(perf_entry Entry, uint32_t Size)
+{
+#if (PERF_COUNTERS == 1)
+    PerfCounters.Calls[Entry]++;
+    PerfCounters.Bytes[Entry] += Size;
+#endif
+    trace_command(TRACE_OPERATION, (uint32_t)Entry, 0U, Size, 0U);
+}
+
+#ifdef USE_COMMAND_TRACE
+/**
+  * @brief  Logs a record in CommandTrace.
+  * @note   Called at each loader entry point and around the BSP calls.
+  * @param  Kind    TRACE_OPERATION, TRACE_CALL, TRACE_RETURN or TRACE_COMMAND.
+  * @param  Call    The TRACE_BSP of a call, perf_entry of an operation, or
+  *                 TRACE_HAL_ of a command.
+  * @param  Address The memory address of the call.
+  * @param  Size    The bytes of the call or of the operation.
+  * @param  Status  The status the BSP returned.
+  * @retval None
+  */
+static void Trace_Command(uint32_t Kind, uint32_t Call, uint32_t Address, uint32_t Size, uint32_t Status)
+{
+    TRACE_RECORD *record = &CommandTrace.Records[CommandTrace.Head % TRACE_DEPTH];
+
+    record->Cycles = Perf_Cycles();
+    record->Kind = Kind;
+    record->Call = Call;
+    record->Address = Address;
+    record->Size = Size;
+    record->Status = Status;
+    record->Instruction = 0U;
+    record->Modes = 0U;
+    CommandTrace.Head++;
+}
+
+/**
+  * @brief  Logs the return of a BSP call run by trace_bsp.
+  * @param  Call   The TRACE_BSP of the call.
+  * @param  Status The status the BSP returned.
+  * @retval Status
+  */
+static int32_t Trace_Return(uint32_t Call, int32_t Status)
+{
+    Trace_Command(TRACE_RETURN, Call, 0U, 0U, (uint32_t)Status);
+    return Status;
+}
+
+/**
+  * @brief  Logs a command sent to the memory.
+  * @note   Called by the HAL wrappers of loader_trace.h, before the command is
+  *         sent.
+  * @param  Call        The TRACE_HAL_ function sending the command.
+  * @param  Instruction The instruction of the command.
+  * @param  Modes       The TRACE_MODES of the command.
+  * @param  Address     The address of the command.
+  * @param  Size        The bytes of its data phase.
+  * @retval None
+  */
+void Trace_Hal(uint32_t Call, uint32_t Instruction, uint32_t Modes, uint32_t Address, uint32_t Size)
+{
+    TRACE_RECORD *record = &CommandTrace.Records[CommandTrace.Head % TRACE_DEPTH];
+
+    Trace_Command(TRACE_COMMAND, Call, Address, Size, 0U);
+    record->Instruction = Instruction;
+    record->Modes = Modes;
+}
+
+/**
+  * @brief  Logs the status the HAL returned for the last command.
+  * @param  Status The status the HAL returned.
+  * @retval Status
+  */
+uint32_t Trace_HalReturn(uint32_t Status)
+{
+    CommandTrace.Records[(CommandTrace.Head - 1U) % TRACE_DEPTH].Status = Status;
+    return Status;
+}
+#endif
+
+/**
+  * @brief  Adds the cycles elapsed since start to a phase, start being moved to
+  *         the current count.
+  * @note   The 64-bit totals do not wrap with the counter as long as this is
+  *         called once per 2^32 cycles.
+  * @param  Phase The phase the cycles were spent in.
+  * @param  Start The cycle count the phase started at.
+  * @retval None
+  */
+static void Perf_Add(perf_phase Phase, uint32_t *Start)
+{
+#if (PERF_COUNTERS == 1)
+    uint32_t now = DWT->CYCCNT;
+
+    PerfCounters.Cycles[Phase] += now - *Start;
+    *Start = now;
+    /* Init changes the clock the cycles count at */
+    PerfCounters.CoreClock = SystemCoreClock;
+#endif
+}
+
+#if (PERF_COUNTERS == 1)
+/**
+  * @brief  Adds Count operations, lasting Cycles in total, to a timing.
+  * @param  Timing The timing of the operation.
+  * @param  Cycles The cycles of the operations.
+  * @param  Count  The number of operations.
+  * @retval None
+  */
+static void Perf_Sample(perf_timing *Timing, uint32_t Cycles, uint32_t Count)
+{
+    uint32_t average = Cycles / Count;
+
+    if ((Timing->Count == 0U) || (average < Timing->Min))
+    {
+        Timing->Min = average;
+    }
+    if (average > Timing->Max)
+    {
+        Timing->Max = average;
+    }
+    Timing->Count += Count;
+    Timing->Total += Cycles;
+}
+#endif
+
+/**
+  * @brief  Accounts a page program run to the data phase and to tPP.
+  * @note   The BSP waits for the end of each page program before sending the
+  *         next page, so each page is sampled with its data phase.
+  * @param  Address The run start address.
+  * @param  Size    The run size.
+  * @param  Start   The cycle count the run started at.
+  * @retval None
+  */
+static void Perf_Program(uint32_t Address, uint32_t Size, uint32_t Start)
+{
+#if (PERF_COUNTERS == 1)
+    uint32_t cycles = DWT->CYCCNT - Start;
+
+    PerfCounters.Cycles[PERF_PHASE_DATA] += cycles;
+    Perf_Sample(&PerfCounters.PageProgram, cycles,
+                ((Address % PROGRAM_PAGE_SIZE) + Size + PROGRAM_PAGE_SIZE - 1U) / PROGRAM_PAGE_SIZE);
+#endif
+}
+
+/**
+  * @brief  Marks the start of a block erase, sampled as tBE once the memory is
+  *         seen idle again.
+  * @retval Cycle count the erase started at.
+  */
+static uint32_t Perf_EraseStart(void)
+{
+#if (PERF_COUNTERS == 1)
+    PerfEraseStart = DWT->CYCCNT;
+    PerfErasing = 1U;
+    return PerfEraseStart;
+#else
+    return 0U;
+#endif
+}
+
+/**
+  * @brief  Samples tBE when the memory is seen idle after a block erase.
+  * @note   With DEFERRED_COMPLETION, the sample also covers the time until the
+  *         next loader call.
+  * @retval None
+  */
+static void Perf_EraseDone(void)
+{
+#if (PERF_COUNTERS == 1)
+    if (PerfErasing != 0U)
+    {
+        Perf_Sample(&PerfCounters.BlockErase, DWT->CYCCNT - PerfEraseStart, 1U);
+        PerfErasing = 0U;
+    }
+#endif
+}
+
 /**
   * @brief  System Clock Configuration
   *         The system Clock is configured as follows :
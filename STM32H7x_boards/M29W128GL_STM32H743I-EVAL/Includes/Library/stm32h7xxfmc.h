@@ -15,6 +15,22 @@ typedef enum {FAILED = 0, PASSED = !FAILED} TestStatus;
 #define PROGRAM_TIMEOUT               ((uint32_t)0x00004400)  /* NOR program timeout     */
 #define ERASE_TIMEOUT                 ((uint32_t)0x00A00000)  /* NOR erase timeout     */
 
+/* Set to 1 to read each block before erasing it, the blocks already at the
+   erase value being skipped */
+#define BLANK_CHECK_BEFORE_ERASE 0
+
+/* Device size, a SectorErase range covering it being run as a chip erase */
+#define NOR_DEVICE_SIZE 0x01000000
+
+/* Halfwords per write-to-buffer operation, the pages being aligned on it */
+#define NOR_BUFFER_WORDS 32
+
+/* Write-to-buffer command sequence (AMD command set) */
+#define NOR_CMD_UNLOCK_ADDR1    0x0555
+#define NOR_CMD_UNLOCK_ADDR2    0x02AA
+#define NOR_CMD_WRITE_TO_BUFFER 0x0025
+#define NOR_CMD_BUFFER_CONFIRM  0x0029
+
 /* #define NOR_MEMORY_WIDTH            FMC_NORSRAM_MEM_BUS_WIDTH_8  */
 #define NOR_MEMORY_WIDTH               FMC_NORSRAM_MEM_BUS_WIDTH_16
 
@@ -2,10 +2,14 @@
 
 NOR_HandleTypeDef hnor;
 FMC_NORSRAM_TimingTypeDef NOR_Timing;
+uint32_t SkippedWords;
+uint32_t SkippedSectors;
 
 
 int NOR_Init(void)
 { 
+  SkippedWords = 0;
+  SkippedSectors = 0;
 
   hnor.Instance  = FMC_NORSRAM_DEVICE;
   hnor.Extended  = FMC_NORSRAM_EXTENDED_DEVICE;
@@ -134,12 +138,49 @@ int NOR_Init(void)
   
 }
 
+/**
+  * @brief   Checks whether a NOR block only holds the erase value (0xFFFF),
+  *          so that its erase can be skipped.
+  * @param   Address : block address in the FMC bank
+  * @param   Size    : block size
+  * @retval  1      : Block is blank
+  * @retval  0      : Block must be erased
+  */
+static int NOR_BlockIsErased(uint32_t Address, uint32_t Size)
+{
+#if (BLANK_CHECK_BEFORE_ERASE == 1)
+  __IO uint32_t* pData = (__IO uint32_t*)Address;
+
+  HAL_NOR_ReturnToReadMode(&hnor);
+  for(; Size >= 4; Size -= 4)
+  {
+    if(*pData++ != 0xFFFFFFFF)
+      return 0;
+  }
+  SkippedSectors++;
+
+  return 1;
+#else
+  return 0;
+#endif
+}
+
 int Sector_Erase (uint32_t EraseStartAddress ,uint32_t EraseEndAddress)
 {     
   uint32_t BlockAddr;
   EraseStartAddress = EraseStartAddress -  EraseStartAddress%0x20000;
+  /* Range covering the whole device, a single chip erase */
+  if((EraseStartAddress == StartAddresse) &&
+     ((EraseEndAddress - EraseEndAddress%0x20000 + 0x20000) >= (StartAddresse + NOR_DEVICE_SIZE)))
+    return chip_Erase();
   while (EraseEndAddress>=EraseStartAddress)
   {
+    /* Skip the block already erased */
+    if(NOR_BlockIsErased(EraseStartAddress, 0x20000) != 0)
+    {
+      EraseStartAddress+=0x20000;
+      continue;
+    }
     BlockAddr = EraseStartAddress - StartAddresse;
     HAL_NOR_Erase_Block(&hnor, BlockAddr, NOR_BANK_ADDR);
     if(HAL_NOR_GetStatus(&hnor, NOR_BANK_ADDR, ERASE_TIMEOUT) != HAL_NOR_STATUS_SUCCESS)
@@ -149,14 +190,88 @@ int Sector_Erase (uint32_t EraseStartAddress ,uint32_t EraseEndAddress)
   return 1;	
 }
 
+/**
+  * @brief   Programs halfwords lying in a single write buffer page with the
+  *          write-to-buffer command (AMD command set). The sequence is issued
+  *          here as HAL_NOR_ProgramBuffer of this HAL version addresses the
+  *          data with the internal address.
+  * @param   Address    : address in the FMC bank
+  * @param   pData      : pointer to data buffer
+  * @param   uwDataSize : number of halfwords, up to NOR_BUFFER_WORDS
+  * @retval  1      : Operation succeeded
+  * @retval  0      : Operation failed
+  */
+static int NOR_ProgramBuffer(uint32_t Address, uint16_t* pData, uint32_t uwDataSize)
+{
+  uint32_t DataAddr = Address;
+
+  NOR_WRITE(NOR_ADDR_SHIFT(NOR_BANK_ADDR, NOR_MEMORY_16B, NOR_CMD_UNLOCK_ADDR1), 0x00AA);
+  NOR_WRITE(NOR_ADDR_SHIFT(NOR_BANK_ADDR, NOR_MEMORY_16B, NOR_CMD_UNLOCK_ADDR2), 0x0055);
+  NOR_WRITE(Address, NOR_CMD_WRITE_TO_BUFFER);
+  NOR_WRITE(Address, (uint16_t)(uwDataSize - 1));
+  for(; uwDataSize > 0; uwDataSize--)
+  {
+    NOR_WRITE(DataAddr, *pData++);
+    DataAddr += 2;
+  }
+  NOR_WRITE(Address, NOR_CMD_BUFFER_CONFIRM);
+
+  if(HAL_NOR_GetStatus(&hnor, Address, PROGRAM_TIMEOUT) != HAL_NOR_STATUS_SUCCESS)
+    return 0;
+
+  return 1;
+}
+
+/**
+  * @brief   Programs an amount of halfwords with the write-to-buffer command,
+  *          one write buffer page of NOR_BUFFER_WORDS halfwords at a time.
+  *          The halfwords left at the erase value (0xFFFF) at both ends of a
+  *          page are skipped, and so are the pages only holding it.
+  * @param   Address    : address in the FMC bank
+  * @param   pData      : pointer to data buffer
+  * @param   uwDataSize : number of halfwords
+  * @retval  1      : Operation succeeded
+  * @retval  0      : Operation failed
+  */
+static int NOR_WriteData(uint32_t Address, uint16_t* pData, uint32_t uwDataSize)
+{
+  uint32_t run;
+  uint32_t first;
+  uint32_t last;
+
+  while(uwDataSize > 0)
+  {
+    /* Halfwords up to the next write buffer boundary */
+    run = NOR_BUFFER_WORDS - (((Address - NOR_BANK_ADDR) / 2) % NOR_BUFFER_WORDS);
+    if(run > uwDataSize)
+      run = uwDataSize;
+
+    /* Trim the halfwords left at the erase value */
+    first = 0;
+    while((first < run) && (pData[first] == 0xFFFF))
+      first++;
+    last = run;
+    while((last > first) && (pData[last - 1] == 0xFFFF))
+      last--;
+    SkippedWords += run - (last - first);
+
+    if((last != first) && (NOR_ProgramBuffer(Address + 2 * first, pData + first, last - first) == 0))
+      return 0;
+
+    pData += run;
+    Address += 2 * run;
+    uwDataSize -= run;
+  }
+
+  return 1;
+}
+
 int Write_FMC (uint32_t Address, uint32_t Size, uint16_t* Buffer)
 {    
   uint32_t InternalAddr = Address - StartAddresse;
-  uint32_t uwIndex = 0;
   uint32_t WritedData = 0;
   uint32_t Counter = 0;   
   uint16_t TmpBuffer = 0x00000000;
-  uint16_t * writeBuffer ;    
   if (InternalAddr%2 != 0)
   {
     HAL_NOR_ReadBuffer(&hnor, (NOR_BANK_ADDR + InternalAddr - InternalAddr%2),&TmpBuffer, 1);
@@ -175,19 +290,10 @@ int Write_FMC (uint32_t Address, uint32_t Size, uint16_t* Buffer)
        
   if (Size-WritedData >= 2)
   {
-    writeBuffer = (uint16_t*)((uint8_t*)Buffer+WritedData);
-      for (uwIndex = 0; uwIndex < ((Size-WritedData)/2); uwIndex++)
-  {
-    /* Write data to NOR */
-    HAL_NOR_Program(&hnor, (uint32_t *)(NOR_BANK_ADDR +InternalAddr+WritedData + 2*uwIndex), writeBuffer);
-
-    /* Read NOR device status */
-    if(HAL_NOR_GetStatus(&hnor, NOR_BANK_ADDR + InternalAddr+WritedData + 2*uwIndex, PROGRAM_TIMEOUT) != HAL_NOR_STATUS_SUCCESS)
+    if (NOR_WriteData(NOR_BANK_ADDR + InternalAddr + WritedData, (uint16_t*)((uint8_t*)Buffer+WritedData), ((Size-WritedData)/2)) == 0)
     {
       return HAL_NOR_STATUS_ERROR;
     }
-    writeBuffer ++ ;
-  }
     
     WritedData += (((Size-WritedData)/2)*2);
   }
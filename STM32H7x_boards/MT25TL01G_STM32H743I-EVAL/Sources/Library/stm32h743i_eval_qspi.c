@@ -62,6 +62,7 @@
 /* Includes ------------------------------------------------------------------*/
 #include "stm32h743i_eval_qspi.h"
 #include <string.h>
+#include "loader_trace.h"
 /** @addtogroup BSP
   * @{
   */
@@ -61,6 +61,7 @@
 /* Includes ------------------------------------------------------------------*/
 #include "stm32h747i_discovery_qspi.h"
 #include <string.h>
+#include "loader_trace.h"
 
 /** @addtogroup BSP
   * @{
@@ -18,6 +18,7 @@
   */
 /* Includes ------------------------------------------------------------------*/
 #include "mt25tl01g.h"
+#include "loader_trace.h"
 /** @addtogroup BSP
   * @{
   */
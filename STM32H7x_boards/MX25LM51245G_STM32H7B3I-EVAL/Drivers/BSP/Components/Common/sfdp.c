@@ -0,0 +1,440 @@
+/**
+  ******************************************************************************
+  * @file    sfdp.c
+  * @modify  MCD Application Team
+  * @brief   This file provides the JESD216 Serial Flash Discoverable
+  *          Parameters (SFDP) parser.
+  ******************************************************************************
+  * SFDP parser action :
+  *   The parser only walks the SFDP address space through the read function
+  *   of the caller: it does not depend on the interface (SPI, QSPI, OSPI) nor
+  *   on the memory driver.
+  *   It decodes :
+  *     - the basic flash parameter table (BFPT, ID 0xFF00): density, address
+  *       bytes, fast reads, erase types, page size and typical and maximum
+  *       erase and program times,
+  *     - the 4-byte address instruction table (ID 0xFF84): 4-byte address,
+  *       DTR and octal reads and programs,
+  *     - the xSPI profile 1.0 table (ID 0xFF05): 8D-8D-8D reads and programs.
+  *   When the basic table is given in several revisions, the latest one is
+  *   used.
+  *
+  ******************************************************************************
+  * @attention
+  *
+  * <h2><center>&copy; Copyright (c) 2018 STMicroelectronics.
+  * All rights reserved.</center></h2>
+  *
+  * This software component is licensed by ST under BSD 3-Clause license,
+  * the "License"; You may not use this file except in compliance with the
+  * License. You may obtain a copy of the License at:
+  *                        opensource.org/licenses/BSD-3-Clause
+  *
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "sfdp.h"
+
+/** @addtogroup BSP
+  * @{
+  */
+
+/** @addtogroup Components
+  * @{
+  */
+
+/** @defgroup SFDP SFDP
+  * @{
+  */
+
+/** @defgroup SFDP_Private_Constants SFDP Private Constants
+  * @{
+  */
+
+#define SFDP_SIGNATURE           0x50444653U  /* "SFDP", little endian        */
+#define SFDP_HEADER_SIZE         8U
+#define SFDP_MAX_HEADERS         16U          /* Parameter headers walked     */
+
+#define SFDP_ID_BFPT             0xFF00U
+#define SFDP_ID_4BAIT            0xFF84U
+#define SFDP_ID_XSPI_PROFILE_1   0xFF05U
+
+#define SFDP_BFPT_DWORDS         20U          /* JESD216C/D basic table       */
+#define SFDP_BFPT_DWORDS_TIMING  11U          /* JESD216A: erase/program times*/
+#define SFDP_BFPT_DWORDS_OCTAL   17U          /* JESD216C: 1-1-8 and 1-8-8    */
+
+/**
+  * @}
+  */
+
+/** @defgroup SFDP_Private_Functions SFDP Private Functions
+  * @{
+  */
+
+static uint32_t SFDP_Dword(const uint8_t *pData)
+{
+  return (uint32_t)pData[0] | ((uint32_t)pData[1] << 8) |
+         ((uint32_t)pData[2] << 16) | ((uint32_t)pData[3] << 24);
+}
+
+/**
+  * @brief  Decode a fast read field: wait states [4:0], mode clocks [7:5],
+  *         instruction [15:8]
+  * @param  Field 16-bit field of the basic table
+  * @param  pRead fast read to fill
+  * @retval None
+  */
+static void SFDP_DecodeFastRead(uint32_t Field, SFDP_FastRead_t *pRead)
+{
+  pRead->Opcode      = (uint8_t)((Field >> 8) & 0xFFU);
+  pRead->DummyCycles = (uint8_t)((Field & 0x1FU) + ((Field >> 5) & 0x07U));
+}
+
+/**
+  * @brief  Decode a typical erase time: count [4:0], unit [6:5] of 1 ms,
+  *         16 ms, 128 ms or 1 s
+  * @param  Field 7-bit field of the basic table
+  * @retval Time in ms
+  */
+static uint32_t SFDP_EraseTime(uint32_t Field)
+{
+  static const uint32_t Unit[4] = {1U, 16U, 128U, 1000U};
+
+  return ((Field & 0x1FU) + 1U) * Unit[(Field >> 5) & 0x03U];
+}
+
+/**
+  * @brief  Decode the basic flash parameter table
+  * @param  Dword DWORDs of the table, the missing ones at 0
+  * @param  Length Number of DWORDs the table holds
+  * @param  pInfo information to fill
+  * @retval None
+  */
+static void SFDP_DecodeBfpt(const uint32_t *Dword, uint32_t Length, SFDP_Info_t *pInfo)
+{
+  static const uint32_t ChipUnit[4] = {16U, 256U, 4000U, 64000U};
+  uint32_t Exponent;
+  uint32_t Multiplier;
+  uint32_t i;
+
+  /* DWORD 1: address bytes and the 1-1-2, 1-2-2, 1-4-4 and 1-1-4 reads */
+  pInfo->AddressBytes = (Dword[0] >> 17) & 0x03U;
+  pInfo->ReadModes    = SFDP_MODE_1S_1S_1S;
+  pInfo->ProgramModes = SFDP_MODE_1S_1S_1S;
+  if ((Dword[0] & (1UL << 16)) != 0U)
+  {
+    pInfo->ReadModes |= SFDP_MODE_1S_1S_2S;
+    SFDP_DecodeFastRead(Dword[3], &pInfo->FastRead[SFDP_READ_1S_1S_2S]);
+  }
+  if ((Dword[0] & (1UL << 20)) != 0U)
+  {
+    pInfo->ReadModes |= SFDP_MODE_1S_2S_2S;
+    SFDP_DecodeFastRead(Dword[3] >> 16, &pInfo->FastRead[SFDP_READ_1S_2S_2S]);
+  }
+  if ((Dword[0] & (1UL << 21)) != 0U)
+  {
+    pInfo->ReadModes |= SFDP_MODE_1S_4S_4S;
+    SFDP_DecodeFastRead(Dword[2], &pInfo->FastRead[SFDP_READ_1S_4S_4S]);
+  }
+  if ((Dword[0] & (1UL << 22)) != 0U)
+  {
+    pInfo->ReadModes |= SFDP_MODE_1S_1S_4S;
+    SFDP_DecodeFastRead(Dword[2] >> 16, &pInfo->FastRead[SFDP_READ_1S_1S_4S]);
+  }
+
+  /* DWORD 2: density in bits, as N - 1 or as 2^N when bit 31 is set */
+  if ((Dword[1] & 0x80000000U) == 0U)
+  {
+    pInfo->Density = (Dword[1] >> 3) + 1U;
+  }
+  else
+  {
+    Exponent = Dword[1] & 0x7FFFFFFFU;
+    pInfo->Density = ((Exponent < 3U) || (Exponent > 34U)) ? 0xFFFFFFFFU : (1UL << (Exponent - 3U));
+  }
+
+  /* DWORDs 5 to 7: the 2-2-2 and 4-4-4 reads */
+  if ((Dword[4] & (1UL << 0)) != 0U)
+  {
+    pInfo->ReadModes |= SFDP_MODE_2S_2S_2S;
+    SFDP_DecodeFastRead(Dword[5] >> 16, &pInfo->FastRead[SFDP_READ_2S_2S_2S]);
+  }
+  if ((Dword[4] & (1UL << 4)) != 0U)
+  {
+    pInfo->ReadModes |= SFDP_MODE_4S_4S_4S;
+    SFDP_DecodeFastRead(Dword[6] >> 16, &pInfo->FastRead[SFDP_READ_4S_4S_4S]);
+  }
+
+  /* DWORDs 8 and 9: erase types, size exponent [7:0] and instruction [15:8] */
+  for (i = 0; i < SFDP_ERASE_TYPES; i++)
+  {
+    Exponent = (Dword[7U + (i / 2U)] >> ((i % 2U) * 16U)) & 0xFFU;
+    if ((Exponent != 0U) && (Exponent < 32U))
+    {
+      pInfo->Erase[i].Size   = 1UL << Exponent;
+      pInfo->Erase[i].Opcode = (Dword[7U + (i / 2U)] >> (((i % 2U) * 16U) + 8U)) & 0xFFU;
+    }
+  }
+
+  if (Length >= SFDP_BFPT_DWORDS_TIMING)
+  {
+    /* DWORD 10: typical erase times, the maximum is 2 * (multiplier + 1) times longer */
+    Multiplier = 2U * ((Dword[9] & 0x0FU) + 1U);
+    for (i = 0; i < SFDP_ERASE_TYPES; i++)
+    {
+      if (pInfo->Erase[i].Size != 0U)
+      {
+        pInfo->Erase[i].TypicalTime = SFDP_EraseTime(Dword[9] >> (4U + (i * 7U)));
+        pInfo->Erase[i].MaxTime     = pInfo->Erase[i].TypicalTime * Multiplier;
+      }
+    }
+
+    /* DWORD 11: page size, page program and chip erase typical times */
+    Multiplier = 2U * ((Dword[10] & 0x0FU) + 1U);
+    pInfo->PageSize           = 1UL << ((Dword[10] >> 4) & 0x0FU);
+    pInfo->PageProgramTime    = (((Dword[10] >> 8) & 0x1FU) + 1U) *
+                                (((Dword[10] & (1UL << 13)) != 0U) ? 64U : 8U);
+    pInfo->PageProgramMaxTime = pInfo->PageProgramTime * Multiplier;
+    pInfo->ChipEraseTime      = (((Dword[10] >> 24) & 0x1FU) + 1U) *
+                                ChipUnit[(Dword[10] >> 29) & 0x03U];
+    pInfo->ChipEraseMaxTime   = pInfo->ChipEraseTime * Multiplier;
+  }
+
+  if (Length >= SFDP_BFPT_DWORDS_OCTAL)
+  {
+    /* DWORD 17: the 1-1-8 [15:0] and 1-8-8 [31:16] reads, 0 instruction when not supported */
+    if (((Dword[16] >> 8) & 0xFFU) != 0U)
+    {
+      pInfo->ReadModes |= SFDP_MODE_1S_1S_8S;
+    }
+    if (((Dword[16] >> 24) & 0xFFU) != 0U)
+    {
+      pInfo->ReadModes |= SFDP_MODE_1S_8S_8S;
+    }
+  }
+
+  if (Length >= SFDP_BFPT_DWORDS)
+  {
+    /* DWORD 20: maximum 8D-8D-8D speed without [27:24] and with [31:28] data
+       strobe, 0xF when the mode is not supported */
+    if ((((Dword[19] >> 24) & 0x0FU) != 0x0FU) || (((Dword[19] >> 28) & 0x0FU) != 0x0FU))
+    {
+      pInfo->ReadModes    |= SFDP_MODE_8D_8D_8D;
+      pInfo->ProgramModes |= SFDP_MODE_8D_8D_8D;
+    }
+  }
+}
+
+/**
+  * @brief  Decode DWORD 1 of the 4-byte address instruction table
+  * @param  Dword first DWORD of the table
+  * @param  pInfo information to fill
+  * @retval None
+  */
+static void SFDP_Decode4Bait(uint32_t Dword, SFDP_Info_t *pInfo)
+{
+  static const struct
+  {
+    uint8_t  Bit;
+    uint8_t  Program;
+    uint16_t Mode;
+  } Map[] =
+  {
+    { 7U, 1U, SFDP_MODE_1S_1S_4S}, { 8U, 1U, SFDP_MODE_1S_4S_4S},
+    {13U, 0U, SFDP_MODE_1S_1D_1D}, {14U, 0U, SFDP_MODE_1S_2D_2D},
+    {15U, 0U, SFDP_MODE_1S_4D_4D}, {18U, 0U, SFDP_MODE_1S_1S_8S},
+    {19U, 0U, SFDP_MODE_1S_8S_8S}, {20U, 1U, SFDP_MODE_1S_1S_8S},
+    {21U, 1U, SFDP_MODE_1S_8S_8S}
+  };
+  uint32_t i;
+
+  for (i = 0; i < (sizeof(Map) / sizeof(Map[0])); i++)
+  {
+    if ((Dword & (1UL << Map[i].Bit)) != 0U)
+    {
+      if (Map[i].Program != 0U)
+      {
+        pInfo->ProgramModes |= Map[i].Mode;
+      }
+      else
+      {
+        pInfo->ReadModes |= Map[i].Mode;
+      }
+    }
+  }
+}
+
+/**
+  * @brief  Sort the erase types by size, the missing ones last
+  * @param  pInfo information to sort
+  * @retval None
+  */
+static void SFDP_SortErase(SFDP_Info_t *pInfo)
+{
+  SFDP_Erase_t Erase;
+  uint32_t i;
+  uint32_t j;
+
+  for (i = 1; i < SFDP_ERASE_TYPES; i++)
+  {
+    Erase = pInfo->Erase[i];
+    for (j = i; (j > 0U) && (Erase.Size != 0U) &&
+         ((pInfo->Erase[j - 1U].Size == 0U) || (pInfo->Erase[j - 1U].Size > Erase.Size)); j--)
+    {
+      pInfo->Erase[j] = pInfo->Erase[j - 1U];
+    }
+    pInfo->Erase[j] = Erase;
+  }
+}
+
+/**
+  * @}
+  */
+
+/** @defgroup SFDP_Exported_Functions SFDP Exported Functions
+  * @{
+  */
+
+/**
+  * @brief  Read and decode the SFDP tables of the memory
+  * @param  Read function reading the SFDP address space
+  * @param  pInfo information to fill, cleared first
+  * @retval SFDP_OK, or an SFDP_ERROR_x code
+  */
+int32_t SFDP_ReadInfo(SFDP_Read_t Read, SFDP_Info_t *pInfo)
+{
+  uint8_t  Header[SFDP_HEADER_SIZE];
+  uint8_t  Table[SFDP_BFPT_DWORDS * 4U];
+  uint32_t Dword[SFDP_BFPT_DWORDS];
+  uint32_t Headers;
+  uint32_t Id;
+  uint32_t Revision;
+  uint32_t Length;
+  uint32_t Pointer;
+  uint32_t BfptPointer = 0;
+  uint32_t BfptLength = 0;
+  uint32_t BaitPointer = 0;
+  uint32_t XspiModes = 0;
+  uint32_t i;
+  uint8_t *pByte = (uint8_t *)pInfo;
+
+  for (i = 0; i < sizeof(SFDP_Info_t); i++)
+  {
+    pByte[i] = 0;
+  }
+
+  /* SFDP header: signature, revision and number of parameter headers - 1 */
+  if (Read(0, Header, SFDP_HEADER_SIZE) != 0)
+  {
+    return SFDP_ERROR_READ;
+  }
+  if (SFDP_Dword(Header) != SFDP_SIGNATURE)
+  {
+    return SFDP_ERROR_SIGNATURE;
+  }
+  pInfo->Revision = ((uint32_t)Header[5] << 8) | Header[4];
+  Headers = (uint32_t)Header[6] + 1U;
+  if (Headers > SFDP_MAX_HEADERS)
+  {
+    Headers = SFDP_MAX_HEADERS;
+  }
+
+  /* Parameter headers: ID LSB, revision, length in DWORDs, pointer, ID MSB */
+  for (i = 0; i < Headers; i++)
+  {
+    if (Read(SFDP_HEADER_SIZE * (i + 1U), Header, SFDP_HEADER_SIZE) != 0)
+    {
+      return SFDP_ERROR_READ;
+    }
+    Id       = ((uint32_t)Header[7] << 8) | Header[0];
+    Revision = ((uint32_t)Header[2] << 8) | Header[1];
+    Length   = Header[3];
+    Pointer  = SFDP_Dword(&Header[4]) & 0x00FFFFFFU;
+
+    if ((Id == SFDP_ID_BFPT) && (Length >= 9U) &&
+        ((BfptLength == 0U) || (Revision > pInfo->BfptRevision)))
+    {
+      pInfo->BfptRevision = Revision;
+      BfptPointer = Pointer;
+      BfptLength  = Length;
+    }
+    else if ((Id == SFDP_ID_4BAIT) && (Length >= 1U))
+    {
+      BaitPointer = Pointer;
+    }
+    else if (Id == SFDP_ID_XSPI_PROFILE_1)
+    {
+      XspiModes = SFDP_MODE_8D_8D_8D;
+    }
+  }
+
+  if (BfptLength == 0U)
+  {
+    return SFDP_ERROR_NO_BFPT;
+  }
+
+  /* Basic flash parameter table, the DWORDs of later revisions at 0 */
+  Length = (BfptLength < SFDP_BFPT_DWORDS) ? BfptLength : SFDP_BFPT_DWORDS;
+  if (Read(BfptPointer, Table, Length * 4U) != 0)
+  {
+    return SFDP_ERROR_READ;
+  }
+  for (i = 0; i < SFDP_BFPT_DWORDS; i++)
+  {
+    Dword[i] = (i < Length) ? SFDP_Dword(&Table[i * 4U]) : 0U;
+  }
+  SFDP_DecodeBfpt(Dword, Length, pInfo);
+  pInfo->ReadModes    |= XspiModes;
+  pInfo->ProgramModes |= XspiModes;
+
+  /* 4-byte address instruction table */
+  if (BaitPointer != 0U)
+  {
+    if (Read(BaitPointer, Table, 4U) != 0)
+    {
+      return SFDP_ERROR_READ;
+    }
+    SFDP_Decode4Bait(SFDP_Dword(Table), pInfo);
+  }
+
+  SFDP_SortErase(pInfo);
+
+  return SFDP_OK;
+}
+
+/**
+  * @brief  Get the fastest of a set of modes
+  * @param  Modes SFDP_MODE_x bits
+  * @retval SFDP_MODE_x bit of the fastest mode, 0 when none
+  */
+uint32_t SFDP_FastestMode(uint32_t Modes)
+{
+  uint32_t Mode = 0;
+
+  while (Modes != 0U)
+  {
+    Mode  = Modes & (~Modes + 1U);
+    Modes = Modes & ~Mode;
+  }
+
+  return Mode;
+}
+
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+/************************ (C) COPYRIGHT STMicroelectronics *****END OF FILE****/
@@ -715,6 +715,35 @@ int32_t BSP_OSPI_NOR_ReadID(uint32_t Instance, uint8_t *Id)
   return ret;
 }
 
+/**
+  * @brief  Read the Serial Flash Discoverable Parameters (SFDP) of the memory
+  * @param  Instance  OSPI instance
+  * @param  pData     Pointer to data to be read
+  * @param  ReadAddr  Read start address in the SFDP space
+  * @param  Size      Size of data to read
+  * @retval BSP status
+  */
+int32_t BSP_OSPI_NOR_ReadSFDP(uint32_t Instance, uint8_t *pData, uint32_t ReadAddr, uint32_t Size)
+{
+  int32_t ret = BSP_ERROR_NONE;
+
+  /* Check if the instance is supported */
+  if(Instance >= OSPI_NOR_INSTANCES_NUMBER)
+  {
+    ret = BSP_ERROR_WRONG_PARAM;
+  }
+  else
+  {
+    if(MX25LM51245G_ReadSFDP(&hospi_nor[Instance], Ospi_Nor_Ctx[Instance].InterfaceMode, Ospi_Nor_Ctx[Instance].TransferRate, pData, ReadAddr, Size) != MX25LM51245G_OK)
+    {
+      ret = BSP_ERROR_COMPONENT_FAILURE;
+    }
+  }
+
+  /* Return BSP status */
+  return ret;
+}
+
 /**
   * @brief  Set Flash to desired Interface mode. And this instance becomes current instance.
   *         If current instance running at MMP mode then this function doesn't work.
@@ -48,6 +48,7 @@
 
 /* Includes ------------------------------------------------------------------*/
 #include "stm32l4r9i_discovery_ospi_nor.h"
+#include "loader_trace.h"
 
 /** @addtogroup BSP
   * @{
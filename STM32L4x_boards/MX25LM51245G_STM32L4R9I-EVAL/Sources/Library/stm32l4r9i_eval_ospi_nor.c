@@ -66,6 +66,7 @@
 
 /* Includes ------------------------------------------------------------------*/
 #include "stm32l4r9i_eval_ospi_nor.h"
+#include "loader_trace.h"
 
 /** @addtogroup BSP
   * @{
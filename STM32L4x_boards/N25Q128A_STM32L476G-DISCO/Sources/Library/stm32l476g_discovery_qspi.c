@@ -56,6 +56,7 @@
 
 /* Includes ------------------------------------------------------------------*/
 #include "stm32l476g_discovery_qspi.h"
+#include "loader_trace.h"
 
 /** @addtogroup BSP
   * @{
@@ -225,6 +225,7 @@ int32_t BSP_OSPI_NOR_GetInfo                     (uint32_t Instance, BSP_OSPI_NO
 int32_t BSP_OSPI_NOR_EnableMemoryMappedMode      (uint32_t Instance);
 int32_t BSP_OSPI_NOR_DisableMemoryMappedMode     (uint32_t Instance);
 int32_t BSP_OSPI_NOR_ReadID                      (uint32_t Instance, uint8_t *Id);
+int32_t BSP_OSPI_NOR_ReadSFDP                    (uint32_t Instance, uint8_t *pData, uint32_t ReadAddr, uint32_t Size);
 int32_t BSP_OSPI_NOR_ConfigFlash                 (uint32_t Instance, BSP_OSPI_NOR_Interface_t Mode, BSP_OSPI_NOR_Transfer_t Rate);
 int32_t BSP_OSPI_NOR_SuspendErase                (uint32_t Instance);
 int32_t BSP_OSPI_NOR_ResumeErase                 (uint32_t Instance);
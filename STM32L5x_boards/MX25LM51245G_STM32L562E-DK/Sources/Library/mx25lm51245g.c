@@ -37,6 +37,7 @@
 
 /* Includes ------------------------------------------------------------------*/
 #include "mx25lm51245g.h"
+#include "loader_trace.h"
 
 /** @addtogroup BSP
   * @{
@@ -1275,6 +1276,61 @@ int32_t MX25LM51245G_ReadID(OSPI_HandleTypeDef *Ctx, MX25LM51245G_Interface_t Mo
   return MX25LM51245G_OK;
 }
 
+/**
+  * @brief  Read the Serial Flash Discoverable Parameters (SFDP).
+  *         SPI/OPI; 1-1-1/8-8-8
+  * @param  Ctx Component object pointer
+  * @param  Mode Interface mode
+  * @param  Rate Transfer rate STR or DTR
+  * @param  pData Pointer to data to be read
+  * @param  ReadAddr Read start address in the SFDP space
+  * @param  Size Size of data to read in Byte
+  * @retval error status
+  */
+int32_t MX25LM51245G_ReadSFDP(OSPI_HandleTypeDef *Ctx, MX25LM51245G_Interface_t Mode, MX25LM51245G_Transfer_t Rate, uint8_t *pData, uint32_t ReadAddr, uint32_t Size)
+{
+  OSPI_RegularCmdTypeDef s_command = {0};
+
+  /* SPI mode and DTR transfer not supported by memory */
+  if ((Mode == MX25LM51245G_SPI_MODE) && (Rate == MX25LM51245G_DTR_TRANSFER))
+  {
+    return MX25LM51245G_ERROR;
+  }
+
+  /* Initialize the read SFDP command */
+  s_command.OperationType      = HAL_OSPI_OPTYPE_COMMON_CFG;
+  s_command.FlashId            = HAL_OSPI_FLASH_ID_1;
+  s_command.InstructionMode    = (Mode == MX25LM51245G_SPI_MODE) ? HAL_OSPI_INSTRUCTION_1_LINE : HAL_OSPI_INSTRUCTION_8_LINES;
+  s_command.InstructionDtrMode = (Rate == MX25LM51245G_DTR_TRANSFER) ? HAL_OSPI_INSTRUCTION_DTR_ENABLE : HAL_OSPI_INSTRUCTION_DTR_DISABLE;
+  s_command.InstructionSize    = (Mode == MX25LM51245G_SPI_MODE) ? HAL_OSPI_INSTRUCTION_8_BITS : HAL_OSPI_INSTRUCTION_16_BITS;
+  s_command.Instruction        = (Mode == MX25LM51245G_SPI_MODE) ? MX25LM51245G_READ_SERIAL_FLASH_DISCO_PARAM_CMD : MX25LM51245G_OCTA_READ_SERIAL_FLASH_DISCO_PARAM_CMD;
+  s_command.AddressMode        = (Mode == MX25LM51245G_SPI_MODE) ? HAL_OSPI_ADDRESS_1_LINE : HAL_OSPI_ADDRESS_8_LINES;
+  s_command.AddressDtrMode     = (Rate == MX25LM51245G_DTR_TRANSFER) ? HAL_OSPI_ADDRESS_DTR_ENABLE : HAL_OSPI_ADDRESS_DTR_DISABLE;
+  s_command.AddressSize        = (Mode == MX25LM51245G_SPI_MODE) ? HAL_OSPI_ADDRESS_24_BITS : HAL_OSPI_ADDRESS_32_BITS;
+  s_command.Address            = ReadAddr;
+  s_command.AlternateBytesMode = HAL_OSPI_ALTERNATE_BYTES_NONE;
+  s_command.DataMode           = (Mode == MX25LM51245G_SPI_MODE) ? HAL_OSPI_DATA_1_LINE : HAL_OSPI_DATA_8_LINES;
+  s_command.DataDtrMode        = (Rate == MX25LM51245G_DTR_TRANSFER) ? HAL_OSPI_DATA_DTR_ENABLE : HAL_OSPI_DATA_DTR_DISABLE;
+  s_command.DummyCycles        = (Mode == MX25LM51245G_SPI_MODE) ? MX25LM51245G_DUMMY_CYCLES_SFDP : MX25LM51245G_DUMMY_CYCLES_SFDP_OCTAL;
+  s_command.NbData             = Size;
+  s_command.DQSMode            = (Rate == MX25LM51245G_DTR_TRANSFER) ? HAL_OSPI_DQS_ENABLE : HAL_OSPI_DQS_DISABLE;
+  s_command.SIOOMode           = HAL_OSPI_SIOO_INST_EVERY_CMD;
+
+  /* Configure the command */
+  if (HAL_OSPI_Command(Ctx, &s_command, HAL_OSPI_TIMEOUT_DEFAULT_VALUE) != HAL_OK)
+  {
+    return MX25LM51245G_ERROR;
+  }
+
+  /* Reception of the data */
+  if (HAL_OSPI_Receive(Ctx, pData, HAL_OSPI_TIMEOUT_DEFAULT_VALUE) != HAL_OK)
+  {
+    return MX25LM51245G_ERROR;
+  }
+
+  return MX25LM51245G_OK;
+}
+
 /* Reset Commands *************************************************************/
 /**
   * @brief  Flash reset enable command
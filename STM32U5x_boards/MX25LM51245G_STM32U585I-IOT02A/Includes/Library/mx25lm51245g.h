@@ -66,6 +66,12 @@
 
 #define MX25LM51245G_AUTOPOLLING_INTERVAL_TIME    0x10U
 
+/**
+  * @brief  MX25LM51245G SFDP read configuration, fixed by the memory
+  */
+#define MX25LM51245G_DUMMY_CYCLES_SFDP            8U
+#define MX25LM51245G_DUMMY_CYCLES_SFDP_OCTAL      20U
+
 /**
   * @brief  MX25LM51245G Error codes
   */
@@ -343,6 +349,7 @@ int32_t MX25LM51245G_ReadSecurityRegister(OSPI_HandleTypeDef *Ctx, MX25LM51245G_
 
 /* ID/Security Commands *******************************************************/
 int32_t MX25LM51245G_ReadID(OSPI_HandleTypeDef *Ctx, MX25LM51245G_Interface_t Mode, MX25LM51245G_Transfer_t Rate, uint8_t *ID);
+int32_t MX25LM51245G_ReadSFDP(OSPI_HandleTypeDef *Ctx, MX25LM51245G_Interface_t Mode, MX25LM51245G_Transfer_t Rate, uint8_t *pData, uint32_t ReadAddr, uint32_t Size);
 
 /* Reset Commands *************************************************************/
 int32_t MX25LM51245G_ResetEnable(OSPI_HandleTypeDef *Ctx, MX25LM51245G_Interface_t Mode, MX25LM51245G_Transfer_t Rate);
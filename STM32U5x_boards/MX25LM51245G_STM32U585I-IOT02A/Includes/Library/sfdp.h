@@ -0,0 +1,167 @@
+/**
+  ******************************************************************************
+  * @file    sfdp.h
+  * @modify  MCD Application Team
+  * @brief   This file contains the description of the JESD216 Serial Flash
+  *          Discoverable Parameters (SFDP) parser.
+  ******************************************************************************
+  * @attention
+  *
+  * <h2><center>&copy; Copyright (c) 2018 STMicroelectronics.
+  * All rights reserved.</center></h2>
+  *
+  * This software component is licensed by ST under BSD 3-Clause license,
+  * the "License"; You may not use this file except in compliance with the
+  * License. You may obtain a copy of the License at:
+  *                        opensource.org/licenses/BSD-3-Clause
+  *
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef SFDP_H
+#define SFDP_H
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdint.h>
+
+/** @addtogroup BSP
+  * @{
+  */
+
+/** @addtogroup Components
+  * @{
+  */
+
+/** @addtogroup SFDP
+  * @{
+  */
+
+/** @defgroup SFDP_Exported_Constants SFDP Exported Constants
+  * @{
+  */
+
+/* SFDP parser error codes */
+#define SFDP_OK                  ( 0)
+#define SFDP_ERROR_READ          (-1)   /*!< Read function failed            */
+#define SFDP_ERROR_SIGNATURE     (-2)   /*!< No "SFDP" signature at address 0 */
+#define SFDP_ERROR_NO_BFPT       (-3)   /*!< No basic flash parameter table   */
+
+/* Read and program modes, instruction-address-data lines (S: single transfer
+   rate, D: double transfer rate), the modes moving more data per clock on
+   higher bits */
+#define SFDP_MODE_1S_1S_1S       0x0001U
+#define SFDP_MODE_1S_1S_2S       0x0002U
+#define SFDP_MODE_1S_2S_2S       0x0004U
+#define SFDP_MODE_2S_2S_2S       0x0008U
+#define SFDP_MODE_1S_1D_1D       0x0010U
+#define SFDP_MODE_1S_1S_4S       0x0020U
+#define SFDP_MODE_1S_4S_4S       0x0040U
+#define SFDP_MODE_4S_4S_4S       0x0080U
+#define SFDP_MODE_1S_2D_2D       0x0100U
+#define SFDP_MODE_1S_1S_8S       0x0200U
+#define SFDP_MODE_1S_8S_8S       0x0400U
+#define SFDP_MODE_1S_4D_4D       0x0800U
+#define SFDP_MODE_8D_8D_8D       0x1000U
+
+/* SFDP_Info_t.AddressBytes values, BFPT DWORD 1 bits 18:17 */
+#define SFDP_ADDRESS_3           0U     /*!< 3-byte addresses only            */
+#define SFDP_ADDRESS_3_OR_4      1U     /*!< 3-byte, 4-byte once entered      */
+#define SFDP_ADDRESS_4           2U     /*!< 4-byte addresses only            */
+
+/* Fast reads of the basic flash parameter table, SFDP_Info_t.FastRead index */
+#define SFDP_READ_1S_1S_2S       0U
+#define SFDP_READ_1S_2S_2S       1U
+#define SFDP_READ_2S_2S_2S       2U
+#define SFDP_READ_1S_1S_4S       3U
+#define SFDP_READ_1S_4S_4S       4U
+#define SFDP_READ_4S_4S_4S       5U
+#define SFDP_READ_COUNT          6U
+
+/* Erase types of the basic flash parameter table */
+#define SFDP_ERASE_TYPES         4U
+
+/**
+  * @}
+  */
+
+/** @defgroup SFDP_Exported_Types SFDP Exported Types
+  * @{
+  */
+
+/**
+  * @brief Reads Size bytes of the SFDP address space from ReadAddr, returns 0
+  *        on success
+  */
+typedef int32_t (*SFDP_Read_t)(uint32_t ReadAddr, uint8_t *pData, uint32_t Size);
+
+typedef struct
+{
+  uint8_t  Opcode;              /*!< Read instruction, 0 when not supported    */
+  uint8_t  DummyCycles;         /*!< Wait states plus mode clocks              */
+  uint16_t Reserved;
+} SFDP_FastRead_t;
+
+typedef struct
+{
+  uint32_t Size;                /*!< Erased size in bytes, 0 when not present  */
+  uint32_t Opcode;              /*!< Erase instruction                         */
+  uint32_t TypicalTime;         /*!< Typical erase time in ms, 0 when unknown  */
+  uint32_t MaxTime;             /*!< Maximum erase time in ms, 0 when unknown  */
+} SFDP_Erase_t;
+
+typedef struct
+{
+  uint32_t Revision;            /*!< SFDP revision, major << 8 | minor         */
+  uint32_t BfptRevision;        /*!< Basic table revision, major << 8 | minor  */
+  uint32_t Density;             /*!< Memory size in bytes                      */
+  uint32_t PageSize;            /*!< Page size in bytes, 0 when not given      */
+  uint32_t AddressBytes;        /*!< SFDP_ADDRESS_x                            */
+  uint32_t ReadModes;           /*!< SFDP_MODE_x bits of the supported reads   */
+  uint32_t ProgramModes;        /*!< SFDP_MODE_x bits of the supported programs*/
+  SFDP_FastRead_t FastRead[SFDP_READ_COUNT]; /*!< Fast reads, SFDP_READ_x     */
+  SFDP_Erase_t Erase[SFDP_ERASE_TYPES];      /*!< Erase types, smallest first */
+  uint32_t PageProgramTime;     /*!< Typical page program time in us, or 0     */
+  uint32_t PageProgramMaxTime;  /*!< Maximum page program time in us, or 0     */
+  uint32_t ChipEraseTime;       /*!< Typical chip erase time in ms, or 0       */
+  uint32_t ChipEraseMaxTime;    /*!< Maximum chip erase time in ms, or 0       */
+} SFDP_Info_t;
+
+/**
+  * @}
+  */
+
+/** @defgroup SFDP_Exported_Functions SFDP Exported Functions
+  * @{
+  */
+
+int32_t  SFDP_ReadInfo(SFDP_Read_t Read, SFDP_Info_t *pInfo);
+uint32_t SFDP_FastestMode(uint32_t Modes);
+
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SFDP_H */
+
+/************************ (C) COPYRIGHT STMicroelectronics *****END OF FILE****/
@@ -0,0 +1,89 @@
+/**
+  ******************************************************************************
+  * @file    emu.h
+  * @brief   Cortex-M emulator running the prebuilt loaders (.stldr) on the
+  *          host. emu_cpu.c executes the Thumb-2 instructions of the ARMv7-M
+  *          and ARMv7E-M profiles, with the single and double precision
+  *          instructions of the FPU, and counts the instructions and the
+  *          core cycles they take. emu_bus.c maps the RAM, the peripherals
+  *          of the device, the QUADSPI or OCTOSPI and the external memory
+  *          answering its commands.
+  ******************************************************************************
+  */
+
+#ifndef EMU_H
+#define EMU_H
+
+#include <stdint.h>
+
+/* Return address given to the entry points: the call ends when the loader
+   branches to it */
+#define EMU_RETURN  0xFFFFFFF0U
+
+/* Devices of the bus models, chosen from the HAL the loader is built with */
+typedef enum
+{
+  EMU_STM32F4 = 0,
+  EMU_STM32L4,
+  EMU_STM32H7,
+  EMU_DEVICE_COUNT
+} EMU_DEVICE;
+
+/* Core state and counts */
+typedef struct
+{
+  uint32_t R[16];          /* R15 is the address of the next instruction  */
+  uint32_t N, Z, C, V, Q;  /* APSR flags, 0 or 1                           */
+  uint32_t GE;             /* APSR.GE bits of the SIMD instructions        */
+  uint32_t ITState;        /* IT block condition and mask                  */
+  uint32_t PRIMASK;
+  uint32_t BASEPRI;
+  uint32_t FAULTMASK;
+  uint32_t CONTROL;
+  uint32_t S[32];          /* FPU registers, D<n> being S<2n+1>:S<2n>      */
+  uint32_t FPSCR;
+  uint64_t Instructions;   /* Instructions run, skipped ones included      */
+  uint64_t Cycles;         /* Core cycles of the instructions run          */
+} EMU_CPU;
+
+extern EMU_CPU Cpu;
+
+/* Runs from Cpu.R[15] until the return to EMU_RETURN, for at most Limit
+   instructions. Returns 0 on the return, and -1 on a fault or when the
+   limit is reached, Emu_Error() telling why */
+int Emu_Run(uint64_t Limit);
+
+/* Stops the emulation on an error of the loader or of the emulator */
+void Emu_Fault(const char* Format, ...);
+const char* Emu_Error(void);
+
+/* Bus --------------------------------------------------------------------------*/
+/* Counts of the external memory model */
+typedef struct
+{
+  uint64_t Commands;       /* Commands sent to the memory                  */
+  uint64_t Polls;          /* Status polls of the interface               */
+  uint64_t Programs;       /* Page programs                                */
+  uint64_t Erases;         /* Block and chip erases                        */
+  uint64_t MappedReads;    /* Bus reads of the memory-mapped window        */
+  uint32_t Errors;         /* Sequences that would fail on the board       */
+} EMU_MEMORY_STATS;
+
+extern EMU_MEMORY_STATS MemoryStats;
+
+/* Maps the RAM, the peripherals of Device with its QUADSPI, or its OCTOSPIs
+   when Octo is set, and the external memory of Size bytes at Base, which
+   answers Id to its read ID commands */
+void Bus_Init(EMU_DEVICE Device, int Octo, uint32_t Base, uint32_t Size, const uint8_t Id[3]);
+
+/* External memory content, writable out of the loader calls */
+uint8_t* Bus_Memory(void);
+
+/* Host pointer to Size bytes of RAM at Address, NULL out of the RAM */
+uint8_t* Bus_Ram(uint32_t Address, uint32_t Size);
+
+/* Bus accesses of the core, Size being 1, 2 or 4 bytes */
+uint32_t Bus_Read(uint32_t Address, uint32_t Size);
+void Bus_Write(uint32_t Address, uint32_t Value, uint32_t Size);
+
+#endif /* EMU_H */
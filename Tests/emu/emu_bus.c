@@ -0,0 +1,889 @@
+/**
+  ******************************************************************************
+  * @file    emu_bus.c
+  * @brief   Bus of the emulator: the RAM the loaders run from, the
+  *          peripherals, and the QUADSPI or OCTOSPI with the external
+  *          memory behind it.
+  *
+  *          The peripheral registers read back what was written, and the
+  *          ready and status bits the HAL waits for follow the enable bits
+  *          they report (RCC oscillators and clock switch, PWR regulator).
+  *          The QUADSPI and OCTOSPI start a command on the register write
+  *          the reference manuals give: the first data written when it
+  *          sends data, else the address when it has one, or else the
+  *          instruction. The memory answers as a serial NOR
+  *          flash which is never busy: a program or an erase completes at
+  *          once, but needs the write enable latch, as on the device.
+  ******************************************************************************
+  */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "emu.h"
+
+EMU_MEMORY_STATS MemoryStats;
+
+/* RAM -------------------------------------------------------------------------*/
+typedef struct
+{
+  uint32_t Base;
+  uint32_t Size;
+  uint8_t* Data;
+} RAM_REGION;
+
+static RAM_REGION Rams[] =
+{
+  {0x00000000U, 0x00010000U, NULL},   /* ITCM                                  */
+  {0x10000000U, 0x00010000U, NULL},   /* CCM of the STM32F4, SRAM2 of the L4   */
+  {0x20000000U, 0x00080000U, NULL},   /* SRAM, DTCM of the STM32H7             */
+  {0x24000000U, 0x00100000U, NULL},   /* AXI SRAM                              */
+  {0x30000000U, 0x00048000U, NULL},   /* AHB SRAM of the STM32H7               */
+  {0x38000000U, 0x00010000U, NULL},   /* SRD SRAM of the STM32H7               */
+};
+
+#define RAM_COUNT  (sizeof(Rams) / sizeof(Rams[0]))
+
+uint8_t* Bus_Ram(uint32_t Address, uint32_t Size)
+{
+  uint32_t i;
+
+  for(i = 0U; i < RAM_COUNT; i++)
+  {
+    if((Address >= Rams[i].Base) && (Address - Rams[i].Base < Rams[i].Size) &&
+       (Size <= Rams[i].Size - (Address - Rams[i].Base)))
+      return Rams[i].Data + (Address - Rams[i].Base);
+  }
+  return NULL;
+}
+
+/* Peripheral registers --------------------------------------------------------*/
+/* Sparse store of the registers, by open addressing */
+#define REGISTER_SLOTS  8192U
+
+typedef struct
+{
+  uint32_t Address;
+  uint32_t Value;
+  uint32_t Used;
+} REGISTER_SLOT;
+
+static REGISTER_SLOT Registers[REGISTER_SLOTS];
+
+static REGISTER_SLOT* Register_Find(uint32_t Address)
+{
+  uint32_t i = ((Address >> 2) * 2654435761U) % REGISTER_SLOTS;
+
+  while(Registers[i].Used && (Registers[i].Address != Address))
+    i = (i + 1U) % REGISTER_SLOTS;
+  if(!Registers[i].Used)
+  {
+    Registers[i].Used = 1U;
+    Registers[i].Address = Address;
+    Registers[i].Value = 0U;
+  }
+  return &Registers[i];
+}
+
+/* Bits of a register the hardware sets from other bits on a read: the
+   Source bits are copied Shift bits higher, and the Set bits are always
+   set */
+typedef struct
+{
+  uint32_t Address;
+  uint32_t Source;
+  uint32_t Shift;
+  uint32_t Set;
+} RULE;
+
+typedef struct
+{
+  uint32_t Address;
+  uint32_t Value;
+} RESET_VALUE;
+
+static const RULE F4Rules[] =
+{
+  {0x40023800U, 0x15010001U, 1U, 0U},          /* RCC_CR: HSI, HSE, PLL, PLLI2S and PLLSAI ready */
+  {0x40023808U, 0x00000003U, 2U, 0U},          /* RCC_CFGR: SWS follows SW                      */
+  {0x40023870U, 0x00000001U, 1U, 0U},          /* RCC_BDCR: LSE ready                           */
+  {0x40023874U, 0x00000001U, 1U, 0U},          /* RCC_CSR: LSI ready                            */
+  {0x40007004U, 0U, 0U, 0x00034000U},          /* PWR_CSR: VOS, over-drive and its switch ready */
+  {0U, 0U, 0U, 0U}
+};
+
+static const RULE L4Rules[] =
+{
+  {0x40021000U, 0x15010001U, 1U, 0U},          /* RCC_CR: MSI, HSE, PLL, PLLSAI1, PLLSAI2 ready */
+  {0x40021000U, 0x00000100U, 2U, 0U},          /* RCC_CR: HSI16 ready                           */
+  {0x40021008U, 0x00000003U, 2U, 0U},          /* RCC_CFGR: SWS follows SW                      */
+  {0x40021090U, 0x00000001U, 1U, 0U},          /* RCC_BDCR: LSE ready                           */
+  {0x40021094U, 0x00000001U, 1U, 0U},          /* RCC_CSR: LSI ready                            */
+  {0x40021098U, 0x00000001U, 1U, 0U},          /* RCC_CRRCR: HSI48 ready                        */
+  {0U, 0U, 0U, 0U}
+};
+
+static const RULE H7Rules[] =
+{
+  {0x58024400U, 0x15011080U, 1U, 0x0000C000U}, /* RCC_CR: CSI, HSI48, HSE, PLL1-3 ready, D1 and D2 clocks */
+  {0x58024400U, 0x00000001U, 2U, 0U},          /* RCC_CR: HSI ready                             */
+  {0x58024410U, 0x00000007U, 3U, 0U},          /* RCC_CFGR: SWS follows SW                      */
+  {0x58024470U, 0x00000001U, 1U, 0U},          /* RCC_BDCR: LSE ready                           */
+  {0x58024474U, 0x00000001U, 1U, 0U},          /* RCC_CSR: LSI ready                            */
+  {0x58024804U, 0U, 0U, 0x00002000U},          /* PWR_CSR1: ACTVOS ready                        */
+  {0x58024818U, 0U, 0U, 0x00002000U},          /* PWR_D3CR, PWR_SRDCR: VOS ready                */
+  {0U, 0U, 0U, 0U}
+};
+
+static const RESET_VALUE F4Resets[] = {{0x40023800U, 0x00000083U}, {0U, 0U}};
+static const RESET_VALUE L4Resets[] = {{0x40021000U, 0x00000063U}, {0U, 0U}};
+static const RESET_VALUE H7Resets[] = {{0x58024400U, 0x00000025U}, {0x5802480CU, 0x00000046U}, {0U, 0U}};
+
+static const RULE* Rules;
+
+static uint32_t Register_Read(uint32_t Address)
+{
+  uint32_t Value = Register_Find(Address)->Value;
+  const RULE* Rule;
+
+  for(Rule = Rules; Rule->Address != 0U; Rule++)
+  {
+    if(Rule->Address == Address)
+      Value = (Value & ~(Rule->Source << Rule->Shift)) | ((Value & Rule->Source) << Rule->Shift) | Rule->Set;
+  }
+  return Value;
+}
+
+/* External memory -------------------------------------------------------------*/
+static uint8_t* Memory;
+static uint32_t MemorySize;
+static uint8_t MemoryId[3];
+static int WriteEnabled;
+static uint8_t StatusRegister;
+static uint8_t ConfigurationRegister[2]; /* Macronix configuration registers   */
+static uint8_t Registers8[256];          /* Configuration registers by read opcode */
+static uint8_t Registers2[256];          /* Configuration register 2 by address    */
+static uint8_t Warned[256];
+
+uint8_t* Bus_Memory(void)
+{
+  return Memory;
+}
+
+/* Configuration registers: the opcode writing each one and the opcode
+   reading it back */
+static const uint8_t RegisterPairs[][2] =
+{
+  {0x81U, 0x85U},  /* Volatile configuration register                         */
+  {0xB1U, 0xB5U},  /* Nonvolatile configuration register                      */
+  {0x61U, 0x65U},  /* Enhanced volatile configuration register                */
+  {0xC5U, 0xC8U},  /* Extended address register                               */
+  {0x31U, 0x35U},  /* Status register 2                                       */
+};
+
+static int IsRead(uint8_t Opcode)
+{
+  static const uint8_t Reads[] = {0x03U, 0x13U, 0x0BU, 0x0CU, 0x3BU, 0x3CU, 0x6BU, 0x6CU, 0xBBU, 0xBCU,
+                                  0xEBU, 0xECU, 0xEEU, 0x0DU, 0xEDU};
+
+  return (memchr(Reads, Opcode, sizeof(Reads)) != NULL);
+}
+
+static int IsProgram(uint8_t Opcode)
+{
+  static const uint8_t Programs[] = {0x02U, 0x12U, 0x32U, 0x34U, 0x38U, 0x3EU};
+
+  return (memchr(Programs, Opcode, sizeof(Programs)) != NULL);
+}
+
+static uint32_t EraseSize(uint8_t Opcode)
+{
+  switch(Opcode)
+  {
+  case 0x20U: case 0x21U: return 0x1000U;
+  case 0x52U: case 0x5CU: return 0x8000U;
+  case 0xD8U: case 0xDCU: return 0x10000U;
+  case 0x60U: case 0xC7U: case 0xC4U: return MemorySize;
+  default: return 0U;
+  }
+}
+
+static void Memory_Error(const char* Message, uint8_t Opcode, uint32_t Address)
+{
+  MemoryStats.Errors++;
+  if(!Warned[Opcode])
+  {
+    fprintf(stderr, "warning: 0x%02X at 0x%08X: %s\n", (unsigned)Opcode, (unsigned)Address, Message);
+    Warned[Opcode] = 1U;
+  }
+}
+
+/* Command of the memory: Data receives the Size bytes read, or holds the
+   Size bytes written when Write is set. HasData is clear for the commands
+   without a data phase */
+static void Memory_Command(uint8_t Opcode, int HasAddress, uint32_t Address, int HasData, int Write,
+                           uint8_t* Data, uint32_t Size)
+{
+  uint32_t Erase = EraseSize(Opcode);
+  uint32_t i;
+
+  MemoryStats.Commands++;
+  if(HasData && !Write && IsRead(Opcode))
+  {
+    for(i = 0U; i < Size; i++)
+      Data[i] = Memory[(Address + i) % MemorySize];
+    return;
+  }
+  if(HasData && Write && HasAddress && IsProgram(Opcode))
+  {
+    if(!WriteEnabled)
+    {
+      Memory_Error("program without write enable", Opcode, Address);
+      return;
+    }
+    for(i = 0U; i < Size; i++)
+      Memory[((Address & ~0xFFU) | ((Address + i) & 0xFFU)) % MemorySize] &= Data[i];
+    MemoryStats.Programs++;
+    WriteEnabled = 0;
+    return;
+  }
+  if(!HasData && (Erase != 0U))
+  {
+    if(!WriteEnabled)
+    {
+      Memory_Error("erase without write enable", Opcode, Address);
+      return;
+    }
+    if(Erase == MemorySize)
+      Address = 0U;
+    Address = (Address % MemorySize) & ~(Erase - 1U);
+    memset(Memory + Address, 0xFF, Erase);
+    MemoryStats.Erases++;
+    WriteEnabled = 0;
+    return;
+  }
+  switch(Opcode)
+  {
+  case 0x05U:
+    /* Status register: never busy */
+    for(i = 0U; i < Size; i++)
+      Data[i] = (uint8_t)((StatusRegister & ~3U) | (WriteEnabled ? 2U : 0U));
+    return;
+  case 0x70U:
+    /* Flag status register: ready */
+    for(i = 0U; i < Size; i++)
+      Data[i] = 0x80U;
+    return;
+  case 0x9FU: case 0x9EU: case 0xAFU:
+    for(i = 0U; i < Size; i++)
+      Data[i] = (i < 3U) ? MemoryId[i] : 0U;
+    return;
+  case 0x15U:
+    for(i = 0U; i < Size; i++)
+      Data[i] = ConfigurationRegister[i % 2U];
+    return;
+  case 0x01U:
+    /* Status register, followed by the configuration registers */
+    if(!WriteEnabled)
+      Memory_Error("write status without write enable", Opcode, Address);
+    else if(Write)
+    {
+      for(i = 0U; (i < Size) && (i < 3U); i++)
+      {
+        if(i == 0U)
+          StatusRegister = Data[0];
+        else
+          ConfigurationRegister[i - 1U] = Data[i];
+      }
+    }
+    WriteEnabled = 0;
+    return;
+  case 0x72U:
+    if(!WriteEnabled)
+      Memory_Error("write configuration register 2 without write enable", Opcode, Address);
+    else if(Write && (Size > 0U))
+      Registers2[Address & 0xFFU] = Data[0];
+    WriteEnabled = 0;
+    return;
+  case 0x71U:
+    for(i = 0U; i < Size; i++)
+      Data[i] = Registers2[Address & 0xFFU];
+    return;
+  case 0x06U:
+    WriteEnabled = 1;
+    return;
+  case 0x04U:
+    WriteEnabled = 0;
+    return;
+  case 0x2BU:
+    /* Security register: no program or erase failure */
+    memset(Data, 0, Size);
+    return;
+  case 0x5AU:
+    /* SFDP: not provided */
+    memset(Data, 0xFF, Size);
+    return;
+  case 0x66U: case 0x99U: case 0xB7U: case 0xE9U: case 0xB9U: case 0xABU: case 0x75U: case 0x7AU:
+  case 0x35U: case 0x38U: case 0xF5U:
+    if(!HasData)
+      return;
+    break;
+  default:
+    break;
+  }
+  for(i = 0U; i < sizeof(RegisterPairs) / sizeof(RegisterPairs[0]); i++)
+  {
+    if(Opcode == RegisterPairs[i][0])
+    {
+      if(Write && (Size > 0U))
+        Registers8[RegisterPairs[i][1]] = Data[0];
+      return;
+    }
+    if(Opcode == RegisterPairs[i][1])
+    {
+      memset(Data, Registers8[Opcode], Size);
+      return;
+    }
+  }
+  Memory_Error("unknown command", Opcode, Address);
+  if(!Write)
+    memset(Data, 0, Size);
+}
+
+/* QUADSPI and OCTOSPI ---------------------------------------------------------*/
+typedef struct
+{
+  int Octo;                /* OCTOSPI register map                     */
+  uint32_t Base;           /* Registers                                */
+  uint32_t Window;         /* Memory-mapped window                     */
+  uint32_t ResetRegister;  /* RCC reset register and bit               */
+  uint32_t ResetBit;
+  uint32_t Reg[0x200];     /* Registers by word offset                 */
+  uint32_t Flags;          /* TEF, TCF, SMF and TOF                    */
+  int Armed;               /* An instruction was written (OCTOSPI)     */
+  int Collecting;          /* Indirect write waiting for its data      */
+  uint8_t Opcode;
+  int HasAddress;
+  uint32_t Address;
+  uint8_t Buffer[0x10000];
+  uint32_t Count;          /* Bytes of Buffer written or read          */
+  uint32_t Length;         /* Bytes of the data phase                  */
+  int Reading;             /* Indirect read data left in Buffer        */
+  int Mapped;              /* Memory-mapped mode running               */
+  int HasMemory;           /* The memory is the one of this interface  */
+} INTERFACE;
+
+static INTERFACE Interfaces[2];
+static uint32_t InterfaceCount;
+static uint32_t InterfaceSize;
+
+#define SR_TEF    0x01U
+#define SR_TCF    0x02U
+#define SR_FTF    0x04U
+#define SR_SMF    0x08U
+#define SR_BUSY   0x20U
+
+/* Register offsets of each map */
+#define QSPI_CR   0x00U
+#define QSPI_SR   0x08U
+#define QSPI_FCR  0x0CU
+#define QSPI_DLR  0x10U
+#define QSPI_CCR  0x14U
+#define QSPI_AR   0x18U
+#define QSPI_DR   0x20U
+#define QSPI_MASK 0x24U
+#define QSPI_MATCH 0x28U
+
+#define OSPI_CR   0x000U
+#define OSPI_SR   0x020U
+#define OSPI_FCR  0x024U
+#define OSPI_DLR  0x040U
+#define OSPI_AR   0x048U
+#define OSPI_DR   0x050U
+#define OSPI_MASK 0x080U
+#define OSPI_MATCH 0x088U
+#define OSPI_CCR  0x100U
+#define OSPI_IR   0x110U
+
+#define REG(If, Offset)  ((If)->Reg[(Offset) / 4U])
+
+static uint32_t Interface_Mode(const INTERFACE* If)
+{
+  return If->Octo ? (REG(If, OSPI_CR) >> 28) & 3U : (REG(If, QSPI_CCR) >> 26) & 3U;
+}
+
+static uint32_t Interface_AddressMode(const INTERFACE* If)
+{
+  return If->Octo ? (REG(If, OSPI_CCR) >> 8) & 7U : (REG(If, QSPI_CCR) >> 10) & 3U;
+}
+
+static uint32_t Interface_DataMode(const INTERFACE* If)
+{
+  return If->Octo ? (REG(If, OSPI_CCR) >> 24) & 7U : (REG(If, QSPI_CCR) >> 24) & 3U;
+}
+
+static uint8_t Interface_Opcode(const INTERFACE* If)
+{
+  uint32_t Instruction;
+
+  if(!If->Octo)
+    return (uint8_t)REG(If, QSPI_CCR);
+  /* A 16-bit instruction is the opcode followed by its inverted value */
+  Instruction = REG(If, OSPI_IR);
+  return (uint8_t)((((REG(If, OSPI_CCR) >> 4) & 3U) == 1U) ? Instruction >> 8 : Instruction);
+}
+
+/* Indirect write with data, which starts on the first data written */
+static int Interface_Sends(const INTERFACE* If)
+{
+  return (Interface_Mode(If) == 0U) && (Interface_DataMode(If) != 0U);
+}
+
+static void Interface_Reset(INTERFACE* If)
+{
+  memset(If->Reg, 0, sizeof(If->Reg));
+  If->Flags = 0U;
+  If->Armed = 0;
+  If->Collecting = 0;
+  If->Reading = 0;
+  If->Mapped = 0;
+  If->Count = 0U;
+}
+
+static uint32_t Interface_Status(const INTERFACE* If)
+{
+  uint32_t Status = If->Flags;
+  uint32_t Level = 0U;
+
+  /* The FIFO of an indirect write has room for its data */
+  if(If->Collecting)
+    Status |= SR_FTF | SR_BUSY;
+  else if(Interface_Sends(If))
+    Status |= SR_FTF;
+  if(If->Reading)
+  {
+    Level = If->Length - If->Count;
+    Status |= SR_FTF | SR_BUSY;
+  }
+  if(If->Mapped)
+    Status |= SR_BUSY;
+  return Status | (((Level > 32U) ? 32U : Level) << 8);
+}
+
+static uint32_t Interface_Length(const INTERFACE* If)
+{
+  uint32_t Length = REG(If, If->Octo ? OSPI_DLR : QSPI_DLR) + 1U;
+
+  if(Length > sizeof(If->Buffer))
+  {
+    Emu_Fault("data phase of %u bytes", (unsigned)Length);
+    return 0U;
+  }
+  return Length;
+}
+
+/* Runs the command configured, from its instruction, address or first
+   data write */
+static void Interface_Start(INTERFACE* If)
+{
+  uint32_t Mode = Interface_Mode(If);
+  uint32_t Status, Mask, Match, i;
+  int HasData = (Interface_DataMode(If) != 0U);
+
+  If->Armed = 0;
+  If->Collecting = 0;
+  If->Reading = 0;
+  If->Opcode = Interface_Opcode(If);
+  If->HasAddress = (Interface_AddressMode(If) != 0U);
+  If->Address = If->HasAddress ? REG(If, If->Octo ? OSPI_AR : QSPI_AR) : 0U;
+  If->Count = 0U;
+  If->Length = HasData ? Interface_Length(If) : 0U;
+  if(!If->HasMemory)
+  {
+    Emu_Fault("command 0x%02X to the interface at 0x%08X, with no memory", (unsigned)If->Opcode,
+              (unsigned)If->Base);
+    return;
+  }
+  switch(Mode)
+  {
+  case 0U:
+    if(HasData)
+    {
+      If->Collecting = 1;
+      return;
+    }
+    Memory_Command(If->Opcode, If->HasAddress, If->Address, 0, 1, If->Buffer, 0U);
+    If->Flags |= SR_TCF;
+    break;
+  case 1U:
+    Memory_Command(If->Opcode, If->HasAddress, If->Address, HasData, 0, If->Buffer, If->Length);
+    MemoryStats.Polls += (If->Opcode == 0x05U) || (If->Opcode == 0x70U);
+    If->Reading = (If->Length != 0U);
+    If->Flags |= SR_TCF;
+    break;
+  case 2U:
+    /* Automatic polling: the memory never being busy, the status matches
+       at the first read or never */
+    Memory_Command(If->Opcode, If->HasAddress, If->Address, 1, 0, If->Buffer, (If->Length > 4U) ? 4U : If->Length);
+    MemoryStats.Polls++;
+    Status = 0U;
+    for(i = 0U; (i < If->Length) && (i < 4U); i++)
+      Status |= (uint32_t)If->Buffer[i] << (8U * i);
+    Mask = REG(If, If->Octo ? OSPI_MASK : QSPI_MASK);
+    Match = REG(If, If->Octo ? OSPI_MATCH : QSPI_MATCH);
+    if(((REG(If, If->Octo ? OSPI_CR : QSPI_CR) >> 23) & 1U) != 0U)
+      i = ((~(Status ^ Match) & Mask) != 0U);
+    else
+      i = (((Status ^ Match) & Mask) == 0U);
+    if(!i)
+    {
+      Emu_Fault("polling 0x%02X never matches: status 0x%X, mask 0x%X, match 0x%X", (unsigned)If->Opcode,
+                (unsigned)Status, (unsigned)Mask, (unsigned)Match);
+      return;
+    }
+    If->Flags |= SR_SMF | SR_TCF;
+    break;
+  default:
+    break;
+  }
+}
+
+static void Interface_WriteData(INTERFACE* If, uint32_t Value, uint32_t Size)
+{
+  uint32_t i;
+
+  if(!If->Collecting)
+  {
+    if(!Interface_Sends(If))
+    {
+      Emu_Fault("data written out of an indirect write");
+      return;
+    }
+    Interface_Start(If);
+  }
+  for(i = 0U; (i < Size) && (If->Count < If->Length); i++)
+    If->Buffer[If->Count++] = (uint8_t)(Value >> (8U * i));
+  if(If->Count == If->Length)
+  {
+    If->Collecting = 0;
+    Memory_Command(If->Opcode, If->HasAddress, If->Address, 1, 1, If->Buffer, If->Length);
+    If->Flags |= SR_TCF;
+  }
+}
+
+static uint32_t Interface_ReadData(INTERFACE* If, uint32_t Size)
+{
+  uint32_t Value = 0U;
+  uint32_t i;
+
+  if(!If->Reading)
+  {
+    Emu_Fault("data read out of an indirect read");
+    return 0U;
+  }
+  for(i = 0U; (i < Size) && (If->Count < If->Length); i++)
+    Value |= (uint32_t)If->Buffer[If->Count++] << (8U * i);
+  if(If->Count == If->Length)
+    If->Reading = 0;
+  return Value;
+}
+
+static uint32_t Interface_Read(INTERFACE* If, uint32_t Offset, uint32_t Size)
+{
+  if(Offset == (If->Octo ? OSPI_SR : QSPI_SR))
+    return Interface_Status(If);
+  if(Offset == (If->Octo ? OSPI_DR : QSPI_DR))
+    return Interface_ReadData(If, Size);
+  return REG(If, Offset);
+}
+
+static void Interface_Write(INTERFACE* If, uint32_t Offset, uint32_t Value)
+{
+  uint32_t Previous = REG(If, Offset);
+  uint32_t Mode;
+
+  if(Offset == (If->Octo ? OSPI_FCR : QSPI_FCR))
+  {
+    If->Flags &= ~(Value & 0x1BU);
+    return;
+  }
+  if(Offset == (If->Octo ? OSPI_SR : QSPI_SR))
+    return;
+  REG(If, Offset) = Value;
+  if(Offset == (If->Octo ? OSPI_CR : QSPI_CR))
+  {
+    if((Value & 2U) != 0U)
+    {
+      /* ABORT: back to the indirect write mode */
+      REG(If, Offset) = Value & ~2U;
+      If->Mapped = 0;
+      If->Collecting = 0;
+      If->Reading = 0;
+      If->Armed = 0;
+      If->Flags |= SR_TCF;
+    }
+    else if(If->Octo && ((((Previous ^ Value) >> 28) & 3U) != 0U))
+    {
+      If->Collecting = 0;
+      If->Reading = 0;
+      If->Mapped = (Interface_Mode(If) == 3U);
+    }
+    return;
+  }
+  if(If->Octo)
+  {
+    /* The OCTOSPI starts on its instruction, or on its address */
+    if(Offset == OSPI_IR)
+    {
+      If->Armed = 1;
+      If->Collecting = 0;
+      if((Interface_AddressMode(If) == 0U) && !Interface_Sends(If))
+        Interface_Start(If);
+    }
+    else if((Offset == OSPI_AR) && (If->Armed || (Interface_Mode(If) != 0U)) &&
+            (Interface_AddressMode(If) != 0U) && !Interface_Sends(If))
+      Interface_Start(If);
+    else if(Offset == OSPI_DR)
+      Interface_WriteData(If, Value, 4U);
+    return;
+  }
+  if(Offset == QSPI_CCR)
+  {
+    If->Collecting = 0;
+    If->Reading = 0;
+    Mode = (Value >> 26) & 3U;
+    If->Mapped = (Mode == 3U);
+    If->Armed = (Mode != 3U);
+    if((Mode != 3U) && (Interface_AddressMode(If) == 0U) && !Interface_Sends(If))
+      Interface_Start(If);
+  }
+  else if((Offset == QSPI_AR) && If->Armed && (Interface_AddressMode(If) != 0U) && !Interface_Sends(If))
+    Interface_Start(If);
+  else if(Offset == QSPI_DR)
+    Interface_WriteData(If, Value, 4U);
+}
+
+static INTERFACE* Interface_Of(uint32_t Address)
+{
+  uint32_t i;
+
+  for(i = 0U; i < InterfaceCount; i++)
+  {
+    if((Address >= Interfaces[i].Base) && (Address - Interfaces[i].Base < InterfaceSize))
+      return &Interfaces[i];
+  }
+  return NULL;
+}
+
+static INTERFACE* Interface_OfWindow(uint32_t Address)
+{
+  uint32_t i;
+
+  for(i = 0U; i < InterfaceCount; i++)
+  {
+    if((Address >= Interfaces[i].Window) && (Address - Interfaces[i].Window < 0x10000000U))
+      return &Interfaces[i];
+  }
+  return NULL;
+}
+
+static void Interface_Add(int Octo, uint32_t Base, uint32_t Window, uint32_t ResetRegister, uint32_t ResetBit)
+{
+  INTERFACE* If = &Interfaces[InterfaceCount++];
+
+  If->Octo = Octo;
+  If->Base = Base;
+  If->Window = Window;
+  If->ResetRegister = ResetRegister;
+  If->ResetBit = ResetBit;
+  Interface_Reset(If);
+}
+
+/* Bus -------------------------------------------------------------------------*/
+void Bus_Init(EMU_DEVICE Device, int Octo, uint32_t Base, uint32_t Size, const uint8_t Id[3])
+{
+  const RESET_VALUE* Reset;
+  uint32_t i;
+
+  for(i = 0U; i < RAM_COUNT; i++)
+  {
+    free(Rams[i].Data);
+    Rams[i].Data = calloc(Rams[i].Size, 1U);
+  }
+  memset(Registers, 0, sizeof(Registers));
+  memset(&MemoryStats, 0, sizeof(MemoryStats));
+  memset(Registers8, 0, sizeof(Registers8));
+  memset(Registers2, 0, sizeof(Registers2));
+  memset(Warned, 0, sizeof(Warned));
+  Registers8[0x85U] = 0xFBU;
+  Registers8[0x65U] = 0xDFU;
+  Registers8[0xB5U] = 0xFFU;
+  StatusRegister = 0U;
+  memset(ConfigurationRegister, 0, sizeof(ConfigurationRegister));
+  WriteEnabled = 0;
+
+  InterfaceCount = 0U;
+  switch(Device)
+  {
+  case EMU_STM32F4:
+    Rules = F4Rules;
+    Reset = F4Resets;
+    InterfaceSize = 0x400U;
+    Interface_Add(0, 0xA0001000U, 0x90000000U, 0x40023818U, 1U << 1);
+    break;
+  case EMU_STM32L4:
+    Rules = L4Rules;
+    Reset = L4Resets;
+    InterfaceSize = 0x400U;
+    if(Octo)
+    {
+      Interface_Add(1, 0xA0001000U, 0x90000000U, 0x40021030U, 1U << 8);
+      Interface_Add(1, 0xA0001400U, 0x70000000U, 0x40021030U, 1U << 9);
+    }
+    else
+      Interface_Add(0, 0xA0001000U, 0x90000000U, 0x40021030U, 1U << 8);
+    break;
+  default:
+    Rules = H7Rules;
+    Reset = H7Resets;
+    InterfaceSize = 0x800U;
+    Interface_Add(Octo, 0x52005000U, 0x90000000U, 0x5802447CU, 1U << 14);
+    if(Octo)
+      Interface_Add(1, 0x5200A000U, 0x70000000U, 0x5802447CU, 1U << 19);
+    break;
+  }
+  for(; Reset->Address != 0U; Reset++)
+    Register_Find(Reset->Address)->Value = Reset->Value;
+
+  free(Memory);
+  Memory = NULL;
+  MemorySize = Size;
+  memcpy(MemoryId, Id, sizeof(MemoryId));
+  for(i = 0U; i < InterfaceCount; i++)
+    Interfaces[i].HasMemory = (Interfaces[i].Window == Base);
+  Memory = malloc(Size);
+}
+
+static void Bus_Error(const char* Access, uint32_t Address)
+{
+  Emu_Fault("bus error: %s at 0x%08X", Access, (unsigned)Address);
+}
+
+static int IsRegister(uint32_t Address)
+{
+  return ((Address >= 0x40000000U) && (Address < 0x60000000U)) ||
+         ((Address >= 0xA0000000U) && (Address < 0xC0000000U)) ||
+         ((Address >= 0xE0000000U) && (Address < 0xE0100000U)) ||
+         ((Address >= 0x08000000U) && (Address < 0x08200000U)) ||
+         ((Address >= 0x1FF00000U) && (Address < 0x20000000U));
+}
+
+/* Word of the bit-band region of a bit-band alias address, and its bit */
+static int BitBand(uint32_t Address, uint32_t* Word, uint32_t* Bit)
+{
+  uint32_t Offset;
+
+  if((Address >= 0x22000000U) && (Address < 0x24000000U))
+    Offset = Address - 0x22000000U;
+  else if((Address >= 0x42000000U) && (Address < 0x44000000U))
+    Offset = Address - 0x42000000U;
+  else
+    return 0;
+  *Word = (Address & 0xF0000000U) + ((Offset >> 5) & ~3U);
+  *Bit = (Offset >> 2) & 31U;
+  return 1;
+}
+
+uint32_t Bus_Read(uint32_t Address, uint32_t Size)
+{
+  uint8_t* Ram = Bus_Ram(Address, Size);
+  INTERFACE* If;
+  uint32_t Value = 0U;
+  uint32_t Word, Bit, i;
+
+  if(Ram != NULL)
+  {
+    for(i = 0U; i < Size; i++)
+      Value |= (uint32_t)Ram[i] << (8U * i);
+    return Value;
+  }
+  if(BitBand(Address, &Word, &Bit))
+    return (Bus_Read(Word, 4U) >> Bit) & 1U;
+  if((If = Interface_Of(Address)) != NULL)
+    return Interface_Read(If, (Address - If->Base) & ~3U, Size) >> (8U * (Address & 3U));
+  if((If = Interface_OfWindow(Address)) != NULL)
+  {
+    if(!If->HasMemory || (Address - If->Window >= MemorySize) || (Interface_Mode(If) != 3U))
+    {
+      Bus_Error("read of the memory window out of the memory-mapped mode", Address);
+      return 0U;
+    }
+    /* An access after an abort starts the memory-mapped mode again */
+    If->Mapped = 1;
+    MemoryStats.MappedReads++;
+    for(i = 0U; i < Size; i++)
+      Value |= (uint32_t)Memory[(Address - If->Window + i) % MemorySize] << (8U * i);
+    return Value;
+  }
+  if(Address == 0xE0001004U)
+    return (uint32_t)Cpu.Cycles;
+  if(IsRegister(Address))
+  {
+    Value = Register_Read(Address & ~3U) >> (8U * (Address & 3U));
+    return (Size == 4U) ? Value : Value & ((1U << (8U * Size)) - 1U);
+  }
+  Bus_Error("read", Address);
+  return 0U;
+}
+
+void Bus_Write(uint32_t Address, uint32_t Value, uint32_t Size)
+{
+  uint8_t* Ram = Bus_Ram(Address, Size);
+  REGISTER_SLOT* Slot;
+  INTERFACE* If;
+  uint32_t Mask, Shift, Word, Bit, i;
+
+  if(Ram != NULL)
+  {
+    for(i = 0U; i < Size; i++)
+      Ram[i] = (uint8_t)(Value >> (8U * i));
+    return;
+  }
+  if(BitBand(Address, &Word, &Bit))
+  {
+    Bus_Write(Word, (Bus_Read(Word, 4U) & ~(1U << Bit)) | ((Value & 1U) << Bit), 4U);
+    return;
+  }
+  if((If = Interface_Of(Address)) != NULL)
+  {
+    /* Byte and halfword writes of the data register are as many bytes
+       pushed to the FIFO */
+    if(((Address - If->Base) & ~3U) == (If->Octo ? OSPI_DR : QSPI_DR))
+    {
+      Interface_WriteData(If, Value, Size);
+      return;
+    }
+    if(Size != 4U)
+    {
+      Shift = 8U * (Address & 3U);
+      Mask = ((1U << (8U * Size)) - 1U) << Shift;
+      Value = (REG(If, (Address - If->Base) & ~3U) & ~Mask) | ((Value << Shift) & Mask);
+    }
+    Interface_Write(If, (Address - If->Base) & ~3U, Value);
+    return;
+  }
+  if(!IsRegister(Address))
+  {
+    Bus_Error("write", Address);
+    return;
+  }
+  Slot = Register_Find(Address & ~3U);
+  Shift = 8U * (Address & 3U);
+  Mask = (Size == 4U) ? 0xFFFFFFFFU : ((1U << (8U * Size)) - 1U) << Shift;
+  Slot->Value = (Slot->Value & ~Mask) | ((Value << Shift) & Mask);
+  for(i = 0U; i < InterfaceCount; i++)
+  {
+    if(((Address & ~3U) == Interfaces[i].ResetRegister) && ((Slot->Value & Interfaces[i].ResetBit) != 0U))
+      Interface_Reset(&Interfaces[i]);
+  }
+}
@@ -0,0 +1,1714 @@
+/**
+  ******************************************************************************
+  * @file    emu_cpu.c
+  * @brief   Thumb-2 core of the emulator: the instructions of the ARMv7-M
+  *          and ARMv7E-M profiles the compilers emit for the loaders, and
+  *          the single and double precision instructions of the FPU.
+  *          Exceptions are not emulated: an SVC, a BKPT, an undefined
+  *          instruction or a bus error stops the emulation.
+  *
+  *          The cycles follow the instruction timings of the Cortex-M4
+  *          technical reference manual, with no wait state: a taken branch
+  *          costs EMU_REFILL cycles on top of its own, a load or store 2
+  *          cycles, or 1 when it follows another one, a load or store
+  *          multiple 1 cycle per register plus 1, a division 2 to 12 cycles
+  *          depending on its operands, and VDIV and VSQRT 14 cycles. The
+  *          same timings are used for the Cortex-M7 loaders, whose dual
+  *          issue is not modeled.
+  ******************************************************************************
+  */
+
+#include <math.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include "emu.h"
+
+/* Pipeline refill cycles of a taken branch (P of the technical reference
+   manual, 1 to 3 depending on the target) */
+#define EMU_REFILL  2U
+
+#define ALIGN4(Address)  ((Address) & ~3U)
+
+EMU_CPU Cpu;
+
+static uint32_t Pc;             /* Address of the instruction being run     */
+static uint32_t NextPc;         /* Address of the next one                  */
+static uint32_t Cost;           /* Cycles of the instruction being run      */
+static int InIT;                /* The instruction is in an IT block        */
+static int LoadStore;           /* The instruction is a single load/store   */
+static int LastLoadStore;       /* The previous one was                     */
+static int Stopped;
+static char Message[256];
+static char Error[300];
+
+void Emu_Fault(const char* Format, ...)
+{
+  va_list Args;
+
+  if(Stopped)
+    return;
+  va_start(Args, Format);
+  vsnprintf(Message, sizeof(Message), Format, Args);
+  va_end(Args);
+  snprintf(Error, sizeof(Error), "0x%08X: %s", (unsigned)Pc, Message);
+  Stopped = 1;
+}
+
+const char* Emu_Error(void)
+{
+  return Error;
+}
+
+/* Helpers ---------------------------------------------------------------------*/
+static void Undefined(uint32_t hw1, uint32_t hw2, int Wide)
+{
+  if(Wide)
+    Emu_Fault("undefined instruction 0x%04X 0x%04X", (unsigned)hw1, (unsigned)hw2);
+  else
+    Emu_Fault("undefined instruction 0x%04X", (unsigned)hw1);
+}
+
+/* Register read, PC reading as the instruction address plus 4 */
+static uint32_t Reg(uint32_t n)
+{
+  return (n == 15U) ? Pc + 4U : Cpu.R[n];
+}
+
+static void Branch(uint32_t Address)
+{
+  NextPc = Address & ~1U;
+  Cost += EMU_REFILL;
+}
+
+/* BX, BLX, POP and LDR to PC: the target must be Thumb code */
+static void BranchExchange(uint32_t Address)
+{
+  if((Address & 1U) == 0U)
+    Emu_Fault("branch to the ARM state at 0x%08X", (unsigned)Address);
+  Branch(Address);
+}
+
+static uint32_t Load(uint32_t Address, uint32_t Size)
+{
+  return Bus_Read(Address, Size);
+}
+
+static void Store(uint32_t Address, uint32_t Value, uint32_t Size)
+{
+  Bus_Write(Address, Value, Size);
+}
+
+static void SetNZ(uint32_t Result)
+{
+  Cpu.N = Result >> 31;
+  Cpu.Z = (Result == 0U);
+}
+
+static uint32_t AddWithCarry(uint32_t x, uint32_t y, uint32_t Carry, uint32_t* CarryOut, uint32_t* Overflow)
+{
+  uint64_t Unsigned = (uint64_t)x + y + Carry;
+  int64_t Signed = (int64_t)(int32_t)x + (int32_t)y + Carry;
+  uint32_t Result = (uint32_t)Unsigned;
+
+  *CarryOut = (uint32_t)(Unsigned >> 32) & 1U;
+  *Overflow = ((int64_t)(int32_t)Result != Signed);
+  return Result;
+}
+
+static uint32_t Ror(uint32_t Value, uint32_t Amount)
+{
+  Amount &= 31U;
+  return (Amount == 0U) ? Value : (Value >> Amount) | (Value << (32U - Amount));
+}
+
+enum { SHIFT_LSL = 0, SHIFT_LSR, SHIFT_ASR, SHIFT_ROR, SHIFT_RRX };
+
+static uint32_t Shift_C(uint32_t Value, uint32_t Type, uint32_t Amount, uint32_t CarryIn, uint32_t* CarryOut)
+{
+  *CarryOut = CarryIn;
+  if(Type == SHIFT_RRX)
+  {
+    *CarryOut = Value & 1U;
+    return (CarryIn << 31) | (Value >> 1);
+  }
+  if(Amount == 0U)
+    return Value;
+  switch(Type)
+  {
+  case SHIFT_LSL:
+    *CarryOut = (Amount <= 32U) ? (uint32_t)(((uint64_t)Value << Amount) >> 32) & 1U : 0U;
+    return (Amount < 32U) ? Value << Amount : 0U;
+  case SHIFT_LSR:
+    *CarryOut = (Amount <= 32U) ? (Value >> (Amount - 1U)) & 1U : 0U;
+    return (Amount < 32U) ? Value >> Amount : 0U;
+  case SHIFT_ASR:
+    if(Amount >= 32U)
+    {
+      *CarryOut = Value >> 31;
+      return (uint32_t)((int32_t)Value >> 31);
+    }
+    *CarryOut = (Value >> (Amount - 1U)) & 1U;
+    return (uint32_t)((int32_t)Value >> Amount);
+  default:
+    Value = Ror(Value, Amount);
+    *CarryOut = Value >> 31;
+    return Value;
+  }
+}
+
+static uint32_t Shift(uint32_t Value, uint32_t Type, uint32_t Amount)
+{
+  uint32_t Carry;
+
+  return Shift_C(Value, Type, Amount, Cpu.C, &Carry);
+}
+
+/* Shift type and amount of the imm5 field of an instruction */
+static void DecodeImmShift(uint32_t Type, uint32_t Imm5, uint32_t* ShiftType, uint32_t* Amount)
+{
+  *ShiftType = Type;
+  *Amount = Imm5;
+  if((Type == SHIFT_LSR) || (Type == SHIFT_ASR))
+    *Amount = (Imm5 == 0U) ? 32U : Imm5;
+  else if((Type == SHIFT_ROR) && (Imm5 == 0U))
+  {
+    *ShiftType = SHIFT_RRX;
+    *Amount = 1U;
+  }
+}
+
+static uint32_t ThumbExpandImm_C(uint32_t Imm12, uint32_t CarryIn, uint32_t* CarryOut)
+{
+  uint32_t Imm8 = Imm12 & 0xFFU;
+  uint32_t Value;
+
+  *CarryOut = CarryIn;
+  if((Imm12 >> 10) == 0U)
+  {
+    switch((Imm12 >> 8) & 3U)
+    {
+    case 0U: return Imm8;
+    case 1U: return (Imm8 << 16) | Imm8;
+    case 2U: return (Imm8 << 24) | (Imm8 << 8);
+    default: return Imm8 * 0x01010101U;
+    }
+  }
+  Value = Ror(0x80U | (Imm12 & 0x7FU), Imm12 >> 7);
+  *CarryOut = Value >> 31;
+  return Value;
+}
+
+static int ConditionPassed(uint32_t Cond)
+{
+  int Result;
+
+  switch(Cond >> 1)
+  {
+  case 0: Result = (Cpu.Z != 0U); break;
+  case 1: Result = (Cpu.C != 0U); break;
+  case 2: Result = (Cpu.N != 0U); break;
+  case 3: Result = (Cpu.V != 0U); break;
+  case 4: Result = (Cpu.C != 0U) && (Cpu.Z == 0U); break;
+  case 5: Result = (Cpu.N == Cpu.V); break;
+  case 6: Result = (Cpu.N == Cpu.V) && (Cpu.Z == 0U); break;
+  default: return 1;
+  }
+  return ((Cond & 1U) != 0U) ? !Result : Result;
+}
+
+static uint32_t SignExtend(uint32_t Value, uint32_t Bits)
+{
+  uint32_t Sign = 1U << (Bits - 1U);
+
+  return (Value ^ Sign) - Sign;
+}
+
+static uint32_t BitCount(uint32_t Value)
+{
+  return (uint32_t)__builtin_popcount(Value);
+}
+
+/* Signed saturation of Value to Bits bits, Q being set when it saturates */
+static uint32_t SignedSat(int64_t Value, uint32_t Bits)
+{
+  int64_t Max = ((int64_t)1 << (Bits - 1U)) - 1;
+  int64_t Min = -((int64_t)1 << (Bits - 1U));
+
+  if(Value > Max) { Cpu.Q = 1U; return (uint32_t)Max; }
+  if(Value < Min) { Cpu.Q = 1U; return (uint32_t)Min; }
+  return (uint32_t)Value;
+}
+
+static uint32_t UnsignedSat(int64_t Value, uint32_t Bits)
+{
+  int64_t Max = ((int64_t)1 << Bits) - 1;
+
+  if(Value > Max) { Cpu.Q = 1U; return (uint32_t)Max; }
+  if(Value < 0) { Cpu.Q = 1U; return 0U; }
+  return (uint32_t)Value;
+}
+
+/* Loads and stores ------------------------------------------------------------*/
+static void LoadMultiple(uint32_t Rn, uint32_t List, int WriteBack, int Decrement)
+{
+  uint32_t Count = BitCount(List);
+  uint32_t Address = Decrement ? Cpu.R[Rn] - 4U * Count : Cpu.R[Rn];
+  uint32_t Base = Cpu.R[Rn];
+  uint32_t i;
+
+  for(i = 0U; i < 15U; i++)
+  {
+    if((List & (1U << i)) != 0U)
+    {
+      Cpu.R[i] = Load(Address, 4U);
+      Address += 4U;
+    }
+  }
+  if(WriteBack && ((List & (1U << Rn)) == 0U))
+    Cpu.R[Rn] = Decrement ? Base - 4U * Count : Base + 4U * Count;
+  if((List & 0x8000U) != 0U)
+    BranchExchange(Load(Address, 4U));
+  Cost += Count;
+}
+
+static void StoreMultiple(uint32_t Rn, uint32_t List, int WriteBack, int Decrement)
+{
+  uint32_t Count = BitCount(List);
+  uint32_t Address = Decrement ? Cpu.R[Rn] - 4U * Count : Cpu.R[Rn];
+  uint32_t i;
+
+  for(i = 0U; i < 15U; i++)
+  {
+    if((List & (1U << i)) != 0U)
+    {
+      Store(Address, Cpu.R[i], 4U);
+      Address += 4U;
+    }
+  }
+  if(WriteBack)
+    Cpu.R[Rn] = Decrement ? Cpu.R[Rn] - 4U * Count : Cpu.R[Rn] + 4U * Count;
+  Cost += Count;
+}
+
+/* Single load or store: Size of 1, 2 or 4 bytes, sign extended when
+   Signed */
+static void LoadStoreSingle(int IsLoad, uint32_t Rt, uint32_t Address, uint32_t Size, int Signed)
+{
+  uint32_t Value;
+
+  LoadStore = 1;
+  Cost = 2U;
+  if(!IsLoad)
+  {
+    Store(Address, Cpu.R[Rt], Size);
+    return;
+  }
+  Value = Load(Address, Size);
+  if(Signed)
+    Value = SignExtend(Value, 8U * Size);
+  if(Rt == 15U)
+    BranchExchange(Value);
+  else
+    Cpu.R[Rt] = Value;
+}
+
+/* Data processing of the 32-bit encodings -------------------------------------*/
+/* Operations of the modified immediate and shifted register encodings:
+   Operand is the second operand, Carry the carry of its shift */
+static void DataProcessing(uint32_t Op, uint32_t S, uint32_t Rn, uint32_t Rd, uint32_t Operand, uint32_t Carry,
+                           uint32_t hw1, uint32_t hw2)
+{
+  uint32_t Result;
+  uint32_t C = Cpu.C;
+  uint32_t V = Cpu.V;
+  int Logical = 1;
+  int Write = 1;
+
+  switch(Op)
+  {
+  case 0x0U:  /* AND, TST */
+    Result = Reg(Rn) & Operand;
+    Write = !((Rd == 15U) && S);
+    break;
+  case 0x1U:  /* BIC */
+    Result = Reg(Rn) & ~Operand;
+    break;
+  case 0x2U:  /* ORR, MOV */
+    Result = (Rn == 15U) ? Operand : Reg(Rn) | Operand;
+    break;
+  case 0x3U:  /* ORN, MVN */
+    Result = (Rn == 15U) ? ~Operand : Reg(Rn) | ~Operand;
+    break;
+  case 0x4U:  /* EOR, TEQ */
+    Result = Reg(Rn) ^ Operand;
+    Write = !((Rd == 15U) && S);
+    break;
+  case 0x8U:  /* ADD, CMN */
+    Result = AddWithCarry(Reg(Rn), Operand, 0U, &C, &V);
+    Logical = 0;
+    Write = !((Rd == 15U) && S);
+    break;
+  case 0xAU:  /* ADC */
+    Result = AddWithCarry(Reg(Rn), Operand, Cpu.C, &C, &V);
+    Logical = 0;
+    break;
+  case 0xBU:  /* SBC */
+    Result = AddWithCarry(Reg(Rn), ~Operand, Cpu.C, &C, &V);
+    Logical = 0;
+    break;
+  case 0xDU:  /* SUB, CMP */
+    Result = AddWithCarry(Reg(Rn), ~Operand, 1U, &C, &V);
+    Logical = 0;
+    Write = !((Rd == 15U) && S);
+    break;
+  case 0xEU:  /* RSB */
+    Result = AddWithCarry(~Reg(Rn), Operand, 1U, &C, &V);
+    Logical = 0;
+    break;
+  default:
+    Undefined(hw1, hw2, 1);
+    return;
+  }
+  if(Write)
+  {
+    if(Rd == 15U)
+    {
+      Undefined(hw1, hw2, 1);
+      return;
+    }
+    Cpu.R[Rd] = Result;
+  }
+  if(S)
+  {
+    SetNZ(Result);
+    Cpu.C = Logical ? Carry : C;
+    if(!Logical)
+      Cpu.V = V;
+  }
+}
+
+static void DataProcessingShifted(uint32_t hw1, uint32_t hw2)
+{
+  uint32_t Op = (hw1 >> 5) & 15U;
+  uint32_t Rn = hw1 & 15U;
+  uint32_t Rd = (hw2 >> 8) & 15U;
+  uint32_t Rm = hw2 & 15U;
+  uint32_t Type, Amount, Carry, Operand;
+
+  DecodeImmShift((hw2 >> 4) & 3U, (((hw2 >> 12) & 7U) << 2) | ((hw2 >> 6) & 3U), &Type, &Amount);
+  Operand = Shift_C(Reg(Rm), Type, Amount, Cpu.C, &Carry);
+  if(Op == 0x6U)
+  {
+    /* PKHBT, PKHTB */
+    if((hw2 & 0x20U) != 0U)
+      Cpu.R[Rd] = (Reg(Rn) & 0xFFFF0000U) | (Operand & 0xFFFFU);
+    else
+      Cpu.R[Rd] = (Operand & 0xFFFF0000U) | (Reg(Rn) & 0xFFFFU);
+    return;
+  }
+  DataProcessing(Op, (hw1 >> 4) & 1U, Rn, Rd, Operand, Carry, hw1, hw2);
+}
+
+static void DataProcessingModified(uint32_t hw1, uint32_t hw2)
+{
+  uint32_t Imm12 = (((hw1 >> 10) & 1U) << 11) | (((hw2 >> 12) & 7U) << 8) | (hw2 & 0xFFU);
+  uint32_t Carry;
+  uint32_t Operand = ThumbExpandImm_C(Imm12, Cpu.C, &Carry);
+
+  DataProcessing((hw1 >> 5) & 15U, (hw1 >> 4) & 1U, hw1 & 15U, (hw2 >> 8) & 15U, Operand, Carry, hw1, hw2);
+}
+
+static void DataProcessingPlain(uint32_t hw1, uint32_t hw2)
+{
+  uint32_t Op = (hw1 >> 4) & 31U;
+  uint32_t Rn = hw1 & 15U;
+  uint32_t Rd = (hw2 >> 8) & 15U;
+  uint32_t Imm12 = (((hw1 >> 10) & 1U) << 11) | (((hw2 >> 12) & 7U) << 8) | (hw2 & 0xFFU);
+  uint32_t Imm16 = ((hw1 & 15U) << 12) | Imm12;
+  uint32_t Lsb = (((hw2 >> 12) & 7U) << 2) | ((hw2 >> 6) & 3U);
+  uint32_t Width = (hw2 & 31U) + 1U;
+  uint32_t Mask, Operand;
+
+  switch(Op)
+  {
+  case 0x00U:  /* ADDW, ADR */
+    Cpu.R[Rd] = (Rn == 15U) ? ALIGN4(Pc + 4U) + Imm12 : Reg(Rn) + Imm12;
+    break;
+  case 0x0AU:  /* SUBW, ADR */
+    Cpu.R[Rd] = (Rn == 15U) ? ALIGN4(Pc + 4U) - Imm12 : Reg(Rn) - Imm12;
+    break;
+  case 0x04U:  /* MOVW */
+    Cpu.R[Rd] = Imm16;
+    break;
+  case 0x0CU:  /* MOVT */
+    Cpu.R[Rd] = (Cpu.R[Rd] & 0xFFFFU) | (Imm16 << 16);
+    break;
+  case 0x10U:  /* SSAT, LSL */
+  case 0x12U:  /* SSAT, ASR */
+  case 0x18U:  /* USAT, LSL */
+  case 0x1AU:  /* USAT, ASR */
+    if(((hw1 >> 5) & 1U) != 0U)
+      Operand = Shift(Reg(Rn), SHIFT_ASR, (Lsb == 0U) ? 32U : Lsb);
+    else
+      Operand = Reg(Rn) << Lsb;
+    if(Op < 0x18U)
+      Cpu.R[Rd] = SignedSat((int32_t)Operand, Width);
+    else
+      Cpu.R[Rd] = UnsignedSat((int32_t)Operand, Width - 1U);
+    break;
+  case 0x14U:  /* SBFX */
+    if(Lsb + Width > 32U)
+      Undefined(hw1, hw2, 1);
+    else
+      Cpu.R[Rd] = (uint32_t)((int32_t)(Reg(Rn) << (32U - Lsb - Width)) >> (32U - Width));
+    break;
+  case 0x1CU:  /* UBFX */
+    if(Lsb + Width > 32U)
+      Undefined(hw1, hw2, 1);
+    else
+      Cpu.R[Rd] = (Width == 32U) ? Reg(Rn) : (Reg(Rn) >> Lsb) & ((1U << Width) - 1U);
+    break;
+  case 0x16U:  /* BFI, BFC: Width holds the msb */
+    if(Width - 1U < Lsb)
+    {
+      Undefined(hw1, hw2, 1);
+      break;
+    }
+    Width = Width - Lsb;
+    Mask = ((Width == 32U) ? 0xFFFFFFFFU : ((1U << Width) - 1U)) << Lsb;
+    Operand = (Rn == 15U) ? 0U : Reg(Rn) << Lsb;
+    Cpu.R[Rd] = (Cpu.R[Rd] & ~Mask) | (Operand & Mask);
+    break;
+  default:
+    Undefined(hw1, hw2, 1);
+    break;
+  }
+}
+
+/* Special registers of MRS and MSR */
+static uint32_t ReadSpecial(uint32_t SYSm)
+{
+  switch(SYSm)
+  {
+  case 0U: case 1U: case 2U: case 3U:
+  case 4U: case 5U: case 6U: case 7U:
+    return (Cpu.N << 31) | (Cpu.Z << 30) | (Cpu.C << 29) | (Cpu.V << 28) | (Cpu.Q << 27) | (Cpu.GE << 16);
+  case 8U: case 9U:
+    return Cpu.R[13];
+  case 16U:
+    return Cpu.PRIMASK;
+  case 17U: case 18U:
+    return Cpu.BASEPRI;
+  case 19U:
+    return Cpu.FAULTMASK;
+  case 20U:
+    return Cpu.CONTROL;
+  default:
+    return 0U;
+  }
+}
+
+static void WriteSpecial(uint32_t SYSm, uint32_t Mask, uint32_t Value)
+{
+  switch(SYSm)
+  {
+  case 0U: case 1U: case 2U: case 3U:
+    if((Mask & 2U) != 0U)
+    {
+      Cpu.N = (Value >> 31) & 1U;
+      Cpu.Z = (Value >> 30) & 1U;
+      Cpu.C = (Value >> 29) & 1U;
+      Cpu.V = (Value >> 28) & 1U;
+      Cpu.Q = (Value >> 27) & 1U;
+    }
+    if((Mask & 1U) != 0U)
+      Cpu.GE = (Value >> 16) & 15U;
+    break;
+  case 8U: case 9U:
+    Cpu.R[13] = Value & ~3U;
+    break;
+  case 16U:
+    Cpu.PRIMASK = Value & 1U;
+    break;
+  case 17U:
+    Cpu.BASEPRI = Value & 0xFFU;
+    break;
+  case 18U:
+    if(((Value & 0xFFU) != 0U) && (((Value & 0xFFU) < Cpu.BASEPRI) || (Cpu.BASEPRI == 0U)))
+      Cpu.BASEPRI = Value & 0xFFU;
+    break;
+  case 19U:
+    Cpu.FAULTMASK = Value & 1U;
+    break;
+  case 20U:
+    Cpu.CONTROL = Value & 7U;
+    break;
+  default:
+    break;
+  }
+}
+
+static void BranchMisc(uint32_t hw1, uint32_t hw2)
+{
+  uint32_t Op1 = (hw2 >> 12) & 7U;
+  uint32_t Op = (hw1 >> 4) & 0x7FU;
+  uint32_t S = (hw1 >> 10) & 1U;
+  uint32_t J1 = (hw2 >> 13) & 1U;
+  uint32_t J2 = (hw2 >> 11) & 1U;
+  uint32_t Imm;
+
+  if((Op1 & 5U) == 0U)
+  {
+    if((hw1 & 0x0380U) != 0x0380U)
+    {
+      /* B<cond>.W */
+      Imm = SignExtend((S << 20) | (J2 << 19) | (J1 << 18) | ((hw1 & 0x3FU) << 12) | ((hw2 & 0x7FFU) << 1), 21U);
+      if(ConditionPassed((hw1 >> 6) & 15U))
+        Branch(Pc + 4U + Imm);
+    }
+    else if((Op & 0x7EU) == 0x38U)
+    {
+      WriteSpecial(hw2 & 0xFFU, (hw2 >> 10) & 3U, Reg(hw1 & 15U));
+      Cost = 2U;
+    }
+    else if((Op & 0x7EU) == 0x3EU)
+    {
+      Cpu.R[(hw2 >> 8) & 15U] = ReadSpecial(hw2 & 0xFFU);
+      Cost = 2U;
+    }
+    else if(Op == 0x3AU)
+    {
+      /* NOP.W, YIELD.W, WFE.W, WFI.W, SEV.W */
+    }
+    else if(Op == 0x3BU)
+    {
+      /* CLREX, DSB, DMB, ISB */
+      Cost = 2U;
+    }
+    else
+      Undefined(hw1, hw2, 1);
+    return;
+  }
+  Imm = SignExtend((S << 24) | ((1U ^ J1 ^ S) << 23) | ((1U ^ J2 ^ S) << 22) | ((hw1 & 0x3FFU) << 12) |
+                   ((hw2 & 0x7FFU) << 1), 25U);
+  if((Op1 & 5U) == 1U)
+  {
+    /* B.W */
+    Branch(Pc + 4U + Imm);
+  }
+  else if((Op1 & 5U) == 5U)
+  {
+    /* BL */
+    Cpu.R[14] = (Pc + 4U) | 1U;
+    Branch(Pc + 4U + Imm);
+  }
+  else
+    Undefined(hw1, hw2, 1);
+}
+
+static void LoadStoreMultiple32(uint32_t hw1, uint32_t hw2)
+{
+  uint32_t Op = (hw1 >> 7) & 3U;
+  uint32_t W = (hw1 >> 5) & 1U;
+  uint32_t Rn = hw1 & 15U;
+
+  if((Op != 1U) && (Op != 2U))
+  {
+    Undefined(hw1, hw2, 1);
+    return;
+  }
+  if(((hw1 >> 4) & 1U) != 0U)
+    LoadMultiple(Rn, hw2, W, Op == 2U);
+  else
+    StoreMultiple(Rn, hw2 & 0x7FFFU, W, Op == 2U);
+}
+
+static void LoadStoreDual(uint32_t hw1, uint32_t hw2)
+{
+  uint32_t P = (hw1 >> 8) & 1U;
+  uint32_t U = (hw1 >> 7) & 1U;
+  uint32_t W = (hw1 >> 5) & 1U;
+  uint32_t L = (hw1 >> 4) & 1U;
+  uint32_t Rn = hw1 & 15U;
+  uint32_t Rt = (hw2 >> 12) & 15U;
+  uint32_t Rt2 = (hw2 >> 8) & 15U;
+  uint32_t Imm = (hw2 & 0xFFU) << 2;
+  uint32_t Base, Offset, Address, Value;
+
+  if((P != 0U) || (W != 0U))
+  {
+    /* LDRD, STRD */
+    Base = (Rn == 15U) ? ALIGN4(Pc + 4U) : Cpu.R[Rn];
+    Offset = (U != 0U) ? Base + Imm : Base - Imm;
+    Address = (P != 0U) ? Offset : Base;
+    if(L != 0U)
+    {
+      Cpu.R[Rt] = Load(Address, 4U);
+      Cpu.R[Rt2] = Load(Address + 4U, 4U);
+    }
+    else
+    {
+      Store(Address, Cpu.R[Rt], 4U);
+      Store(Address + 4U, Cpu.R[Rt2], 4U);
+    }
+    if(W != 0U)
+      Cpu.R[Rn] = Offset;
+    Cost = 3U;
+    return;
+  }
+  if(U == 0U)
+  {
+    /* LDREX, STREX: the exclusive accesses always succeed */
+    Address = Cpu.R[Rn] + Imm;
+    if(L != 0U)
+      Cpu.R[Rt] = Load(Address, 4U);
+    else
+    {
+      Store(Address, Cpu.R[Rt], 4U);
+      Cpu.R[Rt2] = 0U;
+    }
+    Cost = 2U;
+    return;
+  }
+  switch(((hw2 >> 4) & 15U) | (L << 4))
+  {
+  case 0x10U:  /* TBB */
+  case 0x11U:  /* TBH */
+    if(((hw2 >> 4) & 1U) != 0U)
+      Value = Load(Reg(Rn) + 2U * Cpu.R[hw2 & 15U], 2U);
+    else
+      Value = Load(Reg(Rn) + Cpu.R[hw2 & 15U], 1U);
+    Cost = 2U;
+    Branch(Pc + 4U + 2U * Value);
+    break;
+  case 0x14U:  /* LDREXB */
+  case 0x15U:  /* LDREXH */
+    Cpu.R[Rt] = Load(Cpu.R[Rn], ((hw2 >> 4) & 1U) + 1U);
+    Cost = 2U;
+    break;
+  case 0x04U:  /* STREXB */
+  case 0x05U:  /* STREXH */
+    Store(Cpu.R[Rn], Cpu.R[Rt], ((hw2 >> 4) & 1U) + 1U);
+    Cpu.R[hw2 & 15U] = 0U;
+    Cost = 2U;
+    break;
+  default:
+    Undefined(hw1, hw2, 1);
+    break;
+  }
+}
+
+static void LoadStoreSingle32(uint32_t hw1, uint32_t hw2)
+{
+  uint32_t S = (hw1 >> 8) & 1U;
+  uint32_t Size = (hw1 >> 5) & 3U;
+  uint32_t L = (hw1 >> 4) & 1U;
+  uint32_t Rn = hw1 & 15U;
+  uint32_t Rt = (hw2 >> 12) & 15U;
+  uint32_t Address, Offset = 0U;
+  int WriteBack = 0;
+
+  if((Size == 3U) || ((L == 0U) && (S != 0U)))
+  {
+    Undefined(hw1, hw2, 1);
+    return;
+  }
+  if(Rn == 15U)
+  {
+    if(L == 0U)
+    {
+      Undefined(hw1, hw2, 1);
+      return;
+    }
+    Address = ((hw1 & 0x80U) != 0U) ? ALIGN4(Pc + 4U) + (hw2 & 0xFFFU) : ALIGN4(Pc + 4U) - (hw2 & 0xFFFU);
+  }
+  else if((hw1 & 0x80U) != 0U)
+    Address = Cpu.R[Rn] + (hw2 & 0xFFFU);
+  else if((hw2 & 0x800U) != 0U)
+  {
+    /* Immediate offset, pre or post-indexed: P, U and W bits */
+    Offset = ((hw2 & 0x200U) != 0U) ? Cpu.R[Rn] + (hw2 & 0xFFU) : Cpu.R[Rn] - (hw2 & 0xFFU);
+    Address = ((hw2 & 0x400U) != 0U) ? Offset : Cpu.R[Rn];
+    WriteBack = ((hw2 & 0x100U) != 0U);
+    if(((hw2 & 0x400U) == 0U) && !WriteBack)
+    {
+      Undefined(hw1, hw2, 1);
+      return;
+    }
+  }
+  else if(((hw2 >> 6) & 0x3FU) == 0U)
+    Address = Cpu.R[Rn] + (Cpu.R[hw2 & 15U] << ((hw2 >> 4) & 3U));
+  else
+  {
+    Undefined(hw1, hw2, 1);
+    return;
+  }
+  if((L != 0U) && (Rt == 15U) && (Size != 2U))
+  {
+    /* PLD, PLI */
+    return;
+  }
+  if(WriteBack)
+    Cpu.R[Rn] = Offset;
+  LoadStoreSingle(L != 0U, Rt, Address, 1U << Size, S != 0U);
+}
+
+static void DataProcessingRegister(uint32_t hw1, uint32_t hw2)
+{
+  uint32_t Op1 = (hw1 >> 4) & 15U;
+  uint32_t Op2 = (hw2 >> 4) & 15U;
+  uint32_t Rn = hw1 & 15U;
+  uint32_t Rd = (hw2 >> 8) & 15U;
+  uint32_t Rm = hw2 & 15U;
+  uint32_t Value, Result, Carry;
+  int64_t Sum;
+
+  if((Op2 == 0U) && (Op1 < 8U))
+  {
+    /* LSL, LSR, ASR, ROR (register) */
+    Result = Shift_C(Cpu.R[Rn], Op1 >> 1, Cpu.R[Rm] & 0xFFU, Cpu.C, &Carry);
+    Cpu.R[Rd] = Result;
+    if((Op1 & 1U) != 0U)
+    {
+      SetNZ(Result);
+      Cpu.C = Carry;
+    }
+  }
+  else if((Op1 < 6U) && ((Op2 & 8U) != 0U))
+  {
+    /* SXTAH, UXTAH, SXTAB16, UXTAB16, SXTAB, UXTAB and their forms without
+       addition */
+    Value = Ror(Cpu.R[Rm], ((hw2 >> 4) & 3U) * 8U);
+    switch(Op1)
+    {
+    case 0U: Result = SignExtend(Value & 0xFFFFU, 16U); break;
+    case 1U: Result = Value & 0xFFFFU; break;
+    case 2U: Result = (SignExtend(Value & 0xFFU, 8U) & 0xFFFFU) | (SignExtend((Value >> 16) & 0xFFU, 8U) << 16); break;
+    case 3U: Result = Value & 0x00FF00FFU; break;
+    case 4U: Result = SignExtend(Value & 0xFFU, 8U); break;
+    default: Result = Value & 0xFFU; break;
+    }
+    if(Rn != 15U)
+    {
+      if((Op1 == 2U) || (Op1 == 3U))
+        Result = (((Cpu.R[Rn] & 0xFFFFU) + Result) & 0xFFFFU) | (((Cpu.R[Rn] >> 16) + (Result >> 16)) << 16);
+      else
+        Result += Cpu.R[Rn];
+    }
+    Cpu.R[Rd] = Result;
+  }
+  else if(((Op1 & 0xCU) == 8U) && ((Op2 & 0xCU) == 8U))
+  {
+    switch(((Op1 & 3U) << 2) | (Op2 & 3U))
+    {
+    case 0x0U:  /* QADD */
+      Cpu.R[Rd] = SignedSat((int64_t)(int32_t)Cpu.R[Rm] + (int32_t)Cpu.R[Rn], 32U);
+      break;
+    case 0x2U:  /* QSUB */
+      Cpu.R[Rd] = SignedSat((int64_t)(int32_t)Cpu.R[Rm] - (int32_t)Cpu.R[Rn], 32U);
+      break;
+    case 0x4U:  /* REV */
+      Cpu.R[Rd] = __builtin_bswap32(Cpu.R[Rm]);
+      break;
+    case 0x5U:  /* REV16 */
+      Value = Cpu.R[Rm];
+      Cpu.R[Rd] = ((Value & 0x00FF00FFU) << 8) | ((Value >> 8) & 0x00FF00FFU);
+      break;
+    case 0x6U:  /* RBIT */
+      Value = Cpu.R[Rm];
+      Result = 0U;
+      for(Carry = 0U; Carry < 32U; Carry++)
+        Result |= ((Value >> Carry) & 1U) << (31U - Carry);
+      Cpu.R[Rd] = Result;
+      break;
+    case 0x7U:  /* REVSH */
+      Value = Cpu.R[Rm];
+      Cpu.R[Rd] = SignExtend(((Value & 0xFFU) << 8) | ((Value >> 8) & 0xFFU), 16U);
+      break;
+    case 0x8U:  /* SEL */
+      Result = 0U;
+      for(Carry = 0U; Carry < 4U; Carry++)
+        Result |= ((((Cpu.GE >> Carry) & 1U) != 0U) ? Cpu.R[Rn] : Cpu.R[Rm]) & (0xFFU << (8U * Carry));
+      Cpu.R[Rd] = Result;
+      break;
+    case 0xCU:  /* CLZ */
+      Cpu.R[Rd] = (Cpu.R[Rm] == 0U) ? 32U : (uint32_t)__builtin_clz(Cpu.R[Rm]);
+      break;
+    default:
+      Undefined(hw1, hw2, 1);
+      break;
+    }
+  }
+  else if(((Op1 & 8U) != 0U) && ((Op2 & 0xCU) == 0U) && ((Op1 & 7U) == 0U) && ((Op2 & 3U) == 0U))
+  {
+    /* SADD8 */
+    Result = 0U;
+    Cpu.GE = 0U;
+    for(Carry = 0U; Carry < 4U; Carry++)
+    {
+      Sum = (int8_t)(Cpu.R[Rn] >> (8U * Carry)) + (int8_t)(Cpu.R[Rm] >> (8U * Carry));
+      Result |= ((uint32_t)Sum & 0xFFU) << (8U * Carry);
+      Cpu.GE |= (Sum >= 0) ? (1U << Carry) : 0U;
+    }
+    Cpu.R[Rd] = Result;
+  }
+  else if(((Op1 & 8U) != 0U) && ((Op2 & 0xCU) == 4U) && ((Op1 & 7U) == 0U) && ((Op2 & 3U) == 0U))
+  {
+    /* UADD8 */
+    Result = 0U;
+    Cpu.GE = 0U;
+    for(Carry = 0U; Carry < 4U; Carry++)
+    {
+      Sum = (int64_t)((Cpu.R[Rn] >> (8U * Carry)) & 0xFFU) + ((Cpu.R[Rm] >> (8U * Carry)) & 0xFFU);
+      Result |= ((uint32_t)Sum & 0xFFU) << (8U * Carry);
+      Cpu.GE |= (Sum >= 0x100) ? (1U << Carry) : 0U;
+    }
+    Cpu.R[Rd] = Result;
+  }
+  else if(((Op1 & 8U) != 0U) && ((Op2 & 0xCU) == 4U) && ((Op1 & 7U) == 4U) && ((Op2 & 3U) == 0U))
+  {
+    /* USUB8 */
+    Result = 0U;
+    Cpu.GE = 0U;
+    for(Carry = 0U; Carry < 4U; Carry++)
+    {
+      Sum = (int64_t)((Cpu.R[Rn] >> (8U * Carry)) & 0xFFU) - ((Cpu.R[Rm] >> (8U * Carry)) & 0xFFU);
+      Result |= ((uint32_t)Sum & 0xFFU) << (8U * Carry);
+      Cpu.GE |= (Sum >= 0) ? (1U << Carry) : 0U;
+    }
+    Cpu.R[Rd] = Result;
+  }
+  else
+    Undefined(hw1, hw2, 1);
+}
+
+static void Multiply(uint32_t hw1, uint32_t hw2)
+{
+  uint32_t Op1 = (hw1 >> 4) & 7U;
+  uint32_t Op2 = (hw2 >> 4) & 3U;
+  uint32_t Ra = (hw2 >> 12) & 15U;
+  uint32_t Rd = (hw2 >> 8) & 15U;
+  uint32_t Rn = Cpu.R[hw1 & 15U];
+  uint32_t Rm = Cpu.R[hw2 & 15U];
+  int64_t Product;
+
+  switch(Op1)
+  {
+  case 0U:
+    if(Op2 == 0U)
+    {
+      /* MUL, MLA */
+      Cpu.R[Rd] = Rn * Rm + ((Ra == 15U) ? 0U : Cpu.R[Ra]);
+      Cost = (Ra == 15U) ? 1U : 2U;
+    }
+    else if(Op2 == 1U)
+    {
+      /* MLS */
+      Cpu.R[Rd] = Cpu.R[Ra] - Rn * Rm;
+      Cost = 2U;
+    }
+    else
+      Undefined(hw1, hw2, 1);
+    break;
+  case 1U:
+    /* SMULxy, SMLAxy */
+    Product = (int64_t)(int16_t)(((Op2 & 2U) != 0U) ? Rn >> 16 : Rn) * (int16_t)(((Op2 & 1U) != 0U) ? Rm >> 16 : Rm);
+    if(Ra != 15U)
+    {
+      Product += (int32_t)Cpu.R[Ra];
+      if((Product > INT32_MAX) || (Product < INT32_MIN))
+        Cpu.Q = 1U;
+    }
+    Cpu.R[Rd] = (uint32_t)Product;
+    break;
+  case 3U:
+    /* SMULWy, SMLAWy */
+    Product = ((int64_t)(int32_t)Rn * (int16_t)(((Op2 & 1U) != 0U) ? Rm >> 16 : Rm)) >> 16;
+    if(Ra != 15U)
+    {
+      Product += (int32_t)Cpu.R[Ra];
+      if((Product > INT32_MAX) || (Product < INT32_MIN))
+        Cpu.Q = 1U;
+    }
+    Cpu.R[Rd] = (uint32_t)Product;
+    break;
+  case 5U:
+    /* SMMUL, SMMLA, the R bit rounding */
+    Product = (int64_t)(int32_t)Rn * (int32_t)Rm;
+    if(Ra != 15U)
+      Product += (int64_t)((uint64_t)Cpu.R[Ra] << 32);
+    if((Op2 & 1U) != 0U)
+      Product += 0x80000000LL;
+    Cpu.R[Rd] = (uint32_t)((uint64_t)Product >> 32);
+    break;
+  default:
+    Undefined(hw1, hw2, 1);
+    break;
+  }
+}
+
+static uint32_t DivideCycles(uint32_t Dividend, uint32_t Divisor)
+{
+  int Bits = (Dividend == 0U) ? 0 : 32 - __builtin_clz(Dividend);
+  int DivisorBits = (Divisor == 0U) ? 0 : 32 - __builtin_clz(Divisor);
+  int Cycles = 2 + (Bits - DivisorBits) / 4;
+
+  return (Cycles < 2) ? 2U : (Cycles > 12) ? 12U : (uint32_t)Cycles;
+}
+
+static void LongMultiply(uint32_t hw1, uint32_t hw2)
+{
+  uint32_t Op = (((hw1 >> 4) & 7U) << 4) | ((hw2 >> 4) & 15U);
+  uint32_t RdLo = (hw2 >> 12) & 15U;
+  uint32_t RdHi = (hw2 >> 8) & 15U;
+  uint32_t Rn = Cpu.R[hw1 & 15U];
+  uint32_t Rm = Cpu.R[hw2 & 15U];
+  uint64_t Accumulator = ((uint64_t)Cpu.R[RdHi] << 32) | Cpu.R[RdLo];
+  uint64_t Result;
+
+  switch(Op)
+  {
+  case 0x00U:  /* SMULL */
+    Result = (uint64_t)((int64_t)(int32_t)Rn * (int32_t)Rm);
+    break;
+  case 0x20U:  /* UMULL */
+    Result = (uint64_t)Rn * Rm;
+    break;
+  case 0x40U:  /* SMLAL */
+    Result = Accumulator + (uint64_t)((int64_t)(int32_t)Rn * (int32_t)Rm);
+    break;
+  case 0x60U:  /* UMLAL */
+    Result = Accumulator + (uint64_t)Rn * Rm;
+    break;
+  case 0x66U:  /* UMAAL */
+    Result = (uint64_t)Rn * Rm + Cpu.R[RdHi] + Cpu.R[RdLo];
+    break;
+  case 0x1FU:  /* SDIV */
+    if(Rm == 0U)
+      Cpu.R[RdHi] = 0U;
+    else if((Rn == 0x80000000U) && (Rm == 0xFFFFFFFFU))
+      Cpu.R[RdHi] = Rn;
+    else
+      Cpu.R[RdHi] = (uint32_t)((int32_t)Rn / (int32_t)Rm);
+    Cost = DivideCycles(((int32_t)Rn < 0) ? 0U - Rn : Rn, ((int32_t)Rm < 0) ? 0U - Rm : Rm);
+    return;
+  case 0x3FU:  /* UDIV */
+    Cpu.R[RdHi] = (Rm == 0U) ? 0U : Rn / Rm;
+    Cost = DivideCycles(Rn, Rm);
+    return;
+  default:
+    Undefined(hw1, hw2, 1);
+    return;
+  }
+  Cpu.R[RdLo] = (uint32_t)Result;
+  Cpu.R[RdHi] = (uint32_t)(Result >> 32);
+}
+
+/* Floating-point unit ---------------------------------------------------------*/
+static float GetS(uint32_t n)
+{
+  float Value;
+
+  memcpy(&Value, &Cpu.S[n], sizeof(Value));
+  return Value;
+}
+
+static void SetS(uint32_t n, float Value)
+{
+  memcpy(&Cpu.S[n], &Value, sizeof(Value));
+}
+
+static double GetD(uint32_t n)
+{
+  uint64_t Bits = ((uint64_t)Cpu.S[2U * n + 1U] << 32) | Cpu.S[2U * n];
+  double Value;
+
+  memcpy(&Value, &Bits, sizeof(Value));
+  return Value;
+}
+
+static void SetD(uint32_t n, double Value)
+{
+  uint64_t Bits;
+
+  memcpy(&Bits, &Value, sizeof(Bits));
+  Cpu.S[2U * n] = (uint32_t)Bits;
+  Cpu.S[2U * n + 1U] = (uint32_t)(Bits >> 32);
+}
+
+static double GetF(uint32_t n, int Double)
+{
+  return Double ? GetD(n) : (double)GetS(n);
+}
+
+static void SetF(uint32_t n, int Double, double Value)
+{
+  if(Double)
+    SetD(n, Value);
+  else
+    SetS(n, (float)Value);
+}
+
+/* Conversion to a 32-bit integer, saturated, rounded towards zero or to
+   the nearest */
+static uint32_t FloatToInt(double Value, int Signed, int TowardsZero)
+{
+  Value = TowardsZero ? trunc(Value) : nearbyint(Value);
+  if(isnan(Value))
+    return 0U;
+  if(Signed)
+    return (Value >= 2147483647.0) ? 0x7FFFFFFFU : (Value <= -2147483648.0) ? 0x80000000U : (uint32_t)(int32_t)Value;
+  return (Value >= 4294967295.0) ? 0xFFFFFFFFU : (Value <= 0.0) ? 0U : (uint32_t)Value;
+}
+
+static void FloatCompare(double a, double b)
+{
+  uint32_t Flags;
+
+  if(isnan(a) || isnan(b))
+    Flags = 0x3U;
+  else if(a == b)
+    Flags = 0x6U;
+  else if(a < b)
+    Flags = 0x8U;
+  else
+    Flags = 0x2U;
+  Cpu.FPSCR = (Cpu.FPSCR & 0x0FFFFFFFU) | (Flags << 28);
+}
+
+static void FloatDataProcessing(uint32_t hw1, uint32_t hw2, int Double)
+{
+  uint32_t Opc1 = ((hw1 >> 4) & 8U) | ((hw1 >> 4) & 3U);
+  uint32_t Opc2 = hw1 & 15U;
+  uint32_t Opc3 = (hw2 >> 6) & 3U;
+  uint32_t D = (hw1 >> 6) & 1U, Vd = (hw2 >> 12) & 15U;
+  uint32_t N = (hw2 >> 7) & 1U, Vn = hw1 & 15U;
+  uint32_t M = (hw2 >> 5) & 1U, Vm = hw2 & 15U;
+  uint32_t d = Double ? (D << 4) | Vd : (Vd << 1) | D;
+  uint32_t n = Double ? (N << 4) | Vn : (Vn << 1) | N;
+  uint32_t m = Double ? (M << 4) | Vm : (Vm << 1) | M;
+  uint32_t Imm8, Bits;
+  uint64_t Bits64;
+  double a, b, Value;
+  float Single;
+
+  if(Opc1 != 0xBU)
+  {
+    a = GetF(n, Double);
+    b = GetF(m, Double);
+    switch(Opc1)
+    {
+    case 0x0U:  /* VMLA, VMLS */
+      Value = GetF(d, Double) + (((Opc3 & 1U) != 0U) ? -(a * b) : a * b);
+      break;
+    case 0x1U:  /* VNMLS, VNMLA */
+      Value = -GetF(d, Double) + (((Opc3 & 1U) != 0U) ? -(a * b) : a * b);
+      break;
+    case 0x2U:  /* VMUL, VNMUL */
+      Value = ((Opc3 & 1U) != 0U) ? -(a * b) : a * b;
+      break;
+    case 0x3U:  /* VADD, VSUB */
+      Value = ((Opc3 & 1U) != 0U) ? a - b : a + b;
+      break;
+    case 0x8U:  /* VDIV */
+      Value = a / b;
+      Cost = 14U;
+      break;
+    case 0x9U:  /* VFNMS, VFNMA */
+      Value = fma(((Opc3 & 1U) != 0U) ? -a : a, b, -GetF(d, Double));
+      break;
+    case 0xAU:  /* VFMA, VFMS */
+      Value = fma(((Opc3 & 1U) != 0U) ? -a : a, b, GetF(d, Double));
+      break;
+    default:
+      Undefined(hw1, hw2, 1);
+      return;
+    }
+    if(!Double)
+    {
+      /* Single precision rounding of each operation */
+      Single = (float)Value;
+      Value = Single;
+    }
+    SetF(d, Double, Value);
+    return;
+  }
+
+  if((Opc3 & 1U) == 0U)
+  {
+    /* VMOV (immediate) */
+    Imm8 = ((hw1 & 15U) << 4) | (hw2 & 15U);
+    if(Double)
+    {
+      Bits64 = ((uint64_t)(Imm8 >> 7) << 63) | ((uint64_t)(((Imm8 >> 6) & 1U) ^ 1U) << 62) |
+               ((((Imm8 >> 6) & 1U) != 0U) ? 0x3FC0000000000000ULL : 0U) | ((uint64_t)(Imm8 & 0x3FU) << 48);
+      Cpu.S[2U * d] = (uint32_t)Bits64;
+      Cpu.S[2U * d + 1U] = (uint32_t)(Bits64 >> 32);
+    }
+    else
+    {
+      Bits = ((Imm8 >> 7) << 31) | ((((Imm8 >> 6) & 1U) ^ 1U) << 30) |
+             ((((Imm8 >> 6) & 1U) != 0U) ? 0x3E000000U : 0U) | ((Imm8 & 0x3FU) << 19);
+      Cpu.S[d] = Bits;
+    }
+    return;
+  }
+  switch(Opc2)
+  {
+  case 0x0U:  /* VMOV (register), VABS */
+    if(Double)
+    {
+      Cpu.S[2U * d] = Cpu.S[2U * m];
+      Cpu.S[2U * d + 1U] = Cpu.S[2U * m + 1U] & ((Opc3 == 3U) ? 0x7FFFFFFFU : 0xFFFFFFFFU);
+    }
+    else
+      Cpu.S[d] = Cpu.S[m] & ((Opc3 == 3U) ? 0x7FFFFFFFU : 0xFFFFFFFFU);
+    break;
+  case 0x1U:  /* VNEG, VSQRT */
+    if(Opc3 == 3U)
+    {
+      SetF(d, Double, Double ? sqrt(GetD(m)) : (double)sqrtf(GetS(m)));
+      Cost = 14U;
+    }
+    else if(Double)
+    {
+      Cpu.S[2U * d] = Cpu.S[2U * m];
+      Cpu.S[2U * d + 1U] = Cpu.S[2U * m + 1U] ^ 0x80000000U;
+    }
+    else
+      Cpu.S[d] = Cpu.S[m] ^ 0x80000000U;
+    break;
+  case 0x4U:  /* VCMP, VCMPE */
+    FloatCompare(GetF(d, Double), GetF(m, Double));
+    break;
+  case 0x5U:  /* VCMP, VCMPE with zero */
+    FloatCompare(GetF(d, Double), 0.0);
+    break;
+  case 0x7U:  /* VCVT between double and single precision */
+    if(Opc3 != 3U)
+    {
+      Undefined(hw1, hw2, 1);
+      break;
+    }
+    if(Double)
+      SetS((Vd << 1) | D, (float)GetD(m));
+    else
+      SetD((D << 4) | Vd, (double)GetS(m));
+    break;
+  case 0x8U:  /* VCVT from a 32-bit integer, op (bit 7) set when signed */
+    m = (Vm << 1) | M;
+    SetF(d, Double, ((hw2 & 0x80U) != 0U) ? (double)(int32_t)Cpu.S[m] : (double)Cpu.S[m]);
+    break;
+  case 0xCU:  /* VCVT, VCVTR to an unsigned integer */
+  case 0xDU:  /* and to a signed one */
+    Cpu.S[(Vd << 1) | D] = FloatToInt(GetF(m, Double), Opc2 == 0xDU, (hw2 & 0x80U) != 0U);
+    break;
+  default:
+    Undefined(hw1, hw2, 1);
+    break;
+  }
+}
+
+static void Coprocessor(uint32_t hw1, uint32_t hw2)
+{
+  uint32_t Coproc = (hw2 >> 8) & 15U;
+  int Double = (Coproc == 11U);
+  uint32_t D = (hw1 >> 6) & 1U;
+  uint32_t Vd = (hw2 >> 12) & 15U;
+  uint32_t Rn = hw1 & 15U;
+  uint32_t Rt = (hw2 >> 12) & 15U;
+  uint32_t Imm8 = hw2 & 0xFFU;
+  uint32_t d, n, Address, Base, i;
+
+  if(((Coproc & 0xEU) != 0xAU) || ((hw1 & 0x1000U) != 0U))
+  {
+    Undefined(hw1, hw2, 1);
+    return;
+  }
+  if((hw1 & 0x0E00U) == 0x0C00U)
+  {
+    if((hw1 & 0xFFE0U) == 0xEC40U)
+    {
+      /* VMOV between two core registers and a D or two S registers */
+      n = Double ? ((((hw2 >> 5) & 1U) << 4) | (hw2 & 15U)) * 2U : ((hw2 & 15U) << 1) | ((hw2 >> 5) & 1U);
+      if(((hw1 >> 4) & 1U) != 0U)
+      {
+        Cpu.R[Rt] = Cpu.S[n];
+        Cpu.R[Rn] = Cpu.S[n + 1U];
+      }
+      else
+      {
+        Cpu.S[n] = Cpu.R[Rt];
+        Cpu.S[n + 1U] = Cpu.R[Rn];
+      }
+      Cost = 2U;
+      return;
+    }
+    d = Double ? ((D << 4) | Vd) * 2U : (Vd << 1) | D;
+    if((hw1 & 0x0120U) == 0x0100U)
+    {
+      /* VLDR, VSTR */
+      Base = (Rn == 15U) ? ALIGN4(Pc + 4U) : Cpu.R[Rn];
+      Address = ((hw1 & 0x80U) != 0U) ? Base + Imm8 * 4U : Base - Imm8 * 4U;
+      for(i = 0U; i < (Double ? 2U : 1U); i++)
+      {
+        if(((hw1 >> 4) & 1U) != 0U)
+          Cpu.S[d + i] = Load(Address + 4U * i, 4U);
+        else
+          Store(Address + 4U * i, Cpu.S[d + i], 4U);
+      }
+      LoadStore = 1;
+      Cost = 2U;
+      return;
+    }
+    /* VLDM, VSTM, VPUSH, VPOP: increment after or decrement before */
+    if(((hw1 & 0x0100U) != 0U) == ((hw1 & 0x0080U) != 0U))
+    {
+      Undefined(hw1, hw2, 1);
+      return;
+    }
+    Address = ((hw1 & 0x0100U) != 0U) ? Cpu.R[Rn] - Imm8 * 4U : Cpu.R[Rn];
+    for(i = 0U; i < (Imm8 & ~(Double ? 1U : 0U)); i++)
+    {
+      if(((hw1 >> 4) & 1U) != 0U)
+        Cpu.S[(d + i) & 31U] = Load(Address + 4U * i, 4U);
+      else
+        Store(Address + 4U * i, Cpu.S[(d + i) & 31U], 4U);
+    }
+    if((hw1 & 0x0020U) != 0U)
+      Cpu.R[Rn] = ((hw1 & 0x0080U) != 0U) ? Cpu.R[Rn] + Imm8 * 4U : Cpu.R[Rn] - Imm8 * 4U;
+    Cost = 1U + Imm8;
+    return;
+  }
+  if((hw1 & 0x0F00U) != 0x0E00U)
+  {
+    Undefined(hw1, hw2, 1);
+    return;
+  }
+  if((hw2 & 0x10U) == 0U)
+  {
+    FloatDataProcessing(hw1, hw2, Double);
+    return;
+  }
+  if((hw1 & 0xFFEFU) == 0xEEE1U)
+  {
+    /* VMRS, VMSR of the FPSCR, VMRS APSR_nzcv */
+    if((hw1 & 0x0010U) == 0U)
+      Cpu.FPSCR = Cpu.R[Rt];
+    else if(Rt == 15U)
+    {
+      Cpu.N = Cpu.FPSCR >> 31;
+      Cpu.Z = (Cpu.FPSCR >> 30) & 1U;
+      Cpu.C = (Cpu.FPSCR >> 29) & 1U;
+      Cpu.V = (Cpu.FPSCR >> 28) & 1U;
+    }
+    else
+      Cpu.R[Rt] = Cpu.FPSCR;
+    return;
+  }
+  if(((hw1 & 0xFFE0U) == 0xEE00U) || (Double && ((hw1 & 0xFFC0U) == 0xEE00U)))
+  {
+    if(!Double)
+    {
+      /* VMOV between a core register and an S register */
+      n = ((hw1 & 15U) << 1) | ((hw2 >> 7) & 1U);
+      if(((hw1 >> 4) & 1U) != 0U)
+        Cpu.R[Rt] = Cpu.S[n];
+      else
+        Cpu.S[n] = Cpu.R[Rt];
+      return;
+    }
+    /* VMOV between a core register and a 32-bit half of a D register */
+    n = (((((hw2 >> 7) & 1U) << 4) | (hw1 & 15U)) * 2U) + ((hw1 >> 5) & 1U);
+    if(((hw2 >> 5) & 3U) != 0U)
+    {
+      Undefined(hw1, hw2, 1);
+      return;
+    }
+    if(((hw1 >> 4) & 1U) != 0U)
+      Cpu.R[Rt] = Cpu.S[n];
+    else
+      Cpu.S[n] = Cpu.R[Rt];
+    return;
+  }
+  Undefined(hw1, hw2, 1);
+}
+
+/* 16-bit instructions ---------------------------------------------------------*/
+static void DataProcessing16(uint32_t hw)
+{
+  uint32_t Rdn = hw & 7U;
+  uint32_t Rm = (hw >> 3) & 7U;
+  uint32_t Result = 0U;
+  uint32_t C = Cpu.C;
+  uint32_t V = Cpu.V;
+  int S = !InIT;
+  int Write = 1;
+
+  switch((hw >> 6) & 15U)
+  {
+  case 0x0U: Result = Cpu.R[Rdn] & Cpu.R[Rm]; break;
+  case 0x1U: Result = Cpu.R[Rdn] ^ Cpu.R[Rm]; break;
+  case 0x2U: Result = Shift_C(Cpu.R[Rdn], SHIFT_LSL, Cpu.R[Rm] & 0xFFU, Cpu.C, &C); break;
+  case 0x3U: Result = Shift_C(Cpu.R[Rdn], SHIFT_LSR, Cpu.R[Rm] & 0xFFU, Cpu.C, &C); break;
+  case 0x4U: Result = Shift_C(Cpu.R[Rdn], SHIFT_ASR, Cpu.R[Rm] & 0xFFU, Cpu.C, &C); break;
+  case 0x5U: Result = AddWithCarry(Cpu.R[Rdn], Cpu.R[Rm], Cpu.C, &C, &V); break;
+  case 0x6U: Result = AddWithCarry(Cpu.R[Rdn], ~Cpu.R[Rm], Cpu.C, &C, &V); break;
+  case 0x7U: Result = Shift_C(Cpu.R[Rdn], SHIFT_ROR, Cpu.R[Rm] & 0xFFU, Cpu.C, &C); break;
+  case 0x8U: Result = Cpu.R[Rdn] & Cpu.R[Rm]; Write = 0; S = 1; break;                  /* TST */
+  case 0x9U: Result = AddWithCarry(~Cpu.R[Rm], 0U, 1U, &C, &V); break;                  /* RSB #0 */
+  case 0xAU: Result = AddWithCarry(Cpu.R[Rdn], ~Cpu.R[Rm], 1U, &C, &V); Write = 0; S = 1; break;
+  case 0xBU: Result = AddWithCarry(Cpu.R[Rdn], Cpu.R[Rm], 0U, &C, &V); Write = 0; S = 1; break;
+  case 0xCU: Result = Cpu.R[Rdn] | Cpu.R[Rm]; break;
+  case 0xDU: Result = Cpu.R[Rdn] * Cpu.R[Rm]; break;
+  case 0xEU: Result = Cpu.R[Rdn] & ~Cpu.R[Rm]; break;
+  default:   Result = ~Cpu.R[Rm]; break;
+  }
+  if(Write)
+    Cpu.R[Rdn] = Result;
+  if(S)
+  {
+    SetNZ(Result);
+    Cpu.C = C;
+    Cpu.V = V;
+  }
+}
+
+static void Special16(uint32_t hw)
+{
+  uint32_t Rdn = (hw & 7U) | ((hw >> 4) & 8U);
+  uint32_t Rm = (hw >> 3) & 15U;
+  uint32_t Result, C, V;
+
+  switch((hw >> 8) & 3U)
+  {
+  case 0U:  /* ADD (register) */
+    Result = Reg(Rdn) + Reg(Rm);
+    if(Rdn == 15U)
+      Branch(Result);
+    else
+      Cpu.R[Rdn] = Result;
+    break;
+  case 1U:  /* CMP (register) */
+    Result = AddWithCarry(Reg(Rdn), ~Reg(Rm), 1U, &C, &V);
+    SetNZ(Result);
+    Cpu.C = C;
+    Cpu.V = V;
+    break;
+  case 2U:  /* MOV (register) */
+    if(Rdn == 15U)
+      Branch(Reg(Rm));
+    else
+      Cpu.R[Rdn] = Reg(Rm);
+    break;
+  default:  /* BX, BLX */
+    Result = Reg(Rm);
+    if((hw & 0x80U) != 0U)
+      Cpu.R[14] = (Pc + 2U) | 1U;
+    BranchExchange(Result);
+    break;
+  }
+}
+
+static void Misc16(uint32_t hw)
+{
+  uint32_t Value, Rn, Imm;
+
+  if((hw & 0xFF00U) == 0xB000U)
+  {
+    /* ADD, SUB SP, SP, #imm */
+    Imm = (hw & 0x7FU) << 2;
+    Cpu.R[13] = ((hw & 0x80U) != 0U) ? Cpu.R[13] - Imm : Cpu.R[13] + Imm;
+  }
+  else if((hw & 0xF500U) == 0xB100U)
+  {
+    /* CBZ, CBNZ */
+    Rn = hw & 7U;
+    Imm = (((hw >> 9) & 1U) << 6) | (((hw >> 3) & 31U) << 1);
+    if((Cpu.R[Rn] != 0U) == (((hw >> 11) & 1U) != 0U))
+      Branch(Pc + 4U + Imm);
+  }
+  else if((hw & 0xFF00U) == 0xB200U)
+  {
+    /* SXTH, SXTB, UXTH, UXTB */
+    Value = Cpu.R[(hw >> 3) & 7U];
+    switch((hw >> 6) & 3U)
+    {
+    case 0U: Value = SignExtend(Value & 0xFFFFU, 16U); break;
+    case 1U: Value = SignExtend(Value & 0xFFU, 8U); break;
+    case 2U: Value &= 0xFFFFU; break;
+    default: Value &= 0xFFU; break;
+    }
+    Cpu.R[hw & 7U] = Value;
+  }
+  else if((hw & 0xFE00U) == 0xB400U)
+  {
+    /* PUSH */
+    StoreMultiple(13U, (hw & 0xFFU) | (((hw & 0x100U) != 0U) ? 0x4000U : 0U), 1, 1);
+  }
+  else if((hw & 0xFFE8U) == 0xB660U)
+  {
+    /* CPSIE, CPSID */
+    if((hw & 2U) != 0U)
+      Cpu.PRIMASK = (hw >> 4) & 1U;
+    if((hw & 1U) != 0U)
+      Cpu.FAULTMASK = (hw >> 4) & 1U;
+  }
+  else if((hw & 0xFF00U) == 0xBA00U)
+  {
+    /* REV, REV16, REVSH */
+    Value = Cpu.R[(hw >> 3) & 7U];
+    switch((hw >> 6) & 3U)
+    {
+    case 0U: Value = __builtin_bswap32(Value); break;
+    case 1U: Value = ((Value & 0x00FF00FFU) << 8) | ((Value >> 8) & 0x00FF00FFU); break;
+    case 3U: Value = SignExtend(((Value & 0xFFU) << 8) | ((Value >> 8) & 0xFFU), 16U); break;
+    default: Undefined(hw, 0U, 0); return;
+    }
+    Cpu.R[hw & 7U] = Value;
+  }
+  else if((hw & 0xFE00U) == 0xBC00U)
+  {
+    /* POP */
+    LoadMultiple(13U, (hw & 0xFFU) | (((hw & 0x100U) != 0U) ? 0x8000U : 0U), 1, 0);
+  }
+  else if((hw & 0xFF00U) == 0xBE00U)
+    Emu_Fault("BKPT #%u", (unsigned)(hw & 0xFFU));
+  else if((hw & 0xFF00U) == 0xBF00U)
+  {
+    /* IT, or NOP, YIELD, WFE, WFI, SEV */
+    if((hw & 15U) != 0U)
+      Cpu.ITState = hw & 0xFFU;
+  }
+  else
+    Undefined(hw, 0U, 0);
+}
+
+static void Thumb16(uint32_t hw)
+{
+  uint32_t Rd = hw & 7U;
+  uint32_t Rn = (hw >> 3) & 7U;
+  uint32_t Rm = (hw >> 6) & 7U;
+  uint32_t Imm8 = hw & 0xFFU;
+  uint32_t Rdn = (hw >> 8) & 7U;
+  uint32_t Result, Type, Amount, C = Cpu.C, V = Cpu.V;
+  int S = !InIT;
+
+  switch(hw >> 11)
+  {
+  case 0x00U: case 0x01U: case 0x02U:
+    /* LSL, LSR, ASR (immediate), MOV (register) */
+    DecodeImmShift(hw >> 11, (hw >> 6) & 31U, &Type, &Amount);
+    Result = Shift_C(Cpu.R[Rn], Type, Amount, Cpu.C, &C);
+    Cpu.R[Rd] = Result;
+    if(S)
+    {
+      SetNZ(Result);
+      Cpu.C = C;
+    }
+    break;
+  case 0x03U:
+    /* ADD, SUB (register), ADD, SUB (3-bit immediate) */
+    switch((hw >> 9) & 3U)
+    {
+    case 0U: Result = AddWithCarry(Cpu.R[Rn], Cpu.R[Rm], 0U, &C, &V); break;
+    case 1U: Result = AddWithCarry(Cpu.R[Rn], ~Cpu.R[Rm], 1U, &C, &V); break;
+    case 2U: Result = AddWithCarry(Cpu.R[Rn], Rm, 0U, &C, &V); break;
+    default: Result = AddWithCarry(Cpu.R[Rn], ~Rm, 1U, &C, &V); break;
+    }
+    Cpu.R[Rd] = Result;
+    if(S)
+    {
+      SetNZ(Result);
+      Cpu.C = C;
+      Cpu.V = V;
+    }
+    break;
+  case 0x04U:
+    /* MOV (immediate) */
+    Cpu.R[Rdn] = Imm8;
+    if(S)
+      SetNZ(Imm8);
+    break;
+  case 0x05U:
+    /* CMP (immediate) */
+    Result = AddWithCarry(Cpu.R[Rdn], ~Imm8, 1U, &C, &V);
+    SetNZ(Result);
+    Cpu.C = C;
+    Cpu.V = V;
+    break;
+  case 0x06U: case 0x07U:
+    /* ADD, SUB (8-bit immediate) */
+    if((hw >> 11) == 0x06U)
+      Result = AddWithCarry(Cpu.R[Rdn], Imm8, 0U, &C, &V);
+    else
+      Result = AddWithCarry(Cpu.R[Rdn], ~Imm8, 1U, &C, &V);
+    Cpu.R[Rdn] = Result;
+    if(S)
+    {
+      SetNZ(Result);
+      Cpu.C = C;
+      Cpu.V = V;
+    }
+    break;
+  case 0x08U:
+    if((hw & 0x0400U) == 0U)
+      DataProcessing16(hw);
+    else
+      Special16(hw);
+    break;
+  case 0x09U:
+    /* LDR (literal) */
+    LoadStoreSingle(1, Rdn, ALIGN4(Pc + 4U) + Imm8 * 4U, 4U, 0);
+    break;
+  case 0x0AU: case 0x0BU:
+    /* Loads and stores with a register offset */
+    Result = Cpu.R[Rn] + Cpu.R[Rm];
+    switch((hw >> 9) & 7U)
+    {
+    case 0U: LoadStoreSingle(0, Rd, Result, 4U, 0); break;  /* STR   */
+    case 1U: LoadStoreSingle(0, Rd, Result, 2U, 0); break;  /* STRH  */
+    case 2U: LoadStoreSingle(0, Rd, Result, 1U, 0); break;  /* STRB  */
+    case 3U: LoadStoreSingle(1, Rd, Result, 1U, 1); break;  /* LDRSB */
+    case 4U: LoadStoreSingle(1, Rd, Result, 4U, 0); break;  /* LDR   */
+    case 5U: LoadStoreSingle(1, Rd, Result, 2U, 0); break;  /* LDRH  */
+    case 6U: LoadStoreSingle(1, Rd, Result, 1U, 0); break;  /* LDRB  */
+    default: LoadStoreSingle(1, Rd, Result, 2U, 1); break;  /* LDRSH */
+    }
+    break;
+  case 0x0CU: case 0x0DU:
+    /* STR, LDR (immediate) */
+    LoadStoreSingle((hw >> 11) & 1U, Rd, Cpu.R[Rn] + ((hw >> 6) & 31U) * 4U, 4U, 0);
+    break;
+  case 0x0EU: case 0x0FU:
+    /* STRB, LDRB (immediate) */
+    LoadStoreSingle((hw >> 11) & 1U, Rd, Cpu.R[Rn] + ((hw >> 6) & 31U), 1U, 0);
+    break;
+  case 0x10U: case 0x11U:
+    /* STRH, LDRH (immediate) */
+    LoadStoreSingle((hw >> 11) & 1U, Rd, Cpu.R[Rn] + ((hw >> 6) & 31U) * 2U, 2U, 0);
+    break;
+  case 0x12U: case 0x13U:
+    /* STR, LDR (SP relative) */
+    LoadStoreSingle((hw >> 11) & 1U, Rdn, Cpu.R[13] + Imm8 * 4U, 4U, 0);
+    break;
+  case 0x14U:
+    /* ADR */
+    Cpu.R[Rdn] = ALIGN4(Pc + 4U) + Imm8 * 4U;
+    break;
+  case 0x15U:
+    /* ADD (SP plus immediate) */
+    Cpu.R[Rdn] = Cpu.R[13] + Imm8 * 4U;
+    break;
+  case 0x16U: case 0x17U:
+    Misc16(hw);
+    break;
+  case 0x18U:
+    /* STM */
+    StoreMultiple(Rdn, Imm8, 1, 0);
+    break;
+  case 0x19U:
+    /* LDM */
+    LoadMultiple(Rdn, Imm8, 1, 0);
+    break;
+  case 0x1AU: case 0x1BU:
+    /* B<cond>, UDF, SVC */
+    if(((hw >> 8) & 15U) == 0xFU)
+      Emu_Fault("SVC #%u", (unsigned)Imm8);
+    else if(((hw >> 8) & 15U) == 0xEU)
+      Undefined(hw, 0U, 0);
+    else if(ConditionPassed((hw >> 8) & 15U))
+      Branch(Pc + 4U + SignExtend(Imm8 << 1, 9U));
+    break;
+  default:
+    /* B */
+    Branch(Pc + 4U + SignExtend((hw & 0x7FFU) << 1, 12U));
+    break;
+  }
+}
+
+static void Thumb32(uint32_t hw1, uint32_t hw2)
+{
+  switch((hw1 >> 11) & 3U)
+  {
+  case 1U:
+    if((hw1 & 0xFE40U) == 0xE800U)
+      LoadStoreMultiple32(hw1, hw2);
+    else if((hw1 & 0xFE40U) == 0xE840U)
+      LoadStoreDual(hw1, hw2);
+    else if((hw1 & 0xFE00U) == 0xEA00U)
+      DataProcessingShifted(hw1, hw2);
+    else
+      Coprocessor(hw1, hw2);
+    break;
+  case 2U:
+    if((hw2 & 0x8000U) != 0U)
+      BranchMisc(hw1, hw2);
+    else if((hw1 & 0x0200U) != 0U)
+      DataProcessingPlain(hw1, hw2);
+    else
+      DataProcessingModified(hw1, hw2);
+    break;
+  default:
+    if((hw1 & 0xFE00U) == 0xF800U)
+      LoadStoreSingle32(hw1, hw2);
+    else if((hw1 & 0xFF00U) == 0xFA00U)
+      DataProcessingRegister(hw1, hw2);
+    else if((hw1 & 0xFF80U) == 0xFB00U)
+      Multiply(hw1, hw2);
+    else if((hw1 & 0xFF80U) == 0xFB80U)
+      LongMultiply(hw1, hw2);
+    else
+      Coprocessor(hw1, hw2);
+    break;
+  }
+}
+
+/* Runs one instruction */
+static void Step(void)
+{
+  uint32_t hw1 = Load(Pc, 2U);
+  uint32_t hw2 = 0U;
+  int Wide = ((hw1 >> 11) >= 0x1DU);
+
+  if(Wide)
+    hw2 = Load(Pc + 2U, 2U);
+  NextPc = Pc + (Wide ? 4U : 2U);
+  Cost = 1U;
+  LoadStore = 0;
+  InIT = ((Cpu.ITState & 15U) != 0U);
+  if(!InIT || ConditionPassed(Cpu.ITState >> 4))
+  {
+    if(Wide)
+      Thumb32(hw1, hw2);
+    else
+      Thumb16(hw1);
+  }
+  if(InIT)
+    Cpu.ITState = ((Cpu.ITState & 7U) == 0U) ? 0U : (Cpu.ITState & 0xE0U) | ((Cpu.ITState << 1) & 0x1FU);
+  if(LoadStore && LastLoadStore && (Cost == 2U))
+    Cost = 1U;
+  LastLoadStore = LoadStore;
+  Cpu.Instructions++;
+  Cpu.Cycles += Cost;
+  Pc = NextPc;
+}
+
+int Emu_Run(uint64_t Limit)
+{
+  uint64_t End = Cpu.Instructions + Limit;
+
+  Stopped = 0;
+  LastLoadStore = 0;
+  Pc = Cpu.R[15] & ~1U;
+  while((Pc != EMU_RETURN) && !Stopped)
+  {
+    if(Cpu.Instructions >= End)
+      Emu_Fault("no return after %llu instructions", (unsigned long long)Limit);
+    else
+      Step();
+  }
+  Cpu.R[15] = Pc;
+  return Stopped ? -1 : 0;
+}
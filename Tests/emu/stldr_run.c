@@ -0,0 +1,455 @@
+/**
+  ******************************************************************************
+  * @file    stldr_run.c
+  * @brief   Runs a loader binary (.stldr) under the Cortex-M emulator, as
+  *          the STM32CubeProgrammer does in a session erasing, writing and
+  *          verifying an image: Init, SectorErase over the image, Write and
+  *          Verify of it by buffers, CheckSum, and MassErase, each operation
+  *          after its own Init. Each result is checked against the host:
+  *          the memory content, the checksums, and the return values.
+  *
+  *          For each entry point it reports the instructions and the core
+  *          cycles it ran, per call and per byte, and the stack it used.
+  *          The external memory is never busy, so the counts are the ones
+  *          of the loader and its drivers alone: a released binary and a
+  *          rebuilt one are compared by their reports.
+  ******************************************************************************
+  */
+
+#include <elf.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "emu.h"
+
+#define IMAGE_SIZE    0x40000U       /* Image erased, written and verified   */
+#define BUFFER_SIZE   0x8000U        /* Bytes of each Write and Verify call  */
+#define STACK_SIZE    0x4000U
+#define STACK_FILL    0xCDCDCDCDU
+#define CALL_LIMIT    2000000000ULL  /* Instructions of a call              */
+
+typedef enum
+{
+  ENTRY_INIT = 0,
+  ENTRY_SECTOR_ERASE,
+  ENTRY_WRITE,
+  ENTRY_VERIFY,
+  ENTRY_CHECKSUM,
+  ENTRY_MASS_ERASE,
+  ENTRY_COUNT
+} ENTRY;
+
+typedef struct
+{
+  const char* Name;
+  uint32_t Address;        /* Thumb bit set, 0 when the loader has none */
+  uint32_t Calls;
+  uint64_t Bytes;
+  uint64_t Instructions;
+  uint64_t Cycles;
+  uint32_t Stack;
+} ENTRY_COUNTS;
+
+/* Identification of the memories, by the name of the loader */
+typedef struct
+{
+  const char* Name;
+  uint8_t Id[3];
+} MEMORY_ID;
+
+static const MEMORY_ID MemoryIds[] =
+{
+  {"MT25QL512A",   {0x20U, 0xBAU, 0x20U}},
+  {"MT25QL128A",   {0x20U, 0xBAU, 0x18U}},
+  {"N25Q128A",     {0x20U, 0xBAU, 0x18U}},
+  {"N25Q256A",     {0x20U, 0xBAU, 0x19U}},
+  {"N25Q512A",     {0x20U, 0xBAU, 0x20U}},
+  {"MT25TL01G",    {0x20U, 0xBAU, 0x21U}},
+  {"MX25LM51245G", {0xC2U, 0x85U, 0x3AU}},
+  {"MX25R6435F",   {0xC2U, 0x28U, 0x17U}},
+  {"MX25L512",     {0xC2U, 0x20U, 0x1AU}},
+  {"MX25UM51245G", {0xC2U, 0x80U, 0x3AU}},
+};
+
+static const char* DeviceNames[] = {"STM32F4", "STM32L4", "STM32H7"};
+
+static uint8_t* File;
+static long FileSize;
+static const Elf32_Shdr* Sections;
+static uint32_t SectionCount;
+static ENTRY_COUNTS Entries[ENTRY_COUNT];
+static uint32_t StackTop;
+static uint32_t Buffer;
+static int Failed;
+
+static uint32_t Read32(const uint8_t* Data)
+{
+  return Data[0] | (Data[1] << 8) | (Data[2] << 16) | ((uint32_t)Data[3] << 24);
+}
+
+/* Symbol of a name, NULL when the loader has none */
+static const Elf32_Sym* Elf_Symbol(const char* Name)
+{
+  const Elf32_Sym* Symbols;
+  const char* Names;
+  uint32_t i, j;
+
+  for(i = 0; i < SectionCount; i++)
+  {
+    if(Sections[i].sh_type != SHT_SYMTAB)
+      continue;
+    Symbols = (const Elf32_Sym*)(File + Sections[i].sh_offset);
+    Names = (const char*)(File + Sections[Sections[i].sh_link].sh_offset);
+    for(j = 0; j < Sections[i].sh_size / sizeof(Elf32_Sym); j++)
+    {
+      if(strcmp(Names + Symbols[j].st_name, Name) == 0)
+        return &Symbols[j];
+    }
+  }
+  return NULL;
+}
+
+/* Whether a symbol name contains Text, as the source file names of the
+   HAL the loader is built with */
+static int Elf_HasSymbol(const char* Text)
+{
+  const Elf32_Sym* Symbols;
+  const char* Names;
+  uint32_t i, j;
+
+  for(i = 0; i < SectionCount; i++)
+  {
+    if(Sections[i].sh_type != SHT_SYMTAB)
+      continue;
+    Symbols = (const Elf32_Sym*)(File + Sections[i].sh_offset);
+    Names = (const char*)(File + Sections[Sections[i].sh_link].sh_offset);
+    for(j = 0; j < Sections[i].sh_size / sizeof(Elf32_Sym); j++)
+    {
+      if(strstr(Names + Symbols[j].st_name, Text) != NULL)
+        return 1;
+    }
+  }
+  return 0;
+}
+
+/* StorageInfo of Dev_Inf.h, as laid out by the ARM compilers */
+static const uint8_t* Elf_StorageInfo(void)
+{
+  const Elf32_Sym* Symbol = Elf_Symbol("StorageInfo");
+  const Elf32_Shdr* Section;
+
+  if((Symbol == NULL) || (Symbol->st_shndx >= SectionCount) || (Symbol->st_size < 200U))
+    return NULL;
+  Section = &Sections[Symbol->st_shndx];
+  return File + Section->sh_offset + (Symbol->st_value - Section->sh_addr);
+}
+
+/* Copies the segments to the RAM, and returns the end of the highest one
+   or of the highest zero-initialized section, which the IAR linker leaves
+   out of the segments */
+static uint32_t Elf_Load(const Elf32_Ehdr* Header)
+{
+  const Elf32_Phdr* Segments = (const Elf32_Phdr*)(File + Header->e_phoff);
+  uint32_t End = 0U;
+  uint8_t* Ram;
+  uint32_t i;
+
+  for(i = 0; i < Header->e_phnum; i++)
+  {
+    if((Segments[i].p_type != PT_LOAD) || (Segments[i].p_memsz == 0U) ||
+       (Segments[i].p_offset + (uint64_t)Segments[i].p_filesz > (uint64_t)FileSize))
+      continue;
+    Ram = Bus_Ram(Segments[i].p_vaddr, Segments[i].p_memsz);
+    if(Ram == NULL)
+    {
+      printf("  segment at 0x%08X of %u bytes out of the RAM\n", (unsigned)Segments[i].p_vaddr,
+             (unsigned)Segments[i].p_memsz);
+      continue;
+    }
+    memset(Ram, 0, Segments[i].p_memsz);
+    memcpy(Ram, File + Segments[i].p_offset, Segments[i].p_filesz);
+    if(Segments[i].p_vaddr + Segments[i].p_memsz > End)
+      End = Segments[i].p_vaddr + Segments[i].p_memsz;
+  }
+  for(i = 0; i < SectionCount; i++)
+  {
+    if(((Sections[i].sh_flags & SHF_ALLOC) != 0U) && (Sections[i].sh_addr + Sections[i].sh_size > End))
+      End = Sections[i].sh_addr + Sections[i].sh_size;
+  }
+  return End;
+}
+
+/* Runs an entry point with up to four arguments, and returns R1:R0 */
+static uint64_t Call(ENTRY Entry, uint32_t Arg0, uint32_t Arg1, uint32_t Arg2, uint32_t Arg3, uint32_t Bytes)
+{
+  ENTRY_COUNTS* Counts = &Entries[Entry];
+  uint32_t* Stack = (uint32_t*)Bus_Ram(StackTop - STACK_SIZE, STACK_SIZE);
+  uint64_t Instructions = Cpu.Instructions;
+  uint64_t Cycles = Cpu.Cycles;
+  uint32_t Used;
+
+  for(Used = 0U; Used < STACK_SIZE / 4U; Used++)
+    Stack[Used] = STACK_FILL;
+  Cpu.R[0] = Arg0;
+  Cpu.R[1] = Arg1;
+  Cpu.R[2] = Arg2;
+  Cpu.R[3] = Arg3;
+  Cpu.R[13] = StackTop;
+  Cpu.R[14] = EMU_RETURN | 1U;
+  Cpu.R[15] = Counts->Address;
+  Cpu.ITState = 0U;
+  if(Emu_Run(CALL_LIMIT) != 0)
+  {
+    printf("  %s: %s\n", Counts->Name, Emu_Error());
+    Failed = 1;
+  }
+  for(Used = 0U; (Used < STACK_SIZE / 4U) && (Stack[Used] == STACK_FILL); Used++)
+    ;
+  Used = STACK_SIZE - 4U * Used;
+  Counts->Calls++;
+  Counts->Bytes += Bytes;
+  Counts->Instructions += Cpu.Instructions - Instructions;
+  Counts->Cycles += Cpu.Cycles - Cycles;
+  if(Used > Counts->Stack)
+    Counts->Stack = Used;
+  return ((uint64_t)Cpu.R[1] << 32) | Cpu.R[0];
+}
+
+static void Check(int Condition, const char* Message)
+{
+  if(!Condition && !Failed)
+  {
+    printf("  %s\n", Message);
+    Failed = 1;
+  }
+}
+
+static int IsErased(const uint8_t* Data, uint32_t Size)
+{
+  uint32_t i;
+
+  for(i = 0U; i < Size; i++)
+  {
+    if(Data[i] != 0xFFU)
+      return 0;
+  }
+  return 1;
+}
+
+static uint32_t Sum(const uint8_t* Data, uint32_t Size)
+{
+  uint32_t Value = 0U;
+  uint32_t i;
+
+  for(i = 0U; i < Size; i++)
+    Value += Data[i];
+  return Value;
+}
+
+/* Runs Init before an operation, as each operation of a session does */
+static int Init(void)
+{
+  if(Failed)
+    return 0;
+  Check((uint32_t)Call(ENTRY_INIT, 0U, 0U, 0U, 0U, 0U) == 1U, "Init failed");
+  return !Failed;
+}
+
+/* Erase, write and verify session of an image at the start of the memory */
+static void Session(uint32_t Base, uint32_t Size)
+{
+  uint8_t* Memory = Bus_Memory();
+  uint8_t* Image = malloc(IMAGE_SIZE);
+  uint32_t Seed = 0x2545F491U;
+  uint64_t Result;
+  uint32_t Offset, i;
+
+  for(i = 0U; i < Size; i++)
+  {
+    Seed ^= Seed << 13;
+    Seed ^= Seed >> 17;
+    Seed ^= Seed << 5;
+    Memory[i] = (uint8_t)Seed;
+    if(i < IMAGE_SIZE)
+      Image[i] = (uint8_t)(Seed >> 8);
+  }
+
+  if(Init() && (Entries[ENTRY_SECTOR_ERASE].Address != 0U))
+  {
+    Check((uint32_t)Call(ENTRY_SECTOR_ERASE, Base, Base + IMAGE_SIZE - 1U, 0U, 0U, IMAGE_SIZE) == 1U,
+          "SectorErase failed");
+    Check(IsErased(Memory, IMAGE_SIZE), "SectorErase left bytes not erased");
+  }
+  if(Init())
+  {
+    for(Offset = 0U; (Offset < IMAGE_SIZE) && !Failed; Offset += BUFFER_SIZE)
+    {
+      memcpy(Bus_Ram(Buffer, BUFFER_SIZE), Image + Offset, BUFFER_SIZE);
+      Check((uint32_t)Call(ENTRY_WRITE, Base + Offset, BUFFER_SIZE, Buffer, 0U, BUFFER_SIZE) == 1U, "Write failed");
+    }
+    Check(memcmp(Memory, Image, IMAGE_SIZE) == 0, "Write left the memory different from the image");
+  }
+  if(Init() && (Entries[ENTRY_VERIFY].Address != 0U))
+  {
+    for(Offset = 0U; (Offset < IMAGE_SIZE) && !Failed; Offset += BUFFER_SIZE)
+    {
+      memcpy(Bus_Ram(Buffer, BUFFER_SIZE), Image + Offset, BUFFER_SIZE);
+      Result = Call(ENTRY_VERIFY, Base + Offset, Buffer, BUFFER_SIZE / 4U, 0U, BUFFER_SIZE);
+      Check((uint32_t)Result == 0U, "Verify reported a difference");
+      Check((uint32_t)(Result >> 32) == Sum(Image + Offset, BUFFER_SIZE), "Verify returned a wrong checksum");
+    }
+  }
+  if(Init() && (Entries[ENTRY_CHECKSUM].Address != 0U))
+    Check((uint32_t)Call(ENTRY_CHECKSUM, Base, IMAGE_SIZE, 0U, 0U, IMAGE_SIZE) == Sum(Image, IMAGE_SIZE),
+          "CheckSum returned a wrong checksum");
+  if(Init() && (Entries[ENTRY_MASS_ERASE].Address != 0U))
+  {
+    Check((uint32_t)Call(ENTRY_MASS_ERASE, 0U, 0U, 0U, 0U, Size) == 1U, "MassErase failed");
+    Check(IsErased(Memory, Size), "MassErase left bytes not erased");
+  }
+  free(Image);
+}
+
+static void Report(void)
+{
+  const ENTRY_COUNTS* Counts;
+  uint32_t i;
+
+  printf("  %-12s %5s %9s %13s %13s %11s %11s %6s\n", "Entry", "Calls", "Bytes", "Instructions", "Cycles",
+         "Instr/byte", "Cycles/byte", "Stack");
+  for(i = 0U; i < ENTRY_COUNT; i++)
+  {
+    Counts = &Entries[i];
+    if(Counts->Calls == 0U)
+      continue;
+    printf("  %-12s %5u %9llu %13llu %13llu", Counts->Name, (unsigned)Counts->Calls,
+           (unsigned long long)Counts->Bytes, (unsigned long long)Counts->Instructions,
+           (unsigned long long)Counts->Cycles);
+    if(Counts->Bytes != 0U)
+      printf(" %11.3f %11.3f", (double)Counts->Instructions / (double)Counts->Bytes,
+             (double)Counts->Cycles / (double)Counts->Bytes);
+    else
+      printf(" %11s %11s", "-", "-");
+    printf(" %6u\n", (unsigned)Counts->Stack);
+  }
+  printf("  memory: %llu commands, %llu status polls, %llu programs, %llu erases, %llu mapped reads, %u errors\n",
+         (unsigned long long)MemoryStats.Commands, (unsigned long long)MemoryStats.Polls,
+         (unsigned long long)MemoryStats.Programs, (unsigned long long)MemoryStats.Erases,
+         (unsigned long long)MemoryStats.MappedReads, (unsigned)MemoryStats.Errors);
+}
+
+static int Run(const char* Path)
+{
+  static const char* Names[ENTRY_COUNT] = {"Init", "SectorErase", "Write", "Verify", "CheckSum", "MassErase"};
+  const Elf32_Ehdr* Header = (const Elf32_Ehdr*)File;
+  const uint8_t* Info;
+  const MEMORY_ID* Id = NULL;
+  const Elf32_Sym* Symbol;
+  EMU_DEVICE Device;
+  uint32_t Base, Size, End, i;
+  int Octo;
+
+  if((memcmp(Header->e_ident, ELFMAG, SELFMAG) != 0) || (Header->e_ident[EI_CLASS] != ELFCLASS32) ||
+     (Header->e_machine != EM_ARM) ||
+     (Header->e_shoff + (uint64_t)Header->e_shnum * sizeof(Elf32_Shdr) > (uint64_t)FileSize) ||
+     (Header->e_phoff + (uint64_t)Header->e_phnum * sizeof(Elf32_Phdr) > (uint64_t)FileSize))
+  {
+    printf("%s: not an ARM ELF32 loader\n", Path);
+    return 1;
+  }
+  Sections = (const Elf32_Shdr*)(File + Header->e_shoff);
+  SectionCount = Header->e_shnum;
+  if((Info = Elf_StorageInfo()) == NULL)
+  {
+    printf("%s: StorageInfo not found\n", Path);
+    return 1;
+  }
+  Base = Read32(Info + 104);
+  Size = Read32(Info + 108);
+  for(i = 0U; i < sizeof(MemoryIds) / sizeof(MemoryIds[0]); i++)
+  {
+    if(strncmp((const char*)Info, MemoryIds[i].Name, strlen(MemoryIds[i].Name)) == 0)
+      Id = &MemoryIds[i];
+  }
+  if((Id == NULL) || (Size > 0x10000000U))
+  {
+    printf("%s: %.100s is not a known external NOR flash\n", Path, (const char*)Info);
+    return 1;
+  }
+
+  /* The device of the HAL the loader is built with, its interface, and
+     its entry points */
+  if(Elf_HasSymbol("stm32h7xx"))
+    Device = EMU_STM32H7;
+  else if(Elf_HasSymbol("stm32l4xx"))
+    Device = EMU_STM32L4;
+  else if(Elf_HasSymbol("stm32f4xx"))
+    Device = EMU_STM32F4;
+  else
+  {
+    printf("%s: device not found\n", Path);
+    return 1;
+  }
+  Octo = Elf_HasSymbol("OSPI");
+  memset(Entries, 0, sizeof(Entries));
+  for(i = 0U; i < ENTRY_COUNT; i++)
+  {
+    Entries[i].Name = Names[i];
+    Symbol = Elf_Symbol(Names[i]);
+    if((Symbol != NULL) && (ELF32_ST_TYPE(Symbol->st_info) == STT_FUNC))
+      Entries[i].Address = Symbol->st_value | 1U;
+  }
+  if((Entries[ENTRY_INIT].Address == 0U) || (Entries[ENTRY_WRITE].Address == 0U))
+  {
+    printf("%s: no Init or Write\n", Path);
+    return 1;
+  }
+
+  printf("%s\n", Path);
+  printf("  %.100s: %s, %s, 0x%08X, %u bytes\n", (const char*)Info, DeviceNames[Device],
+         Octo ? "OCTOSPI" : "QUADSPI", (unsigned)Base, (unsigned)Size);
+  memset(&Cpu, 0, sizeof(Cpu));
+  Bus_Init(Device, Octo, Base, Size, Id->Id);
+  End = Elf_Load(Header);
+
+  /* The stack and the buffer follow the loader */
+  StackTop = ((End + 7U) & ~7U) + STACK_SIZE;
+  Buffer = StackTop;
+  if(Bus_Ram(Buffer, BUFFER_SIZE) == NULL)
+  {
+    printf("  no RAM for the stack and the buffer after 0x%08X\n", (unsigned)End);
+    return 1;
+  }
+  Failed = 0;
+  Session(Base, Size);
+  Report();
+  printf("\n");
+  return Failed;
+}
+
+int main(int argc, char** argv)
+{
+  FILE* Input;
+  int Arg;
+  int Result = 0;
+
+  for(Arg = 1; Arg < argc; Arg++)
+  {
+    if(((Input = fopen(argv[Arg], "rb")) == NULL) || (fseek(Input, 0, SEEK_END) != 0) ||
+       ((FileSize = ftell(Input)) < (long)sizeof(Elf32_Ehdr)))
+    {
+      printf("%s: cannot be read\n", argv[Arg]);
+      return 1;
+    }
+    File = malloc(FileSize);
+    rewind(Input);
+    if((File == NULL) || (fread(File, 1, FileSize, Input) != (size_t)FileSize))
+      return 1;
+    fclose(Input);
+    Result |= Run(argv[Arg]);
+    free(File);
+  }
+
+  return Result;
+}
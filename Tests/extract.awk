@@ -0,0 +1,39 @@
+# Prints the definitions of the functions and tables named in "funcs" (space
+# separated), in that order, from a Loader_Src.c file. A definition starts on
+# a line at column 0 holding the name followed by "(" or "[" and not ending
+# with ";", and ends on the next line starting with "}". When a name is
+# defined more than once (#if/#else variants), the last definition is kept.
+BEGIN {
+  count = split(funcs, names, " ")
+  current = ""
+}
+
+{
+  if (current == "") {
+    if ($0 ~ /^[A-Za-z_]/ && $0 !~ /;[ \t]*$/) {
+      for (i = 1; i <= count; i++) {
+        if ($0 ~ ("[ *]" names[i] "[ \t]*[([]")) {
+          current = names[i]
+          body[current] = ""
+          line[current] = NR
+          break
+        }
+      }
+    }
+  }
+  if (current != "") {
+    body[current] = body[current] $0 "\n"
+    if ($0 ~ /^}/)
+      current = ""
+  }
+}
+
+END {
+  for (i = 1; i <= count; i++) {
+    if (!(names[i] in body)) {
+      print "extract.awk: " names[i] " not found in " FILENAME > "/dev/stderr"
+      exit 1
+    }
+    printf "#line %d \"%s\"\n%s\n", line[names[i]], FILENAME, body[names[i]]
+  }
+}
@@ -0,0 +1,172 @@
+/**
+  ******************************************************************************
+  * @file    reference.h
+  * @brief   CheckSum and Verify of the original loaders, the references the
+  *          word-parallel versions are compared with, and the CRC-32 of zlib.
+  ******************************************************************************
+  */
+
+#ifndef REFERENCE_H
+#define REFERENCE_H
+
+/* CheckSum of the original loaders, the reference of the word-parallel one */
+static inline uint32_t Ref_CheckSum(uint32_t StartAddress, uint32_t Size, uint32_t InitVal)
+{
+  uint8_t missalignementAddress = StartAddress%4;
+  uint8_t missalignementSize = Size ;
+  int cnt;
+  uint32_t Val;
+
+  StartAddress-=StartAddress%4;
+  Size += (Size%4==0)?0:4-(Size%4);
+
+  for(cnt=0; cnt<Size ; cnt+=4)
+  {
+    Val = *(uint32_t*)StartAddress;
+    if(missalignementAddress)
+    {
+      switch (missalignementAddress)
+      {
+        case 1:
+          InitVal += (uint8_t) (Val>>8 & 0xff);
+          InitVal += (uint8_t) (Val>>16 & 0xff);
+          InitVal += (uint8_t) (Val>>24 & 0xff);
+          missalignementAddress-=1;
+          break;
+        case 2:
+          InitVal += (uint8_t) (Val>>16 & 0xff);
+          InitVal += (uint8_t) (Val>>24 & 0xff);
+          missalignementAddress-=2;
+          break;
+        case 3:
+          InitVal += (uint8_t) (Val>>24 & 0xff);
+          missalignementAddress-=3;
+          break;
+      }
+    }
+    else if((Size-missalignementSize)%4 && (Size-cnt) <=4)
+    {
+      switch (Size-missalignementSize)
+      {
+        case 1:
+          InitVal += (uint8_t) Val;
+          InitVal += (uint8_t) (Val>>8 & 0xff);
+          InitVal += (uint8_t) (Val>>16 & 0xff);
+          missalignementSize-=1;
+          break;
+        case 2:
+          InitVal += (uint8_t) Val;
+          InitVal += (uint8_t) (Val>>8 & 0xff);
+          missalignementSize-=2;
+          break;
+        case 3:
+          InitVal += (uint8_t) Val;
+          missalignementSize-=3;
+          break;
+      }
+    }
+    else
+    {
+      InitVal += (uint8_t) Val;
+      InitVal += (uint8_t) (Val>>8 & 0xff);
+      InitVal += (uint8_t) (Val>>16 & 0xff);
+      InitVal += (uint8_t) (Val>>24 & 0xff);
+    }
+    StartAddress+=4;
+  }
+
+  return (InitVal);
+}
+
+/* Verify of the original memory-mapped loaders */
+static inline uint64_t Ref_Verify(uint32_t MemoryAddr, uint32_t RAMBufferAddr, uint32_t Size, uint32_t missalignement)
+{
+  uint32_t VerifiedData = 0, InitVal = 0;
+  uint64_t checksum;
+  Size*=4;
+
+  checksum = Ref_CheckSum((uint32_t)MemoryAddr + (missalignement & 0xf), Size - ((missalignement >> 16) & 0xF), InitVal);
+  while (Size>VerifiedData)
+  {
+    if ( *(uint8_t*)MemoryAddr++ != *((uint8_t*)RAMBufferAddr + VerifiedData))
+      return ((checksum<<32) + (MemoryAddr + VerifiedData));
+
+    VerifiedData++;
+  }
+
+  return (checksum<<32);
+}
+
+/* Verify of the original FMC NOR loaders reading the memory through the BSP,
+   the memory being at StartAddresse 0 on the host */
+static inline uint64_t Ref_NorVerify(uint32_t MemoryAddr, uint32_t RAMBufferAddr, uint32_t Size, uint32_t missalignement)
+{
+  uint32_t InternalAddr = MemoryAddr - StartAddresse;
+  uint32_t VerifiedData = 0, InitVal = 0;
+  uint16_t TmpBuffer = 0x0000;
+  uint64_t checksum;
+  Size*=4;
+
+  checksum = Ref_CheckSum((uint32_t)MemoryAddr + (missalignement & 0xf), Size - ((missalignement >> 16) & 0xF), InitVal);
+  if (InternalAddr%2 != 0)
+  {
+    BSP_NOR_ReadData((InternalAddr - InternalAddr%2), &TmpBuffer, 1);
+
+    if ((uint8_t)(TmpBuffer>>8) != (*(uint8_t*)RAMBufferAddr))
+      return ((checksum<<32) +  MemoryAddr);
+    VerifiedData++;
+  }
+
+  while ((Size-VerifiedData)>1)
+  {
+    BSP_NOR_ReadData(InternalAddr+VerifiedData, &TmpBuffer, 1);
+
+    if ((TmpBuffer&0x00FF) != (*((uint8_t*)RAMBufferAddr+VerifiedData)))
+      return ((checksum<<32) + MemoryAddr+VerifiedData);
+
+    VerifiedData++;
+
+    if ((uint8_t)(TmpBuffer>>8) != (*((uint8_t*)RAMBufferAddr+VerifiedData)))
+      return ((checksum<<32) + MemoryAddr+VerifiedData);
+
+    VerifiedData++;
+  }
+
+  if ((Size-VerifiedData) != 0)
+  {
+    BSP_NOR_ReadData(InternalAddr+VerifiedData, &TmpBuffer, 1);
+
+    if ((uint8_t)(TmpBuffer&0x00FF) != (*((uint8_t*)RAMBufferAddr+VerifiedData)))
+      return ((checksum<<32) + MemoryAddr+VerifiedData);
+  }
+
+  return (checksum<<32);
+}
+
+/* Table-driven CRC-32 of zlib crc32(), independent of the bitwise model of
+   the CRC unit */
+static inline uint32_t Ref_Crc32(const uint8_t* Data, uint32_t Size)
+{
+  static uint32_t Table[256];
+  uint32_t Crc;
+  uint32_t i, Bit;
+
+  if(Table[1] == 0)
+  {
+    for(i = 0; i < 256; i++)
+    {
+      Crc = i;
+      for(Bit = 0; Bit < 8; Bit++)
+        Crc = (Crc & 1) ? (Crc >> 1) ^ 0xEDB88320U : Crc >> 1;
+      Table[i] = Crc;
+    }
+  }
+
+  Crc = 0xFFFFFFFFU;
+  for(i = 0; i < Size; i++)
+    Crc = Table[(Crc ^ Data[i]) & 0xFF] ^ (Crc >> 8);
+
+  return ~Crc;
+}
+
+#endif /* REFERENCE_H */
@@ -0,0 +1,227 @@
+/**
+  ******************************************************************************
+  * @file    bench.c
+  * @brief   Simulation bench of a QSPI loader: runs Init, MassErase, Write,
+  *          Verify, CheckSum, SectorErase and RunOperations of the loader
+  *          built on the host
+  *          against the memory model of sim_qspi.c, checks the memory content
+  *          after each operation, and reports the simulated time and
+  *          throughput of each one.
+  *
+  *          The image is written at the second sector, in chunks of
+  *          BENCH_CHUNK bytes as STM32CubeProgrammer sends them, one page in
+  *          eight being blank. The sectors around it hold a pattern that no
+  *          operation but MassErase may change.
+  ******************************************************************************
+  */
+
+#include "test.h"
+#include "sim.h"
+#include "Dev_Inf.h"
+#include "Loader_Src.h"
+
+/* Some Loader_Src.h files declare the static SystemClock_Config of their
+   Loader_Src.c, which is never defined here */
+#pragma GCC diagnostic ignored "-Wunused-function"
+
+#ifndef BENCH_IMAGE_SIZE
+#define BENCH_IMAGE_SIZE  0x100000U
+#endif
+#ifndef BENCH_CHUNK
+#define BENCH_CHUNK       0x8000U
+#endif
+
+#define BENCH_PATTERN     0xA5U
+
+/* Loader entry points not declared by Loader_Src.h */
+extern struct StorageInfo const StorageInfo;
+uint32_t CheckSum(uint32_t StartAddress, uint32_t Size, uint32_t InitVal);
+
+#ifdef USE_COMMAND_TRACE
+#ifndef BENCH_TRACE
+#define BENCH_TRACE       "trace.bin"
+#endif
+/* Command trace of the loader, written to BENCH_TRACE at the end */
+extern TRACE_BUFFER CommandTrace;
+#endif /* USE_COMMAND_TRACE */
+
+static uint32_t Start;
+static uint32_t SectorSize;
+static uint32_t ImageOffset;
+static uint8_t* Image;
+static uint64_t StepNs;
+static SIM_STATS StepStats;
+
+static void Bench_Begin(void)
+{
+  Sim_Flush();
+  StepNs = Sim_Time();
+  StepStats = SimStats;
+}
+
+/* Prints the simulated time of an operation, and its throughput */
+static void Bench_End(const char* Name, uint32_t Bytes)
+{
+  uint64_t Ns = Sim_Time() - StepNs;
+
+  printf("%-20s %8u bytes %12.3f ms", Name, (unsigned)Bytes, Ns / 1e6);
+  if((Bytes != 0U) && (Ns != 0U))
+    printf(" %9.3f MB/s", Bytes * 1e3 / Ns);
+  else
+    printf("%15s", "");
+  printf("  %8llu commands %6llu mapped pages\n",
+         (unsigned long long)(SimStats.Commands - StepStats.Commands),
+         (unsigned long long)(SimStats.MappedPages - StepStats.MappedPages));
+}
+
+/* Checks that a zone of the memory holds Data, or Value when Data is NULL */
+static int Bench_Holds(uint32_t Offset, uint32_t Size, const uint8_t* Data, uint8_t Value)
+{
+  const uint8_t* Memory = Sim_Memory() + Offset;
+  uint32_t i;
+
+  for(i = 0; i < Size; i++)
+  {
+    if(Memory[i] != ((Data != NULL) ? Data[i] : Value))
+    {
+      printf("memory at 0x%08X holds 0x%02X instead of 0x%02X\n", (unsigned)(Start + Offset + i),
+             Memory[i], (Data != NULL) ? Data[i] : Value);
+      return 0;
+    }
+  }
+  return 1;
+}
+
+/* The pattern of the sectors around the image is left as is */
+static int Bench_Around(void)
+{
+  return Bench_Holds(0, SectorSize, NULL, BENCH_PATTERN) &&
+         Bench_Holds(ImageOffset + BENCH_IMAGE_SIZE, SectorSize, NULL, BENCH_PATTERN);
+}
+
+static int Bench_Write(uint32_t Offset, uint32_t Size)
+{
+  uint32_t Done, Chunk;
+
+  for(Done = 0; Done < Size; Done += Chunk)
+  {
+    Chunk = (Size - Done < BENCH_CHUNK) ? Size - Done : BENCH_CHUNK;
+    if(Write(Start + Offset + Done, Chunk, Image + (Offset - ImageOffset) + Done) != 1)
+      return 0;
+  }
+  return 1;
+}
+
+int main(void)
+{
+  uint32_t Sum = 0;
+  uint32_t Offset;
+  uint64_t Result;
+  OPERATION Operation;
+  uint32_t i;
+#ifdef USE_COMMAND_TRACE
+  FILE* Output;
+#endif /* USE_COMMAND_TRACE */
+
+  Start = (uint32_t)StorageInfo.DeviceStartAddress;
+  SectorSize = (uint32_t)StorageInfo.sectors[0].SectorSize;
+  ImageOffset = SectorSize;
+  printf("%s, %u bytes, sectors of %u bytes\n", StorageInfo.DeviceName,
+         (unsigned)StorageInfo.DeviceSize, (unsigned)SectorSize);
+
+  Sim_Init(Start, (uint32_t)StorageInfo.DeviceSize);
+  Image = Test_Alloc(BENCH_IMAGE_SIZE);
+  for(i = 0; i < BENCH_IMAGE_SIZE; i++)
+  {
+    Image[i] = ((i / StorageInfo.PageSize) % 8U == 7U) ? 0xFFU : (uint8_t)Test_Random();
+    Sum += Image[i];
+  }
+  /* Previous content of the memory */
+  for(i = 0; i < StorageInfo.DeviceSize; i++)
+    Sim_Memory()[i] = (uint8_t)Test_Random();
+
+  Bench_Begin();
+  CHECK(Init() == 1, "Init failed");
+  Bench_End("Init", 0);
+
+  Bench_Begin();
+  CHECK(MassErase(0) == 1, "MassErase failed");
+  Bench_End("MassErase", StorageInfo.DeviceSize);
+  CHECK(Bench_Holds(0, StorageInfo.DeviceSize, NULL, 0xFF), "MassErase left bytes programmed");
+  memset(Sim_Memory(), BENCH_PATTERN, SectorSize);
+  memset(Sim_Memory() + ImageOffset + BENCH_IMAGE_SIZE, BENCH_PATTERN, SectorSize);
+
+  Bench_Begin();
+  CHECK(Bench_Write(ImageOffset, BENCH_IMAGE_SIZE), "Write failed");
+  Bench_End("Write", BENCH_IMAGE_SIZE);
+  CHECK(Bench_Holds(ImageOffset, BENCH_IMAGE_SIZE, Image, 0), "Write programmed other data");
+
+  Bench_Begin();
+  for(Offset = 0; Offset < BENCH_IMAGE_SIZE; Offset += BENCH_CHUNK)
+  {
+    Result = Verify(Start + ImageOffset + Offset, (uint32_t)(uintptr_t)(Image + Offset), BENCH_CHUNK / 4, 0);
+    CHECK((uint32_t)Result == 0, "Verify failed at 0x%08X", (unsigned)(uint32_t)Result);
+  }
+  Bench_End("Verify", BENCH_IMAGE_SIZE);
+
+  Bench_Begin();
+  CHECK(CheckSum(Start + ImageOffset, BENCH_IMAGE_SIZE, 0) == Sum, "CheckSum differs");
+  Bench_End("CheckSum", BENCH_IMAGE_SIZE);
+
+  Bench_Begin();
+  CHECK(SectorErase(Start + ImageOffset, Start + ImageOffset + BENCH_IMAGE_SIZE - 1) == 1, "SectorErase failed");
+  Bench_End("SectorErase", BENCH_IMAGE_SIZE);
+  CHECK(Bench_Holds(ImageOffset, BENCH_IMAGE_SIZE, NULL, 0xFF), "SectorErase left bytes programmed");
+
+  Bench_Begin();
+  CHECK(SectorErase(Start + ImageOffset, Start + ImageOffset + BENCH_IMAGE_SIZE - 1) == 1, "SectorErase failed");
+  Bench_End("SectorErase (blank)", BENCH_IMAGE_SIZE);
+
+  /* Zone starting and ending inside a page */
+  Bench_Begin();
+  CHECK(Bench_Write(ImageOffset + 0x123, BENCH_CHUNK - 0x246), "Write failed");
+  Bench_End("Write (unaligned)", BENCH_CHUNK - 0x246);
+  CHECK(Bench_Holds(ImageOffset + 0x123, BENCH_CHUNK - 0x246, Image + 0x123, 0), "Write programmed other data");
+  CHECK(Bench_Holds(ImageOffset, 0x123, NULL, 0xFF), "Write programmed the bytes before the zone");
+  CHECK(Bench_Around(), "the sectors around the image changed");
+
+  /* Verify of a size that is not a multiple of 4, the last byte of the
+     buffer then differing from the memory */
+  Operation.Op = OPERATION_VERIFY;
+  Operation.Address = Start + ImageOffset + 0x123;
+  Operation.Size = BENCH_CHUNK - 0x246;
+  Operation.Buffer = Image + 0x123;
+  Bench_Begin();
+  CHECK(RunOperations(&Operation, 1) == 1, "RunOperations failed");
+  Bench_End("RunOperations (verify)", Operation.Size);
+  CHECK(Operation.Status == OPERATION_OK, "RunOperations status %u", (unsigned)Operation.Status);
+  Image[0x123 + Operation.Size - 1] ^= 0x01U;
+  CHECK(RunOperations(&Operation, 1) == 0, "RunOperations missed the last byte");
+  CHECK(Operation.Status == OPERATION_FAILED, "RunOperations status %u", (unsigned)Operation.Status);
+  Image[0x123 + Operation.Size - 1] ^= 0x01U;
+
+  /* Fill with the erase value: it programs nothing, and only succeeds on an
+     erased zone, the last byte checked being the first one programmed */
+  Bench_Begin();
+  CHECK(Fill(Start + ImageOffset, 0x122, 0xFFFFFFFFU, 4) == 1, "Fill failed on the erased zone");
+  Bench_End("Fill (erased)", 0x122);
+  CHECK(Image[0x123] != 0xFFU, "the first byte written is erased");
+  CHECK(Fill(Start + ImageOffset + 0x80, 0xA4, 0xFFFFFFFFU, 4) == 0, "Fill missed a programmed byte");
+  CHECK(Bench_Holds(ImageOffset + 0x123, BENCH_CHUNK - 0x246, Image + 0x123, 0), "Fill changed the memory");
+
+  printf("%llu commands, %llu polls, bus %.3f ms, waits %.3f ms, %llu programs, %llu erases, %llu mapped pages\n",
+         (unsigned long long)SimStats.Commands, (unsigned long long)SimStats.Polls,
+         SimStats.BusNs / 1e6, SimStats.WaitNs / 1e6,
+         (unsigned long long)SimStats.Programs, (unsigned long long)SimStats.Erases,
+         (unsigned long long)SimStats.MappedPages);
+  CHECK(SimStats.Errors == 0, "%u error(s) of the loader sequences", (unsigned)SimStats.Errors);
+
+#ifdef USE_COMMAND_TRACE
+  /* Last records of the bench, as the host reads them back from the RAM */
+  Output = fopen(BENCH_TRACE, "wb");
+  CHECK((Output != NULL) && (fwrite(&CommandTrace, sizeof(CommandTrace), 1, Output) == 1) && (fclose(Output) == 0),
+        "%s cannot be written", BENCH_TRACE);
+#endif /* USE_COMMAND_TRACE */
+
+  return Test_Result("bench");
+}
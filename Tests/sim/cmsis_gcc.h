@@ -0,0 +1,74 @@
+/**
+  ******************************************************************************
+  * @file    cmsis_gcc.h
+  * @brief   Host definitions of the CMSIS compiler macros and core intrinsics
+  *          for the simulation bench. Included by sim.h, its guard keeps out
+  *          the cmsis_gcc.h of the board. The barriers only order the
+  *          compiler.
+  ******************************************************************************
+  */
+
+#ifndef __CMSIS_GCC_H
+#define __CMSIS_GCC_H
+
+#include <stdint.h>
+
+#define __ASM                     __asm
+#define __INLINE                  inline
+#define __STATIC_INLINE           static inline
+#define __STATIC_FORCEINLINE      static inline
+#define __NO_RETURN               __attribute__((__noreturn__))
+#define __USED                    __attribute__((used))
+#define __WEAK                    __attribute__((weak))
+#define __PACKED                  __attribute__((packed, aligned(1)))
+#define __PACKED_STRUCT           struct __attribute__((packed, aligned(1)))
+#define __PACKED_UNION            union __attribute__((packed, aligned(1)))
+#define __ALIGNED(x)              __attribute__((aligned(x)))
+#define __RESTRICT                __restrict
+#define __COMPILER_BARRIER()      __asm volatile("" ::: "memory")
+
+#define __NOP()                   ((void)0)
+#define __WFI()                   ((void)0)
+#define __DSB()                   __COMPILER_BARRIER()
+#define __ISB()                   __COMPILER_BARRIER()
+#define __DMB()                   __COMPILER_BARRIER()
+#define __enable_irq()            ((void)0)
+#define __disable_irq()           ((void)0)
+
+__STATIC_INLINE uint32_t __get_PRIMASK(void)
+{
+  return 0U;
+}
+
+__STATIC_INLINE void __set_PRIMASK(uint32_t priMask)
+{
+  (void)priMask;
+}
+
+__STATIC_INLINE uint32_t __REV(uint32_t value)
+{
+  return __builtin_bswap32(value);
+}
+
+__STATIC_INLINE uint32_t __ROR(uint32_t op1, uint32_t op2)
+{
+  op2 %= 32U;
+  return (op2 == 0U) ? op1 : ((op1 >> op2) | (op1 << (32U - op2)));
+}
+
+__STATIC_INLINE uint32_t __RBIT(uint32_t value)
+{
+  uint32_t result = 0U;
+  uint32_t i;
+
+  for(i = 0U; i < 32U; i++)
+    result |= ((value >> i) & 1U) << (31U - i);
+  return result;
+}
+
+__STATIC_INLINE uint8_t __CLZ(uint32_t value)
+{
+  return (value == 0U) ? 32U : (uint8_t)__builtin_clz(value);
+}
+
+#endif /* __CMSIS_GCC_H */
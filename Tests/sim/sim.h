@@ -0,0 +1,60 @@
+/**
+  ******************************************************************************
+  * @file    sim.h
+  * @brief   Host simulation of a QSPI loader. The loader, its BSP driver and
+  *          Dev_Inf.c are built on the host with this file included first.
+  *          sim_qspi.c replaces the HAL QSPI driver with a model of the
+  *          QUADSPI and of the N25Q128A memory, maps the peripheral and
+  *          memory-mapped regions at their STM32 addresses, and keeps the
+  *          simulated time in the DWT cycle counter.
+  ******************************************************************************
+  */
+
+#ifndef SIM_H
+#define SIM_H
+
+#include <stdint.h>
+#include "cmsis_gcc.h"
+
+/* IAR keywords and section operators of the loaders */
+#define __no_init
+#define __root
+#define __section_begin(Section)  ((char*)0)
+#define __section_size(Section)   (0U)
+
+/* Core cycles of the CPU work of a HAL QSPI call, added to its bus time */
+#define SIM_CALL_CYCLES  100U
+
+/* Memory-mapped reads are charged once per page of this size, from the
+   first access to the page after the memory-mapped mode is entered or after
+   Sim_Flush */
+#define SIM_MAPPED_PAGE  0x1000U
+
+/* Counts of the simulation */
+typedef struct
+{
+  uint64_t Commands;     /* Commands sent to the memory                    */
+  uint64_t Polls;        /* Status reads of the automatic polling        */
+  uint64_t BusNs;        /* Time the QSPI bus was driven                   */
+  uint64_t WaitNs;       /* Time spent waiting for the memory to be ready  */
+  uint64_t MappedPages;  /* Pages read through the memory-mapped mode      */
+  uint64_t Programs;     /* Page programs                                  */
+  uint64_t Erases;       /* Subsector, sector and bulk erases              */
+  uint32_t Errors;       /* Loader or driver errors found by the model     */
+} SIM_STATS;
+
+extern SIM_STATS SimStats;
+
+/* Maps the regions, the memory of Size bytes being mapped at Base */
+void Sim_Init(uint32_t Base, uint32_t Size);
+
+/* Memory content, writable by the bench out of the loader calls */
+uint8_t* Sim_Memory(void);
+
+/* Charges the pages read again, at the start of each loader call */
+void Sim_Flush(void);
+
+/* Simulated time since Sim_Init, in nanoseconds */
+uint64_t Sim_Time(void);
+
+#endif /* SIM_H */
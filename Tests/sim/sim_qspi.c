@@ -0,0 +1,728 @@
+/**
+  ******************************************************************************
+  * @file    sim_qspi.c
+  * @brief   Host model of the QUADSPI and of the N25Q128A memory, standing
+  *          for the HAL QSPI, RCC and GPIO drivers of an STM32L4 or STM32F4
+  *          loader.
+  *
+  *          The memory executes the commands of the BSP driver: reset, write
+  *          enable, status and flag status reads, volatile configuration,
+  *          reads, page programs, subsector, sector and bulk erases. A page
+  *          program only clears bits and wraps in its page, an erase sets
+  *          its block to 0xFF, and both keep the memory busy for their
+  *          typical time. The time of a command is the one of its bits on
+  *          the bus at the QUADSPI clock set by the PRESCALER field of
+  *          QUADSPI->CR, plus SIM_CALL_CYCLES core cycles. The automatic
+  *          polling waits until the memory status matches, or times out.
+  *
+  *          The memory is mapped at its memory-mapped address with no access,
+  *          the pages being opened to reads as they are touched in
+  *          memory-mapped mode. Each page opened is charged as a read
+  *          command of SIM_MAPPED_PAGE bytes.
+  *
+  *          The model reports in SimStats.Errors the sequences that fail or
+  *          corrupt the memory on the board: a command sent while the memory
+  *          is busy or while the QUADSPI is memory-mapped, a memory access
+  *          out of the memory-mapped mode, a program or erase without write
+  *          enable, a page program crossing its page, or read dummy cycles
+  *          differing from the ones the memory is configured with. Reads
+  *          above the memory rating return corrupted data.
+  ******************************************************************************
+  */
+
+#include <signal.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include SIM_HAL_HEADER
+
+/* Regions of the peripherals the loader and its BSP driver access */
+#define SIM_APB_AHB_BASE       0x40000000U  /* RCC, GPIO, CRC             */
+#define SIM_APB_AHB_SIZE       0x10000000U
+#define SIM_QSPI_REG_BASE      0xA0000000U  /* QUADSPI registers          */
+#define SIM_QSPI_REG_SIZE      0x00002000U
+#define SIM_CORE_BASE          0xE0000000U  /* DWT, CoreDebug, SCB        */
+#define SIM_CORE_SIZE          0x00100000U
+
+/* N25Q128A --------------------------------------------------------------------*/
+#define MEM_PAGE_SIZE          0x100U
+#define MEM_SUBSECTOR_SIZE     0x1000U
+#define MEM_SECTOR_SIZE        0x10000U
+#define MEM_MAX_HZ             108000000U  /* Fast reads, 10 dummy cycles */
+#define MEM_READ_MAX_HZ        54000000U   /* READ (0x03) command         */
+#define MEM_VCR_DEFAULT        0xFBU
+
+/* Typical times of the datasheet, in nanoseconds */
+#define MEM_TPP_NS(Bytes)      (50000ULL + (Bytes) * 1750ULL)  /* 0.5 ms / 256 bytes */
+#define MEM_TSSE_NS            250000000ULL                    /* Subsector erase    */
+#define MEM_TSE_NS             700000000ULL                    /* Sector erase       */
+#define MEM_TBE_NS             170000000000ULL                 /* Bulk erase         */
+
+/* Status and flag status registers */
+#define MEM_SR_WIP             0x01U
+#define MEM_SR_WEL             0x02U
+#define MEM_FSR_READY          0x80U
+
+/* Kinds of the commands */
+typedef enum
+{
+  OP_REGISTER,   /* Register access or control command          */
+  OP_READ,       /* Memory read, the dummy cycles being checked */
+  OP_PROGRAM,    /* Page program                                */
+  OP_ERASE       /* Block or bulk erase                         */
+} OP_KIND;
+
+typedef struct
+{
+  uint8_t  Opcode;
+  OP_KIND  Kind;
+  uint8_t  AddressLines;   /* 0 without address     */
+  uint8_t  DataLines;      /* 0 without data        */
+  uint8_t  DefaultDummy;   /* Reads, VCR at default */
+  uint32_t Block;          /* Erases, 0 for bulk    */
+} OPCODE;
+
+static const OPCODE Opcodes[] =
+{
+  {0x66, OP_REGISTER, 0, 0, 0,  0},  /* Reset enable              */
+  {0x99, OP_REGISTER, 0, 0, 0,  0},  /* Reset memory              */
+  {0x06, OP_REGISTER, 0, 0, 0,  0},  /* Write enable              */
+  {0x04, OP_REGISTER, 0, 0, 0,  0},  /* Write disable             */
+  {0x05, OP_REGISTER, 0, 1, 0,  0},  /* Read status register      */
+  {0x70, OP_REGISTER, 0, 1, 0,  0},  /* Read flag status register */
+  {0x50, OP_REGISTER, 0, 0, 0,  0},  /* Clear flag status         */
+  {0x85, OP_REGISTER, 0, 1, 0,  0},  /* Read volatile config      */
+  {0x81, OP_REGISTER, 0, 1, 0,  0},  /* Write volatile config     */
+  {0x9E, OP_REGISTER, 0, 1, 0,  0},  /* Read ID                   */
+  {0x9F, OP_REGISTER, 0, 1, 0,  0},  /* Read ID                   */
+  {0x03, OP_READ,     1, 1, 0,  0},  /* Read                      */
+  {0x0B, OP_READ,     1, 1, 8,  0},  /* Fast read                 */
+  {0x3B, OP_READ,     1, 2, 8,  0},  /* Dual output fast read     */
+  {0xBB, OP_READ,     2, 2, 8,  0},  /* Dual I/O fast read        */
+  {0x6B, OP_READ,     1, 4, 8,  0},  /* Quad output fast read     */
+  {0xEB, OP_READ,     4, 4, 10, 0},  /* Quad I/O fast read        */
+  {0x02, OP_PROGRAM,  1, 1, 0,  0},  /* Page program              */
+  {0xA2, OP_PROGRAM,  1, 2, 0,  0},  /* Dual input fast program   */
+  {0x32, OP_PROGRAM,  1, 4, 0,  0},  /* Quad input fast program   */
+  {0x12, OP_PROGRAM,  4, 4, 0,  0},  /* Extended quad program     */
+  {0x20, OP_ERASE,    1, 0, 0,  MEM_SUBSECTOR_SIZE},
+  {0xD8, OP_ERASE,    1, 0, 0,  MEM_SECTOR_SIZE},
+  {0xC7, OP_ERASE,    0, 0, 0,  0},
+};
+
+/* State of the memory */
+static struct
+{
+  uint8_t*  Content;       /* Writable view of the memory               */
+  uint8_t*  Window;        /* Memory-mapped view, at MemoryBase         */
+  uint32_t  Size;
+  uint8_t   Busy;          /* Program or erase running                  */
+  uint64_t  BusyUntil;
+  uint8_t   Wel;           /* Write enable latch                        */
+  uint8_t   Vcr;           /* Volatile configuration register           */
+  uint8_t   ResetEnabled;
+} Memory;
+
+/* State of the QUADSPI */
+static struct
+{
+  QSPI_CommandTypeDef Pending;    /* Command waiting for its data phase */
+  uint8_t             HasPending;
+  uint8_t             Mapped;     /* Memory-mapped mode                 */
+  QSPI_CommandTypeDef MappedCommand;
+  uint8_t*            Opened;     /* Pages opened, one byte per page    */
+} Qspi;
+
+SIM_STATS SimStats;
+#if defined(RCC_MSIRANGE_6)
+static const uint32_t MsiHz[] = {100000U, 200000U, 400000U, 800000U, 1000000U, 2000000U,
+                                 4000000U, 8000000U, 16000000U, 24000000U, 32000000U, 48000000U};
+uint32_t SystemCoreClock = 4000000U;  /* MSI at reset */
+#else
+uint32_t SystemCoreClock = HSI_VALUE;
+#endif
+static uint64_t SimNs;
+static uint64_t SimCycles;
+static uint64_t SimCycleRest;
+static uint32_t PllHz;
+
+/* Errors and time -------------------------------------------------------------*/
+static void Sim_Error(const char* Format, ...)
+{
+  va_list Args;
+
+  va_start(Args, Format);
+  printf("sim: error: ");
+  vprintf(Format, Args);
+  printf("\n");
+  va_end(Args);
+  SimStats.Errors++;
+}
+
+/* Advances the simulated time and the DWT cycle counter at the core clock */
+static void Sim_Advance(uint64_t Ns)
+{
+  unsigned __int128 Product = (unsigned __int128)Ns * SystemCoreClock + SimCycleRest;
+
+  SimNs += Ns;
+  SimCycles += (uint64_t)(Product / 1000000000U);
+  SimCycleRest = (uint64_t)(Product % 1000000000U);
+  DWT->CYCCNT = (uint32_t)SimCycles;
+}
+
+uint64_t Sim_Time(void)
+{
+  return SimNs;
+}
+
+uint8_t* Sim_Memory(void)
+{
+  return Memory.Content;
+}
+
+/* QUADSPI clock, from the core clock and the PRESCALER field */
+static uint32_t Qspi_Hz(void)
+{
+  return SystemCoreClock / (((QUADSPI->CR & QUADSPI_CR_PRESCALER) >> QUADSPI_CR_PRESCALER_Pos) + 1U);
+}
+
+/* Lines of a CCR mode field: 0, 1, 2 or 4 */
+static uint32_t Qspi_Lines(uint32_t Mode, uint32_t Mask)
+{
+  static const uint32_t Lines[] = {0U, 1U, 2U, 4U};
+
+  return Lines[(Mode & Mask) / (Mask & ~(Mask << 1))];
+}
+
+/* Bus time of a command transferring Bytes data bytes */
+static uint64_t Qspi_BusNs(const QSPI_CommandTypeDef* Command, uint32_t Bytes)
+{
+  uint32_t Ddr = (Command->DdrMode == QSPI_DDR_MODE_ENABLE) ? 2U : 1U;
+  uint32_t Lines;
+  uint64_t Clocks = 1U;  /* Chip select high time */
+
+  if((Lines = Qspi_Lines(Command->InstructionMode, QUADSPI_CCR_IMODE)) != 0U)
+    Clocks += 8U / Lines;
+  if((Lines = Qspi_Lines(Command->AddressMode, QUADSPI_CCR_ADMODE)) != 0U)
+    Clocks += (8U * ((Command->AddressSize >> QUADSPI_CCR_ADSIZE_Pos) + 1U)) / Lines / Ddr;
+  if((Lines = Qspi_Lines(Command->AlternateByteMode, QUADSPI_CCR_ABMODE)) != 0U)
+    Clocks += (8U * ((Command->AlternateBytesSize >> QUADSPI_CCR_ABSIZE_Pos) + 1U)) / Lines / Ddr;
+  Clocks += Command->DummyCycles;
+  if((Lines = Qspi_Lines(Command->DataMode, QUADSPI_CCR_DMODE)) != 0U)
+    Clocks += (8ULL * Bytes) / Lines / Ddr;
+
+  return (Clocks * 1000000000ULL) / Qspi_Hz();
+}
+
+/* Time of a HAL call sending a command */
+static uint64_t Qspi_CommandNs(const QSPI_CommandTypeDef* Command, uint32_t Bytes)
+{
+  return Qspi_BusNs(Command, Bytes) + (SIM_CALL_CYCLES * 1000000000ULL) / SystemCoreClock;
+}
+
+/* Memory ----------------------------------------------------------------------*/
+static void Mem_Update(void)
+{
+  if((Memory.Busy != 0U) && (SimNs >= Memory.BusyUntil))
+  {
+    Memory.Busy = 0U;
+    Memory.Wel = 0U;
+  }
+}
+
+static uint8_t Mem_Status(void)
+{
+  Mem_Update();
+  return (uint8_t)((Memory.Busy != 0U ? MEM_SR_WIP : 0U) | (Memory.Wel != 0U ? MEM_SR_WEL : 0U));
+}
+
+static const OPCODE* Mem_Opcode(uint8_t Instruction)
+{
+  uint32_t i;
+
+  for(i = 0; i < sizeof(Opcodes) / sizeof(Opcodes[0]); i++)
+  {
+    if(Opcodes[i].Opcode == Instruction)
+      return &Opcodes[i];
+  }
+  return NULL;
+}
+
+/* Dummy cycles the memory expects for a read, from the VCR */
+static uint32_t Mem_Dummy(const OPCODE* Opcode)
+{
+  uint32_t Dummy = Memory.Vcr >> 4;
+
+  if(Opcode->Opcode == 0x03U)
+    return 0U;
+  return ((Dummy == 0U) || (Dummy == 0xFU)) ? Opcode->DefaultDummy : Dummy;
+}
+
+/* Checks the lines, address and dummy cycles of a command */
+static const OPCODE* Mem_Check(const QSPI_CommandTypeDef* Command)
+{
+  const OPCODE* Opcode = Mem_Opcode((uint8_t)Command->Instruction);
+
+  if((Command->InstructionMode != QSPI_INSTRUCTION_1_LINE) || (Opcode == NULL))
+  {
+    Sim_Error("command 0x%02X not supported by the memory", (unsigned)Command->Instruction);
+    return NULL;
+  }
+  if((Qspi_Lines(Command->AddressMode, QUADSPI_CCR_ADMODE) != Opcode->AddressLines) ||
+     (Qspi_Lines(Command->DataMode, QUADSPI_CCR_DMODE) != Opcode->DataLines) ||
+     (Command->DdrMode != QSPI_DDR_MODE_DISABLE))
+  {
+    Sim_Error("command 0x%02X sent with other lines than its own", (unsigned)Opcode->Opcode);
+    return NULL;
+  }
+  if((Opcode->AddressLines != 0U) && (Command->AddressSize != QSPI_ADDRESS_24_BITS))
+  {
+    Sim_Error("command 0x%02X sent with a %u-bit address, the memory decodes 24 bits",
+              (unsigned)Opcode->Opcode, (unsigned)(8U * ((Command->AddressSize >> QUADSPI_CCR_ADSIZE_Pos) + 1U)));
+    return NULL;
+  }
+  if((Opcode->Kind == OP_READ) && (Command->DummyCycles != Mem_Dummy(Opcode)))
+  {
+    Sim_Error("read 0x%02X sent with %u dummy cycles, the memory is configured for %u",
+              (unsigned)Opcode->Opcode, (unsigned)Command->DummyCycles, (unsigned)Mem_Dummy(Opcode));
+    return NULL;
+  }
+  return Opcode;
+}
+
+/* Reads memory bytes, corrupted above the memory rating */
+static void Mem_Read(const OPCODE* Opcode, uint32_t Address, uint8_t* Data, uint32_t Size)
+{
+  uint32_t MaxHz = (Opcode->Opcode == 0x03U) ? MEM_READ_MAX_HZ : MEM_MAX_HZ;
+  uint32_t i;
+
+  for(i = 0; i < Size; i++)
+  {
+    Data[i] = Memory.Content[(Address + i) % Memory.Size];
+    if(Qspi_Hz() > MaxHz)
+      Data[i] ^= (uint8_t)(1U << ((Address + i) % 8U));
+  }
+}
+
+/* Starts a program or an erase once write enabled */
+static int Mem_StartWrite(const OPCODE* Opcode)
+{
+  if(Memory.Wel == 0U)
+  {
+    Sim_Error("command 0x%02X sent without write enable, ignored by the memory", (unsigned)Opcode->Opcode);
+    return 0;
+  }
+  return 1;
+}
+
+static void Mem_Busy(uint64_t Ns)
+{
+  Memory.Busy = 1U;
+  Memory.BusyUntil = SimNs + Ns;
+}
+
+/* Executes a command, Data holding the bytes to send or to receive */
+static HAL_StatusTypeDef Mem_Execute(const QSPI_CommandTypeDef* Command, uint8_t* Data)
+{
+  const OPCODE* Opcode;
+  uint32_t Address = Command->Address % Memory.Size;
+  uint32_t Size = (Command->DataMode != QSPI_DATA_NONE) ? Command->NbData : 0U;
+  uint32_t Base;
+  uint32_t i;
+
+  SimStats.Commands++;
+  SimStats.BusNs += Qspi_BusNs(Command, Size);
+  Sim_Advance(Qspi_CommandNs(Command, Size));
+
+  if((Opcode = Mem_Check(Command)) == NULL)
+    return HAL_OK;
+
+  Mem_Update();
+  if((Memory.Busy != 0U) && (Opcode->Opcode != 0x05U) && (Opcode->Opcode != 0x70U))
+  {
+    Sim_Error("command 0x%02X sent while the memory is busy, ignored", (unsigned)Opcode->Opcode);
+    return HAL_OK;
+  }
+  if((Opcode->Opcode != 0x99U) && (Opcode->Opcode != 0x05U) && (Opcode->Opcode != 0x70U))
+    Memory.ResetEnabled = 0U;
+
+  switch(Opcode->Kind)
+  {
+    case OP_REGISTER:
+      switch(Opcode->Opcode)
+      {
+        case 0x66: Memory.ResetEnabled = 1U; break;
+        case 0x99:
+          if(Memory.ResetEnabled != 0U)
+          {
+            Memory.Wel = 0U;
+            Memory.Vcr = MEM_VCR_DEFAULT;
+          }
+          Memory.ResetEnabled = 0U;
+          break;
+        case 0x06: Memory.Wel = 1U; break;
+        case 0x04: Memory.Wel = 0U; break;
+        case 0x05: memset(Data, Mem_Status(), Size); break;
+        case 0x70: memset(Data, (Memory.Busy != 0U) ? 0U : MEM_FSR_READY, Size); break;
+        case 0x85: memset(Data, Memory.Vcr, Size); break;
+        case 0x81:
+          if(Mem_StartWrite(Opcode) != 0)
+          {
+            Memory.Vcr = Data[0];
+            Memory.Wel = 0U;
+          }
+          break;
+        case 0x9E:
+        case 0x9F:
+          for(i = 0; i < Size; i++)
+            Data[i] = (i < 3U) ? (uint8_t[]){0x20, 0xBA, 0x18}[i] : 0U;
+          break;
+        default: break;
+      }
+      break;
+
+    case OP_READ:
+      Mem_Read(Opcode, Address, Data, Size);
+      break;
+
+    case OP_PROGRAM:
+      if(Mem_StartWrite(Opcode) == 0)
+        break;
+      if((Address % MEM_PAGE_SIZE) + Size > MEM_PAGE_SIZE)
+        Sim_Error("page program of %u bytes at 0x%06X crosses its page, wrapped by the memory",
+                  (unsigned)Size, (unsigned)Address);
+      Base = Address - (Address % MEM_PAGE_SIZE);
+      for(i = 0; i < Size; i++)
+        Memory.Content[Base + ((Address + i) % MEM_PAGE_SIZE)] &= Data[i];
+      SimStats.Programs++;
+      Mem_Busy(MEM_TPP_NS(Size));
+      break;
+
+    case OP_ERASE:
+      if(Mem_StartWrite(Opcode) == 0)
+        break;
+      if(Opcode->Block == 0U)
+      {
+        memset(Memory.Content, 0xFF, Memory.Size);
+        Mem_Busy(MEM_TBE_NS);
+      }
+      else
+      {
+        memset(Memory.Content + (Address - (Address % Opcode->Block)), 0xFF, Opcode->Block);
+        Mem_Busy((Opcode->Block == MEM_SECTOR_SIZE) ? MEM_TSE_NS : MEM_TSSE_NS);
+      }
+      SimStats.Erases++;
+      break;
+  }
+
+  return HAL_OK;
+}
+
+/* Memory-mapped window --------------------------------------------------------*/
+void Sim_Flush(void)
+{
+  mprotect(Memory.Window, Memory.Size, PROT_NONE);
+  memset(Qspi.Opened, 0, Memory.Size / SIM_MAPPED_PAGE);
+}
+
+static void Window_Close(void)
+{
+  Sim_Flush();
+  Qspi.Mapped = 0U;
+}
+
+/* Opens the page touched by the loader, charged as a read of the page */
+static void Window_Fault(int Signal, siginfo_t* Info, void* Context)
+{
+  uint8_t* Address = (uint8_t*)Info->si_addr;
+  uint32_t Page = (uint32_t)(Address - Memory.Window) / SIM_MAPPED_PAGE;
+
+  (void)Context;
+  if((Address < Memory.Window) || (Address >= Memory.Window + Memory.Size) || (Qspi.Opened[Page] != 0U))
+  {
+    if((Address >= Memory.Window) && (Address < Memory.Window + Memory.Size))
+      printf("sim: error: write at 0x%08X in the memory-mapped region\n", (unsigned)(uintptr_t)Address);
+    fflush(stdout);
+    signal(Signal, SIG_DFL);
+    return;
+  }
+
+  if(Qspi.Mapped == 0U)
+    Sim_Error("read at 0x%08X out of the memory-mapped mode", (unsigned)(uintptr_t)Address);
+  else
+  {
+    Mem_Update();
+    if(Memory.Busy != 0U)
+      Sim_Error("memory-mapped read at 0x%08X while the memory is busy", (unsigned)(uintptr_t)Address);
+    SimStats.MappedPages++;
+    SimStats.BusNs += Qspi_BusNs(&Qspi.MappedCommand, SIM_MAPPED_PAGE);
+    Sim_Advance(Qspi_BusNs(&Qspi.MappedCommand, SIM_MAPPED_PAGE));
+  }
+  Qspi.Opened[Page] = 1U;
+  mprotect(Memory.Window + Page * SIM_MAPPED_PAGE, SIM_MAPPED_PAGE, PROT_READ);
+}
+
+static void Sim_Map(uint32_t Base, uint32_t Size)
+{
+  if(mmap((void*)(uintptr_t)Base, Size, PROT_READ | PROT_WRITE,
+          MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED, -1, 0) == MAP_FAILED)
+  {
+    fprintf(stderr, "sim: cannot map 0x%08X\n", (unsigned)Base);
+    exit(2);
+  }
+}
+
+void Sim_Init(uint32_t Base, uint32_t Size)
+{
+  struct sigaction Action;
+  FILE* Image = tmpfile();
+
+  Sim_Map(SIM_APB_AHB_BASE, SIM_APB_AHB_SIZE);
+  Sim_Map(SIM_QSPI_REG_BASE, SIM_QSPI_REG_SIZE);
+  Sim_Map(SIM_CORE_BASE, SIM_CORE_SIZE);
+
+  /* The memory content is shared by its writable and memory-mapped views */
+  if((Image == NULL) || (ftruncate(fileno(Image), Size) != 0))
+    exit(2);
+  Memory.Size = Size;
+  Memory.Vcr = MEM_VCR_DEFAULT;
+  Memory.Content = mmap(NULL, Size, PROT_READ | PROT_WRITE, MAP_SHARED, fileno(Image), 0);
+  Memory.Window = mmap((void*)(uintptr_t)Base, Size, PROT_NONE, MAP_SHARED | MAP_FIXED, fileno(Image), 0);
+  Qspi.Opened = calloc(Size / SIM_MAPPED_PAGE, 1);
+  if((Memory.Content == MAP_FAILED) || (Memory.Window != (uint8_t*)(uintptr_t)Base) || (Qspi.Opened == NULL))
+  {
+    fprintf(stderr, "sim: cannot map the memory at 0x%08X\n", (unsigned)Base);
+    exit(2);
+  }
+
+  memset(&Action, 0, sizeof(Action));
+  Action.sa_sigaction = Window_Fault;
+  Action.sa_flags = SA_SIGINFO;
+  sigaction(SIGSEGV, &Action, NULL);
+}
+
+/* HAL QSPI --------------------------------------------------------------------*/
+HAL_StatusTypeDef HAL_QSPI_Init(QSPI_HandleTypeDef *hqspi)
+{
+  hqspi->Instance->CR = (hqspi->Init.ClockPrescaler << QUADSPI_CR_PRESCALER_Pos) | QUADSPI_CR_EN;
+  hqspi->State = HAL_QSPI_STATE_READY;
+  Qspi.HasPending = 0U;
+  return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_QSPI_DeInit(QSPI_HandleTypeDef *hqspi)
+{
+  if(hqspi->Instance != NULL)
+    hqspi->Instance->CR = 0U;
+  hqspi->State = HAL_QSPI_STATE_RESET;
+  Window_Close();
+  return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_QSPI_Abort(QSPI_HandleTypeDef *hqspi)
+{
+  hqspi->State = HAL_QSPI_STATE_READY;
+  Qspi.HasPending = 0U;
+  Window_Close();
+  return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_QSPI_Command(QSPI_HandleTypeDef *hqspi, QSPI_CommandTypeDef *cmd, uint32_t Timeout)
+{
+  (void)Timeout;
+  if(hqspi->State != HAL_QSPI_STATE_READY)
+  {
+    Sim_Error("command 0x%02X sent while the QUADSPI is %s", (unsigned)cmd->Instruction,
+              (hqspi->State == HAL_QSPI_STATE_BUSY_MEM_MAPPED) ? "memory-mapped" : "not ready");
+    return HAL_BUSY;
+  }
+  if(cmd->DataMode != QSPI_DATA_NONE)
+  {
+    Qspi.Pending = *cmd;
+    Qspi.HasPending = 1U;
+    return HAL_OK;
+  }
+  return Mem_Execute(cmd, NULL);
+}
+
+static HAL_StatusTypeDef Qspi_Transfer(uint8_t *pData)
+{
+  if(Qspi.HasPending == 0U)
+  {
+    Sim_Error("data phase without a command");
+    return HAL_ERROR;
+  }
+  Qspi.HasPending = 0U;
+  return Mem_Execute(&Qspi.Pending, pData);
+}
+
+HAL_StatusTypeDef HAL_QSPI_Transmit(QSPI_HandleTypeDef *hqspi, uint8_t *pData, uint32_t Timeout)
+{
+  (void)hqspi;
+  (void)Timeout;
+  return Qspi_Transfer(pData);
+}
+
+HAL_StatusTypeDef HAL_QSPI_Receive(QSPI_HandleTypeDef *hqspi, uint8_t *pData, uint32_t Timeout)
+{
+  (void)hqspi;
+  (void)Timeout;
+  return Qspi_Transfer(pData);
+}
+
+/* Polls the status until it matches, the time being moved to the end of the
+   program or erase running, or by Timeout ms when the status cannot match */
+HAL_StatusTypeDef HAL_QSPI_AutoPolling(QSPI_HandleTypeDef *hqspi, QSPI_CommandTypeDef *cmd,
+                                       QSPI_AutoPollingTypeDef *cfg, uint32_t Timeout)
+{
+  uint64_t Start = SimNs;
+  uint64_t PollNs;
+  uint8_t Status;
+  int Match;
+
+  if(HAL_QSPI_Command(hqspi, cmd, Timeout) != HAL_OK)
+    return HAL_ERROR;
+  Qspi.Pending.NbData = cfg->StatusBytesSize;
+  PollNs = Qspi_BusNs(&Qspi.Pending, cfg->StatusBytesSize) + (cfg->Interval * 1000000000ULL) / Qspi_Hz();
+
+  for(;;)
+  {
+    Qspi.HasPending = 1U;
+    Qspi_Transfer(&Status);
+    if(cfg->MatchMode == QSPI_MATCH_MODE_AND)
+      Match = ((Status & cfg->Mask) == (cfg->Match & cfg->Mask));
+    else
+      Match = (((~(Status ^ cfg->Match)) & cfg->Mask) != 0U);
+    if(Match)
+      return HAL_OK;
+
+    /* The status only changes at the end of the operation running */
+    Mem_Update();
+    if((Memory.Busy == 0U) || (Memory.BusyUntil > Start + Timeout * 1000000ULL))
+    {
+      Sim_Error("automatic polling of 0x%02X timed out, status 0x%02X", (unsigned)cmd->Instruction, Status);
+      if(SimNs < Start + Timeout * 1000000ULL)
+      {
+        SimStats.WaitNs += Start + Timeout * 1000000ULL - SimNs;
+        Sim_Advance(Start + Timeout * 1000000ULL - SimNs);
+      }
+      return HAL_TIMEOUT;
+    }
+    if(Memory.BusyUntil > SimNs + PollNs)
+    {
+      uint64_t Polls = (Memory.BusyUntil - SimNs) / PollNs;
+
+      SimStats.WaitNs += Polls * PollNs;
+      SimStats.Polls += Polls;
+      Sim_Advance(Polls * PollNs);
+    }
+    else
+    {
+      SimStats.WaitNs += PollNs;
+      Sim_Advance(PollNs);
+    }
+  }
+}
+
+HAL_StatusTypeDef HAL_QSPI_MemoryMapped(QSPI_HandleTypeDef *hqspi, QSPI_CommandTypeDef *cmd,
+                                        QSPI_MemoryMappedTypeDef *cfg)
+{
+  const OPCODE* Opcode;
+
+  (void)cfg;
+  if(hqspi->State != HAL_QSPI_STATE_READY)
+  {
+    Sim_Error("memory-mapped mode entered while the QUADSPI is not ready");
+    return HAL_BUSY;
+  }
+  if(((Opcode = Mem_Check(cmd)) == NULL) || (Opcode->Kind != OP_READ))
+    return HAL_ERROR;
+  Mem_Update();
+  if(Memory.Busy != 0U)
+    Sim_Error("memory-mapped mode entered while the memory is busy");
+  Qspi.MappedCommand = *cmd;
+  Qspi.Mapped = 1U;
+  hqspi->State = HAL_QSPI_STATE_BUSY_MEM_MAPPED;
+  return HAL_OK;
+}
+
+/* HAL RCC, GPIO, NVIC and system -------------------------------------------*/
+void SystemInit(void)
+{
+}
+
+HAL_StatusTypeDef HAL_Init(void)
+{
+  return HAL_OK;
+}
+
+/* PLL output of the STM32L4 or STM32F4 clock tree */
+HAL_StatusTypeDef HAL_RCC_OscConfig(RCC_OscInitTypeDef *RCC_OscInitStruct)
+{
+  uint32_t SourceHz = HSI_VALUE;
+
+  if(RCC_OscInitStruct->PLL.PLLState != RCC_PLL_ON)
+    return HAL_OK;
+  if(RCC_OscInitStruct->PLL.PLLSource == RCC_PLLSOURCE_HSE)
+    SourceHz = HSE_VALUE;
+#if defined(RCC_MSIRANGE_6)
+  if(RCC_OscInitStruct->PLL.PLLSource == RCC_PLLSOURCE_MSI)
+    SourceHz = MsiHz[(RCC_OscInitStruct->MSIClockRange >> RCC_CR_MSIRANGE_Pos) % 12U];
+  PllHz = SourceHz / RCC_OscInitStruct->PLL.PLLM * RCC_OscInitStruct->PLL.PLLN / RCC_OscInitStruct->PLL.PLLR;
+#else
+  PllHz = SourceHz / RCC_OscInitStruct->PLL.PLLM * RCC_OscInitStruct->PLL.PLLN / RCC_OscInitStruct->PLL.PLLP;
+#endif
+  return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_RCC_ClockConfig(RCC_ClkInitTypeDef *RCC_ClkInitStruct, uint32_t FLatency)
+{
+  (void)FLatency;
+  if(RCC_ClkInitStruct->SYSCLKSource == RCC_SYSCLKSOURCE_PLLCLK)
+    SystemCoreClock = PllHz;
+  return HAL_OK;
+}
+
+uint32_t HAL_RCC_GetHCLKFreq(void)
+{
+  return SystemCoreClock;
+}
+
+void HAL_GPIO_Init(GPIO_TypeDef *GPIOx, GPIO_InitTypeDef *GPIO_Init)
+{
+  (void)GPIOx;
+  (void)GPIO_Init;
+}
+
+void HAL_GPIO_DeInit(GPIO_TypeDef *GPIOx, uint32_t GPIO_Pin)
+{
+  (void)GPIOx;
+  (void)GPIO_Pin;
+}
+
+void HAL_GPIO_WritePin(GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin, GPIO_PinState PinState)
+{
+  (void)GPIOx;
+  (void)GPIO_Pin;
+  (void)PinState;
+}
+
+void HAL_NVIC_SetPriority(IRQn_Type IRQn, uint32_t PreemptPriority, uint32_t SubPriority)
+{
+  (void)IRQn;
+  (void)PreemptPriority;
+  (void)SubPriority;
+}
+
+void HAL_NVIC_EnableIRQ(IRQn_Type IRQn)
+{
+  (void)IRQn;
+}
+
+void HAL_NVIC_DisableIRQ(IRQn_Type IRQn)
+{
+  (void)IRQn;
+}
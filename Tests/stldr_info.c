@@ -0,0 +1,318 @@
+/**
+  ******************************************************************************
+  * @file    stldr_info.c
+  * @brief   Static report of a loader binary (.stldr): the StorageInfo
+  *          descriptor, and for each entry point its address, its size, its
+  *          Thumb instructions, and the functions, bytes and instructions it
+  *          reaches through its calls (BL) and tail calls (B.W). The data
+  *          the $d mapping symbols mark, as the literal pools, is not
+  *          decoded. Two loaders, such as a released binary and a rebuilt
+  *          one, are compared by their reports.
+  ******************************************************************************
+  */
+
+#include <elf.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_FUNCTIONS  1024U
+
+typedef struct
+{
+  const char* Name;
+  uint32_t    Address;   /* Thumb bit cleared */
+  uint32_t    Size;
+  uint8_t     Reached;
+} FUNCTION;
+
+typedef struct
+{
+  uint32_t Bytes;
+  uint32_t Narrow;       /* 16-bit instructions */
+  uint32_t Wide;         /* 32-bit instructions */
+} CODE_SIZE;
+
+static const char* EntryPoints[] = {"Init", "Write", "SectorErase", "MassErase", "Verify", "CheckSum"};
+
+static uint8_t* File;
+static long FileSize;
+static const Elf32_Shdr* Sections;
+static uint32_t SectionCount;
+static FUNCTION Functions[MAX_FUNCTIONS];
+static uint32_t FunctionCount;
+static uint32_t DataStarts[MAX_FUNCTIONS * 4];   /* $d and $t symbols, in pairs */
+static uint8_t DataKinds[MAX_FUNCTIONS * 4];
+static uint32_t MarkCount;
+
+/* Loads the bytes at an address of a PROGBITS section, NULL outside */
+static const uint8_t* Elf_Bytes(uint32_t Address, uint32_t Size)
+{
+  uint32_t i;
+
+  for(i = 0; i < SectionCount; i++)
+  {
+    if((Sections[i].sh_type == SHT_PROGBITS) && ((Sections[i].sh_flags & SHF_ALLOC) != 0U) &&
+       (Address >= Sections[i].sh_addr) && (Address + Size <= Sections[i].sh_addr + Sections[i].sh_size))
+      return File + Sections[i].sh_offset + (Address - Sections[i].sh_addr);
+  }
+  return NULL;
+}
+
+static uint32_t Read32(const uint8_t* Data)
+{
+  return Data[0] | (Data[1] << 8) | (Data[2] << 16) | ((uint32_t)Data[3] << 24);
+}
+
+static uint16_t Read16(const uint8_t* Data)
+{
+  return (uint16_t)(Data[0] | (Data[1] << 8));
+}
+
+static FUNCTION* Function_At(uint32_t Address)
+{
+  uint32_t i;
+
+  for(i = 0; i < FunctionCount; i++)
+  {
+    if((Address >= Functions[i].Address) && (Address < Functions[i].Address + Functions[i].Size))
+      return &Functions[i];
+  }
+  return NULL;
+}
+
+/* Whether the byte at Address is data, from the last mapping symbol before it */
+static int Is_Data(uint32_t Address)
+{
+  uint32_t Best = 0;
+  int Data = 0;
+  uint32_t i;
+
+  for(i = 0; i < MarkCount; i++)
+  {
+    if((DataStarts[i] <= Address) && (DataStarts[i] >= Best))
+    {
+      Best = DataStarts[i];
+      Data = DataKinds[i];
+    }
+  }
+  return Data;
+}
+
+/* Loads the function and mapping symbols */
+static void Elf_Symbols(void)
+{
+  const Elf32_Sym* Symbols;
+  const char* Names;
+  uint32_t Count;
+  uint32_t i, j;
+
+  for(i = 0; i < SectionCount; i++)
+  {
+    if(Sections[i].sh_type != SHT_SYMTAB)
+      continue;
+    Symbols = (const Elf32_Sym*)(File + Sections[i].sh_offset);
+    Names = (const char*)(File + Sections[Sections[i].sh_link].sh_offset);
+    Count = Sections[i].sh_size / sizeof(Elf32_Sym);
+    for(j = 0; j < Count; j++)
+    {
+      const char* Name = Names + Symbols[j].st_name;
+
+      if((ELF32_ST_TYPE(Symbols[j].st_info) == STT_FUNC) && (Symbols[j].st_size != 0U) &&
+         (FunctionCount < MAX_FUNCTIONS))
+      {
+        Functions[FunctionCount].Name = Name;
+        Functions[FunctionCount].Address = Symbols[j].st_value & ~1U;
+        Functions[FunctionCount].Size = Symbols[j].st_size;
+        FunctionCount++;
+      }
+      else if(((strncmp(Name, "$d", 2) == 0) || (strcmp(Name, "$t") == 0)) &&
+              (MarkCount < MAX_FUNCTIONS * 4) && (Symbols[j].st_value != 0U))
+      {
+        DataStarts[MarkCount] = Symbols[j].st_value;
+        DataKinds[MarkCount] = (Name[1] == 'd');
+        MarkCount++;
+      }
+    }
+  }
+}
+
+/* Counts the instructions of a function and marks the functions it calls */
+static void Function_Code(FUNCTION* Function, CODE_SIZE* Code)
+{
+  const uint8_t* Data = Elf_Bytes(Function->Address, Function->Size);
+  uint32_t Offset = 0;
+  uint32_t Address;
+  uint16_t First, Second;
+  int32_t Jump;
+  FUNCTION* Callee;
+
+  Code->Bytes += Function->Size;
+  if(Data == NULL)
+    return;
+
+  while(Offset + 2U <= Function->Size)
+  {
+    Address = Function->Address + Offset;
+    if(Is_Data(Address))
+    {
+      Offset += 2U;
+      continue;
+    }
+    First = Read16(Data + Offset);
+    if(((First >> 11) < 0x1DU) || (Offset + 4U > Function->Size))
+    {
+      Code->Narrow++;
+      Offset += 2U;
+      continue;
+    }
+
+    Code->Wide++;
+    Second = Read16(Data + Offset + 2U);
+    /* BL and B.W (T4): S:I1:I2:imm10:imm11:0 */
+    if(((First & 0xF800U) == 0xF000U) && (((Second & 0xD000U) == 0xD000U) || ((Second & 0xD000U) == 0x9000U)))
+    {
+      uint32_t S = (First >> 10) & 1U;
+      uint32_t I1 = !(((Second >> 13) & 1U) ^ S);
+      uint32_t I2 = !(((Second >> 11) & 1U) ^ S);
+
+      Jump = (int32_t)((S << 24) | (I1 << 23) | (I2 << 22) | ((First & 0x3FFU) << 12) | ((Second & 0x7FFU) << 1));
+      Jump = (Jump << 7) >> 7;
+      Callee = Function_At(Address + 4U + (uint32_t)Jump);
+      if((Callee != NULL) && (Callee != Function))
+        Callee->Reached = 1U;
+    }
+    Offset += 4U;
+  }
+}
+
+/* Sizes of an entry point alone, and with the functions it reaches */
+static void Entry_Report(const char* Name)
+{
+  CODE_SIZE Own = {0, 0, 0};
+  CODE_SIZE Reached = {0, 0, 0};
+  FUNCTION* Entry = NULL;
+  uint32_t Count = 0;
+  uint32_t i;
+  int Added;
+
+  for(i = 0; i < FunctionCount; i++)
+  {
+    Functions[i].Reached = 0U;
+    if(strcmp(Functions[i].Name, Name) == 0)
+      Entry = &Functions[i];
+  }
+  if(Entry == NULL)
+  {
+    printf("%-12s not found\n", Name);
+    return;
+  }
+
+  Function_Code(Entry, &Own);
+  Entry->Reached = 2U;
+  do
+  {
+    Added = 0;
+    for(i = 0; i < FunctionCount; i++)
+    {
+      if(Functions[i].Reached == 1U)
+      {
+        Functions[i].Reached = 2U;
+        Function_Code(&Functions[i], &Reached);
+        Count++;
+        Added = 1;
+      }
+    }
+  } while(Added);
+
+  printf("%-12s 0x%08X %6u bytes %5u instructions (%u wide)   %3u functions reached, %6u bytes %6u instructions\n",
+         Name, (unsigned)Entry->Address, (unsigned)Own.Bytes, (unsigned)(Own.Narrow + Own.Wide), (unsigned)Own.Wide,
+         (unsigned)Count, (unsigned)(Own.Bytes + Reached.Bytes),
+         (unsigned)(Own.Narrow + Own.Wide + Reached.Narrow + Reached.Wide));
+}
+
+/* StorageInfo of Dev_Inf.h, as laid out by the ARM compilers */
+static void StorageInfo_Report(void)
+{
+  const Elf32_Sym* Symbols;
+  const char* Names;
+  const uint8_t* Info = NULL;
+  uint32_t i, j;
+
+  for(i = 0; (i < SectionCount) && (Info == NULL); i++)
+  {
+    if(Sections[i].sh_type != SHT_SYMTAB)
+      continue;
+    Symbols = (const Elf32_Sym*)(File + Sections[i].sh_offset);
+    Names = (const char*)(File + Sections[Sections[i].sh_link].sh_offset);
+    for(j = 0; j < Sections[i].sh_size / sizeof(Elf32_Sym); j++)
+    {
+      if((strcmp(Names + Symbols[j].st_name, "StorageInfo") == 0) && (Symbols[j].st_shndx < SectionCount) &&
+         (Symbols[j].st_size >= 200U))
+      {
+        const Elf32_Shdr* Section = &Sections[Symbols[j].st_shndx];
+
+        Info = File + Section->sh_offset + (Symbols[j].st_value - Section->sh_addr);
+        break;
+      }
+    }
+  }
+  if(Info == NULL)
+  {
+    printf("StorageInfo not found\n");
+    return;
+  }
+
+  printf("%.100s: type %u, 0x%08X, %u bytes, pages of %u bytes, erased 0x%02X\n",
+         (const char*)Info, (unsigned)Read16(Info + 100), (unsigned)Read32(Info + 104),
+         (unsigned)Read32(Info + 108), (unsigned)Read32(Info + 112), Info[116]);
+  for(i = 0; (i < 10U) && (Read32(Info + 120 + 8 * i) != 0U); i++)
+    printf("  %u sectors of %u bytes\n", (unsigned)Read32(Info + 120 + 8 * i), (unsigned)Read32(Info + 124 + 8 * i));
+}
+
+int main(int argc, char** argv)
+{
+  const Elf32_Ehdr* Header;
+  FILE* Input;
+  int Arg;
+  uint32_t i;
+
+  for(Arg = 1; Arg < argc; Arg++)
+  {
+    if(((Input = fopen(argv[Arg], "rb")) == NULL) || (fseek(Input, 0, SEEK_END) != 0) ||
+       ((FileSize = ftell(Input)) < (long)sizeof(Elf32_Ehdr)))
+    {
+      printf("%s: cannot be read\n", argv[Arg]);
+      return 1;
+    }
+    File = malloc(FileSize);
+    rewind(Input);
+    if((File == NULL) || (fread(File, 1, FileSize, Input) != (size_t)FileSize))
+      return 1;
+    fclose(Input);
+
+    Header = (const Elf32_Ehdr*)File;
+    if((memcmp(Header->e_ident, ELFMAG, SELFMAG) != 0) || (Header->e_ident[EI_CLASS] != ELFCLASS32) ||
+       (Header->e_machine != EM_ARM) ||
+       (Header->e_shoff + (uint64_t)Header->e_shnum * sizeof(Elf32_Shdr) > (uint64_t)FileSize))
+    {
+      printf("%s: not an ARM ELF32 loader\n", argv[Arg]);
+      return 1;
+    }
+    Sections = (const Elf32_Shdr*)(File + Header->e_shoff);
+    SectionCount = Header->e_shnum;
+    FunctionCount = 0;
+    MarkCount = 0;
+    Elf_Symbols();
+
+    printf("%s\n", argv[Arg]);
+    StorageInfo_Report();
+    for(i = 0; i < sizeof(EntryPoints) / sizeof(EntryPoints[0]); i++)
+      Entry_Report(EntryPoints[i]);
+    printf("\n");
+    free(File);
+  }
+
+  return 0;
+}
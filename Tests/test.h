@@ -0,0 +1,329 @@
+/**
+  ******************************************************************************
+  * @file    test.h
+  * @brief   Host environment of the loader algorithm tests. The functions
+  *          under test are extracted from a Loader_Src.c file and compiled
+  *          on the host against the definitions below, which replace the
+  *          loader services they call (performance counters, session) and
+  *          model the CRC and HASH units.
+  ******************************************************************************
+  */
+
+#ifndef TEST_H
+#define TEST_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+
+/* The definitions and unit models below are left out of the simulation of
+   Tests/sim, which builds the loader with the headers of its device */
+#if !defined(SIM_H)
+
+/* Loader definitions ---------------------------------------------------------*/
+#define KeepInCompilation
+#define __STATIC_INLINE                  static inline
+#define KEEP_IN_COMPILATION
+#define Perf_Count(...)                  ((void)0)
+#define Perf_Cycles()                    (0U)
+#define Perf_Add(Phase, Start, ...)      ((void)(Start))
+#define Session_EnterMemoryMapped()      (1)
+#define QSPI_MemoryMappedMode()          ((void)0)
+#define OSPI_EnterMemoryMappedMode()     (LOADER_STATUS_SUCCESS)
+#define LOADER_STATUS_SUCCESS            1
+#define LOADER_STATUS_FAIL               0
+#define Cache_Address(Address)           (Address)
+
+/* FMC NOR loaders: the memory is read through the BSP, at its offset from
+   StartAddresse, the host address space standing for the NOR */
+#define StartAddresse                    0U
+#define BSP_NOR_ReturnToReadMode()       ((void)0)
+#define CHECKSUM_READ_WORDS              16U
+
+static inline uint8_t BSP_NOR_ReadData(uint32_t uwStartAddress, uint16_t *pData, uint32_t uwDataSize)
+{
+  memcpy(pData, (const void*)(uintptr_t)uwStartAddress, 2U * uwDataSize);
+
+  return 0;
+}
+
+#define __REV(x)                         __builtin_bswap32(x)
+#define __RBIT(x)                        Test_Rbit(x)
+#define __ROR(x, n)                      (((uint32_t)(x) >> (n)) | ((uint32_t)(x) << (32U - (n))))
+
+static inline uint32_t Test_Rbit(uint32_t Value)
+{
+  uint32_t Result = 0;
+  int Bit;
+
+  for(Bit = 0; Bit < 32; Bit++)
+    Result |= ((Value >> Bit) & 1U) << (31 - Bit);
+
+  return Result;
+}
+
+/* CRC unit model --------------------------------------------------------------*/
+/* Each access to CRC goes through CRC_Unit(), which processes the register
+   writes made since the previous access. The registers are 64-bit wide so
+   that a 32-bit write is told apart by its cleared upper bits. */
+typedef struct
+{
+  uint64_t DR;
+  uint64_t INIT;
+  uint64_t CR;
+} CRC_Model_t;
+
+#define CRC_CR_RESET                     0x00000001U
+#define CRC_MODEL_REV                    0x000000E0U
+/* Built with CRC_NO_REV, the device has no bit reversal bits and the kernels
+   of loader_kernels.h bit-reverse the words themselves */
+#if !defined(CRC_NO_REV)
+#define CRC_CR_REV_IN                    0x00000060U
+#define CRC_CR_REV_OUT                   0x00000080U
+#endif
+#define CRC_WRITTEN(Reg)                 (((Reg) >> 32) == 0U)
+#define CRC_MARK                         (1ULL << 32)
+#define __HAL_RCC_CRC_CLK_ENABLE()       ((void)0)
+#define RCC_AHB1PeriphClockCmd(...)      ((void)0)
+#define CRC                              (CRC_Unit())
+
+static CRC_Model_t CrcRegs = {CRC_MARK, CRC_MARK | 0xFFFFFFFFU, CRC_MARK};
+static uint32_t CrcState;
+static int CrcReversed;
+
+/* CRC-32 of the IEEE 802.3 polynomial. With the input and output bit-reversed,
+   as configured by most loaders, the register holds the reflected CRC. Without
+   them, as on the CRC unit of the STM32F4 which has neither INIT nor CR
+   configuration bits, the words are processed most significant bit first. */
+static inline CRC_Model_t* CRC_Unit(void)
+{
+  uint32_t Word;
+  int Bit;
+
+  if(CRC_WRITTEN(CrcRegs.CR))
+  {
+    if((CrcRegs.CR & CRC_CR_RESET) != 0U)
+      CrcState = (uint32_t)CrcRegs.INIT;
+    CrcReversed = ((CrcRegs.CR & CRC_MODEL_REV) == CRC_MODEL_REV);
+    CrcRegs.CR |= CRC_MARK;
+  }
+  if(CRC_WRITTEN(CrcRegs.DR))
+  {
+    Word = (uint32_t)CrcRegs.DR;
+    CrcState ^= Word;
+    for(Bit = 0; Bit < 32; Bit++)
+    {
+      if(CrcReversed)
+        CrcState = (CrcState >> 1) ^ (0xEDB88320U & (0U - (CrcState & 1U)));
+      else
+        CrcState = (CrcState << 1) ^ (0x04C11DB7U & (0U - (CrcState >> 31)));
+    }
+  }
+  CrcRegs.DR = CRC_MARK | CrcState;
+
+  return &CrcRegs;
+}
+
+/* HASH unit model -------------------------------------------------------------*/
+/* SHA-256 with the bytes of the input words swapped (DATATYPE 8-bit), the
+   words being hashed in memory order. As for the CRC unit, each access goes
+   through HASH_Unit(), a DIN write being told apart by its cleared upper bits.
+   The digest is calculated when STR has its DCAL bit set, over the bytes
+   written, the last word holding the number of valid bits set in STR.
+   Only defined with HASH_UNIT, loader_kernels.h building the software
+   SHA-256 when HASH is not defined. */
+#if defined(HASH_UNIT)
+typedef struct
+{
+  uint32_t HR[8];
+} HASH_DIGEST_Model_t;
+
+typedef struct
+{
+  uint64_t CR;
+  uint64_t DIN;
+  uint64_t STR;
+  uint64_t SR;
+  HASH_DIGEST_Model_t Digest;
+} HASH_Model_t;
+
+#define HASH_CR_INIT                     0x00000004U
+#define HASH_CR_DATATYPE_1               0x00000020U
+#define HASH_CR_ALGO_0                   0x00000080U
+#define HASH_CR_ALGO_1                   0x00040000U
+#define HASH_STR_NBLW                    0x0000001FU
+#define HASH_STR_DCAL                    0x00000100U
+#define HASH_SR_DCIS                     0x00000002U
+#define HASH_MARK                        (1ULL << 32)
+#define __HAL_RCC_HASH_CLK_ENABLE()      ((void)0)
+#define HASH                             (HASH_Unit())
+#define HASH_DIGEST                      (&HASH_Unit()->Digest)
+
+static HASH_Model_t HashRegs = {0, HASH_MARK, 0, 0, {{0}}};
+static uint8_t* HashMessage;
+static uint32_t HashLength;
+static uint32_t HashSize;
+
+/* SHA-256 of FIPS 180-4, written after the standard and independently of the
+   software SHA-256 of the loaders */
+static inline void Hash_Sha256(const uint8_t* Data, uint32_t Size, uint32_t* State)
+{
+  static const uint32_t K[64] =
+  {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+  };
+  static const uint32_t H0[8] =
+  {
+    0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+  };
+  uint64_t Bits = 8ULL * Size;
+  uint64_t Padded = ((uint64_t)Size + 8 + 64) & ~63ULL;
+  uint32_t W[64], V[8];
+  uint32_t S0, S1, T1, T2;
+  uint64_t Block, i;
+  int t, j;
+
+  memcpy(State, H0, sizeof(H0));
+  for(Block = 0; Block < Padded; Block += 64)
+  {
+    for(t = 0; t < 16; t++)
+    {
+      W[t] = 0;
+      for(j = 0; j < 4; j++)
+      {
+        i = Block + 4 * t + j;
+        W[t] = (W[t] << 8) | ((i < Size) ? Data[i] : (i == Size) ? 0x80U :
+                              (i >= Padded - 8) ? (uint32_t)(Bits >> (8 * (Padded - 1 - i))) & 0xFFU : 0U);
+      }
+    }
+    for(t = 16; t < 64; t++)
+    {
+      S0 = __ROR(W[t - 15], 7) ^ __ROR(W[t - 15], 18) ^ (W[t - 15] >> 3);
+      S1 = __ROR(W[t - 2], 17) ^ __ROR(W[t - 2], 19) ^ (W[t - 2] >> 10);
+      W[t] = W[t - 16] + S0 + W[t - 7] + S1;
+    }
+    memcpy(V, State, sizeof(V));
+    for(t = 0; t < 64; t++)
+    {
+      S1 = __ROR(V[4], 6) ^ __ROR(V[4], 11) ^ __ROR(V[4], 25);
+      T1 = V[7] + S1 + ((V[4] & V[5]) ^ (~V[4] & V[6])) + K[t] + W[t];
+      S0 = __ROR(V[0], 2) ^ __ROR(V[0], 13) ^ __ROR(V[0], 22);
+      T2 = S0 + ((V[0] & V[1]) ^ (V[0] & V[2]) ^ (V[1] & V[2]));
+      memmove(&V[1], &V[0], 7 * sizeof(V[0]));
+      V[4] += T1;
+      V[0] = T1 + T2;
+    }
+    for(t = 0; t < 8; t++)
+      State[t] += V[t];
+  }
+}
+
+static inline HASH_Model_t* HASH_Unit(void)
+{
+  uint32_t Word;
+  uint32_t Valid;
+
+  if((HashRegs.CR & HASH_CR_INIT) != 0U)
+  {
+    HashLength = 0;
+    HashRegs.SR = 0;
+    HashRegs.CR &= ~(uint64_t)HASH_CR_INIT;
+  }
+  if(((HashRegs.DIN >> 32) == 0U) && ((HashRegs.SR & HASH_SR_DCIS) == 0U))
+  {
+    if(HashLength + 4 > HashSize)
+    {
+      HashSize = 2 * HashSize + 64;
+      HashMessage = realloc(HashMessage, HashSize);
+    }
+    Word = (uint32_t)HashRegs.DIN;
+    memcpy(&HashMessage[HashLength], &Word, 4);
+    HashLength += 4;
+  }
+  HashRegs.DIN = HASH_MARK;
+  if(((HashRegs.STR & HASH_STR_DCAL) != 0U) && ((HashRegs.SR & HASH_SR_DCIS) == 0U))
+  {
+    /* Bytes of the last word that are not valid */
+    Valid = (uint32_t)(HashRegs.STR & HASH_STR_NBLW);
+    if((Valid != 0U) && (HashLength >= 4))
+      HashLength -= 4 - Valid / 8;
+    Hash_Sha256(HashMessage, HashLength, HashRegs.Digest.HR);
+    HashRegs.SR |= HASH_SR_DCIS;
+    HashRegs.STR &= ~(uint64_t)HASH_STR_DCAL;
+  }
+
+  return &HashRegs;
+}
+#endif /* HASH_UNIT */
+
+#endif /* SIM_H */
+
+/* Test helpers ----------------------------------------------------------------*/
+static int TestFailures;
+
+#define CHECK(Cond, ...)                                                      \
+  do                                                                          \
+  {                                                                           \
+    if(!(Cond))                                                               \
+    {                                                                         \
+      printf("%s:%d: ", __FILE__, __LINE__);                                  \
+      printf(__VA_ARGS__);                                                    \
+      printf("\n");                                                           \
+      TestFailures++;                                                         \
+    }                                                                         \
+  } while(0)
+
+/* The loaders address the memory with 32-bit integers: the zones they read
+   are allocated below 4 GB */
+static inline uint8_t* Test_Alloc(uint32_t Size)
+{
+  void* Zone;
+
+#if defined(MAP_32BIT)
+  Zone = mmap(NULL, Size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_32BIT, -1, 0);
+#else
+  Zone = mmap((void*)0x10000000, Size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+#endif
+  if((Zone == MAP_FAILED) || ((uintptr_t)Zone + Size > 0xFFFFFFFFU))
+  {
+    printf("cannot allocate %u bytes below 4 GB\n", (unsigned)Size);
+    exit(2);
+  }
+
+  return (uint8_t*)Zone;
+}
+
+/* Reproducible pseudo-random bytes */
+static inline uint32_t Test_Random(void)
+{
+  static uint32_t Seed = 0x12345678U;
+
+  Seed ^= Seed << 13;
+  Seed ^= Seed >> 17;
+  Seed ^= Seed << 5;
+
+  return Seed;
+}
+
+static inline int Test_Result(const char* Name)
+{
+  if(TestFailures != 0)
+  {
+    printf("%s: %d failure(s)\n", Name, TestFailures);
+    return 1;
+  }
+  printf("%s: passed\n", Name);
+
+  return 0;
+}
+
+#endif /* TEST_H */
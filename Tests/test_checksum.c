@@ -0,0 +1,58 @@
+/**
+  ******************************************************************************
+  * @file    test_checksum.c
+  * @brief   CheckSum of the loader against the byte by byte CheckSum it
+  *          replaced, for all the alignments of the start address and sizes
+  *          below and above 256 bytes.
+  ******************************************************************************
+  */
+
+#include "test.h"
+#include "reference.h"
+#include EXTRACTED
+
+#define ZONE_SIZE  0x10000U
+
+int main(void)
+{
+  uint8_t* Zone = Test_Alloc(ZONE_SIZE);
+  uint32_t Address;
+  uint32_t Offset;
+  uint32_t Size;
+  uint32_t InitVal;
+  uint32_t i;
+
+  for(i = 0; i < ZONE_SIZE; i++)
+    Zone[i] = (uint8_t)Test_Random();
+
+  /* Every alignment and size up to 1 KB, with a carried initial value */
+  for(Offset = 0; Offset < 4; Offset++)
+  {
+    for(Size = 0; Size <= 1024; Size++)
+    {
+      Address = (uint32_t)(uintptr_t)Zone + 64 + Offset;
+      InitVal = Test_Random();
+      CHECK(CheckSum(Address, Size, InitVal) == Ref_CheckSum(Address, Size, InitVal),
+            "offset %u size %u", (unsigned)Offset, (unsigned)Size);
+    }
+  }
+
+  /* Large zones of 0xFF bytes, the worst case of the 16-bit lane sums */
+  memset(Zone, 0xFF, ZONE_SIZE);
+  for(Offset = 0; Offset < 4; Offset++)
+  {
+    Address = (uint32_t)(uintptr_t)Zone + Offset;
+    Size = ZONE_SIZE - 4;
+    CHECK(CheckSum(Address, Size, 0) == Ref_CheckSum(Address, Size, 0),
+          "0xFF zone, offset %u", (unsigned)Offset);
+  }
+  CHECK(CheckSum((uint32_t)(uintptr_t)Zone, ZONE_SIZE, 0) == 0xFFU * ZONE_SIZE,
+        "0xFF zone sum");
+
+  /* Known sum of the bytes 0 to 255 */
+  for(i = 0; i < 256; i++)
+    Zone[i] = (uint8_t)i;
+  CHECK(CheckSum((uint32_t)(uintptr_t)Zone, 256, 0) == 0x7F80U, "bytes 0 to 255");
+
+  return Test_Result("checksum");
+}
@@ -0,0 +1,84 @@
+/**
+  ******************************************************************************
+  * @file    test_crc.c
+  * @brief   CheckCRC of the loader: CRC-32 check values, and the CRC-32 of
+  *          zlib for all the alignments of the start address and the sizes
+  *          up to 1 KB and larger zones. Built with CRC_NO_REV, it checks
+  *          the kernels bit-reversing the words for a CRC unit without
+  *          bit reversal.
+  ******************************************************************************
+  */
+
+#include "test.h"
+#include "reference.h"
+#include EXTRACTED
+
+#define ZONE_SIZE  0x10000U
+
+static uint32_t Crc_String(uint8_t* Zone, uint32_t Offset, const char* String)
+{
+  uint32_t Size = strlen(String);
+
+  memcpy(&Zone[Offset], String, Size);
+
+  return CheckCRC((uint32_t)(uintptr_t)&Zone[Offset], Size);
+}
+
+int main(void)
+{
+  static const char Fox[] = "The quick brown fox jumps over the lazy dog";
+  uint8_t* Zone = Test_Alloc(ZONE_SIZE);
+  uint32_t Address;
+  uint32_t Offset;
+  uint32_t Size;
+  uint32_t Crc, Expected;
+  uint32_t i;
+
+  /* Check values, at all the alignments */
+  for(Offset = 0; Offset < 4; Offset++)
+  {
+    Crc = Crc_String(Zone, Offset, "123456789");
+    CHECK(Crc == 0xCBF43926U, "\"123456789\" at +%u: 0x%08x", (unsigned)Offset, (unsigned)Crc);
+    Crc = Crc_String(Zone, Offset, "");
+    CHECK(Crc == 0x00000000U, "empty zone at +%u: 0x%08x", (unsigned)Offset, (unsigned)Crc);
+    Crc = Crc_String(Zone, Offset, "a");
+    CHECK(Crc == 0xE8B7BE43U, "\"a\" at +%u: 0x%08x", (unsigned)Offset, (unsigned)Crc);
+    Crc = Crc_String(Zone, Offset, Fox);
+    CHECK(Crc == 0x414FA339U, "fox at +%u: 0x%08x", (unsigned)Offset, (unsigned)Crc);
+  }
+
+  /* Random data, every alignment and size up to 1 KB */
+  for(i = 0; i < ZONE_SIZE; i++)
+    Zone[i] = (uint8_t)Test_Random();
+  for(Offset = 0; Offset < 4; Offset++)
+  {
+    for(Size = 0; Size <= 1024; Size++)
+    {
+      Address = (uint32_t)(uintptr_t)Zone + 64 + Offset;
+      Crc = CheckCRC(Address, Size);
+      Expected = Ref_Crc32(&Zone[64 + Offset], Size);
+      CHECK(Crc == Expected, "offset %u size %u: 0x%08x instead of 0x%08x",
+            (unsigned)Offset, (unsigned)Size, (unsigned)Crc, (unsigned)Expected);
+    }
+  }
+
+  /* Large zones, random and erased */
+  for(Offset = 0; Offset < 4; Offset++)
+  {
+    Size = ZONE_SIZE - 4 + (Offset & 1);
+    Crc = CheckCRC((uint32_t)(uintptr_t)Zone + Offset, Size);
+    Expected = Ref_Crc32(&Zone[Offset], Size);
+    CHECK(Crc == Expected, "offset %u size %u: 0x%08x instead of 0x%08x",
+          (unsigned)Offset, (unsigned)Size, (unsigned)Crc, (unsigned)Expected);
+  }
+  memset(Zone, 0xFF, ZONE_SIZE);
+  Crc = CheckCRC((uint32_t)(uintptr_t)Zone, ZONE_SIZE);
+  Expected = Ref_Crc32(Zone, ZONE_SIZE);
+  CHECK(Crc == Expected, "0xFF zone: 0x%08x instead of 0x%08x", (unsigned)Crc, (unsigned)Expected);
+
+#if defined(CRC_NO_REV)
+  return Test_Result("crc, no bit reversal");
+#else
+  return Test_Result("crc");
+#endif
+}
@@ -0,0 +1,291 @@
+/**
+  ******************************************************************************
+  * @file    test_lz4.c
+  * @brief   LZ4 block decoder of the loader: a block of the lz4 tool, blocks
+  *          of literals only and of overlapping matches, round trips through
+  *          a reference compressor, and truncated or malformed blocks, which
+  *          must be rejected without reading or writing out of the buffers.
+  ******************************************************************************
+  */
+
+#include "test.h"
+#include EXTRACTED
+
+#define PAGE_SIZE        4096U
+#define ROUND_TRIP_SIZE  4096U
+
+/* Block compressed with "lz4 -l -9" (legacy frame, its 8-byte header
+   removed), from the data of Reference_Data(): literal runs and matches of
+   more than 15 + 255 bytes, and matches at offsets 1 and 2 overlapping the
+   bytes they produce */
+static const uint8_t ReferenceBlock[] =
+{
+  0xFF, 0x1C, 0x53, 0x54, 0x4D, 0x33, 0x32, 0x20, 0x65, 0x78, 0x74, 0x65,
+  0x72, 0x6E, 0x61, 0x6C, 0x20, 0x6C, 0x6F, 0x61, 0x64, 0x65, 0x72, 0x20,
+  0x4C, 0x5A, 0x34, 0x20, 0x72, 0x65, 0x66, 0x65, 0x72, 0x65, 0x6E, 0x63,
+  0x65, 0x20, 0x62, 0x6C, 0x6F, 0x63, 0x6B, 0x2E, 0x20, 0x2B, 0x00, 0xC4,
+  0x1F, 0xFF, 0x01, 0x00, 0xFF, 0x19, 0x2F, 0x61, 0x62, 0x02, 0x00, 0x3B,
+  0xFF, 0x69, 0xC6, 0x7E, 0x81, 0x6B, 0x4B, 0xFB, 0xE2, 0xFB, 0x54, 0xF6,
+  0xBD, 0xDF, 0x7C, 0x1C, 0xE1, 0x87, 0x01, 0xBF, 0x31, 0xDE, 0x56, 0x72,
+  0x0F, 0x47, 0x67, 0x66, 0x87, 0x59, 0xAA, 0x88, 0x3C, 0x59, 0xEA, 0x56,
+  0x13, 0x7B, 0xD2, 0x85, 0xA1, 0xD8, 0x3C, 0x54, 0x55, 0x2F, 0x37, 0xAE,
+  0x65, 0x5B, 0xDA, 0x02, 0x79, 0x98, 0xCC, 0xE3, 0x1A, 0x76, 0x8E, 0x5F,
+  0xD9, 0x99, 0x8F, 0x1F, 0x3F, 0x36, 0xEE, 0x43, 0x78, 0x4D, 0x0D, 0xFA,
+  0xBE, 0xA6, 0xDA, 0xE4, 0x86, 0x8E, 0xDC, 0x29, 0x6D, 0x4E, 0xFF, 0x56,
+  0xE1, 0x70, 0x20, 0xFB, 0x8F, 0xB1, 0x58, 0x05, 0x90, 0xC5, 0x09, 0xDC,
+  0x53, 0xCD, 0xAA, 0x3B, 0x48, 0x99, 0x52, 0xD3, 0x52, 0x9D, 0x06, 0x9F,
+  0xEA, 0xB5, 0xC2, 0x06, 0x13, 0x98, 0x49, 0xB2, 0x01, 0x1E, 0xAC, 0x32,
+  0x88, 0x31, 0x75, 0x02, 0x6E, 0xF0, 0x01, 0x30, 0x31, 0x32, 0x33, 0x34,
+  0x35, 0x36, 0x37, 0x38, 0x39, 0x61, 0x62, 0x63, 0x64, 0x65, 0x66
+};
+
+#define REFERENCE_SIZE  903U
+
+static const char ReferenceText[] = "STM32 external loader LZ4 reference block. ";
+
+static uint32_t Reference_Data(uint8_t* Data)
+{
+  uint32_t Size = 0;
+  uint32_t Seed = 1;
+  uint32_t i;
+
+  for(i = 0; i < 6; i++, Size += sizeof(ReferenceText) - 1)
+    memcpy(&Data[Size], ReferenceText, sizeof(ReferenceText) - 1);
+  for(i = 0; i < 300; i++)
+    Data[Size++] = 0xFF;
+  for(i = 0; i < 40; i++)
+  {
+    Data[Size++] = 'a';
+    Data[Size++] = 'b';
+  }
+  for(i = 0; i < 120; i++)
+  {
+    Seed = Seed * 1103515245U + 12345U;
+    Data[Size++] = (uint8_t)(Seed >> 16);
+  }
+  for(i = 0; i < 3; i++, Size += sizeof(ReferenceText) - 1)
+    memcpy(&Data[Size], ReferenceText, sizeof(ReferenceText) - 1);
+  memcpy(&Data[Size], "0123456789abcdef", 16);
+
+  return Size + 16;
+}
+
+/* Buffer ending at an inaccessible page: reading or writing past its last
+   byte faults */
+static uint8_t* Guarded_Alloc(uint32_t Size)
+{
+  uint32_t Pages = (Size + PAGE_SIZE - 1) / PAGE_SIZE + 1;
+  uint8_t* Zone;
+
+  Zone = mmap(NULL, Pages * PAGE_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if(Zone == MAP_FAILED)
+  {
+    printf("cannot allocate %u bytes\n", (unsigned)Size);
+    exit(2);
+  }
+  mprotect(Zone + (Pages - 1) * PAGE_SIZE, PAGE_SIZE, PROT_NONE);
+
+  return Zone + (Pages - 1) * PAGE_SIZE - Size;
+}
+
+/* Reference compressor ---------------------------------------------------------*/
+static uint32_t Emit_Length(uint8_t* Dst, uint32_t Length)
+{
+  uint32_t Out = 0;
+
+  for(Length -= 15; Length >= 255; Length -= 255)
+    Dst[Out++] = 255;
+  Dst[Out++] = (uint8_t)Length;
+
+  return Out;
+}
+
+static uint32_t Emit_Sequence(uint8_t* Dst, const uint8_t* Literals, uint32_t LiteralLength,
+                              uint32_t Offset, uint32_t MatchLength)
+{
+  uint32_t Out = 1;
+
+  Dst[0] = (uint8_t)(((LiteralLength < 15) ? LiteralLength : 15) << 4);
+  if(LiteralLength >= 15)
+    Out += Emit_Length(&Dst[Out], LiteralLength);
+  memcpy(&Dst[Out], Literals, LiteralLength);
+  Out += LiteralLength;
+  if(MatchLength == 0)
+    return Out;
+
+  Dst[Out++] = (uint8_t)Offset;
+  Dst[Out++] = (uint8_t)(Offset >> 8);
+  MatchLength -= 4;
+  Dst[0] |= (uint8_t)((MatchLength < 15) ? MatchLength : 15);
+  if(MatchLength >= 15)
+    Out += Emit_Length(&Dst[Out], MatchLength);
+
+  return Out;
+}
+
+/* Greedy compressor following the end of block rules of the LZ4 format: the
+   last match starts 12 bytes and ends 5 bytes before the end of the data */
+static uint32_t LZ4_Compress(const uint8_t* Src, uint32_t Size, uint8_t* Dst)
+{
+  static uint32_t Table[4096];
+  uint32_t Anchor = 0;
+  uint32_t Pos = 0;
+  uint32_t Out = 0;
+  uint32_t Sequence;
+  uint32_t Candidate;
+  uint32_t Hash;
+  uint32_t Length;
+
+  memset(Table, 0xFF, sizeof(Table));
+  while(Pos + 12 <= Size)
+  {
+    memcpy(&Sequence, &Src[Pos], 4);
+    Hash = (Sequence * 2654435761U) >> 20;
+    Candidate = Table[Hash];
+    Table[Hash] = Pos;
+    if((Candidate != 0xFFFFFFFFU) && (Pos - Candidate <= 0xFFFF) &&
+       (memcmp(&Src[Candidate], &Src[Pos], 4) == 0))
+    {
+      Length = 4;
+      while((Pos + Length < Size - 5) && (Src[Candidate + Length] == Src[Pos + Length]))
+        Length++;
+      Out += Emit_Sequence(&Dst[Out], &Src[Anchor], Pos - Anchor, Pos - Candidate, Length);
+      Pos += Length;
+      Anchor = Pos;
+    }
+    else
+    {
+      Pos++;
+    }
+  }
+
+  return Out + Emit_Sequence(&Dst[Out], &Src[Anchor], Size - Anchor, 0, 0);
+}
+
+/* Tests ------------------------------------------------------------------------*/
+static void Decode_Case(const char* Name, const uint8_t* Block, uint32_t BlockSize,
+                        const uint8_t* Expected, uint32_t ExpectedSize)
+{
+  uint8_t* Src = Guarded_Alloc(BlockSize);
+  uint8_t* Dst = Guarded_Alloc(ExpectedSize);
+  uint32_t Decoded;
+
+  memcpy(Src, Block, BlockSize);
+  Decoded = LZ4_DecodeBlock(Src, BlockSize, Dst, ExpectedSize);
+  CHECK(Decoded == ExpectedSize, "%s: %u bytes decoded instead of %u", Name, (unsigned)Decoded, (unsigned)ExpectedSize);
+  CHECK(memcmp(Dst, Expected, ExpectedSize) == 0, "%s: wrong data", Name);
+
+  /* One byte short of the decoded size */
+  if(ExpectedSize != 0)
+  {
+    Dst = Guarded_Alloc(ExpectedSize - 1);
+    Decoded = LZ4_DecodeBlock(Src, BlockSize, Dst, ExpectedSize - 1);
+    CHECK(Decoded == 0, "%s: %u bytes decoded in %u", Name, (unsigned)Decoded, (unsigned)ExpectedSize - 1);
+  }
+}
+
+static void Reject_Case(const char* Name, const uint8_t* Block, uint32_t BlockSize, uint32_t DstSize)
+{
+  uint8_t* Src = Guarded_Alloc(BlockSize);
+  uint8_t* Dst = Guarded_Alloc(DstSize);
+  uint32_t Decoded;
+
+  memcpy(Src, Block, BlockSize);
+  Decoded = LZ4_DecodeBlock(Src, BlockSize, Dst, DstSize);
+  CHECK(Decoded == 0, "%s: %u bytes decoded instead of a failure", Name, (unsigned)Decoded);
+}
+
+static void Round_Trip(const char* Name, const uint8_t* Data, uint32_t Size)
+{
+  static uint8_t Block[2 * ROUND_TRIP_SIZE];
+  uint32_t BlockSize = LZ4_Compress(Data, Size, Block);
+
+  Decode_Case(Name, Block, BlockSize, Data, Size);
+}
+
+int main(void)
+{
+  /* Literals only: 8 bytes, and 15 + 255 + 2 bytes with two extension bytes */
+  static const uint8_t Literals8[] = {0x80, 'A', 'B', 'C', 'D', 'E', 'F', 'G', 'H'};
+  /* "abcd", a 12-byte match at offset 4, then 8 final literals */
+  static const uint8_t MatchThen8[] = {0x48, 'a', 'b', 'c', 'd', 0x04, 0x00,
+                                       0x80, '0', '1', '2', '3', '4', '5', '6', '7'};
+  static const char MatchThen8Data[] = "abcdabcdabcdabcd01234567";
+  /* "x", then a match of 4 + 15 + 255 + 10 bytes at offset 1 */
+  static const uint8_t Offset1[] = {0x1F, 'x', 0x01, 0x00, 0xFF, 0x0A, 0x00};
+  /* "xy", then a 19-byte match at offset 2 and an empty final run */
+  static const uint8_t Offset2[] = {0x2F, 'x', 'y', 0x02, 0x00, 0x00, 0x00};
+  /* Malformed blocks */
+  static const uint8_t ZeroOffset[] = {0x10, 'x', 0x00, 0x00, 0x00};
+  static const uint8_t FarOffset[] = {0x10, 'x', 0x02, 0x00, 0x00};
+  static const uint8_t LongLiterals[] = {0x50, 'a', 'b', 'c'};
+  static const uint8_t OpenLiteralLength[] = {0xF0, 0xFF};
+  static const uint8_t OpenMatchLength[] = {0x1F, 'x', 0x01, 0x00, 0xFF};
+  static const uint8_t HalfOffset[] = {0x10, 'x', 0x01};
+  uint8_t* Expected = Test_Alloc(ROUND_TRIP_SIZE);
+  uint8_t* Data = Test_Alloc(ROUND_TRIP_SIZE);
+  uint8_t* Dst;
+  uint8_t Literals[15 + 255 + 2 + 3];
+  uint32_t Size;
+  uint32_t Decoded;
+  uint32_t i;
+
+  /* Block of the lz4 tool */
+  Size = Reference_Data(Expected);
+  CHECK(Size == REFERENCE_SIZE, "reference data of %u bytes", (unsigned)Size);
+  Decode_Case("lz4 block", ReferenceBlock, sizeof(ReferenceBlock), Expected, Size);
+
+  /* Final literal runs, extended literal and match lengths, overlapping
+     matches */
+  Decode_Case("8 literals", Literals8, sizeof(Literals8), (const uint8_t*)"ABCDEFGH", 8);
+  Decode_Case("match and 8 literals", MatchThen8, sizeof(MatchThen8), (const uint8_t*)MatchThen8Data, 24);
+  Literals[0] = 0xF0;
+  Literals[1] = 0xFF;
+  Literals[2] = 0x02;
+  for(i = 0; i < 15 + 255 + 2; i++)
+    Data[i] = Literals[3 + i] = (uint8_t)Test_Random();
+  Decode_Case("272 literals", Literals, sizeof(Literals), Data, 15 + 255 + 2);
+  memset(Data, 'x', 1 + 4 + 15 + 255 + 10);
+  Decode_Case("offset 1", Offset1, sizeof(Offset1), Data, 1 + 4 + 15 + 255 + 10);
+  for(i = 0; i < 2 + 19; i++)
+    Data[i] = "xy"[i & 1];
+  Decode_Case("offset 2", Offset2, sizeof(Offset2), Data, 2 + 19);
+
+  /* Truncated lz4 block: rejected, or decoded up to a sequence end */
+  Dst = Guarded_Alloc(REFERENCE_SIZE);
+  for(Size = 0; Size < sizeof(ReferenceBlock); Size++)
+  {
+    uint8_t* Src = Guarded_Alloc(Size);
+
+    memcpy(Src, ReferenceBlock, Size);
+    Decoded = LZ4_DecodeBlock(Src, Size, Dst, REFERENCE_SIZE);
+    CHECK(Decoded < REFERENCE_SIZE, "block truncated to %u bytes: %u bytes decoded", (unsigned)Size, (unsigned)Decoded);
+    CHECK(memcmp(Dst, Expected, Decoded) == 0, "block truncated to %u bytes: wrong data", (unsigned)Size);
+  }
+
+  /* Malformed blocks */
+  Reject_Case("offset 0", ZeroOffset, sizeof(ZeroOffset), 64);
+  Reject_Case("offset before the data", FarOffset, sizeof(FarOffset), 64);
+  Reject_Case("literals past the block", LongLiterals, sizeof(LongLiterals), 64);
+  Reject_Case("literal length past the block", OpenLiteralLength, sizeof(OpenLiteralLength), 64);
+  Reject_Case("match length past the block", OpenMatchLength, sizeof(OpenMatchLength), 1024);
+  Reject_Case("offset past the block", HalfOffset, sizeof(HalfOffset), 64);
+  Reject_Case("match past the buffer", Offset1, sizeof(Offset1), 100);
+
+  /* Round trips: random, repeated and mixed data of all the small sizes */
+  for(i = 0; i < ROUND_TRIP_SIZE; i++)
+    Expected[i] = (uint8_t)Test_Random();
+  for(i = 0; i < ROUND_TRIP_SIZE; i++)
+    Data[i] = (i & 0x400) ? (uint8_t)(i % 7) : Expected[(i * 13) % 97];
+  for(Size = 1; Size <= 300; Size++)
+  {
+    Round_Trip("random data", Expected, Size);
+    Round_Trip("repeated data", Data, Size);
+  }
+  Round_Trip("random data", Expected, ROUND_TRIP_SIZE);
+  Round_Trip("mixed data", Data, ROUND_TRIP_SIZE);
+  memset(Data, 0xFF, ROUND_TRIP_SIZE);
+  Round_Trip("0xFF data", Data, ROUND_TRIP_SIZE);
+
+  return Test_Result("lz4");
+}
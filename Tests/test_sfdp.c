@@ -0,0 +1,215 @@
+/**
+  ******************************************************************************
+  * @file    test_sfdp.c
+  * @brief   SFDP parser of the MX25LM51245G loaders (sfdp.c): SFDP dumps of
+  *          3-byte, 3-or-4-byte and 4-byte address memories are decoded, and
+  *          a memory without SFDP, a failing read and a dump without basic
+  *          table are rejected.
+  ******************************************************************************
+  */
+
+#include "test.h"
+#include SFDP_SOURCE
+
+/* 3-byte addresses: JESD216 rev 1.0 header and a basic table of 9 DWORDs,
+   the geometry and fast reads of the MX25R6435F (8 MB, 4 KB, 32 KB and 64 KB
+   erases, 1-1-2, 1-2-2, 1-1-4 and 1-4-4 reads), without erase and program
+   times */
+static const uint8_t Dump_3Byte[] =
+{
+  0x53, 0x46, 0x44, 0x50, 0x00, 0x01, 0x00, 0xFF, 0x00, 0x00, 0x01, 0x09, 0x30, 0x00, 0x00, 0xFF,
+  0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+  0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+  0xE5, 0x20, 0xF1, 0xFF, 0xFF, 0xFF, 0xFF, 0x03, 0x44, 0xEB, 0x08, 0x6B, 0x08, 0x3B, 0x04, 0xBB,
+  0xEE, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x00, 0xFF, 0xFF, 0xFF, 0x00, 0xFF, 0x0C, 0x20, 0x0F, 0x52,
+  0x10, 0xD8, 0x00, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+};
+
+/* 3-byte or 4-byte addresses: JESD216C basic table of 20 DWORDs, 4-byte
+   address instruction table, xSPI profile 1.0 and a vendor table, the values
+   of the MX25LM51245G (64 MB, 4 KB and 64 KB erases, 8D-8D-8D) */
+static const uint8_t Dump_3Or4Byte[] =
+{
+  0x53, 0x46, 0x44, 0x50, 0x08, 0x01, 0x03, 0xFF, 0x00, 0x07, 0x01, 0x14, 0x30, 0x00, 0x00, 0xFF,
+  0x84, 0x00, 0x01, 0x02, 0x80, 0x00, 0x00, 0xFF, 0x05, 0x00, 0x01, 0x05, 0x90, 0x00, 0x00, 0xFF,
+  0xC2, 0x00, 0x01, 0x04, 0xC0, 0x00, 0x00, 0x00, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+  0xE5, 0x20, 0x82, 0xFF, 0xFF, 0xFF, 0xFF, 0x1F, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0xEE, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x00, 0xFF, 0xFF, 0xFF, 0x00, 0xFF, 0x0C, 0x20, 0x10, 0xD8,
+  0x00, 0x00, 0x00, 0x00, 0x82, 0x69, 0x01, 0x00, 0x81, 0x22, 0x00, 0x62, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xFF, 0xFF, 0xFF, 0x4F,
+  0x43, 0x06, 0x00, 0xFF, 0x21, 0xDC, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+  0xEE, 0x11, 0xEE, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+  0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+};
+
+/* 4-byte addresses only: a 1 GB memory whose density is given as 2^N bits.
+   A rev 1.0 basic table is followed by the rev 1.6 one of 16 DWORDs, the
+   erase types are listed out of size order, and the 4-byte address
+   instruction table comes right after the basic table: a read past the 16
+   DWORDs would take it for the 1-1-8 read of DWORD 17 */
+static const uint8_t Dump_4Byte[] =
+{
+  0x53, 0x46, 0x44, 0x50, 0x06, 0x01, 0x02, 0xFF, 0x00, 0x00, 0x01, 0x09, 0x30, 0x00, 0x00, 0xFF,
+  0x00, 0x06, 0x01, 0x10, 0x60, 0x00, 0x00, 0xFF, 0x84, 0x00, 0x01, 0x02, 0xA0, 0x00, 0x00, 0xFF,
+  0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+  0xE5, 0x21, 0x84, 0xFF, 0xFF, 0xFF, 0xFF, 0x07, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0xEE, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x00, 0xFF, 0xFF, 0xFF, 0x00, 0xFF, 0x10, 0xDC, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+  0xE5, 0x21, 0x84, 0xFF, 0x21, 0x00, 0x00, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0xEE, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x00, 0xFF, 0xFF, 0xFF, 0x00, 0xFF, 0x10, 0xDC, 0x0C, 0x21,
+  0x0F, 0x5C, 0x00, 0xFF, 0x90, 0xEA, 0x94, 0x00, 0x80, 0x0F, 0x00, 0x58, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0xF3, 0x0F, 0x38, 0x00, 0x21, 0x5C, 0xDC, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+};
+
+static const uint8_t* Dump;
+static uint32_t DumpSize;
+static uint32_t FailAddress;
+
+/* Reads the SFDP space of the dump, failing out of it or at FailAddress */
+static int32_t Dump_Read(uint32_t ReadAddr, uint8_t *pData, uint32_t Size)
+{
+  if((ReadAddr + Size > DumpSize) || ((FailAddress >= ReadAddr) && (FailAddress < ReadAddr + Size)))
+    return -1;
+  memcpy(pData, Dump + ReadAddr, Size);
+  return 0;
+}
+
+static int32_t Dump_Parse(const uint8_t* Data, uint32_t Size, SFDP_Info_t* Info)
+{
+  Dump = Data;
+  DumpSize = Size;
+  FailAddress = 0xFFFFFFFFU;
+  return SFDP_ReadInfo(Dump_Read, Info);
+}
+
+static void Check_Erase(const char* Name, const SFDP_Info_t* Info, uint32_t Index, uint32_t Size,
+                        uint32_t Opcode, uint32_t TypicalTime, uint32_t MaxTime)
+{
+  const SFDP_Erase_t* Erase = &Info->Erase[Index];
+
+  CHECK((Erase->Size == Size) && (Erase->Opcode == Opcode) &&
+        (Erase->TypicalTime == TypicalTime) && (Erase->MaxTime == MaxTime),
+        "%s erase %u: %u bytes, 0x%02X, %u ms, %u ms max", Name, (unsigned)Index,
+        (unsigned)Erase->Size, (unsigned)Erase->Opcode, (unsigned)Erase->TypicalTime,
+        (unsigned)Erase->MaxTime);
+}
+
+static void Check_FastRead(const char* Name, const SFDP_Info_t* Info, uint32_t Index,
+                           uint32_t Opcode, uint32_t DummyCycles)
+{
+  const SFDP_FastRead_t* Read = &Info->FastRead[Index];
+
+  CHECK((Read->Opcode == Opcode) && (Read->DummyCycles == DummyCycles),
+        "%s fast read %u: 0x%02X, %u dummy cycles", Name, (unsigned)Index,
+        (unsigned)Read->Opcode, (unsigned)Read->DummyCycles);
+}
+
+int main(void)
+{
+  SFDP_Info_t Info;
+  uint8_t Copy[sizeof(Dump_3Or4Byte)];
+  int32_t Result;
+
+  /* 3-byte addresses */
+  Result = Dump_Parse(Dump_3Byte, sizeof(Dump_3Byte), &Info);
+  CHECK(Result == SFDP_OK, "3-byte dump: result %d", (int)Result);
+  CHECK((Info.Revision == 0x0100U) && (Info.BfptRevision == 0x0100U),
+        "3-byte dump: revisions 0x%04X 0x%04X", (unsigned)Info.Revision, (unsigned)Info.BfptRevision);
+  CHECK(Info.AddressBytes == SFDP_ADDRESS_3, "3-byte dump: address bytes %u", (unsigned)Info.AddressBytes);
+  CHECK(Info.Density == 0x800000U, "3-byte dump: density 0x%08X", (unsigned)Info.Density);
+  CHECK(Info.ReadModes == (SFDP_MODE_1S_1S_1S | SFDP_MODE_1S_1S_2S | SFDP_MODE_1S_2S_2S |
+                           SFDP_MODE_1S_1S_4S | SFDP_MODE_1S_4S_4S),
+        "3-byte dump: read modes 0x%04X", (unsigned)Info.ReadModes);
+  CHECK(Info.ProgramModes == SFDP_MODE_1S_1S_1S, "3-byte dump: program modes 0x%04X", (unsigned)Info.ProgramModes);
+  CHECK(SFDP_FastestMode(Info.ReadModes) == SFDP_MODE_1S_4S_4S, "3-byte dump: fastest read");
+  Check_FastRead("3-byte dump", &Info, SFDP_READ_1S_1S_2S, 0x3B, 8);
+  Check_FastRead("3-byte dump", &Info, SFDP_READ_1S_2S_2S, 0xBB, 4);
+  Check_FastRead("3-byte dump", &Info, SFDP_READ_1S_1S_4S, 0x6B, 8);
+  Check_FastRead("3-byte dump", &Info, SFDP_READ_1S_4S_4S, 0xEB, 6);
+  Check_FastRead("3-byte dump", &Info, SFDP_READ_4S_4S_4S, 0x00, 0);
+  /* No timing DWORDs in a rev 1.0 table */
+  Check_Erase("3-byte dump", &Info, 0, 0x1000, 0x20, 0, 0);
+  Check_Erase("3-byte dump", &Info, 1, 0x8000, 0x52, 0, 0);
+  Check_Erase("3-byte dump", &Info, 2, 0x10000, 0xD8, 0, 0);
+  Check_Erase("3-byte dump", &Info, 3, 0, 0, 0, 0);
+  CHECK((Info.PageSize == 0U) && (Info.PageProgramTime == 0U) && (Info.ChipEraseTime == 0U),
+        "3-byte dump: page of %u bytes, %u us, chip erase %u ms", (unsigned)Info.PageSize,
+        (unsigned)Info.PageProgramTime, (unsigned)Info.ChipEraseTime);
+
+  /* 3-byte or 4-byte addresses */
+  Result = Dump_Parse(Dump_3Or4Byte, sizeof(Dump_3Or4Byte), &Info);
+  CHECK(Result == SFDP_OK, "3-or-4-byte dump: result %d", (int)Result);
+  CHECK((Info.Revision == 0x0108U) && (Info.BfptRevision == 0x0107U),
+        "3-or-4-byte dump: revisions 0x%04X 0x%04X", (unsigned)Info.Revision, (unsigned)Info.BfptRevision);
+  CHECK(Info.AddressBytes == SFDP_ADDRESS_3_OR_4, "3-or-4-byte dump: address bytes %u", (unsigned)Info.AddressBytes);
+  CHECK(Info.Density == 0x4000000U, "3-or-4-byte dump: density 0x%08X", (unsigned)Info.Density);
+  CHECK(Info.ReadModes == (SFDP_MODE_1S_1S_1S | SFDP_MODE_8D_8D_8D),
+        "3-or-4-byte dump: read modes 0x%04X", (unsigned)Info.ReadModes);
+  CHECK(Info.ProgramModes == (SFDP_MODE_1S_1S_1S | SFDP_MODE_8D_8D_8D),
+        "3-or-4-byte dump: program modes 0x%04X", (unsigned)Info.ProgramModes);
+  CHECK(SFDP_FastestMode(Info.ReadModes) == SFDP_MODE_8D_8D_8D, "3-or-4-byte dump: fastest read");
+  Check_Erase("3-or-4-byte dump", &Info, 0, 0x1000, 0x20, 25, 150);
+  Check_Erase("3-or-4-byte dump", &Info, 1, 0x10000, 0xD8, 224, 1344);
+  Check_Erase("3-or-4-byte dump", &Info, 2, 0, 0, 0, 0);
+  CHECK((Info.PageSize == 256U) && (Info.PageProgramTime == 192U) && (Info.PageProgramMaxTime == 768U),
+        "3-or-4-byte dump: page of %u bytes, %u us, %u us max", (unsigned)Info.PageSize,
+        (unsigned)Info.PageProgramTime, (unsigned)Info.PageProgramMaxTime);
+  CHECK((Info.ChipEraseTime == 192000U) && (Info.ChipEraseMaxTime == 768000U),
+        "3-or-4-byte dump: chip erase %u ms, %u ms max", (unsigned)Info.ChipEraseTime,
+        (unsigned)Info.ChipEraseMaxTime);
+
+  /* 4-byte addresses only */
+  Result = Dump_Parse(Dump_4Byte, sizeof(Dump_4Byte), &Info);
+  CHECK(Result == SFDP_OK, "4-byte dump: result %d", (int)Result);
+  CHECK((Info.Revision == 0x0106U) && (Info.BfptRevision == 0x0106U),
+        "4-byte dump: revisions 0x%04X 0x%04X", (unsigned)Info.Revision, (unsigned)Info.BfptRevision);
+  CHECK(Info.AddressBytes == SFDP_ADDRESS_4, "4-byte dump: address bytes %u", (unsigned)Info.AddressBytes);
+  CHECK(Info.Density == 0x40000000U, "4-byte dump: density 0x%08X", (unsigned)Info.Density);
+  CHECK(Info.ReadModes == (SFDP_MODE_1S_1S_1S | SFDP_MODE_1S_8S_8S),
+        "4-byte dump: read modes 0x%04X", (unsigned)Info.ReadModes);
+  CHECK(Info.ProgramModes == (SFDP_MODE_1S_1S_1S | SFDP_MODE_1S_1S_4S | SFDP_MODE_1S_4S_4S |
+                              SFDP_MODE_1S_1S_8S | SFDP_MODE_1S_8S_8S),
+        "4-byte dump: program modes 0x%04X", (unsigned)Info.ProgramModes);
+  CHECK(SFDP_FastestMode(Info.ProgramModes) == SFDP_MODE_1S_8S_8S, "4-byte dump: fastest program");
+  Check_Erase("4-byte dump", &Info, 0, 0x1000, 0x21, 30, 60);
+  Check_Erase("4-byte dump", &Info, 1, 0x8000, 0x5C, 96, 192);
+  Check_Erase("4-byte dump", &Info, 2, 0x10000, 0xDC, 160, 320);
+  Check_Erase("4-byte dump", &Info, 3, 0, 0, 0, 0);
+  CHECK((Info.PageSize == 256U) && (Info.PageProgramTime == 128U) && (Info.PageProgramMaxTime == 256U),
+        "4-byte dump: page of %u bytes, %u us, %u us max", (unsigned)Info.PageSize,
+        (unsigned)Info.PageProgramTime, (unsigned)Info.PageProgramMaxTime);
+  CHECK((Info.ChipEraseTime == 100000U) && (Info.ChipEraseMaxTime == 200000U),
+        "4-byte dump: chip erase %u ms, %u ms max", (unsigned)Info.ChipEraseTime,
+        (unsigned)Info.ChipEraseMaxTime);
+
+  /* A memory without SFDP reads erased bytes */
+  memset(Copy, 0xFF, sizeof(Copy));
+  Result = Dump_Parse(Copy, sizeof(Copy), &Info);
+  CHECK(Result == SFDP_ERROR_SIGNATURE, "erased memory: result %d", (int)Result);
+
+  /* Failing reads of the header, a parameter header and the basic table */
+  Dump_Parse(Dump_3Or4Byte, sizeof(Dump_3Or4Byte), &Info);
+  FailAddress = 0x00;
+  CHECK(SFDP_ReadInfo(Dump_Read, &Info) == SFDP_ERROR_READ, "header read failure not reported");
+  FailAddress = 0x18;
+  CHECK(SFDP_ReadInfo(Dump_Read, &Info) == SFDP_ERROR_READ, "parameter header read failure not reported");
+  FailAddress = 0x30 + 19 * 4;
+  CHECK(SFDP_ReadInfo(Dump_Read, &Info) == SFDP_ERROR_READ, "basic table read failure not reported");
+  FailAddress = 0x80;
+  CHECK(SFDP_ReadInfo(Dump_Read, &Info) == SFDP_ERROR_READ, "4-byte table read failure not reported");
+
+  /* Only the vendor table left: no basic table */
+  memcpy(Copy, Dump_3Or4Byte, sizeof(Copy));
+  Copy[6] = 0;
+  memcpy(&Copy[8], &Dump_3Or4Byte[32], 8);
+  Result = Dump_Parse(Copy, sizeof(Copy), &Info);
+  CHECK(Result == SFDP_ERROR_NO_BFPT, "no basic table: result %d", (int)Result);
+
+  CHECK(SFDP_FastestMode(0) == 0U, "fastest of no mode");
+
+  return Test_Result("sfdp");
+}
@@ -0,0 +1,101 @@
+/**
+  ******************************************************************************
+  * @file    test_sha256.c
+  * @brief   CheckSHA256 of the loader: the FIPS 180-2 examples, and the
+  *          sizes around the 56 and 64-byte limits of the padding, at all
+  *          the alignments of the start address. Built with HASH_UNIT, it
+  *          checks the HASH unit variant against the model of test.h.
+  ******************************************************************************
+  */
+
+#include "test.h"
+#include EXTRACTED
+
+#define ZONE_SIZE  0x100000U
+
+typedef struct
+{
+  uint32_t Size;
+  const char* Digest;
+} SHA256_Vector_t;
+
+/* Digests of the bytes (i * 31 + 7) & 0xFF, computed with Python hashlib */
+static const SHA256_Vector_t PatternVectors[] =
+{
+  {   1, "ca358758f6d27e6cf45272937977a748fd88391db679ceda7dc7bf1f005ee879"},
+  {   3, "647674a296197442f518bcca323ec605dd8d098b2d4f22ee1fdcdd2bb753a189"},
+  {   4, "b999f79c534a332dfb989ab78cda3d1967c16133ca1d668cf62737f8d768962f"},
+  {  55, "8aa994584139d128848eeebc4e815639ba5ab6e6e39574195a63ac4f14f7c43b"},
+  {  56, "ad574708f75c044c9b85de64cb568ee7711ff4f36448c6242f053ba8f6cc2b63"},
+  {  57, "5b46e502092be01b1100193e089fdda95638c12e19a1d24f308eb2c3d3ae849d"},
+  {  63, "280ed3e8ff1df845b2e7dfe6ac6cee817bef20e783cc65abc41b818b4d2fe076"},
+  {  64, "c6ab9724ade5b6a7a1edfffb12f3aa9181351355af8fd08c919952ad211339dd"},
+  {  65, "788367c73c7ddf4c53f65e68cc0d943e6227ab55b0e78ba63ace822b1c6301c0"},
+  { 119, "3d610547d68216dedf7435a4fb6260353911f6b3fd3f18805ddb8be285d726fe"},
+  { 120, "1f80156a804cb7862ad113e8200e9d74499723e7c7854d5f48776d3148e09656"},
+  { 127, "192409cd280e14b743642ad1343fbd3e82d9305de72c078117745a679210cc3d"},
+  { 128, "cc548ca2dec1f6fe4f58b2e27aa9c7521607df1130d140b55a4dad0665302356"},
+  {1000, "5097e7d587352f5097062ae679f37bda5802d9f875aba14c8cb4d1a188ada179"},
+  {4096, "d41d438c379110c7f7b2c561b1f04f26c1b4549110791f8e022f48974280c13e"},
+};
+
+static uint8_t* Zone;
+
+static void Check_Digest(const char* Name, uint32_t Offset, uint32_t Size, const char* Expected)
+{
+  uint8_t Digest[32];
+  char Hex[65];
+  int Result;
+  int i;
+
+  Result = CheckSHA256((uint32_t)(uintptr_t)&Zone[Offset], Size, Digest);
+  for(i = 0; i < 32; i++)
+    sprintf(&Hex[2 * i], "%02x", Digest[i]);
+  CHECK((Result == 1) && (strcmp(Hex, Expected) == 0), "%s, %u bytes at +%u: %s",
+        Name, (unsigned)Size, (unsigned)Offset, Hex);
+}
+
+static void Check_String(const char* Name, uint32_t Offset, const char* String, const char* Expected)
+{
+  memcpy(&Zone[Offset], String, strlen(String));
+  Check_Digest(Name, Offset, strlen(String), Expected);
+}
+
+int main(void)
+{
+  uint32_t Offset;
+  uint32_t i, j;
+
+  Zone = Test_Alloc(ZONE_SIZE + 4);
+
+  for(Offset = 0; Offset < 4; Offset++)
+  {
+    /* FIPS 180-2 examples */
+    Check_String("\"abc\"", Offset, "abc",
+                 "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad");
+    Check_String("empty zone", Offset, "",
+                 "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855");
+    Check_String("448-bit message", Offset, "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq",
+                 "248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1");
+
+    /* Sizes around the padding limits */
+    for(i = 0; i < 4096; i++)
+      Zone[Offset + i] = (uint8_t)(i * 31 + 7);
+    for(j = 0; j < sizeof(PatternVectors) / sizeof(PatternVectors[0]); j++)
+      Check_Digest("pattern", Offset, PatternVectors[j].Size, PatternVectors[j].Digest);
+  }
+
+  /* One million "a", the last FIPS 180-2 example */
+  memset(Zone, 'a', 1000000);
+  Check_Digest("1000000 \"a\"", 0, 1000000,
+               "cdc76e5c9914fb9281a1c7e284d73e67f1809a48a497200e046d39ccc7112cd0");
+  memmove(&Zone[3], Zone, 1000000);
+  Check_Digest("1000000 \"a\"", 3, 1000000,
+               "cdc76e5c9914fb9281a1c7e284d73e67f1809a48a497200e046d39ccc7112cd0");
+
+#if defined(HASH_UNIT)
+  return Test_Result("sha256, HASH unit");
+#else
+  return Test_Result("sha256");
+#endif
+}
@@ -0,0 +1,101 @@
+/**
+  ******************************************************************************
+  * @file    test_verify.c
+  * @brief   Verify of the loader against the byte by byte Verify it replaced:
+  *          same checksum and same failure address, for aligned and
+  *          unaligned zones, all the leading and trailing byte counts, and
+  *          differences at the start, inside and at the end of the zone.
+  ******************************************************************************
+  */
+
+#include "test.h"
+#include "reference.h"
+#include EXTRACTED
+
+/* The FMC NOR loaders kept their own failure address */
+#if defined(NOR_VERIFY)
+#define Ref_LoaderVerify  Ref_NorVerify
+#else
+#define Ref_LoaderVerify  Ref_Verify
+#endif
+
+#define ZONE_SIZE  0x4000U
+
+static uint8_t* Memory;
+static uint8_t* Buffer;
+
+static void Verify_Case(uint32_t MemoryOffset, uint32_t BufferOffset, uint32_t Words, uint32_t Missalignement)
+{
+  uint32_t MemoryAddr = (uint32_t)(uintptr_t)Memory + MemoryOffset;
+  uint32_t BufferAddr = (uint32_t)(uintptr_t)Buffer + BufferOffset;
+  uint32_t Size = 4 * Words;
+  uint32_t Diff[6];
+  uint32_t i;
+  uint64_t Result, Expected;
+
+  memcpy((void*)(uintptr_t)BufferAddr, (const void*)(uintptr_t)MemoryAddr, Size);
+  Result = Verify(MemoryAddr, BufferAddr, Words, Missalignement);
+  Expected = Ref_LoaderVerify(MemoryAddr, BufferAddr, Words, Missalignement);
+  CHECK(Result == Expected, "match, memory +%u buffer +%u, %u words, missalignement 0x%x: 0x%016llx instead of 0x%016llx",
+        (unsigned)MemoryOffset, (unsigned)BufferOffset, (unsigned)Words, (unsigned)Missalignement,
+        (unsigned long long)Result, (unsigned long long)Expected);
+
+  if(Size == 0)
+    return;
+
+  /* One differing byte, in the first and last words and inside the zone */
+  Diff[0] = 0;
+  Diff[1] = (Size > 1) ? 1 : 0;
+  Diff[2] = (Size > 3) ? 3 : 0;
+  Diff[3] = Size / 2;
+  Diff[4] = Size - 1;
+  Diff[5] = (Size > 4) ? Size - 4 : 0;
+  for(i = 0; i < 6; i++)
+  {
+    ((uint8_t*)(uintptr_t)BufferAddr)[Diff[i]] ^= 0x5A;
+    Result = Verify(MemoryAddr, BufferAddr, Words, Missalignement);
+    Expected = Ref_LoaderVerify(MemoryAddr, BufferAddr, Words, Missalignement);
+    CHECK(Result == Expected, "byte %u differs, memory +%u buffer +%u, %u words, missalignement 0x%x: 0x%016llx instead of 0x%016llx",
+          (unsigned)Diff[i], (unsigned)MemoryOffset, (unsigned)BufferOffset, (unsigned)Words, (unsigned)Missalignement,
+          (unsigned long long)Result, (unsigned long long)Expected);
+    ((uint8_t*)(uintptr_t)BufferAddr)[Diff[i]] ^= 0x5A;
+  }
+}
+
+int main(void)
+{
+  static const uint32_t LargeWords[] = {127, 128, 129, 255, 256, 257, 1000, 2048};
+  uint32_t MemoryOffset, BufferOffset;
+  uint32_t Words;
+  uint32_t Head, Tail;
+  uint32_t i;
+
+  Memory = Test_Alloc(ZONE_SIZE);
+  Buffer = Test_Alloc(ZONE_SIZE);
+  for(i = 0; i < ZONE_SIZE; i++)
+    Memory[i] = (uint8_t)Test_Random();
+
+  /* Small zones, all the alignments and leading and trailing byte counts */
+  for(MemoryOffset = 0; MemoryOffset < 4; MemoryOffset++)
+    for(BufferOffset = 0; BufferOffset < 4; BufferOffset++)
+      for(Words = 0; Words <= 24; Words++)
+        for(Head = 0; Head < 4; Head++)
+          for(Tail = 0; Tail < 4; Tail++)
+            Verify_Case(MemoryOffset, BufferOffset, Words, Head | (Tail << 16));
+
+  /* Zones across the lane folds and the 256-byte limit of the partial word */
+  for(i = 0; i < sizeof(LargeWords) / sizeof(LargeWords[0]); i++)
+    for(Head = 0; Head < 4; Head++)
+      for(Tail = 0; Tail < 4; Tail++)
+      {
+        Verify_Case(0, 0, LargeWords[i], Head | (Tail << 16));
+        Verify_Case(2, 0, LargeWords[i], Head | (Tail << 16));
+      }
+
+  /* Zones of 0xFF bytes, the worst case of the lane sums */
+  memset(Memory, 0xFF, ZONE_SIZE);
+  Verify_Case(0, 0, ZONE_SIZE / 4, 0);
+  Verify_Case(0, 0, ZONE_SIZE / 4 - 1, 3 | (2 << 16));
+
+  return Test_Result("verify");
+}
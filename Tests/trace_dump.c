@@ -0,0 +1,123 @@
+/**
+  ******************************************************************************
+  * @file    trace_dump.c
+  * @brief   Decoder of the CommandTrace ring of the loaders built with
+  *          USE_COMMAND_TRACE (loader_trace.h). It reads a memory image, as
+  *          the RAM read back by the STM32CubeProgrammer CLI, finds the
+  *          trace in it, and prints the records from the oldest one: the
+  *          loader entry points, the BSP calls and returns, and each command
+  *          sent to the memory with its instruction, the lines of its
+  *          phases, its address bytes, dummy cycles, address and data size.
+  ******************************************************************************
+  */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "loader_trace.h"
+
+static const char* Entries[] = {"Init", "Write", "SectorErase", "MassErase", "Verify", "CheckSum",
+                                "CheckCRC", "CheckSHA256"};
+static const char* BspCalls[] = {"init", "deinit", "read", "write", "erase block", "erase chip", "wait",
+                                 "read ID", "read SFDP", "memory-mapped", "indirect"};
+static const char* HalCalls[] = {"command", "polling", "mapped"};
+
+#define NAME(Names, Index)  (((Index) < sizeof(Names) / sizeof(Names[0])) ? Names[Index] : "?")
+
+static void Record_Print(const TRACE_RECORD* Record, uint32_t Previous)
+{
+  uint32_t Modes = Record->Modes;
+
+  printf("%10u %+10d  ", (unsigned)Record->Cycles, (int)(Record->Cycles - Previous));
+  switch(Record->Kind)
+  {
+  case TRACE_OPERATION:
+    printf("%-13s %u bytes\n", NAME(Entries, Record->Call), (unsigned)Record->Size);
+    break;
+  case TRACE_CALL:
+    printf("  call   %-13s 0x%08X %u bytes\n", NAME(BspCalls, Record->Call), (unsigned)Record->Address,
+           (unsigned)Record->Size);
+    break;
+  case TRACE_RETURN:
+    printf("  return %-13s status %d\n", NAME(BspCalls, Record->Call), (int)Record->Status);
+    break;
+  case TRACE_COMMAND:
+    printf("    %-8s 0x%02X %u-%u-%u%s", NAME(HalCalls, Record->Call), (unsigned)Record->Instruction,
+           (unsigned)TRACE_MODES_INSTRUCTION(Modes), (unsigned)TRACE_MODES_ADDRESS(Modes),
+           (unsigned)TRACE_MODES_DATA(Modes), ((Modes & TRACE_MODES_DTR) != 0U) ? " DTR" : "");
+    if(TRACE_MODES_ADDRESS(Modes) != 0U)
+      printf(" address 0x%08X (%u bytes)", (unsigned)Record->Address, (unsigned)TRACE_MODES_ADDRESS_BYTES(Modes));
+    if(TRACE_MODES_DUMMY(Modes) != 0U)
+      printf(" %u dummy cycles", (unsigned)TRACE_MODES_DUMMY(Modes));
+    if(Record->Size != 0U)
+      printf(" %u data bytes", (unsigned)Record->Size);
+    printf(" status %d\n", (int)Record->Status);
+    break;
+  default:
+    printf("kind %u?\n", (unsigned)Record->Kind);
+    break;
+  }
+}
+
+int main(int argc, char** argv)
+{
+  const TRACE_BUFFER* Trace = NULL;
+  uint8_t* File;
+  long FileSize;
+  long Offset;
+  FILE* Input;
+  uint32_t Count;
+  uint32_t Previous;
+  uint32_t i;
+
+  if((argc < 2) || (argc > 3))
+  {
+    printf("usage: %s <memory image> [offset of CommandTrace in the image]\n", argv[0]);
+    return 1;
+  }
+  if(((Input = fopen(argv[1], "rb")) == NULL) || (fseek(Input, 0, SEEK_END) != 0) || ((FileSize = ftell(Input)) < 0))
+  {
+    printf("%s: cannot be read\n", argv[1]);
+    return 1;
+  }
+  File = malloc(FileSize + 1);
+  rewind(Input);
+  if((File == NULL) || (fread(File, 1, FileSize, Input) != (size_t)FileSize))
+    return 1;
+  fclose(Input);
+
+  /* The trace is the one at the offset given, or the first one initialized
+     in the image */
+  for(Offset = (argc == 3) ? strtol(argv[2], NULL, 0) : 0;
+      Offset + (long)sizeof(TRACE_BUFFER) <= FileSize; Offset += 4)
+  {
+    if((((const TRACE_BUFFER*)(File + Offset))->Magic == TRACE_MAGIC) &&
+       (((const TRACE_BUFFER*)(File + Offset))->Depth == TRACE_DEPTH))
+    {
+      Trace = (const TRACE_BUFFER*)(File + Offset);
+      break;
+    }
+    if(argc == 3)
+      break;
+  }
+  if(Trace == NULL)
+  {
+    printf("%s: no CommandTrace of %u records\n", argv[1], (unsigned)TRACE_DEPTH);
+    return 1;
+  }
+
+  Count = (Trace->Head < TRACE_DEPTH) ? Trace->Head : TRACE_DEPTH;
+  printf("CommandTrace at offset 0x%lX, %u records logged, the last %u kept\n", (unsigned long)Offset,
+         (unsigned)Trace->Head, (unsigned)Count);
+  printf("    Cycles      Delta  Record\n");
+  Previous = Trace->Records[(Trace->Head - Count) % TRACE_DEPTH].Cycles;
+  for(i = Trace->Head - Count; i != Trace->Head; i++)
+  {
+    Record_Print(&Trace->Records[i % TRACE_DEPTH], Previous);
+    Previous = Trace->Records[i % TRACE_DEPTH].Cycles;
+  }
+  free(File);
+
+  return 0;
+}